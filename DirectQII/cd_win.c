@@ -33,6 +33,7 @@ static qboolean	playing = false;
 static qboolean	wasPlaying = false;
 static qboolean	enabled = false;
 static qboolean playLooping = false;
+static qboolean streaming = false;	// a wav track going through the sound system rather than MCI
 
 static byte remap[100];
 
@@ -161,11 +162,22 @@ qboolean CDAudio_TryPlay (char *track, qboolean looping)
 void CDAudio_Play2 (int track, qboolean looping)
 {
 	// if the same track is requested, and if it's currently playing, just continue it
-	if (playing && playTrack == track) return;
+	if (playing && playTrack == track && (!streaming || S_StreamPlaying ())) return;
 
 	// stop whatever is currently playing
 	CDAudio_Stop ();
 
+	// wav tracks are streamed by the sound system from the game filesystem, so they can be in a pak
+	// (a streamed track loops on itself rather than moving to cd_looptrack)
+	if (track > 0 && track < 100 && S_StartStream (va ("music/track%02i.wav", remap[track]), looping))
+	{
+		playLooping = looping;
+		playTrack = track;
+		playing = true;
+		streaming = true;
+		return;
+	}
+
 	// if any of these are NULL we didn't get any tracks
 	if (!cd_basedir[0]) return;
 	if (!cd_ext[0]) return;
@@ -201,6 +213,13 @@ void CDAudio_Stop (void)
 	if (!enabled) return;
 	if (!playing) return;
 
+	if (streaming)
+	{
+		S_StopStream ();
+		streaming = wasPlaying = playing = false;
+		return;
+	}
+
 	mciSendString ("stop "Q_MCI_DEVICE, NULL, 0, 0);
 	mciSendString ("close "Q_MCI_DEVICE, NULL, 0, 0);
 	wDeviceID = 0; // device is not open
@@ -215,7 +234,9 @@ void CDAudio_Pause (void)
 	if (!enabled) return;
 	if (!playing) return;
 
-	mciSendString ("pause "Q_MCI_DEVICE, NULL, 0, 0);
+	if (streaming)
+		S_PauseStream (true);
+	else mciSendString ("pause "Q_MCI_DEVICE, NULL, 0, 0);
 
 	wasPlaying = playing;
 	playing = false;
@@ -227,7 +248,9 @@ void CDAudio_Resume (void)
 	if (!enabled) return;
 	if (!wasPlaying) return;
 
-	mciSendString ("resume "Q_MCI_DEVICE, NULL, 0, 0);
+	if (streaming)
+		S_PauseStream (false);
+	else mciSendString ("resume "Q_MCI_DEVICE, NULL, 0, 0);
 
 	playing = true;
 }
@@ -385,7 +408,8 @@ LONG CDAudio_MessageHandler (HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 
 void CDAudio_Update (void)
 {
-	if (playing)
+	// streams take bgmvolume as they're mixed
+	if (playing && !streaming)
 		CDAudio_SetVolume (false);
 }
 
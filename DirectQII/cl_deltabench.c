@@ -0,0 +1,348 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// cl_deltabench.c -- entity and playerstate delta coding timed over a recorded demo
+
+#include "client.h"
+
+/*
+==============================================================================
+
+DELTA BENCHMARK
+
+"deltabench <demo> [passes]" plays the demo and keeps the playerstate and
+entity list of every valid frame that is parsed.  when the demo ends each
+frame is delta encoded against the one before it the same way the server
+does it, then the result is decoded again by the client's own frame parser,
+so both sides are timed on the data of a real game.
+
+for a quick run:
+	quake2 +set vid_null 1 +set timedemo 1 +deltabench demo1.dm2
+
+==============================================================================
+*/
+
+typedef struct dbframe_s
+{
+	player_state_t	ps;
+	int				firstentity;
+	int				numentities;
+	int				msgstart;		// the encoded frame in db_msg
+	int				msglen;
+} dbframe_t;
+
+#define	DB_SCRATCH		0x10000		// far more than one frame can encode to
+
+static dbframe_t *db_frames = NULL;
+static int db_numframes = 0;
+static int db_maxframes = 0;
+
+static entity_state_t *db_entities = NULL;
+static int db_numentities = 0;
+static int db_maxentities = 0;
+
+static byte *db_msg = NULL;
+static int db_msglen = 0;
+static int db_maxmsg = 0;
+
+static qboolean db_capturing = false;
+static int db_passes = 0;
+
+
+static void *CL_DeltaBench_Grow (void *data, int count, int needed, int *max, int size)
+{
+	int newmax = *max ? *max : 1024;
+	byte *newdata;
+
+	while (newmax < needed)
+		newmax *= 2;
+
+	if (newmax == *max)
+		return data;
+
+	newdata = (byte *) Zone_Alloc (newmax * size);
+
+	if (data)
+	{
+		memcpy (newdata, data, count * size);
+		Zone_Free (data);
+	}
+
+	*max = newmax;
+
+	return newdata;
+}
+
+
+static void CL_DeltaBench_Free (void)
+{
+	if (db_frames) Zone_Free (db_frames);
+	if (db_entities) Zone_Free (db_entities);
+	if (db_msg) Zone_Free (db_msg);
+
+	db_frames = NULL;
+	db_entities = NULL;
+	db_msg = NULL;
+
+	db_numframes = db_maxframes = 0;
+	db_numentities = db_maxentities = 0;
+	db_msglen = db_maxmsg = 0;
+}
+
+
+/*
+==================
+CL_DeltaBench_Capture
+
+called from CL_ParseFrame with each valid frame
+==================
+*/
+void CL_DeltaBench_Capture (frame_t *frame)
+{
+	dbframe_t *f;
+	int i;
+
+	if (!db_capturing)
+		return;
+
+	db_frames = (dbframe_t *) CL_DeltaBench_Grow (db_frames, db_numframes, db_numframes + 1, &db_maxframes, sizeof (dbframe_t));
+	db_entities = (entity_state_t *) CL_DeltaBench_Grow (db_entities, db_numentities, db_numentities + frame->num_entities, &db_maxentities, sizeof (entity_state_t));
+
+	f = &db_frames[db_numframes++];
+
+	f->ps = frame->playerstate;
+	f->firstentity = db_numentities;
+	f->numentities = frame->num_entities;
+
+	for (i = 0; i < frame->num_entities; i++)
+		db_entities[db_numentities++] = cl_parse_entities[(frame->parse_entities + i) & (MAX_PARSE_ENTITIES - 1)];
+}
+
+
+/*
+==================
+CL_DeltaBench_Encode
+
+the playerstate body followed by the packet entities, as SV_WriteFrameToClient
+writes them; entities that are new to a frame are sent from a zeroed baseline
+==================
+*/
+static void CL_DeltaBench_Encode (dbframe_t *from, dbframe_t *to, sizebuf_t *msg)
+{
+	static player_state_t nullps;
+	static entity_state_t nullstate;
+	entity_state_t *oldent = NULL, *newent = NULL;
+	int oldindex = 0, newindex = 0;
+	int from_num_entities = from ? from->numentities : 0;
+
+	MSG_WriteDeltaPlayerstate (from ? &from->ps : &nullps, &to->ps, msg);
+
+	while (newindex < to->numentities || oldindex < from_num_entities)
+	{
+		int oldnum, newnum;
+
+		if (newindex >= to->numentities)
+			newnum = 9999;
+		else
+		{
+			newent = &db_entities[to->firstentity + newindex];
+			newnum = newent->number;
+		}
+
+		if (oldindex >= from_num_entities)
+			oldnum = 9999;
+		else
+		{
+			oldent = &db_entities[from->firstentity + oldindex];
+			oldnum = oldent->number;
+		}
+
+		if (newnum == oldnum)
+		{
+			MSG_WriteDeltaEntity (oldent, newent, msg, false, false);
+			oldindex++;
+			newindex++;
+		}
+		else if (newnum < oldnum)
+		{
+			MSG_WriteDeltaEntity (&nullstate, newent, msg, true, true);
+			newindex++;
+		}
+		else
+		{
+			int bits = U_REMOVE;
+
+			if (oldnum >= 256)
+				bits |= U_NUMBER16 | U_MOREBITS1;
+
+			MSG_WriteByte (msg, bits & 255);
+
+			if (bits & 0x0000ff00)
+				MSG_WriteByte (msg, (bits >> 8) & 255);
+
+			if (bits & U_NUMBER16)
+				MSG_WriteShort (msg, oldnum);
+			else
+				MSG_WriteByte (msg, oldnum);
+
+			oldindex++;
+		}
+	}
+
+	MSG_WriteShort (msg, 0);
+}
+
+
+/*
+==================
+CL_DeltaBench_Decode
+
+runs the encoded frames back through CL_ParsePlayerstate and CL_ParsePacketEntities;
+returns the number of entities that came out
+==================
+*/
+static int CL_DeltaBench_Decode (void)
+{
+	frame_t frames[2];
+	sizebuf_t saved = net_message;
+	int total = 0;
+	int i;
+
+	memset (frames, 0, sizeof (frames));
+
+	for (i = 0; i < db_numframes; i++)
+	{
+		frame_t *oldframe = i ? &frames[(i - 1) & 1] : NULL;
+		frame_t *newframe = &frames[i & 1];
+
+		net_message.data = db_msg + db_frames[i].msgstart;
+		net_message.maxsize = net_message.cursize = db_frames[i].msglen;
+		net_message.readcount = 0;
+
+		cl.frame.serverframe = newframe->serverframe = i;
+
+		CL_ParsePlayerstate (oldframe, newframe);
+		CL_ParsePacketEntities (oldframe, newframe);
+
+		total += newframe->num_entities;
+	}
+
+	net_message = saved;
+
+	return total;
+}
+
+
+/*
+==================
+CL_DeltaBench_Run
+
+called from CL_Disconnect when the demo ends, before the client state is cleared
+==================
+*/
+void CL_DeltaBench_Run (void)
+{
+	sizebuf_t msg;
+	byte *scratch;
+	double start, encodetime, decodetime;
+	int pass, i, decoded = 0;
+
+	if (!db_capturing || !cl.attractloop || !db_numframes)
+		return;
+
+	db_capturing = false;
+
+	scratch = (byte *) Zone_Alloc (DB_SCRATCH);
+	SZ_Init (&msg, scratch, DB_SCRATCH);
+
+	// encode everything once to have something to decode
+	for (i = 0; i < db_numframes; i++)
+	{
+		SZ_Clear (&msg);
+		CL_DeltaBench_Encode (i ? &db_frames[i - 1] : NULL, &db_frames[i], &msg);
+
+		db_msg = (byte *) CL_DeltaBench_Grow (db_msg, db_msglen, db_msglen + msg.cursize, &db_maxmsg, 1);
+		memcpy (db_msg + db_msglen, msg.data, msg.cursize);
+
+		db_frames[i].msgstart = db_msglen;
+		db_frames[i].msglen = msg.cursize;
+		db_msglen += msg.cursize;
+	}
+
+	start = Sys_Microseconds ();
+
+	for (pass = 0; pass < db_passes; pass++)
+	{
+		for (i = 0; i < db_numframes; i++)
+		{
+			SZ_Clear (&msg);
+			CL_DeltaBench_Encode (i ? &db_frames[i - 1] : NULL, &db_frames[i], &msg);
+		}
+	}
+
+	encodetime = Sys_Microseconds () - start;
+
+	// the parser keeps lerp state in cl_entities and looks up baselines there
+	memset (cl_entities, 0, sizeof (cl_entities));
+
+	start = Sys_Microseconds ();
+
+	for (pass = 0; pass < db_passes; pass++)
+		decoded = CL_DeltaBench_Decode ();
+
+	decodetime = Sys_Microseconds () - start;
+
+	Com_Printf ("deltabench: %i frames, %i entities, %i bytes, %i passes\n", db_numframes, db_numentities, db_msglen, db_passes);
+	Com_Printf ("encode %8.2f ms, %6.1f ns per entity\n", encodetime * 0.001 / db_passes, encodetime * 1000.0 / ((double) db_numentities * db_passes));
+	Com_Printf ("decode %8.2f ms, %6.1f ns per entity\n", decodetime * 0.001 / db_passes, decodetime * 1000.0 / ((double) db_numentities * db_passes));
+
+	if (decoded != db_numentities)
+		Com_Printf ("deltabench: decoded %i entities of %i\n", decoded, db_numentities);
+
+	Zone_Free (scratch);
+	CL_DeltaBench_Free ();
+}
+
+
+static void CL_DeltaBench_f (void)
+{
+	if (Cmd_Argc () < 2)
+	{
+		Com_Printf ("usage: deltabench <demo> [passes]\n");
+		return;
+	}
+
+	CL_DeltaBench_Free ();
+
+	db_passes = (Cmd_Argc () > 2) ? atoi (Cmd_Argv (2)) : 10;
+
+	if (db_passes < 1)
+		db_passes = 1;
+
+	db_capturing = true;
+
+	Cbuf_AddText (va ("demomap %s\n", Cmd_Argv (1)));
+}
+
+
+void CL_DeltaBench_Init (void)
+{
+	Cmd_AddCommand ("deltabench", CL_DeltaBench_f);
+}
+
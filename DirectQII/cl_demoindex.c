@@ -0,0 +1,352 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// cl_demoindex.c -- writes the .dmi seek index alongside a recorded demo
+
+#include "client.h"
+
+/*
+==============================================================================
+
+DEMO INDEX
+
+every message written to the demo gets an entry with its offset and time,
+and every cl_demoindex_interval seconds the next message that carries a
+frame becomes a keyframe.  a keyframe's snapshot is all the config strings
+followed by the frame that message deltas from, sent uncompressed against
+the baselines, so the server can drop it in front of that message and the
+client picks up from there without parsing anything that came before.
+
+the snapshots are written to the index as they're made and the message
+and keyframe tables go on the end when recording stops.
+
+==============================================================================
+*/
+
+static FILE *dmi_file = NULL;
+
+static dmimessage_t *dmi_messages = NULL;
+static int dmi_nummessages = 0;
+static int dmi_maxmessages = 0;
+
+static dmikeyframe_t *dmi_keyframes = NULL;
+static int dmi_numkeyframes = 0;
+static int dmi_maxkeyframes = 0;
+
+static int dmi_interval = 0;
+static int dmi_lastkeytime = 0;
+static int dmi_lastframe = 0;
+
+// config strings that have been set at some point and must be cleared when seeking back past them
+static byte dmi_everset[(MAX_CONFIGSTRINGS + 7) / 8];
+
+cvar_t *cl_demoindex;
+cvar_t *cl_demoindex_interval;
+
+
+static void *CL_DemoIndex_Grow (void *data, int count, int *max, int size)
+{
+	int newmax;
+	byte *newdata;
+
+	if (count < *max)
+		return data;
+
+	newmax = *max ? *max * 2 : 1024;
+	newdata = (byte *) Zone_Alloc (newmax * size);
+
+	if (data)
+	{
+		memcpy (newdata, data, count * size);
+		Zone_Free (data);
+	}
+
+	*max = newmax;
+
+	return newdata;
+}
+
+
+static void CL_DemoIndex_Free (void)
+{
+	if (dmi_messages) Zone_Free (dmi_messages);
+	if (dmi_keyframes) Zone_Free (dmi_keyframes);
+
+	dmi_messages = NULL;
+	dmi_keyframes = NULL;
+
+	dmi_nummessages = dmi_maxmessages = 0;
+	dmi_numkeyframes = dmi_maxkeyframes = 0;
+}
+
+
+static void CL_DemoIndex_WriteHeader (int ofsmessages, int ofskeyframes)
+{
+	dmiheader_t header;
+
+	header.ident = LittleLong (IDDEMOINDEXHEADER);
+	header.version = LittleLong (DEMOINDEX_VERSION);
+	header.interval = LittleLong (dmi_interval);
+	header.nummessages = LittleLong (dmi_nummessages);
+	header.ofsmessages = LittleLong (ofsmessages);
+	header.numkeyframes = LittleLong (dmi_numkeyframes);
+	header.ofskeyframes = LittleLong (ofskeyframes);
+
+	fseek (dmi_file, 0, SEEK_SET);
+	fwrite (&header, sizeof (header), 1, dmi_file);
+}
+
+
+/*
+====================
+CL_DemoIndex_Open
+
+demoname is the full path of the .dm2 that was just opened
+====================
+*/
+void CL_DemoIndex_Open (char *demoname)
+{
+	char name[MAX_OSPATH];
+
+	CL_DemoIndex_Close ();
+
+	if (!cl_demoindex->value)
+		return;
+
+	COM_StripExtension (demoname, name);
+	strcat (name, ".dmi");
+
+	if ((dmi_file = fopen (name, "wb")) == NULL)
+	{
+		Com_Printf ("couldn't open %s, the demo won't be seekable\n", name);
+		return;
+	}
+
+	dmi_interval = cl_demoindex_interval->value * 1000;
+
+	if (dmi_interval < 1000)
+		dmi_interval = 1000;
+
+	dmi_lastkeytime = 0;
+	dmi_lastframe = 0;
+	memset (dmi_everset, 0, sizeof (dmi_everset));
+
+	// filled in properly at the end
+	CL_DemoIndex_WriteHeader (0, 0);
+}
+
+
+static void CL_DemoIndex_FlushSnapshot (sizebuf_t *buf)
+{
+	int len = LittleLong (buf->cursize);
+
+	fwrite (&len, 4, 1, dmi_file);
+	fwrite (buf->data, buf->cursize, 1, dmi_file);
+
+	SZ_Clear (buf);
+}
+
+
+/*
+====================
+CL_DemoIndex_Keyframe
+
+the message about to be written deltas from 'from', or from nothing if it's NULL
+====================
+*/
+static void CL_DemoIndex_Keyframe (frame_t *from)
+{
+	static player_state_t nullps;
+	byte framedata[MAX_MSGLEN - 16];
+	byte csdata[MAX_MSGLEN - 16];
+	sizebuf_t framebuf, csbuf;
+	dmikeyframe_t *k;
+	int i;
+
+	SZ_Init (&framebuf, framedata, sizeof (framedata));
+	SZ_Init (&csbuf, csdata, sizeof (csdata));
+
+	// build the frame first as it has to fit in a single message
+	if (from)
+	{
+		MSG_WriteByte (&framebuf, svc_frame);
+		MSG_WriteLong (&framebuf, from->serverframe);
+		MSG_WriteLong (&framebuf, -1);
+		MSG_WriteByte (&framebuf, 0);
+
+		MSG_WriteByte (&framebuf, sizeof (from->areabits));
+		SZ_Write (&framebuf, from->areabits, sizeof (from->areabits));
+
+		MSG_WriteByte (&framebuf, svc_playerinfo);
+		MSG_WriteDeltaPlayerstate (&nullps, &from->playerstate, &framebuf);
+
+		MSG_WriteByte (&framebuf, svc_packetentities);
+
+		for (i = 0; i < from->num_entities; i++)
+		{
+			entity_state_t s = cl_parse_entities[(from->parse_entities + i) & (MAX_PARSE_ENTITIES - 1)];
+
+			// too big to go as one message; try again on the next frame
+			if (framebuf.cursize + MSG_MAX_DELTAENTITY + 2 > framebuf.maxsize)
+				return;
+
+			// the event was played when the frame arrived
+			s.event = 0;
+
+			MSG_WriteDeltaEntity (&cl_entities[s.number].baseline, &s, &framebuf, true, true);
+		}
+
+		MSG_WriteShort (&framebuf, 0);
+	}
+
+	dmi_keyframes = (dmikeyframe_t *) CL_DemoIndex_Grow (dmi_keyframes, dmi_numkeyframes, &dmi_maxkeyframes, sizeof (dmikeyframe_t));
+	k = &dmi_keyframes[dmi_numkeyframes++];
+
+	fseek (dmi_file, 0, SEEK_END);
+
+	k->message = dmi_nummessages;
+	k->time = from ? from->servertime : cl.frame.servertime;
+	k->ofssnapshot = ftell (dmi_file);
+
+	for (i = 0; i < MAX_CONFIGSTRINGS; i++)
+	{
+		int len = strlen (cl.configstrings[i]);
+
+		if (!len && !(dmi_everset[i >> 3] & (1 << (i & 7))))
+			continue;
+
+		if (csbuf.cursize + len + 32 > csbuf.maxsize)
+			CL_DemoIndex_FlushSnapshot (&csbuf);
+
+		MSG_WriteByte (&csbuf, svc_configstring);
+		MSG_WriteShort (&csbuf, i);
+		MSG_WriteString (&csbuf, cl.configstrings[i]);
+	}
+
+	if (csbuf.cursize)
+		CL_DemoIndex_FlushSnapshot (&csbuf);
+
+	if (framebuf.cursize)
+		CL_DemoIndex_FlushSnapshot (&framebuf);
+
+	k->snapshotlen = ftell (dmi_file) - k->ofssnapshot;
+
+	dmi_lastkeytime = k->time;
+}
+
+
+/*
+====================
+CL_DemoIndex_Message
+
+called from CL_WriteDemoMessage before the message goes to the demo file
+====================
+*/
+void CL_DemoIndex_Message (void)
+{
+	dmimessage_t *m;
+	int i;
+
+	if (!dmi_file)
+		return;
+
+	for (i = 0; i < MAX_CONFIGSTRINGS; i++)
+		if (cl.configstrings[i][0])
+			dmi_everset[i >> 3] |= 1 << (i & 7);
+
+	// only a message that brought a frame can be resumed at
+	if (cl.frame.valid && cl.frame.serverframe != dmi_lastframe)
+	{
+		if (!dmi_numkeyframes || cl.frame.servertime - dmi_lastkeytime >= dmi_interval || cl.frame.servertime < dmi_lastkeytime)
+		{
+			// CL_ParseFrame has already checked that the delta frame is still there
+			if (cl.frame.deltaframe <= 0)
+				CL_DemoIndex_Keyframe (NULL);
+			else CL_DemoIndex_Keyframe (&cl.frames[cl.frame.deltaframe & UPDATE_MASK]);
+		}
+
+		dmi_lastframe = cl.frame.serverframe;
+	}
+
+	dmi_messages = (dmimessage_t *) CL_DemoIndex_Grow (dmi_messages, dmi_nummessages, &dmi_maxmessages, sizeof (dmimessage_t));
+	m = &dmi_messages[dmi_nummessages++];
+
+	m->offset = ftell (cls.demofile);
+	m->time = cl.frame.servertime;
+}
+
+
+/*
+====================
+CL_DemoIndex_Close
+
+called when recording stops
+====================
+*/
+void CL_DemoIndex_Close (void)
+{
+	int ofsmessages, ofskeyframes;
+	int i;
+
+	if (!dmi_file)
+	{
+		CL_DemoIndex_Free ();
+		return;
+	}
+
+	fseek (dmi_file, 0, SEEK_END);
+	ofsmessages = ftell (dmi_file);
+
+	for (i = 0; i < dmi_nummessages; i++)
+	{
+		dmi_messages[i].offset = LittleLong (dmi_messages[i].offset);
+		dmi_messages[i].time = LittleLong (dmi_messages[i].time);
+	}
+
+	if (dmi_nummessages)
+		fwrite (dmi_messages, sizeof (dmimessage_t), dmi_nummessages, dmi_file);
+
+	ofskeyframes = ftell (dmi_file);
+
+	for (i = 0; i < dmi_numkeyframes; i++)
+	{
+		dmi_keyframes[i].message = LittleLong (dmi_keyframes[i].message);
+		dmi_keyframes[i].time = LittleLong (dmi_keyframes[i].time);
+		dmi_keyframes[i].ofssnapshot = LittleLong (dmi_keyframes[i].ofssnapshot);
+		dmi_keyframes[i].snapshotlen = LittleLong (dmi_keyframes[i].snapshotlen);
+	}
+
+	if (dmi_numkeyframes)
+		fwrite (dmi_keyframes, sizeof (dmikeyframe_t), dmi_numkeyframes, dmi_file);
+
+	CL_DemoIndex_WriteHeader (ofsmessages, ofskeyframes);
+
+	fclose (dmi_file);
+	dmi_file = NULL;
+
+	CL_DemoIndex_Free ();
+}
+
+
+void CL_DemoIndex_Init (void)
+{
+	cl_demoindex = Cvar_Get ("cl_demoindex", "1", CVAR_ARCHIVE, NULL);
+	cl_demoindex_interval = Cvar_Get ("cl_demoindex_interval", "10", CVAR_ARCHIVE, NULL);
+}
+
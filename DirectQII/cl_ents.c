@@ -200,21 +200,24 @@ int CL_ParseEntityBits (unsigned *bits)
 	unsigned	b, total;
 	int			i;
 	int			number;
+	msgcursor_t	c;
 
-	total = MSG_ReadByte (&net_message);
+	MSG_BeginReadCursor (&c, &net_message, MSG_MAX_ENTITYBITS);
+
+	total = MSG_GetByte (&c);
 	if (total & U_MOREBITS1)
 	{
-		b = MSG_ReadByte (&net_message);
+		b = MSG_GetByte (&c);
 		total |= b << 8;
 	}
 	if (total & U_MOREBITS2)
 	{
-		b = MSG_ReadByte (&net_message);
+		b = MSG_GetByte (&c);
 		total |= b << 16;
 	}
 	if (total & U_MOREBITS3)
 	{
-		b = MSG_ReadByte (&net_message);
+		b = MSG_GetByte (&c);
 		total |= b << 24;
 	}
 
@@ -224,9 +227,11 @@ int CL_ParseEntityBits (unsigned *bits)
 			bitcounts[i]++;
 
 	if (total & U_NUMBER16)
-		number = MSG_ReadShort (&net_message);
+		number = MSG_GetShort (&c);
 	else
-		number = MSG_ReadByte (&net_message);
+		number = MSG_GetByte (&c);
+
+	MSG_EndReadCursor (&c, &net_message);
 
 	*bits = total;
 
@@ -242,74 +247,84 @@ Can go from either a baseline or a previous packet_entity
 */
 void CL_ParseDelta (entity_state_t *from, entity_state_t *to, int number, int bits)
 {
+	msgcursor_t	c;
+
 	// set everything to the state we are delta'ing from
 	*to = *from;
 
 	VectorCopy (from->origin, to->old_origin);
 	to->number = number;
 
+	MSG_BeginReadCursor (&c, &net_message, MSG_MAX_DELTAENTITY);
+
 	if (bits & U_MODEL)
-		to->modelindex = MSG_ReadByte (&net_message);
+		to->modelindex = MSG_GetByte (&c);
 	if (bits & U_MODEL2)
-		to->modelindex2 = MSG_ReadByte (&net_message);
+		to->modelindex2 = MSG_GetByte (&c);
 	if (bits & U_MODEL3)
-		to->modelindex3 = MSG_ReadByte (&net_message);
+		to->modelindex3 = MSG_GetByte (&c);
 	if (bits & U_MODEL4)
-		to->modelindex4 = MSG_ReadByte (&net_message);
+		to->modelindex4 = MSG_GetByte (&c);
 
 	if (bits & U_FRAME8)
-		to->frame = MSG_ReadByte (&net_message);
+		to->frame = MSG_GetByte (&c);
 	if (bits & U_FRAME16)
-		to->frame = MSG_ReadShort (&net_message);
+		to->frame = MSG_GetShort (&c);
 
 	if ((bits & U_SKIN8) && (bits & U_SKIN16))		//used for laser colors
-		to->skinnum = MSG_ReadLong (&net_message);
+		to->skinnum = MSG_GetLong (&c);
 	else if (bits & U_SKIN8)
-		to->skinnum = MSG_ReadByte (&net_message);
+		to->skinnum = MSG_GetByte (&c);
 	else if (bits & U_SKIN16)
-		to->skinnum = MSG_ReadShort (&net_message);
+		to->skinnum = MSG_GetShort (&c);
 
 	if ((bits & (U_EFFECTS8 | U_EFFECTS16)) == (U_EFFECTS8 | U_EFFECTS16))
-		to->effects = MSG_ReadLong (&net_message);
+		to->effects = MSG_GetLong (&c);
 	else if (bits & U_EFFECTS8)
-		to->effects = MSG_ReadByte (&net_message);
+		to->effects = MSG_GetByte (&c);
 	else if (bits & U_EFFECTS16)
-		to->effects = MSG_ReadShort (&net_message);
+		to->effects = MSG_GetShort (&c);
 
 	if ((bits & (U_RENDERFX8 | U_RENDERFX16)) == (U_RENDERFX8 | U_RENDERFX16))
-		to->renderfx = MSG_ReadLong (&net_message);
+		to->renderfx = MSG_GetLong (&c);
 	else if (bits & U_RENDERFX8)
-		to->renderfx = MSG_ReadByte (&net_message);
+		to->renderfx = MSG_GetByte (&c);
 	else if (bits & U_RENDERFX16)
-		to->renderfx = MSG_ReadShort (&net_message);
+		to->renderfx = MSG_GetShort (&c);
 
 	if (bits & U_ORIGIN1)
-		to->origin[0] = MSG_ReadCoord (&net_message);
+		to->origin[0] = MSG_GetCoord (&c);
 	if (bits & U_ORIGIN2)
-		to->origin[1] = MSG_ReadCoord (&net_message);
+		to->origin[1] = MSG_GetCoord (&c);
 	if (bits & U_ORIGIN3)
-		to->origin[2] = MSG_ReadCoord (&net_message);
+		to->origin[2] = MSG_GetCoord (&c);
 
 	if (bits & U_ANGLE1)
-		to->angles[0] = MSG_ReadAngle (&net_message);
+		to->angles[0] = MSG_GetAngle (&c);
 	if (bits & U_ANGLE2)
-		to->angles[1] = MSG_ReadAngle (&net_message);
+		to->angles[1] = MSG_GetAngle (&c);
 	if (bits & U_ANGLE3)
-		to->angles[2] = MSG_ReadAngle (&net_message);
+		to->angles[2] = MSG_GetAngle (&c);
 
 	if (bits & U_OLDORIGIN)
-		MSG_ReadPos (&net_message, to->old_origin);
+	{
+		to->old_origin[0] = MSG_GetCoord (&c);
+		to->old_origin[1] = MSG_GetCoord (&c);
+		to->old_origin[2] = MSG_GetCoord (&c);
+	}
 
 	if (bits & U_SOUND)
-		to->sound = MSG_ReadByte (&net_message);
+		to->sound = MSG_GetByte (&c);
 
 	if (bits & U_EVENT)
-		to->event = MSG_ReadByte (&net_message);
+		to->event = MSG_GetByte (&c);
 	else
 		to->event = 0;
 
 	if (bits & U_SOLID)
-		to->solid = MSG_ReadShort (&net_message);
+		to->solid = MSG_GetShort (&c);
+
+	MSG_EndReadCursor (&c, &net_message);
 }
 
 /*
@@ -517,6 +532,7 @@ void CL_ParsePlayerstate (frame_t *oldframe, frame_t *newframe)
 	player_state_t	*state;
 	int			i;
 	int			statbits;
+	msgcursor_t	c;
 
 	state = &newframe->playerstate;
 
@@ -526,40 +542,42 @@ void CL_ParsePlayerstate (frame_t *oldframe, frame_t *newframe)
 	else
 		memset (state, 0, sizeof (*state));
 
-	flags = MSG_ReadShort (&net_message);
+	MSG_BeginReadCursor (&c, &net_message, MSG_MAX_PLAYERSTATE);
+
+	flags = MSG_GetShort (&c);
 
 	// parse the pmove_state_t
 	if (flags & PS_M_TYPE)
-		state->pmove.pm_type = MSG_ReadByte (&net_message);
+		state->pmove.pm_type = MSG_GetByte (&c);
 
 	if (flags & PS_M_ORIGIN)
 	{
-		state->pmove.origin[0] = MSG_ReadShort (&net_message);
-		state->pmove.origin[1] = MSG_ReadShort (&net_message);
-		state->pmove.origin[2] = MSG_ReadShort (&net_message);
+		state->pmove.origin[0] = MSG_GetShort (&c);
+		state->pmove.origin[1] = MSG_GetShort (&c);
+		state->pmove.origin[2] = MSG_GetShort (&c);
 	}
 
 	if (flags & PS_M_VELOCITY)
 	{
-		state->pmove.velocity[0] = MSG_ReadShort (&net_message);
-		state->pmove.velocity[1] = MSG_ReadShort (&net_message);
-		state->pmove.velocity[2] = MSG_ReadShort (&net_message);
+		state->pmove.velocity[0] = MSG_GetShort (&c);
+		state->pmove.velocity[1] = MSG_GetShort (&c);
+		state->pmove.velocity[2] = MSG_GetShort (&c);
 	}
 
 	if (flags & PS_M_TIME)
-		state->pmove.pm_time = MSG_ReadByte (&net_message);
+		state->pmove.pm_time = MSG_GetByte (&c);
 
 	if (flags & PS_M_FLAGS)
-		state->pmove.pm_flags = MSG_ReadByte (&net_message);
+		state->pmove.pm_flags = MSG_GetByte (&c);
 
 	if (flags & PS_M_GRAVITY)
-		state->pmove.gravity = MSG_ReadShort (&net_message);
+		state->pmove.gravity = MSG_GetShort (&c);
 
 	if (flags & PS_M_DELTA_ANGLES)
 	{
-		state->pmove.delta_angles[0] = MSG_ReadShort (&net_message);
-		state->pmove.delta_angles[1] = MSG_ReadShort (&net_message);
-		state->pmove.delta_angles[2] = MSG_ReadShort (&net_message);
+		state->pmove.delta_angles[0] = MSG_GetShort (&c);
+		state->pmove.delta_angles[1] = MSG_GetShort (&c);
+		state->pmove.delta_angles[2] = MSG_GetShort (&c);
 	}
 
 	if (cl.attractloop)
@@ -568,60 +586,62 @@ void CL_ParsePlayerstate (frame_t *oldframe, frame_t *newframe)
 	// parse the rest of the player_state_t
 	if (flags & PS_VIEWOFFSET)
 	{
-		state->viewoffset[0] = MSG_ReadChar (&net_message) * 0.25;
-		state->viewoffset[1] = MSG_ReadChar (&net_message) * 0.25;
-		state->viewoffset[2] = MSG_ReadChar (&net_message) * 0.25;
+		state->viewoffset[0] = MSG_GetChar (&c) * 0.25;
+		state->viewoffset[1] = MSG_GetChar (&c) * 0.25;
+		state->viewoffset[2] = MSG_GetChar (&c) * 0.25;
 	}
 
 	if (flags & PS_VIEWANGLES)
 	{
-		state->viewangles[0] = MSG_ReadAngle16 (&net_message);
-		state->viewangles[1] = MSG_ReadAngle16 (&net_message);
-		state->viewangles[2] = MSG_ReadAngle16 (&net_message);
+		state->viewangles[0] = MSG_GetAngle16 (&c);
+		state->viewangles[1] = MSG_GetAngle16 (&c);
+		state->viewangles[2] = MSG_GetAngle16 (&c);
 	}
 
 	if (flags & PS_KICKANGLES)
 	{
-		state->kick_angles[0] = MSG_ReadChar (&net_message) * 0.25;
-		state->kick_angles[1] = MSG_ReadChar (&net_message) * 0.25;
-		state->kick_angles[2] = MSG_ReadChar (&net_message) * 0.25;
+		state->kick_angles[0] = MSG_GetChar (&c) * 0.25;
+		state->kick_angles[1] = MSG_GetChar (&c) * 0.25;
+		state->kick_angles[2] = MSG_GetChar (&c) * 0.25;
 	}
 
 	if (flags & PS_WEAPONINDEX)
 	{
-		state->gunindex = MSG_ReadByte (&net_message);
+		state->gunindex = MSG_GetByte (&c);
 	}
 
 	if (flags & PS_WEAPONFRAME)
 	{
-		state->gunframe = MSG_ReadByte (&net_message);
-		state->gunoffset[0] = MSG_ReadChar (&net_message) * 0.25;
-		state->gunoffset[1] = MSG_ReadChar (&net_message) * 0.25;
-		state->gunoffset[2] = MSG_ReadChar (&net_message) * 0.25;
-		state->gunangles[0] = MSG_ReadChar (&net_message) * 0.25;
-		state->gunangles[1] = MSG_ReadChar (&net_message) * 0.25;
-		state->gunangles[2] = MSG_ReadChar (&net_message) * 0.25;
+		state->gunframe = MSG_GetByte (&c);
+		state->gunoffset[0] = MSG_GetChar (&c) * 0.25;
+		state->gunoffset[1] = MSG_GetChar (&c) * 0.25;
+		state->gunoffset[2] = MSG_GetChar (&c) * 0.25;
+		state->gunangles[0] = MSG_GetChar (&c) * 0.25;
+		state->gunangles[1] = MSG_GetChar (&c) * 0.25;
+		state->gunangles[2] = MSG_GetChar (&c) * 0.25;
 	}
 
 	if (flags & PS_BLEND)
 	{
-		state->blend[0] = MSG_ReadByte (&net_message) / 255.0;
-		state->blend[1] = MSG_ReadByte (&net_message) / 255.0;
-		state->blend[2] = MSG_ReadByte (&net_message) / 255.0;
-		state->blend[3] = MSG_ReadByte (&net_message) / 255.0;
+		state->blend[0] = MSG_GetByte (&c) / 255.0;
+		state->blend[1] = MSG_GetByte (&c) / 255.0;
+		state->blend[2] = MSG_GetByte (&c) / 255.0;
+		state->blend[3] = MSG_GetByte (&c) / 255.0;
 	}
 
 	if (flags & PS_FOV)
-		state->fov = MSG_ReadByte (&net_message);
+		state->fov = MSG_GetByte (&c);
 
 	if (flags & PS_RDFLAGS)
-		state->rdflags = MSG_ReadByte (&net_message);
+		state->rdflags = MSG_GetByte (&c);
 
 	// parse stats
-	statbits = MSG_ReadLong (&net_message);
+	statbits = MSG_GetLong (&c);
 	for (i = 0; i < MAX_STATS; i++)
 		if (statbits & (1 << i))
-			state->stats[i] = MSG_ReadShort (&net_message);
+			state->stats[i] = MSG_GetShort (&c);
+
+	MSG_EndReadCursor (&c, &net_message);
 }
 
 
@@ -761,6 +781,8 @@ void CL_ParseFrame (void)
 
 		cl.sound_prepped = true;	// can start mixing ambient sounds
 
+		CL_DeltaBench_Capture (&cl.frame);
+
 		// fire entity events
 		CL_FireEntityEvents (&cl.frame);
 		CL_CheckPredictionError ();
@@ -826,6 +848,63 @@ struct model_s *S_RegisterSexedModel (entity_state_t *ent, char *base)
 	return mdl;
 }
 
+/*
+===============
+CL_LerpPacketEntities
+
+the origins and angles of the entities in a frame don't depend on anything else that
+CL_AddPacketEntities does, so they're worked out up front on the job threads
+===============
+*/
+#define LERP_CHUNK		64
+
+typedef struct entlerp_s
+{
+	vec3_t	currorigin;
+	vec3_t	prevorigin;
+	vec3_t	angles;
+} entlerp_t;
+
+static entlerp_t cl_entlerp[MAX_PARSE_ENTITIES];
+static cljobbatch_t cl_lerpbatch;
+
+static void CL_LerpPacketEntities (void *data, int chunk)
+{
+	frame_t	*frame = (frame_t *) data;
+	int		first = chunk * LERP_CHUNK;
+	int		last = first + LERP_CHUNK;
+	int		pnum, i;
+
+	if (last > frame->num_entities)
+		last = frame->num_entities;
+
+	for (pnum = first; pnum < last; pnum++)
+	{
+		entity_state_t *s1 = &cl_parse_entities[(frame->parse_entities + pnum) & (MAX_PARSE_ENTITIES - 1)];
+		centity_t *cent = &cl_entities[s1->number];
+		entlerp_t *lerp = &cl_entlerp[pnum];
+
+		if (s1->renderfx & (RF_FRAMELERP | RF_BEAM))
+		{
+			// step origin discretely, because the frames do the animation properly
+			VectorCopy (cent->current.origin, lerp->currorigin);
+			VectorCopy (cent->current.old_origin, lerp->prevorigin);
+		}
+		else
+		{
+			// interpolate origin
+			lerp->currorigin[0] = lerp->prevorigin[0] = cent->prev.origin[0] + cl.lerpfrac * (cent->current.origin[0] - cent->prev.origin[0]);
+			lerp->currorigin[1] = lerp->prevorigin[1] = cent->prev.origin[1] + cl.lerpfrac * (cent->current.origin[1] - cent->prev.origin[1]);
+			lerp->currorigin[2] = lerp->prevorigin[2] = cent->prev.origin[2] + cl.lerpfrac * (cent->current.origin[2] - cent->prev.origin[2]);
+		}
+
+		// interpolate angles; rotating and spinning entities replace these
+		for (i = 0; i < 3; i++)
+			lerp->angles[i] = LerpAngle (cent->prev.angles[i], cent->current.angles[i], cl.lerpfrac);
+	}
+}
+
+
 /*
 ===============
 CL_AddPacketEntities
@@ -844,6 +923,8 @@ void CL_AddPacketEntities (frame_t *frame)
 	clientinfo_t		*ci;
 	unsigned int		effects, renderfx;
 
+	CL_RunJobs (&cl_lerpbatch, CL_LerpPacketEntities, frame, (frame->num_entities + LERP_CHUNK - 1) / LERP_CHUNK);
+
 	// bonus items rotate at a fixed rate
 	autorotate = anglemod (cl.time / 10);
 
@@ -907,19 +988,9 @@ void CL_AddPacketEntities (frame_t *frame)
 		ent.prevframe = cent->prev.frame;
 		ent.backlerp = 1.0 - cl.lerpfrac;
 
-		if (renderfx & (RF_FRAMELERP | RF_BEAM))
-		{
-			// step origin discretely, because the frames do the animation properly
-			VectorCopy (cent->current.origin, ent.currorigin);
-			VectorCopy (cent->current.old_origin, ent.prevorigin);
-		}
-		else
-		{
-			// interpolate origin
-			ent.currorigin[0] = ent.prevorigin[0] = cent->prev.origin[0] + cl.lerpfrac * (cent->current.origin[0] - cent->prev.origin[0]);
-			ent.currorigin[1] = ent.prevorigin[1] = cent->prev.origin[1] + cl.lerpfrac * (cent->current.origin[1] - cent->prev.origin[1]);
-			ent.currorigin[2] = ent.prevorigin[2] = cent->prev.origin[2] + cl.lerpfrac * (cent->current.origin[2] - cent->prev.origin[2]);
-		}
+		// worked out by CL_LerpPacketEntities
+		VectorCopy (cl_entlerp[pnum].currorigin, ent.currorigin);
+		VectorCopy (cl_entlerp[pnum].prevorigin, ent.prevorigin);
 
 		// create a new entity
 		// tweak the color of beams
@@ -1012,15 +1083,8 @@ void CL_AddPacketEntities (frame_t *frame)
 		}
 		else
 		{
-			// interpolate angles
-			float	a1, a2;
-
-			for (i = 0; i < 3; i++)
-			{
-				a1 = cent->current.angles[i];
-				a2 = cent->prev.angles[i];
-				ent.angles[i] = LerpAngle (a2, a1, cl.lerpfrac);
-			}
+			// interpolated by CL_LerpPacketEntities
+			VectorCopy (cl_entlerp[pnum].angles, ent.angles);
 		}
 
 		if (s1->number == cl.playernum + 1)
@@ -1457,12 +1521,25 @@ void CL_AddEntities (void)
 	if (cl_timedemo->value)
 		cl.lerpfrac = 1.0;
 
+	// the particles from last frame are aged on the job threads while the entities are added
+	CL_TimeDemo_Begin (TD_PARTICLES);
+	CL_BeginParticles ();
+	CL_TimeDemo_End (TD_PARTICLES);
+
+	CL_TimeDemo_Begin (TD_ENTITIES);
 	CL_CalcViewValues ();
 	CL_AddPacketEntities (&cl.frame);
 	CL_AddTEnts ();
+	CL_TimeDemo_End (TD_ENTITIES);
+
+	CL_TimeDemo_Begin (TD_PARTICLES);
 	CL_AddParticles ();
+	CL_TimeDemo_End (TD_PARTICLES);
+
+	CL_TimeDemo_Begin (TD_ENTITIES);
 	CL_AddDLights ();
 	CL_AddLightStyles ();
+	CL_TimeDemo_End (TD_ENTITIES);
 }
 
 
@@ -476,8 +476,11 @@ void CL_SendCmd (void)
 
 	if (cls.state == ca_connected)
 	{
-		if (cls.netchan.message.cursize || sys_currmsec - cls.netchan.last_sent > 1000)
-			Netchan_Transmit (&cls.netchan, 0, buf.data);
+		// downloads happen while connecting, and the acks go straight back
+		CL_WriteDownloadAck (&buf);
+
+		if (buf.cursize || cls.netchan.message.cursize || sys_currmsec - cls.netchan.last_sent > 1000)
+			Netchan_Transmit (&cls.netchan, buf.cursize, buf.data);
 		return;
 	}
 
@@ -532,6 +535,9 @@ void CL_SendCmd (void)
 		buf.data + checksumIndex + 1, buf.cursize - checksumIndex - 1,
 		cls.netchan.outgoing_sequence);
 
+	// after the checksummed part
+	CL_WriteDownloadAck (&buf);
+
 	// deliver the message
 	Netchan_Transmit (&cls.netchan, buf.cursize, buf.data);
 }
@@ -0,0 +1,299 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// cl_jobs.c -- worker threads for the client's per-frame effect work
+
+#include "client.h"
+#include <windows.h>
+
+/*
+==============================================================================
+
+CLIENT JOBS
+
+a batch is a function and a number of jobs, each of which is a call to it
+with the job's index.  the jobs are dealt out in equal runs to the main
+thread and each worker, and a thread that finishes its own run takes jobs
+from the others' until there are none left.  every job writes only to its
+own part of the output, so the results are the same whichever thread ran
+a job and the caller merges them in job order once the batch is finished.
+
+the main thread can begin a batch, go on with other work and finish it
+later; finishing runs whatever jobs haven't been taken yet and then waits
+for the ones that have.  several batches can be in flight at once.
+
+cl_jobs is the number of worker threads, or -1 for one for each core after
+the first; 0 runs everything on the main thread.  nothing called from a
+job may print, error, allocate or touch the filesystem.
+
+==============================================================================
+*/
+
+static HANDLE cl_jobthreads[MAX_JOB_THREADS];
+static int cl_numjobthreads = 0;
+
+static CRITICAL_SECTION cl_joblock;
+static HANDLE cl_jobsema = NULL;
+static volatile LONG cl_jobquit = 0;
+
+// batches that may still have jobs to take
+static cljobbatch_t *cl_jobbatches = NULL;
+
+static cvar_t *cl_jobs;
+
+
+static void CL_UnlinkBatch (cljobbatch_t *batch)
+{
+	cljobbatch_t **link;
+
+	EnterCriticalSection (&cl_joblock);
+
+	for (link = &cl_jobbatches; *link; link = &(*link)->nextbatch)
+	{
+		if (*link != batch) continue;
+
+		*link = batch->nextbatch;
+		break;
+	}
+
+	batch->nextbatch = NULL;
+
+	LeaveCriticalSection (&cl_joblock);
+}
+
+
+/*
+==================
+CL_WorkOnBatch
+
+runs jobs from slot's own run, then from everyone else's, until there are none left to take
+==================
+*/
+static void CL_WorkOnBatch (cljobbatch_t *batch, int slot)
+{
+	int i;
+
+	for (i = 0; i < batch->numslots; i++)
+	{
+		int victim = (slot + i) % batch->numslots;
+
+		for (;;)
+		{
+			// going past the end is harmless as the run is never reopened while the batch is in flight
+			LONG job = InterlockedIncrement (&batch->next[victim]) - 1;
+
+			if (job >= batch->end[victim])
+				break;
+
+			batch->func (batch->data, job);
+			InterlockedDecrement (&batch->remaining);
+		}
+	}
+}
+
+
+static DWORD WINAPI CL_JobThread (LPVOID param)
+{
+	int slot = (int) (intptr_t) param;
+
+	for (;;)
+	{
+		WaitForSingleObject (cl_jobsema, INFINITE);
+
+		if (cl_jobquit)
+			break;
+
+		for (;;)
+		{
+			cljobbatch_t *batch;
+
+			// the batch can't be finished and reused while we're counted as in it
+			EnterCriticalSection (&cl_joblock);
+
+			if ((batch = cl_jobbatches) != NULL)
+				InterlockedIncrement (&batch->users);
+
+			LeaveCriticalSection (&cl_joblock);
+
+			if (!batch)
+				break;
+
+			CL_WorkOnBatch (batch, slot);
+			CL_UnlinkBatch (batch);
+
+			InterlockedDecrement (&batch->users);
+		}
+	}
+
+	return 0;
+}
+
+
+static void CL_StopJobThreads (void)
+{
+	int i;
+
+	if (!cl_numjobthreads) return;
+
+	InterlockedExchange (&cl_jobquit, 1);
+	ReleaseSemaphore (cl_jobsema, cl_numjobthreads, NULL);
+	WaitForMultipleObjects (cl_numjobthreads, cl_jobthreads, TRUE, INFINITE);
+
+	for (i = 0; i < cl_numjobthreads; i++)
+	{
+		CloseHandle (cl_jobthreads[i]);
+		cl_jobthreads[i] = NULL;
+	}
+
+	cl_numjobthreads = 0;
+}
+
+
+static void CL_StartJobThreads (void)
+{
+	SYSTEM_INFO si;
+	int count = cl_jobs->value;
+	int i;
+
+	cl_jobs->modified = false;
+
+	if (count < 0)
+	{
+		GetSystemInfo (&si);
+		count = (int) si.dwNumberOfProcessors - 1;
+	}
+
+	if (count > MAX_JOB_THREADS)
+		count = MAX_JOB_THREADS;
+
+	InterlockedExchange (&cl_jobquit, 0);
+
+	for (i = 0; i < count; i++)
+	{
+		// slot 0 is the main thread's
+		if ((cl_jobthreads[i] = CreateThread (NULL, 0, CL_JobThread, (LPVOID) (intptr_t) (i + 1), 0, NULL)) == NULL)
+			break;
+	}
+
+	// if no threads could be created everything just runs on the main thread
+	cl_numjobthreads = i;
+
+	Com_DPrintf ("Client jobs on %i worker threads\n", cl_numjobthreads);
+}
+
+
+/*
+==================
+CL_BeginJobs
+
+starts numjobs calls of func on the workers; the batch must stay put until CL_FinishJobs
+==================
+*/
+void CL_BeginJobs (cljobbatch_t *batch, cljobfunc_t func, void *data, int numjobs)
+{
+	int i;
+
+	// the threads can only be changed when nothing is using them
+	if (cl_jobs->modified && !cl_jobbatches)
+	{
+		CL_StopJobThreads ();
+		CL_StartJobThreads ();
+	}
+
+	batch->func = func;
+	batch->data = data;
+	batch->numslots = cl_numjobthreads + 1;
+	batch->remaining = numjobs;
+	batch->users = 0;
+	batch->nextbatch = NULL;
+
+	for (i = 0; i < batch->numslots; i++)
+	{
+		batch->next[i] = numjobs * i / batch->numslots;
+		batch->end[i] = numjobs * (i + 1) / batch->numslots;
+	}
+
+	// too little to be worth waking anyone for
+	if (!cl_numjobthreads || numjobs < 2)
+		return;
+
+	EnterCriticalSection (&cl_joblock);
+
+	batch->nextbatch = cl_jobbatches;
+	cl_jobbatches = batch;
+
+	LeaveCriticalSection (&cl_joblock);
+
+	ReleaseSemaphore (cl_jobsema, cl_numjobthreads, NULL);
+}
+
+
+/*
+==================
+CL_FinishJobs
+
+runs whatever hasn't been taken yet and waits for the rest; when it returns every job has run
+==================
+*/
+void CL_FinishJobs (cljobbatch_t *batch)
+{
+	CL_WorkOnBatch (batch, 0);
+	CL_UnlinkBatch (batch);
+
+	// a worker may still be running the last job it took
+	while (batch->remaining > 0 || batch->users > 0)
+		Sleep (0);
+}
+
+
+void CL_RunJobs (cljobbatch_t *batch, cljobfunc_t func, void *data, int numjobs)
+{
+	CL_BeginJobs (batch, func, data, numjobs);
+	CL_FinishJobs (batch);
+}
+
+
+int CL_NumJobThreads (void)
+{
+	return cl_numjobthreads;
+}
+
+
+void CL_InitJobs (void)
+{
+	cl_jobs = Cvar_Get ("cl_jobs", "-1", CVAR_ARCHIVE, NULL);
+
+	InitializeCriticalSection (&cl_joblock);
+	cl_jobsema = CreateSemaphore (NULL, 0, 0x7fffffff, NULL);
+
+	CL_StartJobThreads ();
+}
+
+
+void CL_ShutdownJobs (void)
+{
+	if (!cl_jobsema) return;
+
+	CL_StopJobThreads ();
+
+	CloseHandle (cl_jobsema);
+	cl_jobsema = NULL;
+	DeleteCriticalSection (&cl_joblock);
+}
+
@@ -125,7 +125,7 @@ DLIGHT MANAGEMENT
 ==============================================================
 */
 
-cdlight_t cl_dlights[MAX_DLIGHTS];
+static clpool_t cl_dlights = {"cl_maxdlights", "256", sizeof (cdlight_t)};
 
 /*
 ================
@@ -134,7 +134,19 @@ CL_ClearDlights
 */
 void CL_ClearDlights (void)
 {
-	memset (cl_dlights, 0, sizeof (cl_dlights));
+	CL_PoolClear (&cl_dlights);
+}
+
+
+void CL_InitDlights (void)
+{
+	CL_InitPool (&cl_dlights);
+}
+
+
+void CL_DlightPoolStats (void)
+{
+	CL_PoolStats (&cl_dlights);
 }
 
 
@@ -158,31 +170,6 @@ void CL_NewDlight (cdlight_t *dl, int key)
 }
 
 
-cdlight_t *CL_OldestDlight (void)
-{
-	int		i;
-	int		time;
-	int		index;
-	cdlight_t	*dl;
-
-	// find the oldest explosion (offsetting time by +1 ms in case all MAX_DLIGHTS lights are the same age and that age is the current frametime!!!!)
-	time = cl.time + 1;
-	index = 0;
-	dl = cl_dlights;
-
-	for (i = 0; i < MAX_DLIGHTS; i++, dl++)
-	{
-		if (dl->start < time)
-		{
-			time = dl->start;
-			index = i;
-		}
-	}
-
-	return &cl_dlights[index];
-}
-
-
 /*
 ===============
 CL_AllocDlight
@@ -191,15 +178,12 @@ CL_AllocDlight
 */
 cdlight_t *CL_AllocDlight (int key)
 {
-	int		i;
 	cdlight_t	*dl;
 
 	// first look for an exact key match
 	if (key)
 	{
-		dl = cl_dlights;
-
-		for (i = 0; i < MAX_DLIGHTS; i++, dl++)
+		for (dl = (cdlight_t *) CL_PoolFirst (&cl_dlights); dl; dl = (cdlight_t *) CL_PoolNext (&cl_dlights, dl))
 		{
 			if (dl->key == key)
 			{
@@ -209,20 +193,8 @@ cdlight_t *CL_AllocDlight (int key)
 		}
 	}
 
-	// then look for any dead light
-	dl = cl_dlights;
-
-	for (i = 0; i < MAX_DLIGHTS; i++, dl++)
-	{
-		if (dl->die < cl.time)
-		{
-			CL_NewDlight (dl, key);
-			return dl;
-		}
-	}
-
-	// take the oldest dlight
-	dl = CL_OldestDlight ();
+	// dead lights are freed by CL_AddDLights, and the oldest one is taken if they're all in use
+	dl = (cdlight_t *) CL_PoolAlloc (&cl_dlights);
 	CL_NewDlight (dl, key);
 
 	return dl;
@@ -846,13 +818,12 @@ CL_AddDLights
 */
 void CL_AddDLights (void)
 {
-	int			i;
-	cdlight_t	*dl = cl_dlights;
+	cdlight_t	*dl;
 
-	for (i = 0; i < MAX_DLIGHTS; i++, dl++)
+	for (dl = (cdlight_t *) CL_PoolFirst (&cl_dlights); dl; dl = (cdlight_t *) CL_PoolNext (&cl_dlights, dl))
 	{
 		if (dl->die < cl.time)
-			continue;
+			CL_PoolFree (&cl_dlights, dl);
 		else
 		{
 			float radius = dl->radius - ((float) (cl.time - dl->start) * dl->decay * 0.001f);
@@ -860,7 +831,7 @@ void CL_AddDLights (void)
 			// fixed up minlight so it now works as expected
 			if (radius > dl->minlight)
 				V_AddLight (dl->origin, radius, dl->rgb[0], dl->rgb[1], dl->rgb[2]);
-			else dl->die = 0;
+			else CL_PoolFree (&cl_dlights, dl);
 		}
 	}
 }
@@ -57,6 +57,8 @@ cvar_t	*cl_showclamp;
 cvar_t	*cl_paused;
 cvar_t	*cl_timedemo;
 
+cvar_t	*cl_downloadwindow;
+
 cvar_t	*lookspring;
 cvar_t	*lookstrafe;
 cvar_t	*sensitivity;
@@ -112,6 +114,9 @@ void CL_WriteDemoMessage (void)
 {
 	int		len, swlen;
 
+	// the index wants the offset this message starts at
+	CL_DemoIndex_Message ();
+
 	// the first eight bytes are just packet sequencing stuff
 	len = net_message.cursize - 8;
 	swlen = LittleLong (len);
@@ -143,6 +148,7 @@ void CL_Stop_f (void)
 	fclose (cls.demofile);
 	cls.demofile = NULL;
 	cls.demorecording = false;
+	CL_DemoIndex_Close ();
 	Com_Printf ("Stopped demo.\n");
 }
 
@@ -196,6 +202,8 @@ void CL_Record_f (void)
 	}
 	cls.demorecording = true;
 
+	CL_DemoIndex_Open (name);
+
 	// don't start saving messages until a non-delta compressed message is received
 	cls.demowaiting = true;
 
@@ -400,6 +408,9 @@ void CL_SendConnectPacket (void)
 	port = Cvar_VariableValue ("qport");
 	userinfo_modified = false;
 
+	// the netchan sends this with every packet
+	cls.quakePort = port;
+
 	Netchan_OutOfBandPrint (NS_CLIENT, adr, "connect %i %i %i \"%s\"\n",
 		PROTOCOL_VERSION, port, cls.challenge, Cvar_Userinfo ());
 }
@@ -596,8 +607,12 @@ void CL_Disconnect (void)
 
 		if (time > 0)
 			Com_Printf ("%i frames, %3.1f seconds: %3.1f fps\n", cl.timedemo_frames, time / 1000.0, cl.timedemo_frames * 1000.0 / time);
+
+		CL_TimeDemo_Report (time);
 	}
 
+	CL_DeltaBench_Run ();
+
 	VectorClear (cl.refdef.blend);
 
 	M_ForceMenuOff ();
@@ -619,11 +634,7 @@ void CL_Disconnect (void)
 	CL_ClearState ();
 
 	// stop download
-	if (cls.download)
-	{
-		fclose (cls.download);
-		cls.download = NULL;
-	}
+	CL_AbortDownload ();
 
 	cls.state = ca_disconnected;
 }
@@ -1486,12 +1497,23 @@ void CL_InitLocal (void)
 
 	cl_vwep = Cvar_Get ("cl_vwep", "1", CVAR_ARCHIVE, NULL);
 
+	// chunks in flight for downloads, 0 for the old one chunk per round trip protocol
+	cl_downloadwindow = Cvar_Get ("cl_downloadwindow", "32", CVAR_ARCHIVE, NULL);
+
 #ifdef _DEBUG
 	cl_showfps = Cvar_Get ("scr_showfps", "1", 0, NULL);
 #else
 	cl_showfps = Cvar_Get ("scr_showfps", "0", CVAR_ARCHIVE, NULL);
 #endif
 
+	CL_TimeDemo_Init ();
+	CL_DemoIndex_Init ();
+	CL_DeltaBench_Init ();
+	CL_InitJobs ();
+	CL_InitParticles ();
+	CL_InitTEnts ();
+	CL_InitDlights ();
+
 	// register our commands
 	Cmd_AddCommand ("cmd", CL_ForwardToServer_f);
 	Cmd_AddCommand ("pause", CL_Pause_f);
@@ -1499,6 +1521,7 @@ void CL_InitLocal (void)
 	Cmd_AddCommand ("skins", CL_Skins_f);
 
 	Cmd_AddCommand ("userinfo", CL_Userinfo_f);
+	Cmd_AddCommand ("poolstats", CL_PoolStats_f);
 	Cmd_AddCommand ("snd_restart", CL_Snd_Restart_f);
 
 	Cmd_AddCommand ("changing", CL_Changing_f);
@@ -1737,14 +1760,20 @@ void CL_Frame (int msec)
 	if (msec > 1000)
 		cls.netchan.last_received = Sys_Milliseconds ();
 
+	CL_TimeDemo_Begin (TD_FRAME);
+
 	// fetch results from server
+	CL_TimeDemo_Begin (TD_PARSE);
 	CL_ReadPackets ();
+	CL_TimeDemo_End (TD_PARSE);
 
 	// send a new command message to the server
 	CL_SendCommand ();
 
 	// predict all unacknowledged movements
+	CL_TimeDemo_Begin (TD_PREDICT);
 	CL_PredictMovement ();
+	CL_TimeDemo_End (TD_PREDICT);
 
 	// do one-time stuff if necessary
 	if (!cl.refresh_prepped && cls.state == ca_active)
@@ -1754,7 +1783,9 @@ void CL_Frame (int msec)
 	SCR_UpdateScreen (SCR_DEFAULT);
 
 	// update audio
+	CL_TimeDemo_Begin (TD_SOUND);
 	S_Update (cl.refdef.vieworg, cl.v_forward, cl.v_right, cl.v_up);
+	CL_TimeDemo_End (TD_SOUND);
 
 	CDAudio_Update ();
 
@@ -1763,6 +1794,9 @@ void CL_Frame (int msec)
 	SCR_RunCinematic ();
 	SCR_RunConsole ();
 
+	CL_TimeDemo_End (TD_FRAME);
+	CL_TimeDemo_EndFrame ();
+
 	cls.framecount++;
 }
 
@@ -1835,6 +1869,7 @@ void CL_Shutdown (void)
 	S_Shutdown ();
 	IN_Shutdown ();
 	VID_Shutdown ();
+	CL_ShutdownJobs ();
 }
 
 
@@ -20,6 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // cl_parse.c  -- parse a message received from the server
 
 #include "client.h"
+#include <io.h>
 
 char *svc_strings[256] =
 {
@@ -45,11 +46,55 @@ char *svc_strings[256] =
 	"svc_playerinfo",
 	"svc_packetentities",
 	"svc_deltapacketentities",
-	"svc_frame"
+	"svc_frame",
+	"svc_downloadchunk"
 };
 
 //=============================================================================
 
+static void CL_ClearDownloadWindow (void)
+{
+	if (cls.downloadreceived)
+	{
+		Zone_Free (cls.downloadreceived);
+		cls.downloadreceived = NULL;
+	}
+
+	cls.downloadwindowed = false;
+	cls.downloadstarted = false;
+	cls.downloadacknow = false;
+}
+
+
+/*
+===============
+CL_SendDownloadRequest
+
+servers that don't know windowed downloads ignore the window and answer with svc_download
+===============
+*/
+static void CL_SendDownloadRequest (int offset)
+{
+	int window = (int) cl_downloadwindow->value;
+
+	if (window > DOWNLOAD_WINDOW)
+		window = DOWNLOAD_WINDOW;
+
+	CL_ClearDownloadWindow ();
+
+	cls.downloadwindowed = (window > 0);
+	cls.downloadoffset = offset;
+
+	MSG_WriteByte (&cls.netchan.message, clc_stringcmd);
+
+	if (window > 0)
+		MSG_WriteString (&cls.netchan.message, va ("download %s %i %i", cls.downloadname, offset, window));
+	else if (offset)
+		MSG_WriteString (&cls.netchan.message, va ("download %s %i", cls.downloadname, offset));
+	else MSG_WriteString (&cls.netchan.message, va ("download %s", cls.downloadname));
+}
+
+
 void CL_DownloadFileName (char *dest, int destlen, char *fn)
 {
 	if (strncmp (fn, "players", 7) == 0)
@@ -110,14 +155,12 @@ qboolean CL_CheckOrDownloadFile (char *filename)
 
 		// give the server an offset to start the download
 		Com_Printf ("Resuming %s\n", cls.downloadname);
-		MSG_WriteByte (&cls.netchan.message, clc_stringcmd);
-		MSG_WriteString (&cls.netchan.message, va ("download %s %i", cls.downloadname, len));
+		CL_SendDownloadRequest (len);
 	}
 	else
 	{
 		Com_Printf ("Downloading %s\n", cls.downloadname);
-		MSG_WriteByte (&cls.netchan.message, clc_stringcmd);
-		MSG_WriteString (&cls.netchan.message, va ("download %s", cls.downloadname));
+		CL_SendDownloadRequest (0);
 	}
 
 	cls.downloadnumber++;
@@ -167,8 +210,7 @@ void CL_Download_f (void)
 	COM_StripExtension (cls.downloadname, cls.downloadtempname);
 	strcat (cls.downloadtempname, ".tmp");
 
-	MSG_WriteByte (&cls.netchan.message, clc_stringcmd);
-	MSG_WriteString (&cls.netchan.message, va ("download %s", cls.downloadname));
+	CL_SendDownloadRequest (0);
 
 	cls.downloadnumber++;
 }
@@ -204,16 +246,40 @@ CL_ParseDownload
 A download message has been received from the server
 =====================
 */
+static void CL_FinishDownload (void)
+{
+	char	oldn[MAX_OSPATH];
+	char	newn[MAX_OSPATH];
+
+	fclose (cls.download);
+
+	// rename the temp file to it's final name
+	CL_DownloadFileName (oldn, sizeof (oldn), cls.downloadtempname);
+	CL_DownloadFileName (newn, sizeof (newn), cls.downloadname);
+
+	if (rename (oldn, newn))
+		Com_Printf ("failed to rename.\n");
+
+	cls.download = NULL;
+	cls.downloadpercent = 0;
+
+	// get another file if needed
+	CL_RequestNextDownload ();
+}
+
+
 void CL_ParseDownload (void)
 {
 	int		size, percent;
 	char	name[MAX_OSPATH];
-	int		r;
 
 	// read the data
 	size = MSG_ReadShort (&net_message);
 	percent = MSG_ReadByte (&net_message);
 
+	// refused, or the server only knows the old protocol
+	CL_ClearDownloadWindow ();
+
 	if (size == -1)
 	{
 		Com_Printf ("Server does not have this file.\n");
@@ -256,27 +322,185 @@ void CL_ParseDownload (void)
 		MSG_WriteByte (&cls.netchan.message, clc_stringcmd);
 		SZ_Print (&cls.netchan.message, "nextdl");
 	}
-	else
+	else CL_FinishDownload ();
+}
+
+
+/*
+=====================
+CL_ParseDownloadChunk
+
+chunks of a windowed download can arrive in any order, more than once, or after the download has finished
+=====================
+*/
+void CL_ParseDownloadChunk (void)
+{
+	int		id = MSG_ReadByte (&net_message);
+	int		filesize = MSG_ReadLong (&net_message);
+	int		offset = MSG_ReadLong (&net_message);
+	int		size = MSG_ReadShort (&net_message);
+	byte	*data = net_message.data + net_message.readcount;
+	int		chunk = offset / DOWNLOAD_CHUNK;
+
+	if (size < 0 || net_message.readcount + size > net_message.cursize)
+		Com_Error (ERR_DROP, "CL_ParseDownloadChunk: bad size");
+
+	net_message.readcount += size;
+
+	// the server keeps resending a finished download until it hears that the last chunk arrived
+	if (id && id == cls.downloaddoneid)
 	{
-		char	oldn[MAX_OSPATH];
-		char	newn[MAX_OSPATH];
+		if (cls.downloadfinalacks < 1)
+			cls.downloadfinalacks = 1;
 
-		fclose (cls.download);
+		return;
+	}
 
-		// rename the temp file to it's final name
-		CL_DownloadFileName (oldn, sizeof (oldn), cls.downloadtempname);
-		CL_DownloadFileName (newn, sizeof (newn), cls.downloadname);
-		r = rename (oldn, newn);
+	if (!cls.downloadwindowed)
+		return;
 
-		if (r)
-			Com_Printf ("failed to rename.\n");
+	if (!cls.downloadstarted)
+	{
+		// the first chunk of a new download has a new id, and describes the file
+		if (id == cls.downloadid || filesize <= 0)
+			return;
 
-		cls.download = NULL;
-		cls.downloadpercent = 0;
+		cls.downloadid = id;
+		cls.downloadchunks = (filesize + DOWNLOAD_CHUNK - 1) / DOWNLOAD_CHUNK;
+		cls.downloadreceived = (byte *) Zone_Alloc ((cls.downloadchunks + 7) >> 3);
+		cls.downloadstarted = true;
 
-		// get another file if needed
-		CL_RequestNextDownload ();
+		// the server starts on the chunk holding the resume offset
+		if ((cls.downloadbase = cls.downloadoffset / DOWNLOAD_CHUNK) > cls.downloadchunks)
+			cls.downloadbase = cls.downloadchunks;
+	}
+	else if (id != cls.downloadid)
+		return;
+
+	if (offset < 0 || (offset % DOWNLOAD_CHUNK) || chunk >= cls.downloadchunks)
+		return;
+
+	// the server didn't hear about this one so make sure it does
+	cls.downloadacknow = true;
+
+	if (chunk < cls.downloadbase || (cls.downloadreceived[chunk >> 3] & (1 << (chunk & 7))))
+		return;
+
+	// open the file if not opened yet
+	if (!cls.download)
+	{
+		char name[MAX_OSPATH];
+
+		CL_DownloadFileName (name, sizeof (name), cls.downloadtempname);
+		FS_CreatePath (name);
+
+		if ((cls.download = fopen (name, "wb")) == NULL)
+		{
+			Com_Printf ("Failed to open %s\n", cls.downloadtempname);
+			CL_ClearDownloadWindow ();
+			CL_RequestNextDownload ();
+			return;
+		}
 	}
+
+	fseek (cls.download, offset, SEEK_SET);
+	fwrite (data, 1, size, cls.download);
+
+	cls.downloadreceived[chunk >> 3] |= 1 << (chunk & 7);
+
+	while (cls.downloadbase < cls.downloadchunks && (cls.downloadreceived[cls.downloadbase >> 3] & (1 << (cls.downloadbase & 7))))
+		cls.downloadbase++;
+
+	cls.downloadpercent = cls.downloadbase * 100 / cls.downloadchunks;
+
+	if (cls.downloadbase < cls.downloadchunks)
+		return;
+
+	// the server keeps the file until it hears that the last chunk arrived, so tell it a few times; any
+	// chunks of it that arrive after that are acked again
+	CL_ClearDownloadWindow ();
+	cls.downloaddoneid = cls.downloadid;
+	cls.downloaddonechunks = cls.downloadchunks;
+	cls.downloadfinalacks = 4;
+
+	CL_FinishDownload ();
+}
+
+
+static void CL_WriteAck (sizebuf_t *buf, int id, int base, unsigned mask)
+{
+	MSG_WriteByte (buf, clc_downloadack);
+	MSG_WriteByte (buf, id);
+	MSG_WriteLong (buf, base);
+	MSG_WriteLong (buf, mask);
+}
+
+
+/*
+=====================
+CL_WriteDownloadAck
+
+goes in the unreliable part of every packet while chunks are arriving; a finished download's acks
+can go in the same packet as the first ones for the next
+=====================
+*/
+void CL_WriteDownloadAck (sizebuf_t *buf)
+{
+	unsigned	mask = 0;
+	int			i;
+
+	if (cls.downloadfinalacks > 0)
+	{
+		// a base past the last chunk acks all of it
+		CL_WriteAck (buf, cls.downloaddoneid, cls.downloaddonechunks, 0);
+		cls.downloadfinalacks--;
+	}
+
+	if (!cls.downloadwindowed || !cls.downloadstarted || !cls.downloadacknow)
+		return;
+
+	for (i = 0; i < 32; i++)
+	{
+		int chunk = cls.downloadbase + 1 + i;
+
+		if (chunk < cls.downloadchunks && (cls.downloadreceived[chunk >> 3] & (1 << (chunk & 7))))
+			mask |= 1u << i;
+	}
+
+	cls.downloadacknow = false;
+
+	CL_WriteAck (buf, cls.downloadid, cls.downloadbase, mask);
+}
+
+
+/*
+=====================
+CL_AbortDownload
+
+a windowed download can leave holes after the first missing chunk, so the temp file is cut back to what's
+whole and resuming by its length carries on from there
+=====================
+*/
+void CL_AbortDownload (void)
+{
+	if (cls.download)
+	{
+		if (cls.downloadwindowed && cls.downloadstarted)
+		{
+			fflush (cls.download);
+			_chsize (_fileno (cls.download), cls.downloadbase * DOWNLOAD_CHUNK);
+		}
+
+		fclose (cls.download);
+		cls.download = NULL;
+	}
+
+	CL_ClearDownloadWindow ();
+
+	// the next server numbers its downloads from the start again
+	cls.downloadid = 0;
+	cls.downloaddoneid = 0;
+	cls.downloadfinalacks = 0;
 }
 
 
@@ -770,6 +994,10 @@ void CL_ParseServerMessage (void)
 			CL_ParseDownload ();
 			break;
 
+		case svc_downloadchunk:
+			CL_ParseDownloadChunk ();
+			break;
+
 		case svc_frame:
 			CL_ParseFrame ();
 			break;
@@ -50,13 +50,132 @@ static vec3_t avelocities[NUMVERTEXNORMALS] = {
 
 PARTICLE MANAGEMENT
 
+live particles are kept packed at the front of parallel arrays.  movement
+is done on the GPU from the spawn position, velocity and acceleration, so
+the only thing the CPU does with a particle after it's spawned is age it
+and drop it when it has faded out.  the three fields that ageing reads
+each get an array of their own and are done four at a time; the rest only
+ever go to the renderer, so they're kept in its vertex layout and drawing
+a particle is a single copy into the scene.
+
+the effects fill in cparticle_t's from CL_GetParticle, or a run of them at
+once from CL_GetParticles, and CL_AddParticles moves the new ones into the
+arrays.  the arrays hold cl_maxparticles; when they're full the oldest
+particles, which are always at the front, make way for the new ones.
+
 ==============================================================
 */
 
-cparticle_t	*active_particles, *free_particles;
-cparticle_t	particles[MAX_PARTICLES];
+#if defined (_M_IX86) || defined (_M_X64) || defined (__SSE__)
+#include <xmmintrin.h>
+#define CL_PARTICLE_SSE
+#endif
+
+// aged every frame; each array has a spare group on the end so four can be loaded from any particle
+static float		*cl_parttime;		// cl.time when it was spawned
+static float		*cl_partalpha;
+static float		*cl_partalphavel;
+
+// only copied to the scene, with time and alpha filled in then
+static particle_t	*cl_partdraw;
+
+// the survivors are moved into these each frame and then the two sets are swapped
+static float		*cl_backtime;
+static float		*cl_backalpha;
+static float		*cl_backalphavel;
+static particle_t	*cl_backdraw;
+
+static int			cl_numactiveparticles = 0;
+
+// spawned since the last CL_AddParticles
+static cparticle_t	*cl_newparticles;
+static int			cl_numnewparticles = 0;
+
+// dropped to make room before they had faded out
+static int			cl_partevicted = 0;
+
+static cvar_t		*cl_maxparticles;
+
+// particlebench turns this off to time the plain C loop
+static qboolean		cl_partusesse = true;
+
+// the effects' own random numbers; see CL_PartRand
+static unsigned int	cl_partseed = 0x2545f491;
+
+int			cl_numparticles = 0;
+
+// each job ages or moves this many; a multiple of 4
+#define PARTICLE_CHUNK		2048
+
+// cl_maxparticles is clamped to this so that the array sizes can't overflow an int
+#define PARTICLE_LIMIT		1048576
+
+static cljobbatch_t	cl_partbatch;
+static qboolean		cl_partageing = false;	// CL_BeginParticles has started the batch for this frame
+static float		cl_partnow;
+static int			cl_partnumchunks;
+
+static byte			*cl_partkeep;			// a bit for each particle in a group of four that's still visible
+static int			*cl_partchunks;			// how many survived in each chunk, then where they go
+static particle_t	*cl_partout;			// the scene's particles
+
+static const byte	cl_partbitcount[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+
+
+static void CL_FreeParticles (void)
+{
+	Zone_Free (cl_parttime);
+	Zone_Free (cl_partalpha);
+	Zone_Free (cl_partalphavel);
+	Zone_Free (cl_partdraw);
+
+	Zone_Free (cl_backtime);
+	Zone_Free (cl_backalpha);
+	Zone_Free (cl_backalphavel);
+	Zone_Free (cl_backdraw);
+
+	Zone_Free (cl_newparticles);
+	Zone_Free (cl_partkeep);
+	Zone_Free (cl_partchunks);
+}
+
+
+// (re)allocates the arrays when cl_maxparticles has changed
+static void CL_SizeParticles (void)
+{
+	int size;
+
+	// clamped before it's converted as a huge float doesn't fit in an int either
+	if (cl_maxparticles->value > PARTICLE_LIMIT)
+		size = PARTICLE_LIMIT;
+	else if (cl_maxparticles->value < 1024)
+		size = 1024;
+	else size = ((int) cl_maxparticles->value + 3) & ~3;
 
-int			cl_numparticles = MAX_PARTICLES;
+	cl_maxparticles->modified = false;
+
+	if (size == cl_numparticles)
+		return;
+
+	if (cl_numparticles)
+		CL_FreeParticles ();
+
+	cl_parttime = (float *) Zone_Alloc ((size + 4) * sizeof (float));
+	cl_partalpha = (float *) Zone_Alloc ((size + 4) * sizeof (float));
+	cl_partalphavel = (float *) Zone_Alloc ((size + 4) * sizeof (float));
+	cl_partdraw = (particle_t *) Zone_Alloc (size * sizeof (particle_t));
+
+	cl_backtime = (float *) Zone_Alloc ((size + 4) * sizeof (float));
+	cl_backalpha = (float *) Zone_Alloc ((size + 4) * sizeof (float));
+	cl_backalphavel = (float *) Zone_Alloc ((size + 4) * sizeof (float));
+	cl_backdraw = (particle_t *) Zone_Alloc (size * sizeof (particle_t));
+
+	cl_newparticles = (cparticle_t *) Zone_Alloc (size * sizeof (cparticle_t));
+	cl_partkeep = (byte *) Zone_Alloc (size / 4);
+	cl_partchunks = (int *) Zone_Alloc ((size / PARTICLE_CHUNK + 1) * sizeof (int));
+
+	cl_numparticles = size;
+}
 
 
 /*
@@ -66,30 +185,29 @@ CL_ClearParticles
 */
 void CL_ClearParticles (void)
 {
-	int		i;
+	// the workers may still be ageing the old ones
+	if (cl_partageing)
+	{
+		CL_FinishJobs (&cl_partbatch);
+		cl_partageing = false;
+	}
 
-	free_particles = &particles[0];
-	active_particles = NULL;
+	cl_numactiveparticles = 0;
+	cl_numnewparticles = 0;
 
-	for (i = 0; i < cl_numparticles; i++)
-		particles[i].next = &particles[i + 1];
-	particles[cl_numparticles - 1].next = NULL;
+	if (cl_maxparticles)
+		CL_SizeParticles ();
 }
 
 
 cparticle_t *CL_GetParticle (void)
 {
-	if (!free_particles)
+	if (cl_numnewparticles >= cl_numparticles)
 		return NULL;
 	else
 	{
 		// get a new particle
-		cparticle_t *p = free_particles;
-
-		// link it in
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+		cparticle_t *p = &cl_newparticles[cl_numnewparticles++];
 
 		// save off creation time for it
 		p->time = cl.time;
@@ -100,6 +218,75 @@ cparticle_t *CL_GetParticle (void)
 }
 
 
+/*
+===============
+CL_GetParticles
+
+reserves up to count particles at once, which is what most effects want; returns how
+many it got, which follow on from *first.  their spawn time is set as for CL_GetParticle
+===============
+*/
+int CL_GetParticles (int count, cparticle_t **first)
+{
+	int room = cl_numparticles - cl_numnewparticles;
+	int i;
+
+	if (count > room) count = room;
+	if (count < 0) count = 0;
+
+	*first = &cl_newparticles[cl_numnewparticles];
+
+	for (i = 0; i < count; i++)
+		cl_newparticles[cl_numnewparticles + i].time = cl.time;
+
+	cl_numnewparticles += count;
+
+	return count;
+}
+
+
+// how many particles a trail puts down over len units at one every spacing units
+static int CL_TrailCount (float len, float spacing)
+{
+	if (len <= 0 || spacing <= 0)
+		return 0;
+
+	return (int) ceil (len / spacing);
+}
+
+
+/*
+===============
+CL_PartRand
+
+the effects take several random numbers for every particle, so they use an
+xorshift generator that inlines to a few instructions instead of calling rand ().
+particles are only made on the main thread so one seed does.  the ranges are
+the same as rand (), frand () and crand () with a 15-bit RAND_MAX
+===============
+*/
+static __inline int CL_PartRand (void)
+{
+	cl_partseed ^= cl_partseed << 13;
+	cl_partseed ^= cl_partseed >> 17;
+	cl_partseed ^= cl_partseed << 5;
+
+	return (cl_partseed >> 16) & 0x7fff;
+}
+
+
+static __inline float CL_PartFrand (void)
+{
+	return CL_PartRand () * (1.0f / 32767.0f);
+}
+
+
+static __inline float CL_PartCrand (void)
+{
+	return CL_PartRand () * (2.0f / 32767.0f) - 1.0f;
+}
+
+
 /*
 ===============
 CL_ParticleEffect
@@ -109,28 +296,28 @@ Wall impact puffs
 */
 void CL_ParticleEffect (vec3_t org, vec3_t dir, int color, int count)
 {
-	int			i, j;
+	int			i, j, n;
 	cparticle_t	*p;
 	float		d;
 
-	for (i = 0; i < count; i++)
-	{
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (count, &p);
 
-		p->color = color + (rand () & 7);
-		d = rand () & 31;
+	for (i = 0; i < n; i++, p++)
+	{
+		p->color = color + (CL_PartRand () & 7);
+		d = CL_PartRand () & 31;
 
 		for (j = 0; j < 3; j++)
 		{
-			p->org[j] = org[j] + ((rand () & 7) - 4) + d * dir[j];
-			p->vel[j] = crand () * 20;
+			p->org[j] = org[j] + ((CL_PartRand () & 7) - 4) + d * dir[j];
+			p->vel[j] = CL_PartCrand () * 20;
 		}
 
 		p->accel[0] = p->accel[1] = 0;
 		p->accel[2] = -PARTICLE_GRAVITY;
 
 		p->alpha = 1.0;
-		p->alphavel = -1.0 / (0.5 + frand () * 0.3);
+		p->alphavel = -1.0 / (0.5 + CL_PartFrand () * 0.3);
 	}
 }
 
@@ -142,28 +329,28 @@ CL_ParticleEffect2
 */
 void CL_ParticleEffect2 (vec3_t org, vec3_t dir, int color, int count)
 {
-	int			i, j;
+	int			i, j, n;
 	cparticle_t	*p;
 	float		d;
 
-	for (i = 0; i < count; i++)
-	{
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (count, &p);
 
+	for (i = 0; i < n; i++, p++)
+	{
 		p->color = color;
-		d = rand () & 7;
+		d = CL_PartRand () & 7;
 
 		for (j = 0; j < 3; j++)
 		{
-			p->org[j] = org[j] + ((rand () & 7) - 4) + d * dir[j];
-			p->vel[j] = crand () * 20;
+			p->org[j] = org[j] + ((CL_PartRand () & 7) - 4) + d * dir[j];
+			p->vel[j] = CL_PartCrand () * 20;
 		}
 
 		p->accel[0] = p->accel[1] = 0;
 		p->accel[2] = -PARTICLE_GRAVITY;
 
 		p->alpha = 1.0;
-		p->alphavel = -1.0 / (0.5 + frand () * 0.3);
+		p->alphavel = -1.0 / (0.5 + CL_PartFrand () * 0.3);
 	}
 }
 
@@ -176,28 +363,28 @@ CL_ParticleEffect3
 */
 void CL_ParticleEffect3 (vec3_t org, vec3_t dir, int color, int count)
 {
-	int			i, j;
+	int			i, j, n;
 	cparticle_t	*p;
 	float		d;
 
-	for (i = 0; i < count; i++)
-	{
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (count, &p);
 
+	for (i = 0; i < n; i++, p++)
+	{
 		p->color = color;
-		d = rand () & 7;
+		d = CL_PartRand () & 7;
 
 		for (j = 0; j < 3; j++)
 		{
-			p->org[j] = org[j] + ((rand () & 7) - 4) + d * dir[j];
-			p->vel[j] = crand () * 20;
+			p->org[j] = org[j] + ((CL_PartRand () & 7) - 4) + d * dir[j];
+			p->vel[j] = CL_PartCrand () * 20;
 		}
 
 		p->accel[0] = p->accel[1] = 0;
 		p->accel[2] = PARTICLE_GRAVITY;
 
 		p->alpha = 1.0;
-		p->alphavel = -1.0 / (0.5 + frand () * 0.3);
+		p->alphavel = -1.0 / (0.5 + CL_PartFrand () * 0.3);
 	}
 }
 
@@ -208,23 +395,23 @@ CL_TeleporterParticles
 */
 void CL_TeleporterParticles (entity_state_t *ent)
 {
-	int			i, j;
+	int			i, j, n;
 	cparticle_t	*p;
 
-	for (i = 0; i < 8; i++)
-	{
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (8, &p);
 
+	for (i = 0; i < n; i++, p++)
+	{
 		p->color = 0xdb;
 
 		for (j = 0; j < 2; j++)
 		{
-			p->org[j] = ent->origin[j] - 16 + (rand () & 31);
-			p->vel[j] = crand () * 14;
+			p->org[j] = ent->origin[j] - 16 + (CL_PartRand () & 31);
+			p->vel[j] = CL_PartCrand () * 14;
 		}
 
-		p->org[2] = ent->origin[2] - 8 + (rand () & 7);
-		p->vel[2] = 80 + (rand () & 7);
+		p->org[2] = ent->origin[2] - 8 + (CL_PartRand () & 7);
+		p->vel[2] = 80 + (CL_PartRand () & 7);
 
 		p->accel[0] = p->accel[1] = 0;
 		p->accel[2] = -PARTICLE_GRAVITY;
@@ -243,32 +430,32 @@ CL_LogoutEffect
 */
 void CL_LogoutEffect (vec3_t org, int type)
 {
-	int			i, j;
+	int			i, j, n;
 	cparticle_t	*p;
 
-	for (i = 0; i < 500; i++)
-	{
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (500, &p);
 
+	for (i = 0; i < n; i++, p++)
+	{
 		if (type == MZ_LOGIN)
-			p->color = 0xd0 + (rand () & 7);	// green
+			p->color = 0xd0 + (CL_PartRand () & 7);	// green
 		else if (type == MZ_LOGOUT)
-			p->color = 0x40 + (rand () & 7);	// red
+			p->color = 0x40 + (CL_PartRand () & 7);	// red
 		else
-			p->color = 0xe0 + (rand () & 7);	// yellow
+			p->color = 0xe0 + (CL_PartRand () & 7);	// yellow
 
-		p->org[0] = org[0] - 16 + frand () * 32;
-		p->org[1] = org[1] - 16 + frand () * 32;
-		p->org[2] = org[2] - 24 + frand () * 56;
+		p->org[0] = org[0] - 16 + CL_PartFrand () * 32;
+		p->org[1] = org[1] - 16 + CL_PartFrand () * 32;
+		p->org[2] = org[2] - 24 + CL_PartFrand () * 56;
 
 		for (j = 0; j < 3; j++)
-			p->vel[j] = crand () * 20;
+			p->vel[j] = CL_PartCrand () * 20;
 
 		p->accel[0] = p->accel[1] = 0;
 		p->accel[2] = -PARTICLE_GRAVITY;
 
 		p->alpha = 1.0;
-		p->alphavel = -1.0 / (1.0 + frand () * 0.3);
+		p->alphavel = -1.0 / (1.0 + CL_PartFrand () * 0.3);
 	}
 }
 
@@ -281,27 +468,27 @@ CL_ItemRespawnParticles
 */
 void CL_ItemRespawnParticles (vec3_t org)
 {
-	int			i, j;
+	int			i, j, n;
 	cparticle_t	*p;
 
-	for (i = 0; i < 64; i++)
-	{
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (64, &p);
 
-		p->color = 0xd4 + (rand () & 3);	// green
+	for (i = 0; i < n; i++, p++)
+	{
+		p->color = 0xd4 + (CL_PartRand () & 3);	// green
 
-		p->org[0] = org[0] + crand () * 8;
-		p->org[1] = org[1] + crand () * 8;
-		p->org[2] = org[2] + crand () * 8;
+		p->org[0] = org[0] + CL_PartCrand () * 8;
+		p->org[1] = org[1] + CL_PartCrand () * 8;
+		p->org[2] = org[2] + CL_PartCrand () * 8;
 
 		for (j = 0; j < 3; j++)
-			p->vel[j] = crand () * 8;
+			p->vel[j] = CL_PartCrand () * 8;
 
 		p->accel[0] = p->accel[1] = 0;
 		p->accel[2] = -PARTICLE_GRAVITY * 0.2;
 
 		p->alpha = 1.0;
-		p->alphavel = -1.0 / (1.0 + frand () * 0.3);
+		p->alphavel = -1.0 / (1.0 + CL_PartFrand () * 0.3);
 	}
 }
 
@@ -313,26 +500,26 @@ CL_ExplosionParticles
 */
 void CL_ExplosionParticles (vec3_t org)
 {
-	int			i, j;
+	int			i, j, n;
 	cparticle_t	*p;
 
-	for (i = 0; i < 256; i++)
-	{
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (256, &p);
 
-		p->color = 0xe0 + (rand () & 7);
+	for (i = 0; i < n; i++, p++)
+	{
+		p->color = 0xe0 + (CL_PartRand () & 7);
 
 		for (j = 0; j < 3; j++)
 		{
-			p->org[j] = org[j] + ((rand () % 32) - 16);
-			p->vel[j] = (rand () % 384) - 192;
+			p->org[j] = org[j] + ((CL_PartRand () % 32) - 16);
+			p->vel[j] = (CL_PartRand () % 384) - 192;
 		}
 
 		p->accel[0] = p->accel[1] = 0;
 		p->accel[2] = -PARTICLE_GRAVITY;
 
 		p->alpha = 1.0;
-		p->alphavel = -0.8 / (0.5 + frand () * 0.3);
+		p->alphavel = -0.8 / (0.5 + CL_PartFrand () * 0.3);
 	}
 }
 
@@ -344,34 +531,34 @@ CL_BigTeleportParticles
 */
 void CL_BigTeleportParticles (vec3_t org)
 {
-	int			i;
+	int			i, n;
 	cparticle_t	*p;
 	float		angle, dist;
 	static int colortable[4] = {2 * 8, 13 * 8, 21 * 8, 18 * 8};
 
-	for (i = 0; i < 4096; i++)
-	{
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (4096, &p);
 
-		p->color = colortable[rand () & 3];
+	for (i = 0; i < n; i++, p++)
+	{
+		p->color = colortable[CL_PartRand () & 3];
 
-		angle = M_PI * 2 * (rand () & 1023) / 1023.0;
-		dist = rand () & 31;
+		angle = M_PI * 2 * (CL_PartRand () & 1023) / 1023.0;
+		dist = CL_PartRand () & 31;
 
 		p->org[0] = org[0] + cos (angle) * dist;
-		p->vel[0] = cos (angle) * (70 + (rand () & 63));
+		p->vel[0] = cos (angle) * (70 + (CL_PartRand () & 63));
 		p->accel[0] = -cos (angle) * 100;
 
 		p->org[1] = org[1] + sin (angle) * dist;
-		p->vel[1] = sin (angle) * (70 + (rand () & 63));
+		p->vel[1] = sin (angle) * (70 + (CL_PartRand () & 63));
 		p->accel[1] = -sin (angle) * 100;
 
-		p->org[2] = org[2] + 8 + (rand () % 90);
-		p->vel[2] = -100 + (rand () & 31);
+		p->org[2] = org[2] + 8 + (CL_PartRand () % 90);
+		p->vel[2] = -100 + (CL_PartRand () & 31);
 		p->accel[2] = PARTICLE_GRAVITY * 4;
 
 		p->alpha = 1.0;
-		p->alphavel = -0.3 / (0.5 + frand () * 0.3);
+		p->alphavel = -0.3 / (0.5 + CL_PartFrand () * 0.3);
 	}
 }
 
@@ -385,30 +572,30 @@ Wall impact puffs
 */
 void CL_BlasterParticles (vec3_t org, vec3_t dir)
 {
-	int			i, j;
+	int			i, j, n;
 	cparticle_t	*p;
 	float		d;
 	int			count;
 
 	count = 40;
-	for (i = 0; i < count; i++)
-	{
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (count, &p);
 
-		p->color = 0xe0 + (rand () & 7);
-		d = rand () & 15;
+	for (i = 0; i < n; i++, p++)
+	{
+		p->color = 0xe0 + (CL_PartRand () & 7);
+		d = CL_PartRand () & 15;
 
 		for (j = 0; j < 3; j++)
 		{
-			p->org[j] = org[j] + ((rand () & 7) - 4) + d * dir[j];
-			p->vel[j] = dir[j] * 30 + crand () * 40;
+			p->org[j] = org[j] + ((CL_PartRand () & 7) - 4) + d * dir[j];
+			p->vel[j] = dir[j] * 30 + CL_PartCrand () * 40;
 		}
 
 		p->accel[0] = p->accel[1] = 0;
 		p->accel[2] = -PARTICLE_GRAVITY;
 
 		p->alpha = 1.0;
-		p->alphavel = -1.0 / (0.5 + frand () * 0.3);
+		p->alphavel = -1.0 / (0.5 + CL_PartFrand () * 0.3);
 	}
 }
 
@@ -424,7 +611,7 @@ void CL_BlasterTrail (vec3_t start, vec3_t end)
 	vec3_t		move;
 	vec3_t		vec;
 	float		len;
-	int			j;
+	int			i, j, n;
 	cparticle_t	*p;
 	int			dec;
 
@@ -435,23 +622,20 @@ void CL_BlasterTrail (vec3_t start, vec3_t end)
 	dec = 5;
 	VectorScale (vec, 5, vec);
 
-	// FIXME: this is a really silly way to have a loop
-	while (len > 0)
-	{
-		len -= dec;
-
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (CL_TrailCount (len, dec), &p);
 
+	for (i = 0; i < n; i++, p++)
+	{
 		VectorClear (p->accel);
 
 		p->alpha = 1.0;
-		p->alphavel = -1.0 / (0.3 + frand () * 0.2);
+		p->alphavel = -1.0 / (0.3 + CL_PartFrand () * 0.2);
 		p->color = 0xe0;
 
 		for (j = 0; j < 3; j++)
 		{
-			p->org[j] = move[j] + crand ();
-			p->vel[j] = crand () * 5;
+			p->org[j] = move[j] + CL_PartCrand ();
+			p->vel[j] = CL_PartCrand () * 5;
 		}
 
 		VectorAdd (move, vec, move);
@@ -469,7 +653,7 @@ void CL_QuadTrail (vec3_t start, vec3_t end)
 	vec3_t		move;
 	vec3_t		vec;
 	float		len;
-	int			j;
+	int			i, j, n;
 	cparticle_t	*p;
 	int			dec;
 
@@ -480,22 +664,20 @@ void CL_QuadTrail (vec3_t start, vec3_t end)
 	dec = 5;
 	VectorScale (vec, 5, vec);
 
-	while (len > 0)
-	{
-		len -= dec;
-
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (CL_TrailCount (len, dec), &p);
 
+	for (i = 0; i < n; i++, p++)
+	{
 		VectorClear (p->accel);
 
 		p->alpha = 1.0;
-		p->alphavel = -1.0 / (0.8 + frand () * 0.2);
+		p->alphavel = -1.0 / (0.8 + CL_PartFrand () * 0.2);
 		p->color = 115;
 
 		for (j = 0; j < 3; j++)
 		{
-			p->org[j] = move[j] + crand () * 16;
-			p->vel[j] = crand () * 5;
+			p->org[j] = move[j] + CL_PartCrand () * 16;
+			p->vel[j] = CL_PartCrand () * 5;
 		}
 
 		VectorAdd (move, vec, move);
@@ -513,7 +695,7 @@ void CL_FlagTrail (vec3_t start, vec3_t end, float color)
 	vec3_t		move;
 	vec3_t		vec;
 	float		len;
-	int			j;
+	int			i, j, n;
 	cparticle_t	*p;
 	int			dec;
 
@@ -524,22 +706,20 @@ void CL_FlagTrail (vec3_t start, vec3_t end, float color)
 	dec = 5;
 	VectorScale (vec, 5, vec);
 
-	while (len > 0)
-	{
-		len -= dec;
-
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (CL_TrailCount (len, dec), &p);
 
+	for (i = 0; i < n; i++, p++)
+	{
 		VectorClear (p->accel);
 
 		p->alpha = 1.0;
-		p->alphavel = -1.0 / (0.8 + frand () * 0.2);
+		p->alphavel = -1.0 / (0.8 + CL_PartFrand () * 0.2);
 		p->color = color;
 
 		for (j = 0; j < 3; j++)
 		{
-			p->org[j] = move[j] + crand () * 16;
-			p->vel[j] = crand () * 5;
+			p->org[j] = move[j] + CL_PartCrand () * 16;
+			p->vel[j] = CL_PartCrand () * 5;
 		}
 
 		VectorAdd (move, vec, move);
@@ -591,7 +771,7 @@ void CL_DiminishingTrail (vec3_t start, vec3_t end, centity_t *old, int flags)
 		len -= dec;
 
 		// drop less particles as it flies
-		if ((rand () & 1023) < old->trailcount)
+		if ((CL_PartRand () & 1023) < old->trailcount)
 		{
 			if ((p = CL_GetParticle ()) == NULL) return;
 
@@ -600,12 +780,12 @@ void CL_DiminishingTrail (vec3_t start, vec3_t end, centity_t *old, int flags)
 			if (flags & EF_GIB)
 			{
 				p->alpha = 1.0;
-				p->alphavel = -1.0 / (1 + frand () * 0.4);
-				p->color = 0xe8 + (rand () & 7);
+				p->alphavel = -1.0 / (1 + CL_PartFrand () * 0.4);
+				p->color = 0xe8 + (CL_PartRand () & 7);
 				for (j = 0; j < 3; j++)
 				{
-					p->org[j] = move[j] + crand () * orgscale;
-					p->vel[j] = crand () * velscale;
+					p->org[j] = move[j] + CL_PartCrand () * orgscale;
+					p->vel[j] = CL_PartCrand () * velscale;
 					p->accel[j] = 0;
 				}
 				p->vel[2] -= PARTICLE_GRAVITY;
@@ -613,12 +793,12 @@ void CL_DiminishingTrail (vec3_t start, vec3_t end, centity_t *old, int flags)
 			else if (flags & EF_GREENGIB)
 			{
 				p->alpha = 1.0;
-				p->alphavel = -1.0 / (1 + frand () * 0.4);
-				p->color = 0xdb + (rand () & 7);
+				p->alphavel = -1.0 / (1 + CL_PartFrand () * 0.4);
+				p->color = 0xdb + (CL_PartRand () & 7);
 				for (j = 0; j < 3; j++)
 				{
-					p->org[j] = move[j] + crand () * orgscale;
-					p->vel[j] = crand () * velscale;
+					p->org[j] = move[j] + CL_PartCrand () * orgscale;
+					p->vel[j] = CL_PartCrand () * velscale;
 					p->accel[j] = 0;
 				}
 				p->vel[2] -= PARTICLE_GRAVITY;
@@ -626,12 +806,12 @@ void CL_DiminishingTrail (vec3_t start, vec3_t end, centity_t *old, int flags)
 			else
 			{
 				p->alpha = 1.0;
-				p->alphavel = -1.0 / (1 + frand () * 0.2);
-				p->color = 4 + (rand () & 7);
+				p->alphavel = -1.0 / (1 + CL_PartFrand () * 0.2);
+				p->color = 4 + (CL_PartRand () & 7);
 				for (j = 0; j < 3; j++)
 				{
-					p->org[j] = move[j] + crand () * orgscale;
-					p->vel[j] = crand () * velscale;
+					p->org[j] = move[j] + CL_PartCrand () * orgscale;
+					p->vel[j] = CL_PartCrand () * velscale;
 				}
 				p->accel[2] = 20;
 			}
@@ -690,20 +870,20 @@ void CL_RocketTrail (vec3_t start, vec3_t end, centity_t *old)
 	{
 		len -= dec;
 
-		if ((rand () & 7) == 0)
+		if ((CL_PartRand () & 7) == 0)
 		{
 			if ((p = CL_GetParticle ()) == NULL) return;
 
 			VectorClear (p->accel);
 
 			p->alpha = 1.0;
-			p->alphavel = -1.0 / (1 + frand () * 0.2);
-			p->color = 0xdc + (rand () & 3);
+			p->alphavel = -1.0 / (1 + CL_PartFrand () * 0.2);
+			p->color = 0xdc + (CL_PartRand () & 3);
 
 			for (j = 0; j < 3; j++)
 			{
-				p->org[j] = move[j] + crand () * 5;
-				p->vel[j] = crand () * 20;
+				p->org[j] = move[j] + CL_PartCrand () * 5;
+				p->vel[j] = CL_PartCrand () * 20;
 			}
 
 			p->accel[2] = -PARTICLE_GRAVITY;
@@ -724,7 +904,7 @@ void CL_RailTrail (vec3_t start, vec3_t end)
 	vec3_t		move;
 	vec3_t		vec;
 	float		len;
-	int			j;
+	int			j, n;
 	cparticle_t	*p;
 	float		dec;
 	vec3_t		right, up;
@@ -739,10 +919,10 @@ void CL_RailTrail (vec3_t start, vec3_t end)
 
 	MakeNormalVectors (vec, right, up);
 
-	for (i = 0; i < len; i++)
-	{
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (CL_TrailCount (len, 1), &p);
 
+	for (i = 0; i < n; i++, p++)
+	{
 		VectorClear (p->accel);
 
 		d = i * 0.1;
@@ -753,8 +933,8 @@ void CL_RailTrail (vec3_t start, vec3_t end)
 		VectorMA (dir, s, up, dir);
 
 		p->alpha = 1.0;
-		p->alphavel = -1.0 / (1 + frand () * 0.2);
-		p->color = clr + (rand () & 7);
+		p->alphavel = -1.0 / (1 + CL_PartFrand () * 0.2);
+		p->color = clr + (CL_PartRand () & 7);
 
 		for (j = 0; j < 3; j++)
 		{
@@ -769,22 +949,20 @@ void CL_RailTrail (vec3_t start, vec3_t end)
 	VectorScale (vec, dec, vec);
 	VectorCopy (start, move);
 
-	while (len > 0)
-	{
-		len -= dec;
-
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (CL_TrailCount (len, dec), &p);
 
+	for (i = 0; i < n; i++, p++)
+	{
 		VectorClear (p->accel);
 
 		p->alpha = 1.0;
-		p->alphavel = -1.0 / (0.6 + frand () * 0.2);
-		p->color = 0x0 + rand () & 15;
+		p->alphavel = -1.0 / (0.6 + CL_PartFrand () * 0.2);
+		p->color = 0x0 + CL_PartRand () & 15;
 
 		for (j = 0; j < 3; j++)
 		{
-			p->org[j] = move[j] + crand () * 3;
-			p->vel[j] = crand () * 3;
+			p->org[j] = move[j] + CL_PartCrand () * 3;
+			p->vel[j] = CL_PartCrand () * 3;
 		}
 
 		VectorAdd (move, vec, move);
@@ -802,7 +980,7 @@ void CL_IonripperTrail (vec3_t start, vec3_t ent)
 	vec3_t	move;
 	vec3_t	vec;
 	float	len;
-	int		j;
+	int		i, j, n;
 	cparticle_t *p;
 	int		dec;
 	int     left = 0;
@@ -814,17 +992,15 @@ void CL_IonripperTrail (vec3_t start, vec3_t ent)
 	dec = 5;
 	VectorScale (vec, 5, vec);
 
-	while (len > 0)
-	{
-		len -= dec;
-
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (CL_TrailCount (len, dec), &p);
 
+	for (i = 0; i < n; i++, p++)
+	{
 		VectorClear (p->accel);
 
 		p->alpha = 0.5;
-		p->alphavel = -1.0 / (0.3 + frand () * 0.2);
-		p->color = 0xe4 + (rand () & 3);
+		p->alphavel = -1.0 / (0.3 + CL_PartFrand () * 0.2);
+		p->color = 0xe4 + (CL_PartRand () & 3);
 
 		for (j = 0; j < 3; j++)
 		{
@@ -862,7 +1038,7 @@ void CL_BubbleTrail (vec3_t start, vec3_t end)
 	vec3_t		move;
 	vec3_t		vec;
 	float		len;
-	int			i, j;
+	int			i, j, n;
 	cparticle_t	*p;
 	float		dec;
 
@@ -873,20 +1049,20 @@ void CL_BubbleTrail (vec3_t start, vec3_t end)
 	dec = 32;
 	VectorScale (vec, dec, vec);
 
-	for (i = 0; i < len; i += dec)
-	{
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (CL_TrailCount (len, dec), &p);
 
+	for (i = 0; i < n; i++, p++)
+	{
 		VectorClear (p->accel);
 
 		p->alpha = 1.0;
-		p->alphavel = -1.0 / (1 + frand () * 0.2);
-		p->color = 4 + (rand () & 7);
+		p->alphavel = -1.0 / (1 + CL_PartFrand () * 0.2);
+		p->color = 4 + (CL_PartRand () & 7);
 
 		for (j = 0; j < 3; j++)
 		{
-			p->org[j] = move[j] + crand () * 2;
-			p->vel[j] = crand () * 5;
+			p->org[j] = move[j] + CL_PartCrand () * 2;
+			p->vel[j] = CL_PartCrand () * 5;
 		}
 
 		p->vel[2] += 6;
@@ -1048,7 +1224,7 @@ void CL_TrapParticles (entity_t *ent)
 	vec3_t		vec;
 	vec3_t		start, end;
 	float		len;
-	int			j;
+	int			i, j, n;
 	cparticle_t	*p;
 	int			dec;
 
@@ -1064,23 +1240,20 @@ void CL_TrapParticles (entity_t *ent)
 	dec = 5;
 	VectorScale (vec, 5, vec);
 
-	// FIXME: this is a really silly way to have a loop
-	while (len > 0)
-	{
-		len -= dec;
-
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (CL_TrailCount (len, dec), &p);
 
+	for (i = 0; i < n; i++, p++)
+	{
 		VectorClear (p->accel);
 
 		p->alpha = 1.0;
-		p->alphavel = -1.0 / (0.3 + frand () * 0.2);
+		p->alphavel = -1.0 / (0.3 + CL_PartFrand () * 0.2);
 		p->color = 0xe0;
 
 		for (j = 0; j < 3; j++)
 		{
-			p->org[j] = move[j] + crand ();
-			p->vel[j] = crand () * 15;
+			p->org[j] = move[j] + CL_PartCrand ();
+			p->vel[j] = CL_PartCrand () * 15;
 		}
 
 		p->accel[2] = PARTICLE_GRAVITY;
@@ -1106,20 +1279,20 @@ void CL_TrapParticles (entity_t *ent)
 				{
 					if ((p = CL_GetParticle ()) == NULL) return;
 
-					p->color = 0xe0 + (rand () & 3);
+					p->color = 0xe0 + (CL_PartRand () & 3);
 					p->alpha = 1.0;
-					p->alphavel = -1.0 / (0.3 + (rand () & 7) * 0.02);
+					p->alphavel = -1.0 / (0.3 + (CL_PartRand () & 7) * 0.02);
 
-					p->org[0] = org[0] + i + ((rand () & 23) * crand ());
-					p->org[1] = org[1] + j + ((rand () & 23) * crand ());
-					p->org[2] = org[2] + k + ((rand () & 23) * crand ());
+					p->org[0] = org[0] + i + ((CL_PartRand () & 23) * CL_PartCrand ());
+					p->org[1] = org[1] + j + ((CL_PartRand () & 23) * CL_PartCrand ());
+					p->org[2] = org[2] + k + ((CL_PartRand () & 23) * CL_PartCrand ());
 
 					dir[0] = j * 8;
 					dir[1] = i * 8;
 					dir[2] = k * 8;
 
 					VectorNormalize (dir);
-					vel = 50 + rand () & 63;
+					vel = 50 + CL_PartRand () & 63;
 					VectorScale (dir, vel, p->vel);
 
 					p->accel[0] = p->accel[1] = 0;
@@ -1139,26 +1312,26 @@ CL_BFGExplosionParticles
 //FIXME combined with CL_ExplosionParticles
 void CL_BFGExplosionParticles (vec3_t org)
 {
-	int			i, j;
+	int			i, j, n;
 	cparticle_t	*p;
 
-	for (i = 0; i < 256; i++)
-	{
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (256, &p);
 
-		p->color = 0xd0 + (rand () & 7);
+	for (i = 0; i < n; i++, p++)
+	{
+		p->color = 0xd0 + (CL_PartRand () & 7);
 
 		for (j = 0; j < 3; j++)
 		{
-			p->org[j] = org[j] + ((rand () % 32) - 16);
-			p->vel[j] = (rand () % 384) - 192;
+			p->org[j] = org[j] + ((CL_PartRand () % 32) - 16);
+			p->vel[j] = (CL_PartRand () % 384) - 192;
 		}
 
 		p->accel[0] = p->accel[1] = 0;
 		p->accel[2] = -PARTICLE_GRAVITY;
 
 		p->alpha = 1.0;
-		p->alphavel = -0.8 / (0.5 + frand () * 0.3);
+		p->alphavel = -0.8 / (0.5 + CL_PartFrand () * 0.3);
 	}
 }
 
@@ -1184,21 +1357,21 @@ void CL_TeleportParticles (vec3_t org)
 			{
 				if ((p = CL_GetParticle ()) == NULL) return;
 
-				p->color = 7 + (rand () & 7);
+				p->color = 7 + (CL_PartRand () & 7);
 
 				p->alpha = 1.0;
-				p->alphavel = -1.0 / (0.3 + (rand () & 7) * 0.02);
+				p->alphavel = -1.0 / (0.3 + (CL_PartRand () & 7) * 0.02);
 
-				p->org[0] = org[0] + i + (rand () & 3);
-				p->org[1] = org[1] + j + (rand () & 3);
-				p->org[2] = org[2] + k + (rand () & 3);
+				p->org[0] = org[0] + i + (CL_PartRand () & 3);
+				p->org[1] = org[1] + j + (CL_PartRand () & 3);
+				p->org[2] = org[2] + k + (CL_PartRand () & 3);
 
 				dir[0] = j * 8;
 				dir[1] = i * 8;
 				dir[2] = k * 8;
 
 				VectorNormalize (dir);
-				vel = 50 + (rand () & 63);
+				vel = 50 + (CL_PartRand () & 63);
 				VectorScale (dir, vel, p->vel);
 
 				p->accel[0] = p->accel[1] = 0;
@@ -1266,7 +1439,7 @@ void CL_DebugTrail (vec3_t start, vec3_t end)
 	cparticle_t	*p;
 	float		dec;
 	vec3_t		right, up;
-	//	int			i;
+	int			i, n;
 	//	float		d, c, s;
 	//	vec3_t		dir;
 
@@ -1284,18 +1457,16 @@ void CL_DebugTrail (vec3_t start, vec3_t end)
 	VectorScale (vec, dec, vec);
 	VectorCopy (start, move);
 
-	while (len > 0)
-	{
-		len -= dec;
-
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (CL_TrailCount (len, dec), &p);
 
+	for (i = 0; i < n; i++, p++)
+	{
 		VectorClear (p->accel);
 		VectorClear (p->vel);
 
 		p->alpha = 1.0;
 		p->alphavel = -0.1;
-		p->color = 0x74 + (rand () & 7);
+		p->color = 0x74 + (CL_PartRand () & 7);
 
 		VectorCopy (move, p->org);
 		VectorAdd (move, vec, move);
@@ -1313,7 +1484,7 @@ void CL_SmokeTrail (vec3_t start, vec3_t end, int colorStart, int colorRun, int
 	vec3_t		move;
 	vec3_t		vec;
 	float		len;
-	int			j;
+	int			i, j, n;
 	cparticle_t	*p;
 
 	VectorCopy (start, move);
@@ -1322,23 +1493,20 @@ void CL_SmokeTrail (vec3_t start, vec3_t end, int colorStart, int colorRun, int
 
 	VectorScale (vec, spacing, vec);
 
-	// FIXME: this is a really silly way to have a loop
-	while (len > 0)
-	{
-		len -= spacing;
-
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (CL_TrailCount (len, spacing), &p);
 
+	for (i = 0; i < n; i++, p++)
+	{
 		VectorClear (p->accel);
 
 		p->alpha = 1.0;
-		p->alphavel = -1.0 / (1 + frand () * 0.5);
-		p->color = colorStart + (rand () % colorRun);
+		p->alphavel = -1.0 / (1 + CL_PartFrand () * 0.5);
+		p->color = colorStart + (CL_PartRand () % colorRun);
 
 		for (j = 0; j < 3; j++)
-			p->org[j] = move[j] + crand () * 3;
+			p->org[j] = move[j] + CL_PartCrand () * 3;
 
-		p->vel[2] = 20 + crand () * 5;
+		p->vel[2] = 20 + CL_PartCrand () * 5;
 		VectorAdd (move, vec, move);
 	}
 }
@@ -1362,22 +1530,22 @@ void CL_ForceWall (vec3_t start, vec3_t end, int color)
 	{
 		len -= 4;
 
-		if (frand () > 0.3)
+		if (CL_PartFrand () > 0.3)
 		{
 			if ((p = CL_GetParticle ()) == NULL) return;
 
 			VectorClear (p->accel);
 
 			p->alpha = 1.0;
-			p->alphavel = -1.0 / (3.0 + frand () * 0.5);
+			p->alphavel = -1.0 / (3.0 + CL_PartFrand () * 0.5);
 			p->color = color;
 
 			for (j = 0; j < 3; j++)
-				p->org[j] = move[j] + crand () * 3;
+				p->org[j] = move[j] + CL_PartCrand () * 3;
 
 			p->vel[0] = 0;
 			p->vel[1] = 0;
-			p->vel[2] = -40 - (crand () * 10);
+			p->vel[2] = -40 - (CL_PartCrand () * 10);
 		}
 
 		VectorAdd (move, vec, move);
@@ -1390,7 +1558,7 @@ void CL_FlameEffects (centity_t *ent, vec3_t origin)
 	int			j;
 	cparticle_t	*p;
 
-	count = rand () & 0xF;
+	count = CL_PartRand () & 0xF;
 
 	for (n = 0; n < count; n++)
 	{
@@ -1399,20 +1567,20 @@ void CL_FlameEffects (centity_t *ent, vec3_t origin)
 		VectorClear (p->accel);
 
 		p->alpha = 1.0;
-		p->alphavel = -1.0 / (1 + frand () * 0.2);
-		p->color = 226 + (rand () % 4);
+		p->alphavel = -1.0 / (1 + CL_PartFrand () * 0.2);
+		p->color = 226 + (CL_PartRand () % 4);
 
 		for (j = 0; j < 3; j++)
 		{
-			p->org[j] = origin[j] + crand () * 5;
-			p->vel[j] = crand () * 5;
+			p->org[j] = origin[j] + CL_PartCrand () * 5;
+			p->vel[j] = CL_PartCrand () * 5;
 		}
 
-		p->vel[2] = crand () * -10;
+		p->vel[2] = CL_PartCrand () * -10;
 		p->accel[2] = -PARTICLE_GRAVITY;
 	}
 
-	count = rand () & 0x7;
+	count = CL_PartRand () & 0x7;
 
 	for (n = 0; n < count; n++)
 	{
@@ -1421,15 +1589,15 @@ void CL_FlameEffects (centity_t *ent, vec3_t origin)
 		VectorClear (p->accel);
 
 		p->alpha = 1.0;
-		p->alphavel = -1.0 / (1 + frand () * 0.5);
-		p->color = 0 + (rand () % 4);
+		p->alphavel = -1.0 / (1 + CL_PartFrand () * 0.5);
+		p->color = 0 + (CL_PartRand () % 4);
 
 		for (j = 0; j < 3; j++)
 		{
-			p->org[j] = origin[j] + crand () * 3;
+			p->org[j] = origin[j] + CL_PartCrand () * 3;
 		}
 
-		p->vel[2] = 20 + crand () * 5;
+		p->vel[2] = 20 + CL_PartCrand () * 5;
 	}
 }
 
@@ -1441,24 +1609,24 @@ CL_GenericParticleEffect
 */
 void CL_GenericParticleEffect (vec3_t org, vec3_t dir, int color, int count, int numcolors, int dirspread, float alphavel)
 {
-	int			i, j;
+	int			i, j, n;
 	cparticle_t	*p;
 	float		d;
 
-	for (i = 0; i < count; i++)
-	{
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (count, &p);
 
+	for (i = 0; i < n; i++, p++)
+	{
 		if (numcolors > 1)
-			p->color = color + (rand () & numcolors);
+			p->color = color + (CL_PartRand () & numcolors);
 		else
 			p->color = color;
 
-		d = rand () & dirspread;
+		d = CL_PartRand () & dirspread;
 		for (j = 0; j < 3; j++)
 		{
-			p->org[j] = org[j] + ((rand () & 7) - 4) + d * dir[j];
-			p->vel[j] = crand () * 20;
+			p->org[j] = org[j] + ((CL_PartRand () & 7) - 4) + d * dir[j];
+			p->vel[j] = CL_PartCrand () * 20;
 		}
 
 		p->accel[0] = p->accel[1] = 0;
@@ -1466,7 +1634,7 @@ void CL_GenericParticleEffect (vec3_t org, vec3_t dir, int color, int count, int
 		//		VectorCopy (accel, p->accel);
 		p->alpha = 1.0;
 
-		p->alphavel = -1.0 / (0.5 + frand () * alphavel);
+		p->alphavel = -1.0 / (0.5 + CL_PartFrand () * alphavel);
 		//		p->alphavel = alphavel;
 	}
 }
@@ -1482,7 +1650,7 @@ void CL_BubbleTrail2 (vec3_t start, vec3_t end, int dist)
 	vec3_t		move;
 	vec3_t		vec;
 	float		len;
-	int			i, j;
+	int			i, j, n;
 	cparticle_t	*p;
 	float		dec;
 
@@ -1493,20 +1661,20 @@ void CL_BubbleTrail2 (vec3_t start, vec3_t end, int dist)
 	dec = dist;
 	VectorScale (vec, dec, vec);
 
-	for (i = 0; i < len; i += dec)
-	{
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (CL_TrailCount (len, dec), &p);
 
+	for (i = 0; i < n; i++, p++)
+	{
 		VectorClear (p->accel);
 
 		p->alpha = 1.0;
-		p->alphavel = -1.0 / (1 + frand () * 0.1);
-		p->color = 4 + (rand () & 7);
+		p->alphavel = -1.0 / (1 + CL_PartFrand () * 0.1);
+		p->color = 4 + (CL_PartRand () & 7);
 
 		for (j = 0; j < 3; j++)
 		{
-			p->org[j] = move[j] + crand () * 2;
-			p->vel[j] = crand () * 10;
+			p->org[j] = move[j] + CL_PartCrand () * 2;
+			p->vel[j] = CL_PartCrand () * 10;
 		}
 
 		p->org[2] -= 4;
@@ -1592,7 +1760,7 @@ void CL_Heatbeam (vec3_t start, vec3_t forward)
 			//		p->alphavel = -1.0 / (1 + frand () * 0.2);
 			p->alphavel = -1000.0;
 			//		p->color = 0x74 + (rand () & 7);
-			p->color = 223 - (rand () & 7);
+			p->color = 223 - (CL_PartRand () & 7);
 
 			for (j = 0; j < 3; j++)
 			{
@@ -1615,7 +1783,7 @@ Puffs with velocity along direction, with some randomness thrown in
 */
 void CL_ParticleSteamEffect (vec3_t org, vec3_t dir, int color, int count, int magnitude)
 {
-	int			i, j;
+	int			i, j, n;
 	cparticle_t	*p;
 	float		d;
 	vec3_t		r, u;
@@ -1625,29 +1793,29 @@ void CL_ParticleSteamEffect (vec3_t org, vec3_t dir, int color, int count, int m
 
 	MakeNormalVectors (dir, r, u);
 
-	for (i = 0; i < count; i++)
-	{
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (count, &p);
 
-		p->color = color + (rand () & 7);
+	for (i = 0; i < n; i++, p++)
+	{
+		p->color = color + (CL_PartRand () & 7);
 
 		for (j = 0; j < 3; j++)
 		{
-			p->org[j] = org[j] + magnitude * 0.1 * crand ();
+			p->org[j] = org[j] + magnitude * 0.1 * CL_PartCrand ();
 			//			p->vel[j] = dir[j] * magnitude;
 		}
 
 		VectorScale (dir, magnitude, p->vel);
-		d = crand () * magnitude / 3;
+		d = CL_PartCrand () * magnitude / 3;
 		VectorMA (p->vel, d, r, p->vel);
-		d = crand () * magnitude / 3;
+		d = CL_PartCrand () * magnitude / 3;
 		VectorMA (p->vel, d, u, p->vel);
 
 		p->accel[0] = p->accel[1] = 0;
 		p->accel[2] = -PARTICLE_GRAVITY / 2;
 		p->alpha = 1.0;
 
-		p->alphavel = -1.0 / (0.5 + frand () * 0.3);
+		p->alphavel = -1.0 / (0.5 + CL_PartFrand () * 0.3);
 	}
 }
 
@@ -1671,25 +1839,25 @@ void CL_ParticleSteamEffect2 (cl_sustain_t *self)
 	{
 		if ((p = CL_GetParticle ()) == NULL) return;
 
-		p->color = self->color + (rand () & 7);
+		p->color = self->color + (CL_PartRand () & 7);
 
 		for (j = 0; j < 3; j++)
 		{
-			p->org[j] = self->org[j] + self->magnitude * 0.1 * crand ();
+			p->org[j] = self->org[j] + self->magnitude * 0.1 * CL_PartCrand ();
 			//			p->vel[j] = dir[j] * magnitude;
 		}
 
 		VectorScale (dir, self->magnitude, p->vel);
-		d = crand () * self->magnitude / 3;
+		d = CL_PartCrand () * self->magnitude / 3;
 		VectorMA (p->vel, d, r, p->vel);
-		d = crand () * self->magnitude / 3;
+		d = CL_PartCrand () * self->magnitude / 3;
 		VectorMA (p->vel, d, u, p->vel);
 
 		p->accel[0] = p->accel[1] = 0;
 		p->accel[2] = -PARTICLE_GRAVITY / 2;
 		p->alpha = 1.0;
 
-		p->alphavel = -1.0 / (0.5 + frand () * 0.3);
+		p->alphavel = -1.0 / (0.5 + CL_PartFrand () * 0.3);
 	}
 	self->nextthink += self->thinkinterval;
 }
@@ -1706,7 +1874,7 @@ void CL_TrackerTrail (vec3_t start, vec3_t end, int particleColor)
 	vec3_t		forward, right, up, angle_dir;
 	float		len;
 	cparticle_t	*p;
-	int			dec;
+	int			i, dec, n;
 	float		dist;
 
 	VectorCopy (start, move);
@@ -1720,13 +1888,10 @@ void CL_TrackerTrail (vec3_t start, vec3_t end, int particleColor)
 	dec = 3;
 	VectorScale (vec, 3, vec);
 
-	// FIXME: this is a really silly way to have a loop
-	while (len > 0)
-	{
-		len -= dec;
-
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (CL_TrailCount (len, dec), &p);
 
+	for (i = 0; i < n; i++, p++)
+	{
 		VectorClear (p->accel);
 
 		p->alpha = 1.0;
@@ -1745,22 +1910,22 @@ void CL_TrackerTrail (vec3_t start, vec3_t end, int particleColor)
 void CL_Tracker_Shell (vec3_t origin)
 {
 	vec3_t			dir;
-	int				i;
+	int				i, n;
 	cparticle_t		*p;
 
-	for (i = 0; i < 300; i++)
-	{
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (300, &p);
 
+	for (i = 0; i < n; i++, p++)
+	{
 		VectorClear (p->accel);
 
 		p->alpha = 1.0;
 		p->alphavel = INSTANT_PARTICLE;
 		p->color = 0;
 
-		dir[0] = crand ();
-		dir[1] = crand ();
-		dir[2] = crand ();
+		dir[0] = CL_PartCrand ();
+		dir[1] = CL_PartCrand ();
+		dir[2] = CL_PartCrand ();
 		VectorNormalize (dir);
 
 		VectorMA (origin, 40, dir, p->org);
@@ -1770,22 +1935,22 @@ void CL_Tracker_Shell (vec3_t origin)
 void CL_MonsterPlasma_Shell (vec3_t origin)
 {
 	vec3_t			dir;
-	int				i;
+	int				i, n;
 	cparticle_t		*p;
 
-	for (i = 0; i < 40; i++)
-	{
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (40, &p);
 
+	for (i = 0; i < n; i++, p++)
+	{
 		VectorClear (p->accel);
 
 		p->alpha = 1.0;
 		p->alphavel = INSTANT_PARTICLE;
 		p->color = 0xe0;
 
-		dir[0] = crand ();
-		dir[1] = crand ();
-		dir[2] = crand ();
+		dir[0] = CL_PartCrand ();
+		dir[1] = CL_PartCrand ();
+		dir[2] = CL_PartCrand ();
 		VectorNormalize (dir);
 
 		VectorMA (origin, 10, dir, p->org);
@@ -1796,26 +1961,26 @@ void CL_MonsterPlasma_Shell (vec3_t origin)
 void CL_Widowbeamout (cl_sustain_t *self)
 {
 	vec3_t			dir;
-	int				i;
+	int				i, n;
 	cparticle_t		*p;
 	static int colortable[4] = {2 * 8, 13 * 8, 21 * 8, 18 * 8};
 	float			ratio;
 
 	ratio = 1.0 - (((float) self->endtime - (float) cl.time) / 2100.0);
 
-	for (i = 0; i < 300; i++)
-	{
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (300, &p);
 
+	for (i = 0; i < n; i++, p++)
+	{
 		VectorClear (p->accel);
 
 		p->alpha = 1.0;
 		p->alphavel = INSTANT_PARTICLE;
-		p->color = colortable[rand () & 3];
+		p->color = colortable[CL_PartRand () & 3];
 
-		dir[0] = crand ();
-		dir[1] = crand ();
-		dir[2] = crand ();
+		dir[0] = CL_PartCrand ();
+		dir[1] = CL_PartCrand ();
+		dir[2] = CL_PartCrand ();
 		VectorNormalize (dir);
 
 		VectorMA (self->org, (45.0 * ratio), dir, p->org);
@@ -1826,26 +1991,26 @@ void CL_Widowbeamout (cl_sustain_t *self)
 void CL_Nukeblast (cl_sustain_t *self)
 {
 	vec3_t			dir;
-	int				i;
+	int				i, n;
 	cparticle_t		*p;
 	static int colortable[4] = {110, 112, 114, 116};
 	float			ratio;
 
 	ratio = 1.0 - (((float) self->endtime - (float) cl.time) / 1000.0);
 
-	for (i = 0; i < 700; i++)
-	{
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (700, &p);
 
+	for (i = 0; i < n; i++, p++)
+	{
 		VectorClear (p->accel);
 
 		p->alpha = 1.0;
 		p->alphavel = INSTANT_PARTICLE;
-		p->color = colortable[rand () & 3];
+		p->color = colortable[CL_PartRand () & 3];
 
-		dir[0] = crand ();
-		dir[1] = crand ();
-		dir[2] = crand ();
+		dir[0] = CL_PartCrand ();
+		dir[1] = CL_PartCrand ();
+		dir[2] = CL_PartCrand ();
 		VectorNormalize (dir);
 
 		VectorMA (self->org, (200.0 * ratio), dir, p->org);
@@ -1856,19 +2021,19 @@ void CL_Nukeblast (cl_sustain_t *self)
 void CL_WidowSplash (vec3_t org)
 {
 	static int colortable[4] = {2 * 8, 13 * 8, 21 * 8, 18 * 8};
-	int			i;
+	int			i, n;
 	cparticle_t	*p;
 	vec3_t		dir;
 
-	for (i = 0; i < 256; i++)
-	{
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (256, &p);
 
-		p->color = colortable[rand () & 3];
+	for (i = 0; i < n; i++, p++)
+	{
+		p->color = colortable[CL_PartRand () & 3];
 
-		dir[0] = crand ();
-		dir[1] = crand ();
-		dir[2] = crand ();
+		dir[0] = CL_PartCrand ();
+		dir[1] = CL_PartCrand ();
+		dir[2] = CL_PartCrand ();
 		VectorNormalize (dir);
 		VectorMA (org, 45.0, dir, p->org);
 		VectorMA (vec3_origin, 40.0, dir, p->vel);
@@ -1876,7 +2041,7 @@ void CL_WidowSplash (vec3_t org)
 		p->accel[0] = p->accel[1] = 0;
 		p->alpha = 1.0;
 
-		p->alphavel = -0.8 / (0.5 + frand () * 0.3);
+		p->alphavel = -0.8 / (0.5 + CL_PartFrand () * 0.3);
 	}
 }
 
@@ -1884,22 +2049,22 @@ void CL_WidowSplash (vec3_t org)
 void CL_Tracker_Explode (vec3_t	origin)
 {
 	vec3_t			dir, backdir;
-	int				i;
+	int				i, n;
 	cparticle_t		*p;
 
-	for (i = 0; i < 300; i++)
-	{
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (300, &p);
 
+	for (i = 0; i < n; i++, p++)
+	{
 		VectorClear (p->accel);
 
 		p->alpha = 1.0;
 		p->alphavel = -1.0;
 		p->color = 0;
 
-		dir[0] = crand ();
-		dir[1] = crand ();
-		dir[2] = crand ();
+		dir[0] = CL_PartCrand ();
+		dir[1] = CL_PartCrand ();
+		dir[2] = CL_PartCrand ();
 		VectorNormalize (dir);
 		VectorScale (dir, -1, backdir);
 
@@ -1940,13 +2105,13 @@ void CL_TagTrail (vec3_t start, vec3_t end, float color)
 		VectorClear (p->accel);
 
 		p->alpha = 1.0;
-		p->alphavel = -1.0 / (0.8 + frand () * 0.2);
+		p->alphavel = -1.0 / (0.8 + CL_PartFrand () * 0.2);
 		p->color = color;
 
 		for (j = 0; j < 3; j++)
 		{
-			p->org[j] = move[j] + crand () * 16;
-			p->vel[j] = crand () * 5;
+			p->org[j] = move[j] + CL_PartCrand () * 16;
+			p->vel[j] = CL_PartCrand () * 5;
 		}
 
 		VectorAdd (move, vec, move);
@@ -1960,26 +2125,26 @@ CL_ColorExplosionParticles
 */
 void CL_ColorExplosionParticles (vec3_t org, int color, int run)
 {
-	int			i, j;
+	int			i, j, n;
 	cparticle_t	*p;
 
-	for (i = 0; i < 128; i++)
-	{
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (128, &p);
 
-		p->color = color + (rand () % run);
+	for (i = 0; i < n; i++, p++)
+	{
+		p->color = color + (CL_PartRand () % run);
 
 		for (j = 0; j < 3; j++)
 		{
-			p->org[j] = org[j] + ((rand () % 32) - 16);
-			p->vel[j] = (rand () % 256) - 128;
+			p->org[j] = org[j] + ((CL_PartRand () % 32) - 16);
+			p->vel[j] = (CL_PartRand () % 256) - 128;
 		}
 
 		p->accel[0] = p->accel[1] = 0;
 		p->accel[2] = -PARTICLE_GRAVITY;
 		p->alpha = 1.0;
 
-		p->alphavel = -0.4 / (0.6 + frand () * 0.2);
+		p->alphavel = -0.4 / (0.6 + CL_PartFrand () * 0.2);
 	}
 }
 
@@ -1990,34 +2155,34 @@ CL_ParticleSmokeEffect - like the steam effect, but unaffected by gravity
 */
 void CL_ParticleSmokeEffect (vec3_t org, vec3_t dir, int color, int count, int magnitude)
 {
-	int			i, j;
+	int			i, j, n;
 	cparticle_t	*p;
 	float		d;
 	vec3_t		r, u;
 
 	MakeNormalVectors (dir, r, u);
 
-	for (i = 0; i < count; i++)
-	{
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (count, &p);
 
-		p->color = color + (rand () & 7);
+	for (i = 0; i < n; i++, p++)
+	{
+		p->color = color + (CL_PartRand () & 7);
 
 		for (j = 0; j < 3; j++)
 		{
-			p->org[j] = org[j] + magnitude * 0.1 * crand ();
+			p->org[j] = org[j] + magnitude * 0.1 * CL_PartCrand ();
 			//			p->vel[j] = dir[j] * magnitude;
 		}
 		VectorScale (dir, magnitude, p->vel);
-		d = crand () * magnitude / 3;
+		d = CL_PartCrand () * magnitude / 3;
 		VectorMA (p->vel, d, r, p->vel);
-		d = crand () * magnitude / 3;
+		d = CL_PartCrand () * magnitude / 3;
 		VectorMA (p->vel, d, u, p->vel);
 
 		p->accel[0] = p->accel[1] = p->accel[2] = 0;
 		p->alpha = 1.0;
 
-		p->alphavel = -1.0 / (0.5 + frand () * 0.3);
+		p->alphavel = -1.0 / (0.5 + CL_PartFrand () * 0.3);
 	}
 }
 
@@ -2030,30 +2195,30 @@ Wall impact puffs (Green)
 */
 void CL_BlasterParticles2 (vec3_t org, vec3_t dir, unsigned int color)
 {
-	int			i, j;
+	int			i, j, n;
 	cparticle_t	*p;
 	float		d;
 	int			count;
 
 	count = 40;
-	for (i = 0; i < count; i++)
-	{
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (count, &p);
 
-		p->color = color + (rand () & 7);
+	for (i = 0; i < n; i++, p++)
+	{
+		p->color = color + (CL_PartRand () & 7);
 
-		d = rand () & 15;
+		d = CL_PartRand () & 15;
 		for (j = 0; j < 3; j++)
 		{
-			p->org[j] = org[j] + ((rand () & 7) - 4) + d * dir[j];
-			p->vel[j] = dir[j] * 30 + crand () * 40;
+			p->org[j] = org[j] + ((CL_PartRand () & 7) - 4) + d * dir[j];
+			p->vel[j] = dir[j] * 30 + CL_PartCrand () * 40;
 		}
 
 		p->accel[0] = p->accel[1] = 0;
 		p->accel[2] = -PARTICLE_GRAVITY;
 		p->alpha = 1.0;
 
-		p->alphavel = -1.0 / (0.5 + frand () * 0.3);
+		p->alphavel = -1.0 / (0.5 + CL_PartFrand () * 0.3);
 	}
 }
 
@@ -2069,7 +2234,7 @@ void CL_BlasterTrail2 (vec3_t start, vec3_t end)
 	vec3_t		move;
 	vec3_t		vec;
 	float		len;
-	int			j;
+	int			i, j, n;
 	cparticle_t	*p;
 	int			dec;
 
@@ -2080,23 +2245,20 @@ void CL_BlasterTrail2 (vec3_t start, vec3_t end)
 	dec = 5;
 	VectorScale (vec, 5, vec);
 
-	// FIXME: this is a really silly way to have a loop
-	while (len > 0)
-	{
-		len -= dec;
-
-		if ((p = CL_GetParticle ()) == NULL) return;
+	n = CL_GetParticles (CL_TrailCount (len, dec), &p);
 
+	for (i = 0; i < n; i++, p++)
+	{
 		VectorClear (p->accel);
 
 		p->alpha = 1.0;
-		p->alphavel = -1.0 / (0.3 + frand () * 0.2);
+		p->alphavel = -1.0 / (0.3 + CL_PartFrand () * 0.2);
 		p->color = 0xd0;
 
 		for (j = 0; j < 3; j++)
 		{
-			p->org[j] = move[j] + crand ();
-			p->vel[j] = crand () * 5;
+			p->org[j] = move[j] + CL_PartCrand ();
+			p->vel[j] = CL_PartCrand () * 5;
 		}
 
 		VectorAdd (move, vec, move);
@@ -2104,64 +2266,348 @@ void CL_BlasterTrail2 (vec3_t start, vec3_t end)
 }
 
 
+// PMM - added INSTANT_PARTICLE handling for heat beam
+static __inline int CL_AgeParticle (float time, float alpha, float alphavel, float now, float *outage, float *outalpha)
+{
+	*outage = (now - time) * 0.001f;
+
+	if (alphavel != INSTANT_PARTICLE)
+	{
+		// this needs to run on the CPU so that we can correctly remove faded-out particles
+		*outalpha = alpha + *outage * alphavel;
+		return (*outalpha > 0);
+	}
+	else
+	{
+		*outalpha = alpha;
+		return 1;
+	}
+}
+
+
 /*
 ===============
-CL_AddParticles
+CL_AgeParticles
+
+ages the four particles from first and returns a bit for each one that's still visible
 ===============
 */
-void CL_AddParticles (void)
+static int CL_AgeParticles (int first, float now, float *age, float *alpha)
+{
+	int i, keep = 0;
+
+#ifdef CL_PARTICLE_SSE
+	if (cl_partusesse)
+	{
+		__m128 t = _mm_mul_ps (_mm_sub_ps (_mm_set1_ps (now), _mm_loadu_ps (&cl_parttime[first])), _mm_set1_ps (0.001f));
+		__m128 a0 = _mm_loadu_ps (&cl_partalpha[first]);
+		__m128 av = _mm_loadu_ps (&cl_partalphavel[first]);
+		__m128 a = _mm_add_ps (a0, _mm_mul_ps (t, av));
+
+		// PMM - added INSTANT_PARTICLE handling for heat beam
+		__m128 instant = _mm_cmpeq_ps (av, _mm_set1_ps (INSTANT_PARTICLE));
+
+		a = _mm_or_ps (_mm_and_ps (instant, a0), _mm_andnot_ps (instant, a));
+
+		_mm_storeu_ps (age, t);
+		_mm_storeu_ps (alpha, a);
+
+		return _mm_movemask_ps (_mm_or_ps (instant, _mm_cmpgt_ps (a, _mm_setzero_ps ())));
+	}
+#endif
+
+	for (i = 0; i < 4; i++)
+	{
+		if (CL_AgeParticle (cl_parttime[first + i], cl_partalpha[first + i], cl_partalphavel[first + i], now, &age[i], &alpha[i]))
+			keep |= 1 << i;
+	}
+
+	return keep;
+}
+
+
+// the first pass; finds which particles in the chunk survive and counts them
+static void CL_AgeParticleChunk (void *data, int chunk)
 {
-	cparticle_t		*p, *next;
-	float			alpha;
+	int		first = chunk * PARTICLE_CHUNK;
+	int		last = first + PARTICLE_CHUNK;
+	int		kept = 0;
+	int		i;
 
-	cparticle_t *active = NULL;
-	cparticle_t *tail = NULL;
+	if (last > cl_numactiveparticles)
+		last = cl_numactiveparticles;
 
-	for (p = active_particles; p; p = next)
+	for (i = first; i < last; i += 4)
 	{
-		// moved this outside the condition so that it's valid for moving the particle below
-		float time = (cl.time - p->time) * 0.001;
+		float	age[4], alpha[4];
+		int		keep = CL_AgeParticles (i, cl_partnow, age, alpha);
 
-		next = p->next;
+		// the last group may run past the last particle
+		if (last - i < 4)
+			keep &= (1 << (last - i)) - 1;
 
-		// PMM - added INSTANT_PARTICLE handling for heat beam
-		if (p->alphavel != INSTANT_PARTICLE)
-		{
-			// this needs to run on the CPU so that we can correctly remove faded-out particles
-			alpha = p->alpha + time * p->alphavel;
+		cl_partkeep[i >> 2] = keep;
+		kept += cl_partbitcount[keep];
+	}
 
-			if (alpha <= 0)
-			{
-				// faded out
-				p->next = free_particles;
-				free_particles = p;
+	cl_partchunks[chunk] = kept;
+}
+
+
+static void CL_MoveParticle (int from, int to, float age, float alpha)
+{
+	cl_backtime[to] = cl_parttime[from];
+	cl_backalpha[to] = cl_partalpha[from];
+	cl_backalphavel[to] = cl_partalphavel[from];
+	cl_backdraw[to] = cl_partdraw[from];
+
+	// particle movement is now done on the GPU
+	cl_partout[to] = cl_partdraw[from];
+	cl_partout[to].time = age;
+	cl_partout[to].alpha = alpha;
+
+	// PMM - INSTANT_PARTICLE only lasts for 1 frame and dies immediately after
+	if (cl_backalphavel[to] == INSTANT_PARTICLE)
+	{
+		cl_backalphavel[to] = 0.0;
+		cl_backalpha[to] = 0.0;
+	}
+}
+
+
+// the second pass; moves the chunk's survivors to where the counts from the first pass put them
+static void CL_MoveParticleChunk (void *data, int chunk)
+{
+	int		first = chunk * PARTICLE_CHUNK;
+	int		last = first + PARTICLE_CHUNK;
+	int		to = cl_partchunks[chunk];
+	int		i, j;
+
+	if (last > cl_numactiveparticles)
+		last = cl_numactiveparticles;
+
+	for (i = first; i < last; i += 4)
+	{
+		float	age[4], alpha[4];
+		int		keep = cl_partkeep[i >> 2];
+
+		if (!keep)
+			continue;
+
+		// ageing again is cheaper than keeping the results from the first pass
+		CL_AgeParticles (i, cl_partnow, age, alpha);
+
+		for (j = 0; j < 4; j++)
+		{
+			if (!(keep & (1 << j)))
 				continue;
-			}
+
+			// anything before the start is being evicted
+			if (to >= 0)
+				CL_MoveParticle (i + j, to, age[j], alpha[j]);
+
+			to++;
 		}
-		else alpha = p->alpha;
+	}
+}
 
-		p->next = NULL;
 
-		if (!tail)
-			active = tail = p;
-		else
+/*
+===============
+CL_BeginParticles
+
+starts ageing the particles on the job threads, which goes on while the main thread adds the
+entities and temp entities; the particles those spawn go on the end in CL_AddParticles
+===============
+*/
+void CL_BeginParticles (void)
+{
+	if (cl_partageing)
+		return;
+
+	// the arrays are reallocated so everything in them goes
+	if (cl_maxparticles->modified)
+		CL_ClearParticles ();
+
+	cl_partnow = cl.time;
+	cl_partnumchunks = (cl_numactiveparticles + PARTICLE_CHUNK - 1) / PARTICLE_CHUNK;
+
+	CL_BeginJobs (&cl_partbatch, CL_AgeParticleChunk, NULL, cl_partnumchunks);
+	cl_partageing = true;
+}
+
+
+/*
+===============
+CL_AddParticles
+
+drops the particles that have faded out, packing the rest down in the order they were spawned,
+and writes the survivors straight into the scene.  the work is split into chunks whose results
+are put together in order, so the scene is the same however many threads did it
+===============
+*/
+void CL_AddParticles (void)
+{
+	int			kept = 0, excess;
+	int			chunk, i;
+	float		*swaptime, *swapalpha, *swapalphavel;
+	particle_t	*swapdraw;
+
+	// particlebench calls this without going through CL_AddEntities
+	CL_BeginParticles ();
+
+	CL_FinishJobs (&cl_partbatch);
+	cl_partageing = false;
+
+	for (chunk = 0; chunk < cl_partnumchunks; chunk++)
+		kept += cl_partchunks[chunk];
+
+	// the oldest survivors make way if there isn't room for everything that was spawned
+	if ((excess = kept + cl_numnewparticles - cl_numparticles) > 0)
+		cl_partevicted += excess;
+	else excess = 0;
+
+	// turn the counts into where each chunk's survivors start
+	for (chunk = 0, kept = -excess; chunk < cl_partnumchunks; chunk++)
+	{
+		int count = cl_partchunks[chunk];
+
+		cl_partchunks[chunk] = kept;
+		kept += count;
+	}
+
+	cl_partout = V_BeginParticles (kept + cl_numnewparticles);
+
+	CL_RunJobs (&cl_partbatch, CL_MoveParticleChunk, NULL, cl_partnumchunks);
+
+	// and the ones that were spawned since the last frame go on the end
+	for (i = 0; i < cl_numnewparticles; i++)
+	{
+		cparticle_t *p = &cl_newparticles[i];
+		particle_t *d = &cl_backdraw[kept];
+		float age, alpha;
+
+		if (!CL_AgeParticle (p->time, p->alpha, p->alphavel, cl_partnow, &age, &alpha))
+			continue;
+
+		cl_backtime[kept] = p->time;
+		cl_backalpha[kept] = p->alpha;
+		cl_backalphavel[kept] = p->alphavel;
+
+		VectorCopy (p->org, d->origin);
+		VectorCopy (p->vel, d->velocity);
+		VectorCopy (p->accel, d->acceleration);
+		d->color = p->color;
+
+		cl_partout[kept] = *d;
+		cl_partout[kept].time = age;
+		cl_partout[kept].alpha = alpha;
+
+		// PMM - INSTANT_PARTICLE only lasts for 1 frame and dies immediately after
+		if (cl_backalphavel[kept] == INSTANT_PARTICLE)
 		{
-			tail->next = p;
-			tail = p;
+			cl_backalphavel[kept] = 0.0;
+			cl_backalpha[kept] = 0.0;
 		}
 
-		// particle movement is now done on the GPU
-		V_AddParticle (p->org, p->vel, p->accel, time, p->color, alpha);
+		kept++;
+	}
 
-		// PMM - INSTANT_PARTICLE only lasts for 1 frame and dies immediately after
-		if (p->alphavel == INSTANT_PARTICLE)
+	// the survivors are now in the back arrays
+	swaptime = cl_parttime; cl_parttime = cl_backtime; cl_backtime = swaptime;
+	swapalpha = cl_partalpha; cl_partalpha = cl_backalpha; cl_backalpha = swapalpha;
+	swapalphavel = cl_partalphavel; cl_partalphavel = cl_backalphavel; cl_backalphavel = swapalphavel;
+	swapdraw = cl_partdraw; cl_partdraw = cl_backdraw; cl_backdraw = swapdraw;
+
+	cl_numactiveparticles = kept;
+	cl_numnewparticles = 0;
+
+	V_EndParticles (kept);
+}
+
+
+/*
+===============
+CL_ParticleBench_f
+
+particlebench [frames]: keeps the particle store full of explosions and rail
+trails and times CL_AddParticles over that many 60 fps frames, with and without
+SSE, as well as the effects that spawned them.  nothing is drawn, so it can be
+run from the console with no map loaded
+===============
+*/
+static void CL_ParticleBench_f (void)
+{
+	int		frames = (Cmd_Argc () > 1) ? atoi (Cmd_Argv (1)) : 600;
+	int		savedtime = cl.time;
+	int		pass, f;
+	double	times[2] = {0, 0};
+	double	counts[2] = {0, 0};
+	double	spawntime = 0, spawned = 0;
+
+	if (frames < 1)
+		frames = 1;
+
+	for (pass = 0; pass < 2; pass++)
+	{
+		cl_partusesse = (pass == 1);
+
+		CL_ClearParticles ();
+		cl_partseed = 0x2545f491;
+
+		for (f = 0, cl.time = 0; f < frames; f++, cl.time += 16)
 		{
-			p->alphavel = 0.0;
-			p->alpha = 0.0;
+			double start = Sys_Microseconds ();
+			int before = cl_numactiveparticles;
+
+			// top up with 256 particle explosions and 256 unit rail trails (about 600 particles) until the store is full
+			while (cl_numactiveparticles + cl_numnewparticles + 1024 <= cl_numparticles)
+			{
+				vec3_t org = {CL_PartCrand () * 1024, CL_PartCrand () * 1024, CL_PartCrand () * 256};
+				vec3_t end = {org[0] + 256, org[1], org[2]};
+
+				CL_ExplosionParticles (org);
+				CL_RailTrail (org, end);
+			}
+
+			spawntime += Sys_Microseconds () - start;
+			spawned += cl_numactiveparticles + cl_numnewparticles - before;
+
+			V_ClearScene ();
+
+			start = Sys_Microseconds ();
+			CL_AddParticles ();
+			times[pass] += Sys_Microseconds () - start;
+			counts[pass] += cl_numactiveparticles;
 		}
 	}
 
-	active_particles = active;
+	cl_partusesse = true;
+	cl.time = savedtime;
+
+	CL_ClearParticles ();
+	V_ClearScene ();
+
+	Com_Printf ("particlebench: %i frames, %0.0f particles a frame, %i job threads\n", frames, counts[0] / frames, CL_NumJobThreads ());
+	Com_Printf ("spawn : %8.3f ms a frame, %6.2f ns a particle\n", spawntime * 0.0005 / frames, spawntime * 1000.0 / spawned);
+	Com_Printf ("C     : %8.3f ms a frame, %6.2f ns a particle\n", times[0] * 0.001 / frames, times[0] * 1000.0 / counts[0]);
+#ifdef CL_PARTICLE_SSE
+	Com_Printf ("SSE   : %8.3f ms a frame, %6.2f ns a particle\n", times[1] * 0.001 / frames, times[1] * 1000.0 / counts[1]);
+#endif
 }
 
 
+void CL_ParticleStats (void)
+{
+	Com_Printf ("%-12s %5i in use %5i allocated %6i limit %6i recycled\n", "particles", cl_numactiveparticles, cl_numparticles, (int) cl_maxparticles->value, cl_partevicted);
+}
+
+
+void CL_InitParticles (void)
+{
+	cl_maxparticles = Cvar_Get ("cl_maxparticles", "65536", CVAR_ARCHIVE, NULL);
+	CL_SizeParticles ();
+
+	Cmd_AddCommand ("particlebench", CL_ParticleBench_f);
+}
+
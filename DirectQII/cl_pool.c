@@ -0,0 +1,238 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// cl_pool.c -- growable pools for the client's temporary effects
+
+#include "client.h"
+
+/*
+==============================================================================
+
+EFFECT POOLS
+
+explosions, beams, lasers, sustains and dlights used to live in small fixed
+arrays that were scanned for a free slot, and then for the oldest one, every
+time one was wanted.  a pool hands them out from a free list and keeps the
+ones in use on a list in the order they were allocated, so getting one,
+freeing one and finding the oldest are all constant time.
+
+a pool starts empty and grows a block at a time, each twice the size of
+everything allocated so far, up to the limit in its cvar.  blocks are never
+moved or given back, so a pointer to an item stays good for as long as the
+client runs.  once the limit is reached the oldest item is recycled rather
+than the new one being dropped.
+
+the item a walk is on can be freed, and the walk carries on from where it
+was, as long as nothing is allocated from the pool before moving on.
+
+==============================================================================
+*/
+
+// items are kept 16 byte aligned after their links
+#define	POOL_ALIGN(size)	(((size) + 15) & ~15)
+#define	POOL_HEADER			POOL_ALIGN (sizeof (poollink_t))
+
+#define	POOL_MINBLOCK		16
+
+// the most a limit cvar can ask for, so that a block's size can't overflow an int
+#define	POOL_MAXLIMIT		65536
+
+#define	POOL_ITEM(link)		((void *) ((byte *) (link) + POOL_HEADER))
+#define	POOL_LINK(item)		((poollink_t *) ((byte *) (item) - POOL_HEADER))
+
+
+/*
+==================
+CL_InitPool
+
+registers the pool's limit cvar; safe to call more than once
+==================
+*/
+void CL_InitPool (clpool_t *pool)
+{
+	if (!pool->active.next)
+		pool->active.next = pool->active.prev = &pool->active;
+
+	if (!pool->limit)
+		pool->limit = Cvar_Get (pool->cvarname, pool->defaultlimit, CVAR_ARCHIVE, NULL);
+}
+
+
+static int CL_PoolLimit (clpool_t *pool)
+{
+	// clamped before it's converted as a huge float doesn't fit in an int either
+	if (pool->limit->value > POOL_MAXLIMIT)
+		return POOL_MAXLIMIT;
+	else if (pool->limit->value < 1)
+		return 1;
+	else return (int) pool->limit->value;
+}
+
+
+static void CL_PoolGrow (clpool_t *pool)
+{
+	int		count = pool->numitems ? pool->numitems : POOL_MINBLOCK;
+	int		stride = POOL_HEADER + POOL_ALIGN (pool->itemsize);
+	byte	*block;
+	int		i;
+
+	if (count > CL_PoolLimit (pool) - pool->numitems)
+		count = CL_PoolLimit (pool) - pool->numitems;
+
+	block = (byte *) Zone_Alloc (count * stride);
+
+	for (i = 0; i < count; i++)
+	{
+		poollink_t *link = (poollink_t *) (block + i * stride);
+
+		link->nextfree = pool->free;
+		pool->free = link;
+	}
+
+	pool->numitems += count;
+}
+
+
+static void CL_PoolUnlink (clpool_t *pool, poollink_t *link)
+{
+	// link->next is left alone so that a walk that's on this item can still find the next one
+	link->prev->next = link->next;
+	link->next->prev = link->prev;
+
+	pool->numactive--;
+}
+
+
+/*
+==================
+CL_PoolAlloc
+
+returns a zeroed item that's newer than everything else in the pool
+==================
+*/
+void *CL_PoolAlloc (clpool_t *pool)
+{
+	poollink_t *link;
+
+	CL_InitPool (pool);
+
+	// the limit may have been lowered since the items were allocated
+	while (pool->numactive >= CL_PoolLimit (pool))
+	{
+		link = pool->active.next;
+
+		CL_PoolUnlink (pool, link);
+
+		link->nextfree = pool->free;
+		pool->free = link;
+
+		pool->evicted++;
+	}
+
+	if (!pool->free && pool->numitems < CL_PoolLimit (pool))
+		CL_PoolGrow (pool);
+
+	link = pool->free;
+	pool->free = link->nextfree;
+
+	memset (POOL_ITEM (link), 0, pool->itemsize);
+
+	link->prev = pool->active.prev;
+	link->next = &pool->active;
+	link->prev->next = link;
+	pool->active.prev = link;
+
+	pool->numactive++;
+
+	return POOL_ITEM (link);
+}
+
+
+void CL_PoolFree (clpool_t *pool, void *item)
+{
+	poollink_t *link = POOL_LINK (item);
+
+	CL_PoolUnlink (pool, link);
+
+	link->nextfree = pool->free;
+	pool->free = link;
+}
+
+
+/*
+==================
+CL_PoolClear
+
+frees everything in the pool, keeping the memory for next time
+==================
+*/
+void CL_PoolClear (clpool_t *pool)
+{
+	while (CL_PoolFirst (pool))
+		CL_PoolFree (pool, CL_PoolFirst (pool));
+}
+
+
+/*
+==================
+CL_PoolFirst
+
+the oldest item in use, or NULL
+==================
+*/
+void *CL_PoolFirst (clpool_t *pool)
+{
+	if (!pool->active.next || pool->active.next == &pool->active)
+		return NULL;
+
+	return POOL_ITEM (pool->active.next);
+}
+
+
+void *CL_PoolNext (clpool_t *pool, void *item)
+{
+	poollink_t *next = POOL_LINK (item)->next;
+
+	return (next == &pool->active) ? NULL : POOL_ITEM (next);
+}
+
+
+void CL_PoolStats (clpool_t *pool)
+{
+	if (!pool->limit)
+		return;
+
+	Com_Printf ("%-12s %5i in use %5i allocated %6i limit %6i recycled\n", pool->cvarname, pool->numactive, pool->numitems, CL_PoolLimit (pool), pool->evicted);
+}
+
+
+/*
+==================
+CL_PoolStats_f
+
+poolstats: how full each effect pool is and how often it has had to recycle
+==================
+*/
+void CL_PoolStats_f (void)
+{
+	CL_ParticleStats ();
+	CL_DlightPoolStats ();
+	CL_TEntPoolStats ();
+}
+
@@ -40,12 +40,9 @@ typedef struct explosion_s
 
 
 
-#define	MAX_EXPLOSIONS	32
-explosion_t	cl_explosions[MAX_EXPLOSIONS];
+static clpool_t cl_explosions = {"cl_maxexplosions", "256", sizeof (explosion_t)};
 
 
-#define	MAX_BEAMS	32
-
 typedef struct beam_s
 {
 	int		entity;
@@ -56,12 +53,10 @@ typedef struct beam_s
 	vec3_t	start, end;
 } beam_t;
 
-beam_t		cl_beams[MAX_BEAMS];
+static clpool_t cl_beams = {"cl_maxbeams", "256", sizeof (beam_t)};
 //PMM - added this for player-linked beams.  Currently only used by the plasma beam
-beam_t		cl_playerbeams[MAX_BEAMS];
-
+static clpool_t cl_playerbeams = {"cl_maxplayerbeams", "64", sizeof (beam_t)};
 
-#define	MAX_LASERS	32
 
 typedef struct laser_s
 {
@@ -69,10 +64,10 @@ typedef struct laser_s
 	int			endtime;
 } laser_t;
 
-laser_t		cl_lasers[MAX_LASERS];
+static clpool_t cl_lasers = {"cl_maxlasers", "256", sizeof (laser_t)};
 
 //ROGUE
-cl_sustain_t	cl_sustains[MAX_SUSTAINS];
+static clpool_t cl_sustains = {"cl_maxsustains", "128", sizeof (cl_sustain_t)};
 //ROGUE
 
 //PGM
@@ -216,52 +211,50 @@ CL_ClearTEnts
 */
 void CL_ClearTEnts (void)
 {
-	memset (cl_beams, 0, sizeof (cl_beams));
-	memset (cl_explosions, 0, sizeof (cl_explosions));
-	memset (cl_lasers, 0, sizeof (cl_lasers));
+	CL_PoolClear (&cl_beams);
+	CL_PoolClear (&cl_explosions);
+	CL_PoolClear (&cl_lasers);
 
 	//ROGUE
-	memset (cl_playerbeams, 0, sizeof (cl_playerbeams));
-	memset (cl_sustains, 0, sizeof (cl_sustains));
+	CL_PoolClear (&cl_playerbeams);
+	CL_PoolClear (&cl_sustains);
 	//ROGUE
 }
 
+
 /*
 =================
-CL_AllocExplosion
+CL_InitTEnts
 =================
 */
-explosion_t *CL_AllocExplosion (void)
+void CL_InitTEnts (void)
 {
-	int		i;
-	int		time;
-	int		index;
-
-	// find a free explosion
-	for (i = 0; i < MAX_EXPLOSIONS; i++)
-	{
-		if (cl_explosions[i].type == ex_free)
-		{
-			memset (&cl_explosions[i], 0, sizeof (cl_explosions[i]));
-			return &cl_explosions[i];
-		}
-	}
+	CL_InitPool (&cl_beams);
+	CL_InitPool (&cl_playerbeams);
+	CL_InitPool (&cl_explosions);
+	CL_InitPool (&cl_lasers);
+	CL_InitPool (&cl_sustains);
+}
 
-	// find the oldest explosion
-	time = cl.time;
-	index = 0;
 
-	for (i = 0; i < MAX_EXPLOSIONS; i++)
-	{
-		if (cl_explosions[i].start < time)
-		{
-			time = cl_explosions[i].start;
-			index = i;
-		}
-	}
+void CL_TEntPoolStats (void)
+{
+	CL_PoolStats (&cl_explosions);
+	CL_PoolStats (&cl_beams);
+	CL_PoolStats (&cl_playerbeams);
+	CL_PoolStats (&cl_lasers);
+	CL_PoolStats (&cl_sustains);
+}
 
-	memset (&cl_explosions[index], 0, sizeof (cl_explosions[index]));
-	return &cl_explosions[index];
+/*
+=================
+CL_AllocExplosion
+=================
+*/
+explosion_t *CL_AllocExplosion (void)
+{
+	// the oldest explosion is replaced if they're all in use
+	return (explosion_t *) CL_PoolAlloc (&cl_explosions);
 }
 
 /*
@@ -310,6 +303,27 @@ void CL_ParseParticles (void)
 	CL_ParticleEffect (pos, dir, color, count);
 }
 
+/*
+=================
+CL_FindBeam
+
+the beam already coming from ent, and going to dest_ent unless that's -1
+=================
+*/
+static beam_t *CL_FindBeam (clpool_t *pool, int ent, int dest_ent)
+{
+	beam_t *b;
+
+	for (b = (beam_t *) CL_PoolFirst (pool); b; b = (beam_t *) CL_PoolNext (pool, b))
+	{
+		if (b->entity == ent && (dest_ent == -1 || b->dest_entity == dest_ent))
+			return b;
+	}
+
+	return NULL;
+}
+
+
 /*
 =================
 CL_ParseBeam
@@ -320,44 +334,23 @@ int CL_ParseBeam (struct model_s *model)
 	int		ent;
 	vec3_t	start, end;
 	beam_t	*b;
-	int		i;
 
 	ent = MSG_ReadShort (&net_message);
 
 	MSG_ReadPos (&net_message, start);
 	MSG_ReadPos (&net_message, end);
 
-	// override any beam with the same entity
-	for (i = 0, b = cl_beams; i < MAX_BEAMS; i++, b++)
-	{
-		if (b->entity == ent)
-		{
-			b->entity = ent;
-			b->model = model;
-			b->endtime = cl.time + 200;
-			VectorCopy (start, b->start);
-			VectorCopy (end, b->end);
-			VectorClear (b->offset);
-			return ent;
-		}
-	}
+	// override any beam with the same entity, or else take a new one
+	if ((b = CL_FindBeam (&cl_beams, ent, -1)) == NULL)
+		b = (beam_t *) CL_PoolAlloc (&cl_beams);
 
-	// find a free beam
-	for (i = 0, b = cl_beams; i < MAX_BEAMS; i++, b++)
-	{
-		if (!b->model || b->endtime < cl.time)
-		{
-			b->entity = ent;
-			b->model = model;
-			b->endtime = cl.time + 200;
-			VectorCopy (start, b->start);
-			VectorCopy (end, b->end);
-			VectorClear (b->offset);
-			return ent;
-		}
-	}
+	b->entity = ent;
+	b->model = model;
+	b->endtime = cl.time + 200;
+	VectorCopy (start, b->start);
+	VectorCopy (end, b->end);
+	VectorClear (b->offset);
 
-	Com_Printf ("beam list overflow!\n");
 	return ent;
 }
 
@@ -371,7 +364,6 @@ int CL_ParseBeam2 (struct model_s *model)
 	int		ent;
 	vec3_t	start, end, offset;
 	beam_t	*b;
-	int		i;
 
 	ent = MSG_ReadShort (&net_message);
 
@@ -381,37 +373,17 @@ int CL_ParseBeam2 (struct model_s *model)
 
 	//	Com_Printf ("end- %f %f %f\n", end[0], end[1], end[2]);
 
-	// override any beam with the same entity
-	for (i = 0, b = cl_beams; i < MAX_BEAMS; i++, b++)
-	{
-		if (b->entity == ent)
-		{
-			b->entity = ent;
-			b->model = model;
-			b->endtime = cl.time + 200;
-			VectorCopy (start, b->start);
-			VectorCopy (end, b->end);
-			VectorCopy (offset, b->offset);
-			return ent;
-		}
-	}
+	// override any beam with the same entity, or else take a new one
+	if ((b = CL_FindBeam (&cl_beams, ent, -1)) == NULL)
+		b = (beam_t *) CL_PoolAlloc (&cl_beams);
 
-	// find a free beam
-	for (i = 0, b = cl_beams; i < MAX_BEAMS; i++, b++)
-	{
-		if (!b->model || b->endtime < cl.time)
-		{
-			b->entity = ent;
-			b->model = model;
-			b->endtime = cl.time + 200;
-			VectorCopy (start, b->start);
-			VectorCopy (end, b->end);
-			VectorCopy (offset, b->offset);
-			return ent;
-		}
-	}
+	b->entity = ent;
+	b->model = model;
+	b->endtime = cl.time + 200;
+	VectorCopy (start, b->start);
+	VectorCopy (end, b->end);
+	VectorCopy (offset, b->offset);
 
-	Com_Printf ("beam list overflow!\n");
 	return ent;
 }
 
@@ -427,7 +399,6 @@ int CL_ParsePlayerBeam (struct model_s *model)
 	int		ent;
 	vec3_t	start, end, offset;
 	beam_t	*b;
-	int		i;
 
 	ent = MSG_ReadShort (&net_message);
 
@@ -449,36 +420,20 @@ int CL_ParsePlayerBeam (struct model_s *model)
 
 	// override any beam with the same entity
 	// PMM - For player beams, we only want one per player (entity) so..
-	for (i = 0, b = cl_playerbeams; i < MAX_BEAMS; i++, b++)
+	if ((b = CL_FindBeam (&cl_playerbeams, ent, -1)) != NULL)
+		b->endtime = cl.time + 200;
+	else
 	{
-		if (b->entity == ent)
-		{
-			b->entity = ent;
-			b->model = model;
-			b->endtime = cl.time + 200;
-			VectorCopy (start, b->start);
-			VectorCopy (end, b->end);
-			VectorCopy (offset, b->offset);
-			return ent;
-		}
+		b = (beam_t *) CL_PoolAlloc (&cl_playerbeams);
+		b->endtime = cl.time + 100;		// PMM - this needs to be 100 to prevent multiple heatbeams
 	}
 
-	// find a free beam
-	for (i = 0, b = cl_playerbeams; i < MAX_BEAMS; i++, b++)
-	{
-		if (!b->model || b->endtime < cl.time)
-		{
-			b->entity = ent;
-			b->model = model;
-			b->endtime = cl.time + 100;		// PMM - this needs to be 100 to prevent multiple heatbeams
-			VectorCopy (start, b->start);
-			VectorCopy (end, b->end);
-			VectorCopy (offset, b->offset);
-			return ent;
-		}
-	}
+	b->entity = ent;
+	b->model = model;
+	VectorCopy (start, b->start);
+	VectorCopy (end, b->end);
+	VectorCopy (offset, b->offset);
 
-	Com_Printf ("beam list overflow!\n");
 	return ent;
 }
 //rogue
@@ -493,7 +448,6 @@ int CL_ParseLightning (struct model_s *model)
 	int		srcEnt, destEnt;
 	vec3_t	start, end;
 	beam_t	*b;
-	int		i;
 
 	srcEnt = MSG_ReadShort (&net_message);
 	destEnt = MSG_ReadShort (&net_message);
@@ -501,41 +455,18 @@ int CL_ParseLightning (struct model_s *model)
 	MSG_ReadPos (&net_message, start);
 	MSG_ReadPos (&net_message, end);
 
-	// override any beam with the same source AND destination entities
-	for (i = 0, b = cl_beams; i < MAX_BEAMS; i++, b++)
-	{
-		if (b->entity == srcEnt && b->dest_entity == destEnt)
-		{
-			//			Com_Printf("%d: OVERRIDE  %d -> %d\n", cl.time, srcEnt, destEnt);
-			b->entity = srcEnt;
-			b->dest_entity = destEnt;
-			b->model = model;
-			b->endtime = cl.time + 200;
-			VectorCopy (start, b->start);
-			VectorCopy (end, b->end);
-			VectorClear (b->offset);
-			return srcEnt;
-		}
-	}
+	// override any beam with the same source AND destination entities, or else take a new one
+	if ((b = CL_FindBeam (&cl_beams, srcEnt, destEnt)) == NULL)
+		b = (beam_t *) CL_PoolAlloc (&cl_beams);
 
-	// find a free beam
-	for (i = 0, b = cl_beams; i < MAX_BEAMS; i++, b++)
-	{
-		if (!b->model || b->endtime < cl.time)
-		{
-			//			Com_Printf("%d: NORMAL  %d -> %d\n", cl.time, srcEnt, destEnt);
-			b->entity = srcEnt;
-			b->dest_entity = destEnt;
-			b->model = model;
-			b->endtime = cl.time + 200;
-			VectorCopy (start, b->start);
-			VectorCopy (end, b->end);
-			VectorClear (b->offset);
-			return srcEnt;
-		}
-	}
+	b->entity = srcEnt;
+	b->dest_entity = destEnt;
+	b->model = model;
+	b->endtime = cl.time + 200;
+	VectorCopy (start, b->start);
+	VectorCopy (end, b->end);
+	VectorClear (b->offset);
 
-	Com_Printf ("beam list overflow!\n");
 	return srcEnt;
 }
 
@@ -549,26 +480,20 @@ void CL_ParseLaser (int colors)
 	vec3_t	start;
 	vec3_t	end;
 	laser_t	*l;
-	int		i;
 
 	MSG_ReadPos (&net_message, start);
 	MSG_ReadPos (&net_message, end);
 
-	for (i = 0, l = cl_lasers; i < MAX_LASERS; i++, l++)
-	{
-		if (l->endtime < cl.time)
-		{
-			l->ent.flags = RF_TRANSLUCENT | RF_BEAM;
-			VectorCopy (start, l->ent.currorigin);
-			VectorCopy (end, l->ent.prevorigin);
-			l->ent.alpha = 0.30;
-			l->ent.skinnum = (colors >> ((rand () % 4) * 8)) & 0xff;
-			l->ent.model = NULL;
-			l->ent.currframe = 4;
-			l->endtime = cl.time + 100;
-			return;
-		}
-	}
+	l = (laser_t *) CL_PoolAlloc (&cl_lasers);
+
+	l->ent.flags = RF_TRANSLUCENT | RF_BEAM;
+	VectorCopy (start, l->ent.currorigin);
+	VectorCopy (end, l->ent.prevorigin);
+	l->ent.alpha = 0.30;
+	l->ent.skinnum = (colors >> ((rand () % 4) * 8)) & 0xff;
+	l->ent.model = NULL;
+	l->ent.currframe = 4;
+	l->endtime = cl.time + 100;
 }
 
 
@@ -577,54 +502,32 @@ void CL_ParseLaser (int colors)
 void CL_ParseSteam (void)
 {
 	vec3_t	pos, dir;
-	int		id, i;
+	int		id;
 	int		r;
 	int		cnt;
 	int		color;
 	int		magnitude;
-	cl_sustain_t	*s, *free_sustain;
+	cl_sustain_t	*s;
 
 	id = MSG_ReadShort (&net_message);		// an id of -1 is an instant effect
 
 	if (id != -1) // sustains
 	{
 		//			Com_Printf ("Sustain effect id %d\n", id);
-		free_sustain = NULL;
-
-		for (i = 0, s = cl_sustains; i < MAX_SUSTAINS; i++, s++)
-		{
-			if (s->id == 0)
-			{
-				free_sustain = s;
-				break;
-			}
-		}
+		// the oldest sustain is replaced if they're all in use
+		s = (cl_sustain_t *) CL_PoolAlloc (&cl_sustains);
 
-		if (free_sustain)
-		{
-			s->id = id;
-			s->count = MSG_ReadByte (&net_message);
-			MSG_ReadPos (&net_message, s->org);
-			MSG_ReadDir (&net_message, s->dir);
-			r = MSG_ReadByte (&net_message);
-			s->color = r & 0xff;
-			s->magnitude = MSG_ReadShort (&net_message);
-			s->endtime = cl.time + MSG_ReadLong (&net_message);
-			s->think = CL_ParticleSteamEffect2;
-			s->thinkinterval = 100;
-			s->nextthink = cl.time;
-		}
-		else
-		{
-			//				Com_Printf ("No free sustains!\n");
-			// FIXME - read the stuff anyway
-			cnt = MSG_ReadByte (&net_message);
-			MSG_ReadPos (&net_message, pos);
-			MSG_ReadDir (&net_message, dir);
-			r = MSG_ReadByte (&net_message);
-			magnitude = MSG_ReadShort (&net_message);
-			magnitude = MSG_ReadLong (&net_message); // really interval
-		}
+		s->id = id;
+		s->count = MSG_ReadByte (&net_message);
+		MSG_ReadPos (&net_message, s->org);
+		MSG_ReadDir (&net_message, s->dir);
+		r = MSG_ReadByte (&net_message);
+		s->color = r & 0xff;
+		s->magnitude = MSG_ReadShort (&net_message);
+		s->endtime = cl.time + MSG_ReadLong (&net_message);
+		s->think = CL_ParticleSteamEffect2;
+		s->thinkinterval = 100;
+		s->nextthink = cl.time;
 	}
 	else // instant
 	{
@@ -642,70 +545,33 @@ void CL_ParseSteam (void)
 
 void CL_ParseWidow (void)
 {
-	vec3_t	pos;
-	int		id, i;
-	cl_sustain_t	*s, *free_sustain;
+	int		id;
+	cl_sustain_t	*s;
 
 	id = MSG_ReadShort (&net_message);
 
-	free_sustain = NULL;
+	s = (cl_sustain_t *) CL_PoolAlloc (&cl_sustains);
 
-	for (i = 0, s = cl_sustains; i < MAX_SUSTAINS; i++, s++)
-	{
-		if (s->id == 0)
-		{
-			free_sustain = s;
-			break;
-		}
-	}
-
-	if (free_sustain)
-	{
-		s->id = id;
-		MSG_ReadPos (&net_message, s->org);
-		s->endtime = cl.time + 2100;
-		s->think = CL_Widowbeamout;
-		s->thinkinterval = 1;
-		s->nextthink = cl.time;
-	}
-	else // no free sustains
-	{
-		// FIXME - read the stuff anyway
-		MSG_ReadPos (&net_message, pos);
-	}
+	s->id = id;
+	MSG_ReadPos (&net_message, s->org);
+	s->endtime = cl.time + 2100;
+	s->think = CL_Widowbeamout;
+	s->thinkinterval = 1;
+	s->nextthink = cl.time;
 }
 
 void CL_ParseNuke (void)
 {
-	vec3_t	pos;
-	int		i;
-	cl_sustain_t	*s, *free_sustain;
-
-	free_sustain = NULL;
+	cl_sustain_t	*s;
 
-	for (i = 0, s = cl_sustains; i < MAX_SUSTAINS; i++, s++)
-	{
-		if (s->id == 0)
-		{
-			free_sustain = s;
-			break;
-		}
-	}
+	s = (cl_sustain_t *) CL_PoolAlloc (&cl_sustains);
 
-	if (free_sustain)
-	{
-		s->id = 21000;
-		MSG_ReadPos (&net_message, s->org);
-		s->endtime = cl.time + 1000;
-		s->think = CL_Nukeblast;
-		s->thinkinterval = 1;
-		s->nextthink = cl.time;
-	}
-	else // no free sustains
-	{
-		// FIXME - read the stuff anyway
-		MSG_ReadPos (&net_message, pos);
-	}
+	s->id = 21000;
+	MSG_ReadPos (&net_message, s->org);
+	s->endtime = cl.time + 1000;
+	s->think = CL_Nukeblast;
+	s->thinkinterval = 1;
+	s->nextthink = cl.time;
 }
 
 //ROGUE
@@ -1239,7 +1105,7 @@ CL_AddBeams
 */
 void CL_AddBeams (void)
 {
-	int			i, j;
+	int			j;
 	beam_t		*b;
 	vec3_t		dist, org;
 	float		d;
@@ -1250,10 +1116,13 @@ void CL_AddBeams (void)
 	float		model_length;
 
 	// update beams
-	for (i = 0, b = cl_beams; i < MAX_BEAMS; i++, b++)
+	for (b = (beam_t *) CL_PoolFirst (&cl_beams); b; b = (beam_t *) CL_PoolNext (&cl_beams, b))
 	{
 		if (!b->model || b->endtime < cl.time)
+		{
+			CL_PoolFree (&cl_beams, b);
 			continue;
+		}
 
 		// if coming from the player, update the start position
 		if (b->entity == cl.playernum + 1)	// entity 0 is the world
@@ -1382,7 +1251,7 @@ CL_AddPlayerBeams
 */
 void CL_AddPlayerBeams (void)
 {
-	int			i, j;
+	int			j;
 	beam_t		*b;
 	vec3_t		dist, org;
 	float		d;
@@ -1414,11 +1283,14 @@ void CL_AddPlayerBeams (void)
 	//PMM
 
 	// update beams
-	for (i = 0, b = cl_playerbeams; i < MAX_BEAMS; i++, b++)
+	for (b = (beam_t *) CL_PoolFirst (&cl_playerbeams); b; b = (beam_t *) CL_PoolNext (&cl_playerbeams, b))
 	{
 		vec3_t		f, r, u;
 		if (!b->model || b->endtime < cl.time)
+		{
+			CL_PoolFree (&cl_playerbeams, b);
 			continue;
+		}
 
 		if (cl_mod_heatbeam && (b->model == cl_mod_heatbeam))
 		{
@@ -1632,7 +1504,6 @@ CL_AddExplosions
 void CL_AddExplosions (void)
 {
 	entity_t	*ent;
-	int			i;
 	explosion_t	*ex;
 	float		frac;
 	int			f;
@@ -1640,13 +1511,16 @@ void CL_AddExplosions (void)
 	// huh??? obviously a holdover from an earlier version when ent was not a pointer
 	// memset (&ent, 0, sizeof (ent));
 
-	for (i = 0, ex = cl_explosions; i < MAX_EXPLOSIONS; i++, ex++)
+	for (ex = (explosion_t *) CL_PoolFirst (&cl_explosions); ex; ex = (explosion_t *) CL_PoolNext (&cl_explosions, ex))
 	{
 		// don't add light if contributing less
 		float minlight = 0;
 
 		if (ex->type == ex_free)
+		{
+			CL_PoolFree (&cl_explosions, ex);
 			continue;
+		}
 
 		frac = (cl.time - ex->start) / 100.0;
 		f = floor (frac);
@@ -1723,7 +1597,10 @@ void CL_AddExplosions (void)
 		}
 
 		if (ex->type == ex_free)
+		{
+			CL_PoolFree (&cl_explosions, ex);
 			continue;
+		}
 
 		// using the actual value that will be used for the light
 		if ((ex->light * ent->alpha) > minlight)
@@ -1754,12 +1631,12 @@ CL_AddLasers
 void CL_AddLasers (void)
 {
 	laser_t		*l;
-	int			i;
 
-	for (i = 0, l = cl_lasers; i < MAX_LASERS; i++, l++)
+	for (l = (laser_t *) CL_PoolFirst (&cl_lasers); l; l = (laser_t *) CL_PoolNext (&cl_lasers, l))
 	{
 		if (l->endtime >= cl.time)
 			V_AddEntity (&l->ent);
+		else CL_PoolFree (&cl_lasers, l);
 	}
 }
 
@@ -1767,18 +1644,14 @@ void CL_AddLasers (void)
 void CL_ProcessSustain ()
 {
 	cl_sustain_t	*s;
-	int				i;
 
-	for (i = 0, s = cl_sustains; i < MAX_SUSTAINS; i++, s++)
+	for (s = (cl_sustain_t *) CL_PoolFirst (&cl_sustains); s; s = (cl_sustain_t *) CL_PoolNext (&cl_sustains, s))
 	{
-		if (s->id)
-		{
-			// how is this not nasty????
-			if ((s->endtime >= cl.time) && (cl.time >= s->nextthink))
-				s->think (s);
-			else if (s->endtime < cl.time)
-				s->id = 0;
-		}
+		// how is this not nasty????
+		if ((s->endtime >= cl.time) && (cl.time >= s->nextthink))
+			s->think (s);
+		else if (s->endtime < cl.time)
+			CL_PoolFree (&cl_sustains, s);
 	}
 }
 
@@ -0,0 +1,284 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// cl_timedemo.c -- per-stage frame timing for timedemo runs
+
+#include "client.h"
+
+/*
+==============================================================================
+
+TIMEDEMO PROFILING
+
+while timedemo is set each client frame is split into stages which are timed
+separately; every frame that renders a view is kept as a sample, and when the
+demo ends min/avg/p50/p99/max for each stage are printed and written out as
+JSON so that runs can be compared by scripts.  the number of client job
+threads goes in too, so runs at different cl_jobs settings show how the
+entity and particle stages scale.
+
+to run without a window or device:
+	quake2 +set vid_null 1 +set timedemo 1 +set timedemo_quit 1 +demomap demo1.dm2
+
+==============================================================================
+*/
+
+typedef struct tdsample_s
+{
+	float	stage[TD_NUMSTAGES];
+} tdsample_t;
+
+static char *td_stagenames[TD_NUMSTAGES] = {"parse", "predict", "entities", "particles", "sound", "frame"};
+
+static tdsample_t *td_samples = NULL;
+static int td_numsamples = 0;
+static int td_maxsamples = 0;
+
+// the frame currently being timed
+static double td_stagestart[TD_NUMSTAGES];
+static tdsample_t td_current;
+static int td_lastframes = 0;
+
+cvar_t *timedemo_report;
+cvar_t *timedemo_quit;
+
+
+static void CL_TimeDemo_FreeSamples (void)
+{
+	if (td_samples)
+	{
+		Zone_Free (td_samples);
+		td_samples = NULL;
+	}
+
+	td_numsamples = td_maxsamples = 0;
+	td_lastframes = 0;
+}
+
+
+/*
+==================
+CL_TimeDemo_Begin
+CL_TimeDemo_End
+
+a stage may be entered several times in a frame and the times are summed
+==================
+*/
+void CL_TimeDemo_Begin (int stage)
+{
+	if (!cl_timedemo->value) return;
+
+	td_stagestart[stage] = Sys_Microseconds ();
+}
+
+
+void CL_TimeDemo_End (int stage)
+{
+	if (!cl_timedemo->value) return;
+
+	td_current.stage[stage] += (Sys_Microseconds () - td_stagestart[stage]) * 0.001;
+}
+
+
+/*
+==================
+CL_TimeDemo_EndFrame
+
+keeps the frame if it rendered a view; frames spent loading or waiting on the server are thrown away
+==================
+*/
+void CL_TimeDemo_EndFrame (void)
+{
+	if (!cl_timedemo->value) return;
+
+	if (cl.timedemo_frames != td_lastframes && cl.timedemo_frames > 0)
+	{
+		if (td_numsamples == td_maxsamples)
+		{
+			int newmax = td_maxsamples ? td_maxsamples * 2 : 4096;
+			tdsample_t *newsamples = (tdsample_t *) Zone_Alloc (newmax * sizeof (tdsample_t));
+
+			if (td_samples)
+			{
+				memcpy (newsamples, td_samples, td_numsamples * sizeof (tdsample_t));
+				Zone_Free (td_samples);
+			}
+
+			td_samples = newsamples;
+			td_maxsamples = newmax;
+		}
+
+		td_samples[td_numsamples++] = td_current;
+		td_lastframes = cl.timedemo_frames;
+	}
+
+	memset (&td_current, 0, sizeof (td_current));
+}
+
+
+static int CL_TimeDemo_SortFloat (const float *a, const float *b)
+{
+	if (*a < *b)
+		return -1;
+	else if (*a > *b)
+		return 1;
+	else return 0;
+}
+
+
+// nearest-rank percentile from a sorted list
+static float CL_TimeDemo_Percentile (float *sorted, int count, int pct)
+{
+	int rank = (pct * count + 99) / 100;
+
+	if (rank < 1) rank = 1;
+	if (rank > count) rank = count;
+
+	return sorted[rank - 1];
+}
+
+
+// writes s as a quoted JSON string; it comes from the server so may hold anything, including
+// high-bit characters that aren't valid UTF-8 and so are escaped as well
+static void CL_TimeDemo_WriteString (FILE *f, char *s)
+{
+	fputc ('"', f);
+
+	for (; *s; s++)
+	{
+		if (*s == '"' || *s == '\\')
+			fprintf (f, "\\%c", *s);
+		else if ((unsigned char) *s < ' ' || (unsigned char) *s > '~')
+			fprintf (f, "\\u%04x", (unsigned char) *s);
+		else fputc (*s, f);
+	}
+
+	fputc ('"', f);
+}
+
+
+/*
+==================
+CL_TimeDemo_Report
+
+called from CL_Disconnect while the timedemo state is still valid
+==================
+*/
+void CL_TimeDemo_Report (int msec)
+{
+	char name[MAX_OSPATH];
+	float *sorted;
+	FILE *f = NULL;
+	int stage, i;
+
+	if (!td_numsamples)
+	{
+		CL_TimeDemo_FreeSamples ();
+		return;
+	}
+
+	if (timedemo_report->string[0])
+	{
+		Com_sprintf (name, sizeof (name), "%s/%s", FS_Gamedir (), timedemo_report->string);
+		FS_CreatePath (name);
+
+		if ((f = fopen (name, "w")) == NULL)
+			Com_Printf ("CL_TimeDemo_Report: couldn't open %s\n", name);
+	}
+
+	if (f)
+	{
+		fprintf (f, "{\n");
+		fprintf (f, "\t\"map\": ");
+		CL_TimeDemo_WriteString (f, cl.configstrings[CS_MODELS + 1]);
+		fprintf (f, ",\n");
+		fprintf (f, "\t\"headless\": %s,\n", Cvar_VariableValue ("vid_null") ? "true" : "false");
+		fprintf (f, "\t\"jobthreads\": %i,\n", CL_NumJobThreads ());
+		fprintf (f, "\t\"frames\": %i,\n", td_numsamples);
+		fprintf (f, "\t\"seconds\": %0.3f,\n", msec / 1000.0);
+		fprintf (f, "\t\"fps\": %0.2f,\n", msec > 0 ? cl.timedemo_frames * 1000.0 / msec : 0.0);
+		fprintf (f, "\t\"units\": \"ms\",\n");
+		fprintf (f, "\t\"stages\": {\n");
+	}
+
+	Com_Printf ("%i client job threads\n", CL_NumJobThreads ());
+	Com_Printf ("stage            min      avg      p50      p99      max\n");
+
+	sorted = (float *) Zone_Alloc (td_numsamples * sizeof (float));
+
+	for (stage = 0; stage < TD_NUMSTAGES; stage++)
+	{
+		double total = 0;
+		float avg, p50, p99;
+
+		for (i = 0; i < td_numsamples; i++)
+		{
+			sorted[i] = td_samples[i].stage[stage];
+			total += sorted[i];
+		}
+
+		qsort (sorted, td_numsamples, sizeof (float), (sortfunc_t) CL_TimeDemo_SortFloat);
+
+		avg = total / td_numsamples;
+		p50 = CL_TimeDemo_Percentile (sorted, td_numsamples, 50);
+		p99 = CL_TimeDemo_Percentile (sorted, td_numsamples, 99);
+
+		Com_Printf ("%-10s %8.3f %8.3f %8.3f %8.3f %8.3f\n", td_stagenames[stage], sorted[0], avg, p50, p99, sorted[td_numsamples - 1]);
+
+		if (f)
+		{
+			fprintf (
+				f,
+				"\t\t\"%s\": { \"min\": %0.4f, \"avg\": %0.4f, \"p50\": %0.4f, \"p99\": %0.4f, \"max\": %0.4f }%s\n",
+				td_stagenames[stage],
+				sorted[0],
+				avg,
+				p50,
+				p99,
+				sorted[td_numsamples - 1],
+				(stage < TD_NUMSTAGES - 1) ? "," : ""
+			);
+		}
+	}
+
+	Zone_Free (sorted);
+
+	if (f)
+	{
+		fprintf (f, "\t}\n");
+		fprintf (f, "}\n");
+		fclose (f);
+
+		Com_Printf ("wrote %s\n", name);
+	}
+
+	CL_TimeDemo_FreeSamples ();
+
+	// for unattended runs
+	if (timedemo_quit->value)
+		Cbuf_AddText ("quit\n");
+}
+
+
+void CL_TimeDemo_Init (void)
+{
+	timedemo_report = Cvar_Get ("timedemo_report", "timedemo.json", 0, NULL);
+	timedemo_quit = Cvar_Get ("timedemo_quit", "0", 0, NULL);
+}
+
@@ -42,14 +42,17 @@ static cvar_t		*cl_stats;
 static cvar_t		*intensity;
 
 
-static int			r_numdlights;
-static dlight_t	r_dlights[MAX_DLIGHTS];
+// the scene lists grow as they're needed and are kept from frame to frame
+static int			r_numdlights, r_maxdlights;
+static dlight_t	*r_dlights;
 
-static int			r_numentities;
-static entity_t	r_entities[MAX_ENTITIES];
+static int			r_numentities, r_maxentities;
+static entity_t	*r_entities;
 
-static int			r_numparticles;
-static particle_t	r_particles[MAX_PARTICLES];
+static int			r_numparticles, r_maxparticles;
+static particle_t	*r_particles;
+
+static cvar_t		*cl_maxentities;
 
 static float		r_lightstyles[MAX_LIGHTSTYLES];
 
@@ -57,6 +60,31 @@ char cl_weaponmodels[MAX_CLIENTWEAPONMODELS][MAX_QPATH];
 int num_cl_weaponmodels;
 
 
+static void *V_GrowList (void *list, int *max, int needed, int size)
+{
+	int newmax = *max ? *max : 64;
+	byte *newlist;
+
+	if (needed <= *max)
+		return list;
+
+	while (newmax < needed)
+		newmax *= 2;
+
+	newlist = (byte *) Zone_Alloc (newmax * size);
+
+	if (list)
+	{
+		memcpy (newlist, list, *max * size);
+		Zone_Free (list);
+	}
+
+	*max = newmax;
+
+	return newlist;
+}
+
+
 /*
 ====================
 V_ClearScene
@@ -80,9 +108,11 @@ V_AddEntity
 */
 void V_AddEntity (entity_t *ent)
 {
-	if (r_numentities >= MAX_ENTITIES)
+	if (r_numentities >= cl_maxentities->value)
 		return;
 
+	r_entities = (entity_t *) V_GrowList (r_entities, &r_maxentities, r_numentities + 1, sizeof (entity_t));
+
 	// and add it
 	r_entities[r_numentities] = *ent;
 
@@ -105,22 +135,41 @@ V_AddParticle
 */
 void V_AddParticle (vec3_t org, vec3_t vel, vec3_t accel, float time, int color, float alpha)
 {
-	if (r_numparticles >= MAX_PARTICLES)
-		return;
-	else
-	{
-		particle_t *p = &r_particles[r_numparticles];
+	particle_t *p;
 
-		VectorCopy (org, p->origin);
-		VectorCopy (vel, p->velocity);
-		VectorCopy (accel, p->acceleration);
+	r_particles = (particle_t *) V_GrowList (r_particles, &r_maxparticles, r_numparticles + 1, sizeof (particle_t));
+	p = &r_particles[r_numparticles];
 
-		p->time = time;
-		p->color = color;
-		p->alpha = alpha;
+	VectorCopy (org, p->origin);
+	VectorCopy (vel, p->velocity);
+	VectorCopy (accel, p->acceleration);
 
-		r_numparticles++;
-	}
+	p->time = time;
+	p->color = color;
+	p->alpha = alpha;
+
+	r_numparticles++;
+}
+
+
+/*
+=====================
+V_BeginParticles
+
+returns where the next particles go in the scene, with room for at least count of them;
+the caller writes them in place and says how many it used with V_EndParticles
+=====================
+*/
+particle_t *V_BeginParticles (int count)
+{
+	r_particles = (particle_t *) V_GrowList (r_particles, &r_maxparticles, r_numparticles + count, sizeof (particle_t));
+	return &r_particles[r_numparticles];
+}
+
+
+void V_EndParticles (int count)
+{
+	r_numparticles += count;
 }
 
 /*
@@ -131,29 +180,27 @@ V_AddLight
 */
 void V_AddLight (vec3_t org, float radius, float r, float g, float b)
 {
-	if (r_numdlights >= MAX_DLIGHTS)
-		return;
-	else
-	{
-		dlight_t *dl = &r_dlights[r_numdlights];
+	dlight_t *dl;
 
-		VectorCopy (org, dl->origin);
-		dl->radius = radius;
+	r_dlights = (dlight_t *) V_GrowList (r_dlights, &r_maxdlights, r_numdlights + 1, sizeof (dlight_t));
+	dl = &r_dlights[r_numdlights];
 
-		dl->color[0] = r;
-		dl->color[1] = g;
-		dl->color[2] = b;
+	VectorCopy (org, dl->origin);
+	dl->radius = radius;
 
-		// normalize colour scale
-		VectorNormalize (dl->color);
+	dl->color[0] = r;
+	dl->color[1] = g;
+	dl->color[2] = b;
 
-		// scale by intensity
-		dl->color[0] *= intensity->value;
-		dl->color[1] *= intensity->value;
-		dl->color[2] *= intensity->value;
+	// normalize colour scale
+	VectorNormalize (dl->color);
 
-		r_numdlights++;
-	}
+	// scale by intensity
+	dl->color[0] *= intensity->value;
+	dl->color[1] *= intensity->value;
+	dl->color[2] *= intensity->value;
+
+	r_numdlights++;
 }
 
 
@@ -221,7 +268,8 @@ void V_TestEntities (void)
 	entity_t	*ent;
 
 	r_numentities = 32;
-	memset (r_entities, 0, sizeof (r_entities));
+	r_entities = (entity_t *) V_GrowList (r_entities, &r_maxentities, r_numentities, sizeof (entity_t));
+	memset (r_entities, 0, r_numentities * sizeof (entity_t));
 
 	for (i = 0; i < r_numentities; i++)
 	{
@@ -252,7 +300,8 @@ void V_TestLights (void)
 	dlight_t	*dl;
 
 	r_numdlights = MAX_DLIGHTS;
-	memset (r_dlights, 0, sizeof (r_dlights));
+	r_dlights = (dlight_t *) V_GrowList (r_dlights, &r_maxdlights, r_numdlights, sizeof (dlight_t));
+	memset (r_dlights, 0, r_numdlights * sizeof (dlight_t));
 
 	for (i = 0; i < r_numdlights; i++)
 	{
@@ -641,6 +690,7 @@ void V_Init (void)
 
 	cl_testblend = Cvar_Get ("cl_testblend", "0", 0, NULL);
 	cl_testparticles = Cvar_Get ("cl_testparticles", "0", 0, NULL);
+	cl_maxentities = Cvar_Get ("cl_maxentities", "2048", CVAR_ARCHIVE, NULL);
 	cl_testentities = Cvar_Get ("cl_testentities", "0", 0, NULL);
 	cl_testlights = Cvar_Get ("cl_testlights", "0", CVAR_CHEAT, NULL);
 
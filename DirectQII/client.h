@@ -230,6 +230,19 @@ typedef struct client_static_s
 	dltype_t	downloadtype;
 	int			downloadpercent;
 
+	// windowed downloads; chunks are written straight into the temp file at their offsets
+	qboolean	downloadwindowed;	// asked for one and haven't had it all yet
+	qboolean	downloadstarted;	// the first chunk has arrived
+	int			downloadoffset;		// resumed from
+	int			downloadid;			// of the current or last windowed download
+	int			downloadchunks;
+	int			downloadbase;		// first chunk not received
+	byte		*downloadreceived;	// a bit for each chunk
+	qboolean	downloadacknow;		// chunks have arrived since the last ack
+	int			downloaddoneid;		// of the last windowed download to finish, 0 if none
+	int			downloaddonechunks;	// its length in chunks, which is the base that acks all of it
+	int			downloadfinalacks;	// acks still to send for it
+
 	// demo recording info must be here, so it isn't cleared on level change
 	qboolean	demorecording;
 	qboolean	demowaiting;	// don't record until a non-delta message is received
@@ -286,6 +299,8 @@ extern	cvar_t	*cl_timedemo;
 
 extern	cvar_t	*cl_vwep;
 
+extern	cvar_t	*cl_downloadwindow;
+
 typedef struct cdlight_s
 {
 	int		key;				// so entities can reuse same entry
@@ -299,7 +314,6 @@ typedef struct cdlight_s
 } cdlight_t;
 
 extern	centity_t	cl_entities[MAX_EDICTS];
-extern	cdlight_t	cl_dlights[MAX_DLIGHTS];
 
 // the cl_parse_entities must be large enough to hold UPDATE_BACKUP frames of
 // entities, so that when a delta compressed message arives from the server
@@ -334,7 +348,6 @@ typedef struct cl_sustain
 	void (*think) (struct cl_sustain *self);
 } cl_sustain_t;
 
-#define MAX_SUSTAINS		32
 void CL_ParticleSteamEffect2 (cl_sustain_t *self);
 
 void CL_TeleporterParticles (entity_state_t *ent);
@@ -351,8 +364,6 @@ void CL_ParticleEffect3 (vec3_t org, vec3_t dir, int color, int count);
 // PGM
 typedef struct cparticle_s
 {
-	struct cparticle_s	*next;
-
 	float		time;
 
 	vec3_t		org;
@@ -412,6 +423,8 @@ void CL_WidowSplash (vec3_t org);
 
 int CL_ParseEntityBits (unsigned *bits);
 void CL_ParseDelta (entity_state_t *from, entity_state_t *to, int number, int bits);
+void CL_ParsePlayerstate (frame_t *oldframe, frame_t *newframe);
+void CL_ParsePacketEntities (frame_t *oldframe, frame_t *newframe);
 void CL_ParseFrame (void);
 
 void CL_ParseTEnt (void);
@@ -504,6 +517,8 @@ void CL_LoadClientinfo (clientinfo_t *ci, char *s);
 void SHOWNET (char *s);
 void CL_ParseClientinfo (int player);
 void CL_Download_f (void);
+void CL_WriteDownloadAck (sizebuf_t *buf);
+void CL_AbortDownload (void);
 
 //
 // cl_view.c
@@ -514,13 +529,117 @@ extern	struct model_s	*gun_model;
 void V_Init (void);
 void V_RenderView (void);
 void V_AddEntity (entity_t *ent);
+void V_ClearScene (void);
 void V_AddParticle (vec3_t org, vec3_t vel, vec3_t accel, float time, int color, float alpha);
+particle_t *V_BeginParticles (int count);
+void V_EndParticles (int count);
 void V_AddLight (vec3_t org, float radius, float r, float g, float b);
 void V_AddLightStyle (int style, float value);
 
+//
+// cl_timedemo.c
+//
+typedef enum tdstage_s
+{
+	TD_PARSE,
+	TD_PREDICT,
+	TD_ENTITIES,
+	TD_PARTICLES,
+	TD_SOUND,
+	TD_FRAME,
+	TD_NUMSTAGES
+} tdstage_t;
+
+void CL_TimeDemo_Init (void);
+void CL_TimeDemo_Begin (int stage);
+void CL_TimeDemo_End (int stage);
+void CL_TimeDemo_EndFrame (void);
+void CL_TimeDemo_Report (int msec);
+
+//
+// cl_demoindex.c
+//
+extern cvar_t *cl_demoindex;
+extern cvar_t *cl_demoindex_interval;
+
+void CL_DemoIndex_Init (void);
+void CL_DemoIndex_Open (char *demoname);
+void CL_DemoIndex_Message (void);
+void CL_DemoIndex_Close (void);
+
+//
+// cl_deltabench.c
+//
+void CL_DeltaBench_Init (void);
+void CL_DeltaBench_Capture (frame_t *frame);
+void CL_DeltaBench_Run (void);
+
+//
+// cl_pool.c
+//
+typedef struct poollink_s
+{
+	struct poollink_s	*prev, *next;	// in the order they were allocated while in use
+	struct poollink_s	*nextfree;
+} poollink_t;
+
+typedef struct clpool_s
+{
+	char		*cvarname;			// holds the most items there can be at once
+	char		*defaultlimit;
+	int			itemsize;
+
+	cvar_t		*limit;
+	poollink_t	active;				// active.next is the oldest, active.prev the newest
+	poollink_t	*free;
+	int			numactive;
+	int			numitems;			// allocated so far
+	int			evicted;			// recycled while still in use because the pool was full
+} clpool_t;
+
+void CL_InitPool (clpool_t *pool);
+void *CL_PoolAlloc (clpool_t *pool);
+void CL_PoolFree (clpool_t *pool, void *item);
+void CL_PoolClear (clpool_t *pool);
+void *CL_PoolFirst (clpool_t *pool);
+void *CL_PoolNext (clpool_t *pool, void *item);
+void CL_PoolStats (clpool_t *pool);
+void CL_PoolStats_f (void);
+
+//
+// cl_jobs.c
+//
+#define	MAX_JOB_THREADS		15
+
+typedef void (*cljobfunc_t) (void *data, int job);
+
+typedef struct cljobbatch_s
+{
+	cljobfunc_t		func;
+	void			*data;
+	int				numslots;						// the main thread and each worker
+
+	volatile long	next[MAX_JOB_THREADS + 1];		// the next job in each slot's run
+	int				end[MAX_JOB_THREADS + 1];
+
+	volatile long	remaining;						// jobs that haven't finished
+	volatile long	users;							// workers that are in the batch
+
+	struct cljobbatch_s	*nextbatch;
+} cljobbatch_t;
+
+void CL_InitJobs (void);
+void CL_ShutdownJobs (void);
+void CL_BeginJobs (cljobbatch_t *batch, cljobfunc_t func, void *data, int numjobs);
+void CL_FinishJobs (cljobbatch_t *batch);
+void CL_RunJobs (cljobbatch_t *batch, cljobfunc_t func, void *data, int numjobs);
+int CL_NumJobThreads (void);
+
 //
 // cl_tent.c
 //
+void CL_InitTEnts (void);
+void CL_TEntPoolStats (void);
 void CL_RegisterTEntSounds (void);
 void CL_RegisterTEntModels (void);
 void CL_SmokeAndFlash (vec3_t origin);
@@ -550,12 +669,17 @@ void CL_CheckPredictionError (void);
 void CL_SetDlightColour (cdlight_t *dl, int r, int g, int b);
 
 cdlight_t *CL_AllocDlight (int key);
+void CL_InitDlights (void);
+void CL_DlightPoolStats (void);
 void CL_BigTeleportParticles (vec3_t org);
 void CL_RocketTrail (vec3_t start, vec3_t end, centity_t *old);
 void CL_DiminishingTrail (vec3_t start, vec3_t end, centity_t *old, int flags);
 void CL_FlyEffect (centity_t *ent, vec3_t origin);
 void CL_BfgParticles (entity_t *ent);
 void CL_AddParticles (void);
+void CL_InitParticles (void);
+void CL_BeginParticles (void);
+void CL_ParticleStats (void);
 void CL_EntityEvent (entity_state_t *ent);
 // RAFAEL
 void CL_TrapParticles (entity_t *ent);
@@ -21,12 +21,35 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "qcommon.h"
 
+#ifdef _WIN32
+#include <windows.h>
+#define CM_THREADLOCAL	__declspec(thread)
+#else
+#include <pthread.h>
+#define CM_THREADLOCAL	__thread
+#endif
+
 typedef struct cnode_s
 {
 	cplane_t	*plane;
 	int			children[2];		// negative numbers are leafs
 } cnode_t;
 
+/*
+flattened nodes carry their plane inline and are laid out depth-first, with each node's front child straight after
+it, so that a traversal walks forward through memory rather than chasing node and plane pointers.  headnodes and
+topnodes seen outside of cmodel.c are always numbered as in the bsp.
+*/
+typedef struct cfnode_s
+{
+	cplane_t	plane;
+	int			children[2];		// flattened node numbers; negative numbers are leafs
+	int			orignum;			// the node's number in the bsp
+} cfnode_t;
+
+// no traversal stack can be deeper than the tree it walks
+#define CM_MAXDEPTH		512
+
 typedef struct cbrushside_s
 {
 	cplane_t	*plane;
@@ -47,78 +70,360 @@ typedef struct cbrush_s
 	int			contents;
 	int			numsides;
 	int			firstbrushside;
-	int			checkcount;		// to avoid repeated testings
 } cbrush_t;
 
 typedef struct carea_s
 {
 	int		numareaportals;
 	int		firstareaportal;
+} carea_t;
+
+typedef struct careaflood_s
+{
 	int		floodnum;			// if two areas have equal floodnums, they are connected
 	int		floodvalid;
-} carea_t;
+} careaflood_t;
 
-int			checkcount;
 
-char		map_name[MAX_QPATH];
+/*
+the collision data for a bsp, sized to the bsp and never written to after it's loaded, so that every world
+that has the same map loaded can share it
+*/
+typedef struct cmap_s
+{
+	char		name[MAX_QPATH];
+	unsigned	checksum;
+	int			refcount;
+	struct cmap_s *next;
 
-int			numbrushsides;
-cbrushside_t map_brushsides[MAX_MAP_BRUSHSIDES];
+	int			numbrushsides;
+	cbrushside_t *brushsides;
 
-int			numtexinfo;
-mapsurface_t	map_surfaces[MAX_MAP_TEXINFO];
+	int			numtexinfo;
+	mapsurface_t	*surfaces;
 
-int			numplanes;
-cplane_t	map_planes[MAX_MAP_PLANES + 6];		// extra for box hull
+	int			numplanes;
+	cplane_t	*planes;
 
-int			numnodes;
-cnode_t		map_nodes[MAX_MAP_NODES + 6];		// extra for box hull
+	int			numnodes;
+	cnode_t		*nodes;
+	cfnode_t	*fnodes;
+	int			*flatnum;			// bsp node number to flattened node number
+	int			maxdepth;
 
-int			numleafs = 1;	// allow leaf funcs to be called without a map
-cleaf_t		map_leafs[MAX_MAP_LEAFS];
-int			emptyleaf, solidleaf;
+	int			numleafs;
+	cleaf_t		*leafs;
+	int			emptyleaf, solidleaf;
 
-int			numleafbrushes;
-unsigned short	map_leafbrushes[MAX_MAP_LEAFBRUSHES];
+	int			numleafbrushes;
+	unsigned short	*leafbrushes;
 
-int			numcmodels;
-cmodel_t	map_cmodels[MAX_MAP_MODELS];
+	int			numcmodels;
+	cmodel_t	*cmodels;
 
-int			numbrushes;
-cbrush_t	map_brushes[MAX_MAP_BRUSHES];
+	int			numbrushes;
+	cbrush_t	*brushes;
 
-int			numvisibility;
-byte		map_visibility[MAX_MAP_VISIBILITY];
-dvis_t		*map_vis = (dvis_t *) map_visibility;
+	int			numvisibility;
+	byte		*visibility;
+	dvis_t		*vis;
 
-int			numentitychars;
-char		map_entitystring[MAX_MAP_ENTSTRING];
+	int			numentitychars;
+	char		*entitystring;
 
-int			numareas = 1;
-carea_t		map_areas[MAX_MAP_AREAS];
+	int			numareas;
+	carea_t		*areas;
 
-int			numareaportals;
-dareaportal_t map_areaportals[MAX_MAP_AREAPORTALS];
+	int			numareaportals;
+	dareaportal_t *areaportals;
 
-int			numclusters = 1;
+	int			numclusters;
+} cmap_t;
 
-mapsurface_t	nullsurface;
 
-int			floodvalid;
+/*
+a collision world; everything that changes while a map is in use lives here rather than in the shared cmap_t
+*/
+struct cmodel_world_s
+{
+	cmap_t		*map;
+
+	// the box hull follows the map's nodes, leafs and brushes in numbering but is stored here because every
+	// CM_HeadnodeForBox call rewrites its planes
+	int			box_headnode;
+	cplane_t	box_planes[12];
+	cnode_t		box_nodes[6];
+	cfnode_t	box_fnodes[6];		// numbered from 0 rather than following the map's flattened nodes
+	cbrushside_t box_brushsides[6];
+	cbrush_t	box_brush;
+	cleaf_t		box_leaf;
+	unsigned short	box_leafbrush;
+
+	int			checkcount;
+	int			*brushcheckcount;	// to avoid repeated testings; one per map brush plus the box brush
+
+	int			floodvalid;
+	careaflood_t *areaflood;
+	qboolean	portalopen[MAX_MAP_AREAPORTALS];
+
+	byte		*pvsrow;
+	byte		*phsrow;
+
+	// CM_BoxLeafnums
+	int			leaf_count, leaf_maxcount;
+	int			*leaf_list;
+	float		*leaf_mins, *leaf_maxs;
+	int			leaf_topnode;
+
+	// CM_BoxTrace
+	vec3_t		trace_start, trace_end;
+	vec3_t		trace_mins, trace_maxs;
+	vec3_t		trace_extents;
+
+	trace_t		trace_trace;
+	int			trace_contents;
+	qboolean	trace_ispoint;		// optimized case
+};
+
+
+// used when no map is loaded so that leaf funcs can be called without a map
+static cleaf_t		cm_nullleaf;
+static carea_t		cm_nullarea;
+static cmodel_t		cm_nullcmodel;
+static cmap_t		cm_nullmap;	// set up by CM_Init
+
+// every map currently in use by a world; worlds on different threads can load and free maps at the same time
+// so the list and the refcounts on it are only touched under cm_mapslock
+static cmap_t		*cm_maps;
 
-qboolean	portalopen[MAX_MAP_AREAPORTALS];
+#ifdef _WIN32
+static CRITICAL_SECTION	cm_mapslock;
+#define CM_LockMaps()	EnterCriticalSection (&cm_mapslock)
+#define CM_UnlockMaps()	LeaveCriticalSection (&cm_mapslock)
+#else
+static pthread_mutex_t	cm_mapslock = PTHREAD_MUTEX_INITIALIZER;
+#define CM_LockMaps()	pthread_mutex_lock (&cm_mapslock)
+#define CM_UnlockMaps()	pthread_mutex_unlock (&cm_mapslock)
+#endif
+
+// a map that was being loaded on this thread when an error was thrown
+static CM_THREADLOCAL cmap_t	*cm_loadingmap;
 
+// the world used by the client and the local server, and the world each thread's CM_ calls go to
+static cmodel_world_t	cm_defaultworld;
+static CM_THREADLOCAL cmodel_world_t *cm_world = &cm_defaultworld;
+
+mapsurface_t	nullsurface;
 
 cvar_t		*map_noareas;
+cvar_t		*cm_flatnodes;
 
-void CM_InitBoxHull (void);
-void FloodAreaConnections (void);
+static void CM_InitBoxHull (cmodel_world_t *w);
+static void FloodAreaConnections (cmodel_world_t *w);
 
 
 int		c_pointcontents;
 int		c_traces, c_brush_traces;
 
 
+/*
+===============================================================================
+
+COLLISION WORLDS
+
+===============================================================================
+*/
+
+static void CM_FreeMap (cmap_t *map)
+{
+	if (map->brushsides) Zone_Free (map->brushsides);
+	if (map->surfaces) Zone_Free (map->surfaces);
+	if (map->planes) Zone_Free (map->planes);
+	if (map->nodes) Zone_Free (map->nodes);
+	if (map->fnodes) Zone_Free (map->fnodes);
+	if (map->flatnum) Zone_Free (map->flatnum);
+	if (map->leafs) Zone_Free (map->leafs);
+	if (map->leafbrushes) Zone_Free (map->leafbrushes);
+	if (map->cmodels) Zone_Free (map->cmodels);
+	if (map->brushes) Zone_Free (map->brushes);
+	if (map->visibility) Zone_Free (map->visibility);
+	if (map->entitystring) Zone_Free (map->entitystring);
+	if (map->areas) Zone_Free (map->areas);
+	if (map->areaportals) Zone_Free (map->areaportals);
+
+	Zone_Free (map);
+}
+
+
+static void CM_ReleaseMap (cmap_t *map)
+{
+	cmap_t **prev;
+
+	if (map == &cm_nullmap)
+		return;
+
+	CM_LockMaps ();
+
+	if (--map->refcount > 0)
+	{
+		CM_UnlockMaps ();
+		return;
+	}
+
+	// nobody is using it any more so take it off the list and free it
+	for (prev = &cm_maps; *prev; prev = &(*prev)->next)
+	{
+		if (*prev == map)
+		{
+			*prev = map->next;
+			break;
+		}
+	}
+
+	CM_UnlockMaps ();
+
+	// off the list so no other thread can find it now
+	CM_FreeMap (map);
+}
+
+
+/*
+==================
+CM_FindMap
+
+returns a map that's already loaded with a reference taken on it, or NULL
+==================
+*/
+static cmap_t *CM_FindMap (char *name)
+{
+	cmap_t *map;
+
+	CM_LockMaps ();
+
+	for (map = cm_maps; map; map = map->next)
+	{
+		if (!strcmp (map->name, name))
+		{
+			map->refcount++;
+			break;
+		}
+	}
+
+	CM_UnlockMaps ();
+
+	return map;
+}
+
+
+static void CM_FreeWorldData (cmodel_world_t *w)
+{
+	if (w->brushcheckcount) Zone_Free (w->brushcheckcount);
+	if (w->areaflood) Zone_Free (w->areaflood);
+	if (w->pvsrow) Zone_Free (w->pvsrow);
+	if (w->phsrow) Zone_Free (w->phsrow);
+
+	w->brushcheckcount = NULL;
+	w->areaflood = NULL;
+	w->pvsrow = NULL;
+	w->phsrow = NULL;
+}
+
+
+/*
+==================
+CM_AttachMap
+
+Points a world at a map (which it must already hold a reference to) and sizes the world's own state to it
+==================
+*/
+static void CM_AttachMap (cmodel_world_t *w, cmap_t *map)
+{
+	// pvs rows are read in longs by SV_FatPVS
+	int rowbytes = ((map->numclusters + 31) >> 5) << 2;
+
+	CM_FreeWorldData (w);
+
+	w->map = map;
+	w->checkcount = 0;
+	w->brushcheckcount = (int *) Zone_Alloc ((map->numbrushes + 1) * sizeof (int));
+	w->areaflood = (careaflood_t *) Zone_Alloc ((map->numareas + 1) * sizeof (careaflood_t));	// CM_AreasConnected allows area == numareas
+	w->pvsrow = (byte *) Zone_Alloc (rowbytes);
+	w->phsrow = (byte *) Zone_Alloc (rowbytes);
+
+	CM_InitBoxHull (w);
+
+	memset (w->portalopen, 0, sizeof (w->portalopen));
+	w->floodvalid = 0;
+	FloodAreaConnections (w);
+}
+
+
+static cmodel_world_t *CM_World (void)
+{
+	cmodel_world_t *w = cm_world;
+
+	// the default world is set up on first use
+	if (!w->map) CM_AttachMap (w, &cm_nullmap);
+
+	return w;
+}
+
+
+/*
+==================
+CM_CreateWorld
+
+Creates an empty collision world; bind it with CM_BindWorld and load a map into it with CM_LoadMap
+==================
+*/
+cmodel_world_t *CM_CreateWorld (void)
+{
+	cmodel_world_t *w = (cmodel_world_t *) Zone_Alloc (sizeof (cmodel_world_t));
+
+	CM_AttachMap (w, &cm_nullmap);
+
+	return w;
+}
+
+
+/*
+==================
+CM_FreeWorld
+==================
+*/
+void CM_FreeWorld (cmodel_world_t *w)
+{
+	if (!w || w == &cm_defaultworld)
+		return;
+
+	if (cm_world == w)
+		cm_world = &cm_defaultworld;
+
+	if (w->map) CM_ReleaseMap (w->map);
+
+	CM_FreeWorldData (w);
+	Zone_Free (w);
+}
+
+
+/*
+==================
+CM_BindWorld
+
+Directs the calling thread's CM_ calls to a world (or back to the default world if NULL) and returns the world
+that was bound before
+==================
+*/
+cmodel_world_t *CM_BindWorld (cmodel_world_t *w)
+{
+	cmodel_world_t *old = cm_world;
+
+	cm_world = w ? w : &cm_defaultworld;
+
+	return old;
+}
+
+
 /*
 ===============================================================================
 
@@ -127,14 +432,15 @@ MAP LOADING
 ===============================================================================
 */
 
-byte	*cmod_base;
+// the file of the map being loaded on this thread
+static CM_THREADLOCAL byte	*cmod_base;
 
 /*
 =================
 CMod_LoadSubmodels
 =================
 */
-void CMod_LoadSubmodels (lump_t *l)
+void CMod_LoadSubmodels (cmap_t *map, lump_t *l)
 {
 	dmodel_t	*in;
 	cmodel_t	*out;
@@ -150,20 +456,24 @@ void CMod_LoadSubmodels (lump_t *l)
 	if (count > MAX_MAP_MODELS)
 		Com_Error (ERR_DROP, "Map has too many models");
 
-	numcmodels = count;
+	map->cmodels = (cmodel_t *) Zone_Alloc (count * sizeof (cmodel_t));
+	map->numcmodels = count;
+
+	// all floats and longs
+	LittleLongArray (in, l->filelen >> 2);
 
 	for (i = 0; i < count; i++, in++, out++)
 	{
-		out = &map_cmodels[i];
+		out = &map->cmodels[i];
 
 		for (j = 0; j < 3; j++)
 		{
 			// spread the mins / maxs by a pixel
-			out->mins[j] = LittleFloat (in->mins[j]) - 1;
-			out->maxs[j] = LittleFloat (in->maxs[j]) + 1;
-			out->origin[j] = LittleFloat (in->origin[j]);
+			out->mins[j] = in->mins[j] - 1;
+			out->maxs[j] = in->maxs[j] + 1;
+			out->origin[j] = in->origin[j];
 		}
-		out->headnode = LittleLong (in->headnode);
+		out->headnode = in->headnode;
 	}
 }
 
@@ -173,7 +483,7 @@ void CMod_LoadSubmodels (lump_t *l)
 CMod_LoadSurfaces
 =================
 */
-void CMod_LoadSurfaces (lump_t *l)
+void CMod_LoadSurfaces (cmap_t *map, lump_t *l)
 {
 	texinfo_t	*in;
 	mapsurface_t	*out;
@@ -188,8 +498,9 @@ void CMod_LoadSurfaces (lump_t *l)
 	if (count > MAX_MAP_TEXINFO)
 		Com_Error (ERR_DROP, "Map has too many surfaces");
 
-	numtexinfo = count;
-	out = map_surfaces;
+	map->surfaces = (mapsurface_t *) Zone_Alloc (count * sizeof (mapsurface_t));
+	map->numtexinfo = count;
+	out = map->surfaces;
 
 	for (i = 0; i < count; i++, in++, out++)
 	{
@@ -207,7 +518,7 @@ CMod_LoadNodes
 
 =================
 */
-void CMod_LoadNodes (lump_t *l)
+void CMod_LoadNodes (cmap_t *map, lump_t *l)
 {
 	dnode_t		*in;
 	int			child;
@@ -224,12 +535,13 @@ void CMod_LoadNodes (lump_t *l)
 	if (count > MAX_MAP_NODES)
 		Com_Error (ERR_DROP, "Map has too many nodes");
 
-	out = map_nodes;
-	numnodes = count;
+	map->nodes = (cnode_t *) Zone_Alloc (count * sizeof (cnode_t));
+	out = map->nodes;
+	map->numnodes = count;
 
 	for (i = 0; i < count; i++, out++, in++)
 	{
-		out->plane = map_planes + LittleLong (in->planenum);
+		out->plane = map->planes + LittleLong (in->planenum);
 		for (j = 0; j < 2; j++)
 		{
 			child = LittleLong (in->children[j]);
@@ -239,13 +551,95 @@ void CMod_LoadNodes (lump_t *l)
 }
 
 
+/*
+=================
+CMod_FlattenNodes
+
+Builds the flattened copy of the node tree; needs the planes, nodes and submodels
+=================
+*/
+void CMod_FlattenNodes (cmap_t *map)
+{
+	int			*stack = (int *) Zone_Alloc ((map->numnodes + 1) * 2 * sizeof (int));
+	int			i, j, root;
+	int			numflat = 0;
+
+	map->fnodes = (cfnode_t *) Zone_Alloc (map->numnodes * sizeof (cfnode_t));
+	map->flatnum = (int *) Zone_Alloc (map->numnodes * sizeof (int));
+	map->maxdepth = 0;
+
+	for (i = 0; i < map->numnodes; i++)
+		map->flatnum[i] = -1;
+
+	// lay out each model's tree in turn, then anything that isn't under a model headnode
+	for (root = 0; root < map->numcmodels + map->numnodes; root++)
+	{
+		int node = (root < map->numcmodels) ? map->cmodels[root].headnode : root - map->numcmodels;
+		int sp = 0;
+
+		if (node < 0 || node >= map->numnodes || map->flatnum[node] != -1)
+			continue;
+
+		// depth-first with the front child pushed last so that it's numbered straight after its parent
+		stack[sp++] = node;
+		stack[sp++] = 1;
+
+		while (sp)
+		{
+			int depth = stack[--sp];
+
+			node = stack[--sp];
+			map->flatnum[node] = numflat++;
+
+			if (depth > map->maxdepth)
+				map->maxdepth = depth;
+
+			for (j = 1; j >= 0; j--)
+			{
+				int child = map->nodes[node].children[j];
+
+				if (child >= map->numnodes)
+					Com_Error (ERR_DROP, "CMod_FlattenNodes: bad node child");
+
+				if (child < 0 || map->flatnum[child] != -1)
+					continue;
+
+				// claim it now so that a node can't be reached twice
+				map->flatnum[child] = -2;
+				stack[sp++] = child;
+				stack[sp++] = depth + 1;
+			}
+		}
+	}
+
+	Zone_Free (stack);
+
+	if (map->maxdepth > CM_MAXDEPTH)
+		Com_Error (ERR_DROP, "Map has too deep a bsp (%i levels, max %i)", map->maxdepth, CM_MAXDEPTH);
+
+	for (i = 0; i < map->numnodes; i++)
+	{
+		cfnode_t *out = &map->fnodes[map->flatnum[i]];
+
+		out->plane = *map->nodes[i].plane;
+		out->orignum = i;
+
+		for (j = 0; j < 2; j++)
+		{
+			int child = map->nodes[i].children[j];
+			out->children[j] = (child < 0) ? child : map->flatnum[child];
+		}
+	}
+}
+
+
 /*
 =================
 CMod_LoadBrushes
 
 =================
 */
-void CMod_LoadBrushes (lump_t *l)
+void CMod_LoadBrushes (cmap_t *map, lump_t *l)
 {
 	dbrush_t	*in;
 	cbrush_t	*out;
@@ -256,18 +650,22 @@ void CMod_LoadBrushes (lump_t *l)
 		Com_Error (ERR_DROP, "CMod_LoadBrushes: funny lump size");
 	count = l->filelen / sizeof (*in);
 
-	if (count > MAX_MAP_BRUSHES)
+	// the box brush is numbered after these
+	if (count + 1 > MAX_MAP_BRUSHES)
 		Com_Error (ERR_DROP, "Map has too many brushes");
 
-	out = map_brushes;
+	map->brushes = (cbrush_t *) Zone_Alloc (count * sizeof (cbrush_t));
+	out = map->brushes;
 
-	numbrushes = count;
+	map->numbrushes = count;
+
+	LittleLongArray (in, l->filelen >> 2);
 
 	for (i = 0; i < count; i++, out++, in++)
 	{
-		out->firstbrushside = LittleLong (in->firstside);
-		out->numsides = LittleLong (in->numsides);
-		out->contents = LittleLong (in->contents);
+		out->firstbrushside = in->firstside;
+		out->numsides = in->numsides;
+		out->contents = in->contents;
 	}
 
 }
@@ -277,7 +675,7 @@ void CMod_LoadBrushes (lump_t *l)
 CMod_LoadLeafs
 =================
 */
-void CMod_LoadLeafs (lump_t *l)
+void CMod_LoadLeafs (cmap_t *map, lump_t *l)
 {
 	int			i;
 	cleaf_t		*out;
@@ -291,13 +689,14 @@ void CMod_LoadLeafs (lump_t *l)
 
 	if (count < 1)
 		Com_Error (ERR_DROP, "Map with no leafs");
-	// need to save space for box planes
-	if (count > MAX_MAP_PLANES)
-		Com_Error (ERR_DROP, "Map has too many planes");
+	// need to save space for the box leaf
+	if (count + 1 > MAX_MAP_LEAFS)
+		Com_Error (ERR_DROP, "Map has too many leafs");
 
-	out = map_leafs;
-	numleafs = count;
-	numclusters = 0;
+	map->leafs = (cleaf_t *) Zone_Alloc (count * sizeof (cleaf_t));
+	out = map->leafs;
+	map->numleafs = count;
+	map->numclusters = 0;
 
 	for (i = 0; i < count; i++, in++, out++)
 	{
@@ -307,23 +706,23 @@ void CMod_LoadLeafs (lump_t *l)
 		out->firstleafbrush = LittleShort (in->firstleafbrush);
 		out->numleafbrushes = LittleShort (in->numleafbrushes);
 
-		if (out->cluster >= numclusters)
-			numclusters = out->cluster + 1;
+		if (out->cluster >= map->numclusters)
+			map->numclusters = out->cluster + 1;
 	}
 
-	if (map_leafs[0].contents != CONTENTS_SOLID)
+	if (map->leafs[0].contents != CONTENTS_SOLID)
 		Com_Error (ERR_DROP, "Map leaf 0 is not CONTENTS_SOLID");
-	solidleaf = 0;
-	emptyleaf = -1;
-	for (i = 1; i < numleafs; i++)
+	map->solidleaf = 0;
+	map->emptyleaf = -1;
+	for (i = 1; i < map->numleafs; i++)
 	{
-		if (!map_leafs[i].contents)
+		if (!map->leafs[i].contents)
 		{
-			emptyleaf = i;
+			map->emptyleaf = i;
 			break;
 		}
 	}
-	if (emptyleaf == -1)
+	if (map->emptyleaf == -1)
 		Com_Error (ERR_DROP, "Map does not have an empty leaf");
 }
 
@@ -332,7 +731,7 @@ void CMod_LoadLeafs (lump_t *l)
 CMod_LoadPlanes
 =================
 */
-void CMod_LoadPlanes (lump_t *l)
+void CMod_LoadPlanes (cmap_t *map, lump_t *l)
 {
 	int			i, j;
 	cplane_t	*out;
@@ -347,25 +746,28 @@ void CMod_LoadPlanes (lump_t *l)
 
 	if (count < 1)
 		Com_Error (ERR_DROP, "Map with no planes");
-	// need to save space for box planes
 	if (count > MAX_MAP_PLANES)
 		Com_Error (ERR_DROP, "Map has too many planes");
 
-	out = map_planes;
-	numplanes = count;
+	map->planes = (cplane_t *) Zone_Alloc (count * sizeof (cplane_t));
+	out = map->planes;
+	map->numplanes = count;
+
+	// all floats and longs
+	LittleLongArray (in, l->filelen >> 2);
 
 	for (i = 0; i < count; i++, in++, out++)
 	{
 		bits = 0;
 		for (j = 0; j < 3; j++)
 		{
-			out->normal[j] = LittleFloat (in->normal[j]);
+			out->normal[j] = in->normal[j];
 			if (out->normal[j] < 0)
 				bits |= 1 << j;
 		}
 
-		out->dist = LittleFloat (in->dist);
-		out->type = LittleLong (in->type);
+		out->dist = in->dist;
+		out->type = in->type;
 		out->signbits = bits;
 	}
 }
@@ -375,10 +777,8 @@ void CMod_LoadPlanes (lump_t *l)
 CMod_LoadLeafBrushes
 =================
 */
-void CMod_LoadLeafBrushes (lump_t *l)
+void CMod_LoadLeafBrushes (cmap_t *map, lump_t *l)
 {
-	int			i;
-	unsigned short	*out;
 	unsigned short 	*in;
 	int			count;
 
@@ -389,15 +789,14 @@ void CMod_LoadLeafBrushes (lump_t *l)
 
 	if (count < 1)
 		Com_Error (ERR_DROP, "Map with no planes");
-	// need to save space for box planes
 	if (count > MAX_MAP_LEAFBRUSHES)
 		Com_Error (ERR_DROP, "Map has too many leafbrushes");
 
-	out = map_leafbrushes;
-	numleafbrushes = count;
+	map->leafbrushes = (unsigned short *) Zone_Alloc (count * sizeof (unsigned short));
+	map->numleafbrushes = count;
 
-	for (i = 0; i < count; i++, in++, out++)
-		*out = LittleShort (*in);
+	LittleShortArray (in, count);
+	memcpy (map->leafbrushes, in, count * sizeof (unsigned short));
 }
 
 /*
@@ -405,7 +804,7 @@ void CMod_LoadLeafBrushes (lump_t *l)
 CMod_LoadBrushSides
 =================
 */
-void CMod_LoadBrushSides (lump_t *l)
+void CMod_LoadBrushSides (cmap_t *map, lump_t *l)
 {
 	int			i, j;
 	cbrushside_t	*out;
@@ -418,21 +817,24 @@ void CMod_LoadBrushSides (lump_t *l)
 		Com_Error (ERR_DROP, "CMod_LoadBrushSides: funny lump size");
 	count = l->filelen / sizeof (*in);
 
-	// need to save space for box planes
 	if (count > MAX_MAP_BRUSHSIDES)
 		Com_Error (ERR_DROP, "Map has too many planes");
 
-	out = map_brushsides;
-	numbrushsides = count;
+	map->brushsides = (cbrushside_t *) Zone_Alloc (count * sizeof (cbrushside_t));
+	out = map->brushsides;
+	map->numbrushsides = count;
+
+	// all shorts
+	LittleShortArray (in, l->filelen >> 1);
 
 	for (i = 0; i < count; i++, in++, out++)
 	{
-		num = LittleShort (in->planenum);
-		out->plane = &map_planes[num];
-		j = LittleShort (in->texinfo);
-		if (j >= numtexinfo)
+		num = in->planenum;
+		out->plane = &map->planes[num];
+		j = in->texinfo;
+		if (j >= map->numtexinfo)
 			Com_Error (ERR_DROP, "Bad brushside texinfo");
-		out->surface = &map_surfaces[j];
+		out->surface = &map->surfaces[j];
 	}
 }
 
@@ -441,7 +843,7 @@ void CMod_LoadBrushSides (lump_t *l)
 CMod_LoadAreas
 =================
 */
-void CMod_LoadAreas (lump_t *l)
+void CMod_LoadAreas (cmap_t *map, lump_t *l)
 {
 	int			i;
 	carea_t		*out;
@@ -456,15 +858,17 @@ void CMod_LoadAreas (lump_t *l)
 	if (count > MAX_MAP_AREAS)
 		Com_Error (ERR_DROP, "Map has too many areas");
 
-	out = map_areas;
-	numareas = count;
+	// always have at least one area so that area 0 can be looked up
+	map->areas = (carea_t *) Zone_Alloc ((count ? count : 1) * sizeof (carea_t));
+	out = map->areas;
+	map->numareas = count;
+
+	LittleLongArray (in, l->filelen >> 2);
 
 	for (i = 0; i < count; i++, in++, out++)
 	{
-		out->numareaportals = LittleLong (in->numareaportals);
-		out->firstareaportal = LittleLong (in->firstareaportal);
-		out->floodvalid = 0;
-		out->floodnum = 0;
+		out->numareaportals = in->numareaportals;
+		out->firstareaportal = in->firstareaportal;
 	}
 }
 
@@ -473,10 +877,8 @@ void CMod_LoadAreas (lump_t *l)
 CMod_LoadAreaPortals
 =================
 */
-void CMod_LoadAreaPortals (lump_t *l)
+void CMod_LoadAreaPortals (cmap_t *map, lump_t *l)
 {
-	int			i;
-	dareaportal_t		*out;
 	dareaportal_t 	*in;
 	int			count;
 
@@ -488,14 +890,11 @@ void CMod_LoadAreaPortals (lump_t *l)
 	if (count > MAX_MAP_AREAS)
 		Com_Error (ERR_DROP, "Map has too many areas");
 
-	out = map_areaportals;
-	numareaportals = count;
+	map->areaportals = (dareaportal_t *) Zone_Alloc (count * sizeof (dareaportal_t));
+	map->numareaportals = count;
 
-	for (i = 0; i < count; i++, in++, out++)
-	{
-		out->portalnum = LittleLong (in->portalnum);
-		out->otherarea = LittleLong (in->otherarea);
-	}
+	LittleLongArray (in, l->filelen >> 2);
+	memcpy (map->areaportals, in, count * sizeof (dareaportal_t));
 }
 
 /*
@@ -503,22 +902,22 @@ void CMod_LoadAreaPortals (lump_t *l)
 CMod_LoadVisibility
 =================
 */
-void CMod_LoadVisibility (lump_t *l)
+void CMod_LoadVisibility (cmap_t *map, lump_t *l)
 {
-	int		i;
-
-	numvisibility = l->filelen;
+	map->numvisibility = l->filelen;
 	if (l->filelen > MAX_MAP_VISIBILITY)
 		Com_Error (ERR_DROP, "Map has too large visibility lump");
 
-	memcpy (map_visibility, cmod_base + l->fileofs, l->filelen);
+	if (!l->filelen)
+		return;
 
-	map_vis->numclusters = LittleLong (map_vis->numclusters);
-	for (i = 0; i < map_vis->numclusters; i++)
-	{
-		map_vis->bitofs[i][0] = LittleLong (map_vis->bitofs[i][0]);
-		map_vis->bitofs[i][1] = LittleLong (map_vis->bitofs[i][1]);
-	}
+	map->visibility = (byte *) Zone_Alloc (l->filelen);
+	map->vis = (dvis_t *) map->visibility;
+
+	memcpy (map->visibility, cmod_base + l->fileofs, l->filelen);
+
+	map->vis->numclusters = LittleLong (map->vis->numclusters);
+	LittleLongArray (map->vis->bitofs, map->vis->numclusters * 2);
 }
 
 
@@ -527,105 +926,153 @@ void CMod_LoadVisibility (lump_t *l)
 CMod_LoadEntityString
 =================
 */
-void CMod_LoadEntityString (lump_t *l)
+void CMod_LoadEntityString (cmap_t *map, lump_t *l)
 {
-	numentitychars = l->filelen;
+	map->numentitychars = l->filelen;
 	if (l->filelen > MAX_MAP_ENTSTRING)
 		Com_Error (ERR_DROP, "Map has too large entity lump");
 
-	memcpy (map_entitystring, cmod_base + l->fileofs, l->filelen);
+	map->entitystring = (char *) Zone_Alloc (l->filelen + 1);
+	memcpy (map->entitystring, cmod_base + l->fileofs, l->filelen);
 }
 
 
+/*
+==================
+CMod_ParseBSP
+
+Builds a new cmap_t from a bsp file in memory, byte swapping its lumps in place; the map is left in
+cm_loadingmap so that it's freed if an error is thrown
+==================
+*/
+static cmap_t *CMod_ParseBSP (char *name, unsigned *buf, int length)
+{
+	dheader_t		header;
+	cmap_t			*map;
+
+	// clean up after a previous load that errored out
+	if (cm_loadingmap)
+	{
+		CM_FreeMap (cm_loadingmap);
+		cm_loadingmap = NULL;
+	}
+
+	map = cm_loadingmap = (cmap_t *) Zone_Alloc (sizeof (cmap_t));
+	map->checksum = LittleLong (Com_BlockChecksum (buf, length));
+
+	header = *(dheader_t *) buf;
+	LittleLongArray (&header, sizeof (dheader_t) / 4);
+
+	if (header.version != BSPVERSION)
+		Com_Error (ERR_DROP, "CMod_LoadBrushModel: %s has wrong version number (%i should be %i)", name, header.version, BSPVERSION);
+
+	cmod_base = (byte *) buf;
+
+	// load into heap
+	CMod_LoadSurfaces (map, &header.lumps[LUMP_TEXINFO]);
+	CMod_LoadLeafs (map, &header.lumps[LUMP_LEAFS]);
+	CMod_LoadLeafBrushes (map, &header.lumps[LUMP_LEAFBRUSHES]);
+	CMod_LoadPlanes (map, &header.lumps[LUMP_PLANES]);
+	CMod_LoadBrushes (map, &header.lumps[LUMP_BRUSHES]);
+	CMod_LoadBrushSides (map, &header.lumps[LUMP_BRUSHSIDES]);
+	CMod_LoadSubmodels (map, &header.lumps[LUMP_MODELS]);
+	CMod_LoadNodes (map, &header.lumps[LUMP_NODES]);
+	CMod_FlattenNodes (map);
+	CMod_LoadAreas (map, &header.lumps[LUMP_AREAS]);
+	CMod_LoadAreaPortals (map, &header.lumps[LUMP_AREAPORTALS]);
+	CMod_LoadVisibility (map, &header.lumps[LUMP_VISIBILITY]);
+	CMod_LoadEntityString (map, &header.lumps[LUMP_ENTITIES]);
+
+	strcpy (map->name, name);
+
+	return map;
+}
+
 
 /*
 ==================
-CM_LoadMap
+CMod_LoadBSP
 
-Loads in the map and all submodels
+Loads a bsp into a new cmap_t and puts it on the list of maps in use with a reference taken on it; two
+threads loading the same map at once each get their own copy
 ==================
 */
-cmodel_t *CM_LoadMap (char *name, qboolean clientload, unsigned *checksum)
+static cmap_t *CMod_LoadBSP (char *name)
 {
 	unsigned		*buf;
-	int				i;
-	dheader_t		header;
 	int				length;
-	static unsigned	last_checksum;
+	cmap_t			*map;
+
+	// load the file
+	length = FS_LoadFile (name, (void **) &buf);
+	if (!buf)
+		Com_Error (ERR_DROP, "Couldn't load %s", name);
+
+	map = CMod_ParseBSP (name, buf, length);
+
+	FS_FreeFile (buf);
+
+	// it's good so it goes on the list
+	map->refcount = 1;
+	cm_loadingmap = NULL;
+
+	CM_LockMaps ();
+	map->next = cm_maps;
+	cm_maps = map;
+	CM_UnlockMaps ();
+
+	return map;
+}
+
+
+/*
+==================
+CM_LoadMap
+
+Loads in the map and all submodels into the bound world.  A map that another world already has loaded is shared
+rather than loaded again, unless flushmap is set for a server load.
+==================
+*/
+cmodel_t *CM_LoadMap (char *name, qboolean clientload, unsigned *checksum)
+{
+	cmodel_world_t	*w = CM_World ();
+	cmap_t			*map = NULL;
+	qboolean		flush = !clientload && Cvar_VariableValue ("flushmap");
 
 	map_noareas = Cvar_Get ("map_noareas", "0", 0, NULL);
 
-	if (!strcmp (map_name, name) && (clientload || !Cvar_VariableValue ("flushmap")))
+	if (!strcmp (w->map->name, name) && !flush)
 	{
-		*checksum = last_checksum;
+		*checksum = w->map->checksum;
 		if (!clientload)
 		{
-			memset (portalopen, 0, sizeof (portalopen));
-			FloodAreaConnections ();
+			memset (w->portalopen, 0, sizeof (w->portalopen));
+			FloodAreaConnections (w);
 		}
-		return &map_cmodels[0];		// still have the right version
+		return &w->map->cmodels[0];		// still have the right version
 	}
 
 	// free old stuff
-	numplanes = 0;
-	numnodes = 0;
-	numleafs = 0;
-	numcmodels = 0;
-	numvisibility = 0;
-	numentitychars = 0;
-	map_entitystring[0] = 0;
-	map_name[0] = 0;
+	CM_ReleaseMap (w->map);
+	CM_AttachMap (w, &cm_nullmap);
 
 	if (!name || !name[0])
 	{
-		numleafs = 1;
-		numclusters = 1;
-		numareas = 1;
 		*checksum = 0;
-		return &map_cmodels[0];			// cinematic servers won't have anything at all
+		return &w->map->cmodels[0];			// cinematic servers won't have anything at all
 	}
 
-	// load the file
-	length = FS_LoadFile (name, (void **) &buf);
-	if (!buf)
-		Com_Error (ERR_DROP, "Couldn't load %s", name);
-
-	last_checksum = LittleLong (Com_BlockChecksum (buf, length));
-	*checksum = last_checksum;
-
-	header = *(dheader_t *) buf;
-	for (i = 0; i < sizeof (dheader_t) / 4; i++)
-		((int *) &header)[i] = LittleLong (((int *) &header)[i]);
-
-	if (header.version != BSPVERSION)
-		Com_Error (ERR_DROP, "CMod_LoadBrushModel: %s has wrong version number (%i should be %i)", name, header.version, BSPVERSION);
-
-	cmod_base = (byte *) buf;
-
-	// load into heap
-	CMod_LoadSurfaces (&header.lumps[LUMP_TEXINFO]);
-	CMod_LoadLeafs (&header.lumps[LUMP_LEAFS]);
-	CMod_LoadLeafBrushes (&header.lumps[LUMP_LEAFBRUSHES]);
-	CMod_LoadPlanes (&header.lumps[LUMP_PLANES]);
-	CMod_LoadBrushes (&header.lumps[LUMP_BRUSHES]);
-	CMod_LoadBrushSides (&header.lumps[LUMP_BRUSHSIDES]);
-	CMod_LoadSubmodels (&header.lumps[LUMP_MODELS]);
-	CMod_LoadNodes (&header.lumps[LUMP_NODES]);
-	CMod_LoadAreas (&header.lumps[LUMP_AREAS]);
-	CMod_LoadAreaPortals (&header.lumps[LUMP_AREAPORTALS]);
-	CMod_LoadVisibility (&header.lumps[LUMP_VISIBILITY]);
-	CMod_LoadEntityString (&header.lumps[LUMP_ENTITIES]);
-
-	FS_FreeFile (buf);
+	if (!flush)
+		map = CM_FindMap (name);
 
-	CM_InitBoxHull ();
+	if (!map)
+		map = CMod_LoadBSP (name);
 
-	memset (portalopen, 0, sizeof (portalopen));
-	FloodAreaConnections ();
+	CM_AttachMap (w, map);
 
-	strcpy (map_name, name);
+	*checksum = map->checksum;
 
-	return &map_cmodels[0];
+	return &map->cmodels[0];
 }
 
 /*
@@ -635,60 +1082,105 @@ CM_InlineModel
 */
 cmodel_t	*CM_InlineModel (char *name)
 {
+	cmap_t	*map = CM_World ()->map;
 	int		num;
 
 	if (!name || name[0] != '*')
 		Com_Error (ERR_DROP, "CM_InlineModel: bad name");
 	num = atoi (name + 1);
-	if (num < 1 || num >= numcmodels)
+	if (num < 1 || num >= map->numcmodels)
 		Com_Error (ERR_DROP, "CM_InlineModel: bad number");
 
-	return &map_cmodels[num];
+	return &map->cmodels[num];
 }
 
 int		CM_NumClusters (void)
 {
-	return numclusters;
+	return CM_World ()->map->numclusters;
 }
 
 int		CM_NumInlineModels (void)
 {
-	return numcmodels;
+	return CM_World ()->map->numcmodels;
 }
 
 char	*CM_EntityString (void)
 {
-	return map_entitystring;
+	cmap_t	*map = CM_World ()->map;
+
+	return map->entitystring ? map->entitystring : "";
 }
 
 int		CM_LeafContents (int leafnum)
 {
-	if (leafnum < 0 || leafnum >= numleafs)
+	cmap_t	*map = CM_World ()->map;
+
+	if (leafnum < 0 || leafnum >= map->numleafs)
 		Com_Error (ERR_DROP, "CM_LeafContents: bad number");
-	return map_leafs[leafnum].contents;
+	return map->leafs[leafnum].contents;
 }
 
 int		CM_LeafCluster (int leafnum)
 {
-	if (leafnum < 0 || leafnum >= numleafs)
+	cmap_t	*map = CM_World ()->map;
+
+	if (leafnum < 0 || leafnum >= map->numleafs)
 		Com_Error (ERR_DROP, "CM_LeafCluster: bad number");
-	return map_leafs[leafnum].cluster;
+	return map->leafs[leafnum].cluster;
 }
 
 int		CM_LeafArea (int leafnum)
 {
-	if (leafnum < 0 || leafnum >= numleafs)
+	cmap_t	*map = CM_World ()->map;
+
+	if (leafnum < 0 || leafnum >= map->numleafs)
 		Com_Error (ERR_DROP, "CM_LeafArea: bad number");
-	return map_leafs[leafnum].area;
+	return map->leafs[leafnum].area;
 }
 
 //=======================================================================
 
 
-cplane_t	*box_planes;
-int			box_headnode;
-cbrush_t	*box_brush;
-cleaf_t		*box_leaf;
+/*
+===================
+node, leaf and brush lookups that know about the box hull, which is numbered after the map's own
+===================
+*/
+static cnode_t *CM_Node (cmodel_world_t *w, int num)
+{
+	if (num < w->map->numnodes)
+		return &w->map->nodes[num];
+	else return &w->box_nodes[num - w->map->numnodes];
+}
+
+static cleaf_t *CM_Leaf (cmodel_world_t *w, int num)
+{
+	if (num < w->map->numleafs)
+		return &w->map->leafs[num];
+	else return &w->box_leaf;
+}
+
+static unsigned short *CM_LeafBrushes (cmodel_world_t *w, cleaf_t *leaf)
+{
+	if (leaf == &w->box_leaf)
+		return &w->box_leafbrush;
+	else return &w->map->leafbrushes[leaf->firstleafbrush];
+}
+
+static cbrush_t *CM_Brush (cmodel_world_t *w, int num)
+{
+	if (num < w->map->numbrushes)
+		return &w->map->brushes[num];
+	else return &w->box_brush;
+}
+
+static cbrushside_t *CM_BrushSides (cmodel_world_t *w, cbrush_t *brush)
+{
+	if (brush == &w->box_brush)
+		return w->box_brushsides;
+	else return &w->map->brushsides[brush->firstbrushside];
+}
+
 
 /*
 ===================
@@ -698,62 +1190,68 @@ Set up the planes and nodes so that the six floats of a bounding box
 can just be stored out and get a proper clipping hull structure.
 ===================
 */
-void CM_InitBoxHull (void)
+static void CM_InitBoxHull (cmodel_world_t *w)
 {
 	int			i;
 	int			side;
 	cnode_t		*c;
+	cfnode_t	*f;
 	cplane_t	*p;
 	cbrushside_t	*s;
+	cmap_t		*map = w->map;
 
-	box_headnode = numnodes;
-	box_planes = &map_planes[numplanes];
-
-	if (numnodes + 6 > MAX_MAP_NODES || numbrushes + 1 > MAX_MAP_BRUSHES || numleafbrushes + 1 > MAX_MAP_LEAFBRUSHES || numbrushsides + 6 > MAX_MAP_BRUSHSIDES || numplanes + 12 > MAX_MAP_PLANES)
-		Com_Error (ERR_DROP, "Not enough room for box tree");
+	w->box_headnode = map->numnodes;
 
-	box_brush = &map_brushes[numbrushes];
-	box_brush->numsides = 6;
-	box_brush->firstbrushside = numbrushsides;
-	box_brush->contents = CONTENTS_MONSTER;
+	w->box_brush.numsides = 6;
+	w->box_brush.firstbrushside = 0;
+	w->box_brush.contents = CONTENTS_MONSTER;
 
-	box_leaf = &map_leafs[numleafs];
-	box_leaf->contents = CONTENTS_MONSTER;
-	box_leaf->firstleafbrush = numleafbrushes;
-	box_leaf->numleafbrushes = 1;
+	w->box_leaf.contents = CONTENTS_MONSTER;
+	w->box_leaf.firstleafbrush = 0;
+	w->box_leaf.numleafbrushes = 1;
 
-	map_leafbrushes[numleafbrushes] = numbrushes;
+	w->box_leafbrush = map->numbrushes;
 
 	for (i = 0; i < 6; i++)
 	{
 		side = i & 1;
 
 		// brush sides
-		s = &map_brushsides[numbrushsides + i];
-		s->plane = map_planes + (numplanes + i * 2 + side);
+		s = &w->box_brushsides[i];
+		s->plane = &w->box_planes[i * 2 + side];
 		s->surface = &nullsurface;
 
 		// nodes
-		c = &map_nodes[box_headnode + i];
-		c->plane = map_planes + (numplanes + i * 2);
-		c->children[side] = -1 - emptyleaf;
+		c = &w->box_nodes[i];
+		c->plane = &w->box_planes[i * 2];
+		c->children[side] = -1 - map->emptyleaf;
 		if (i != 5)
-			c->children[side ^ 1] = box_headnode + i + 1;
+			c->children[side ^ 1] = w->box_headnode + i + 1;
 		else
-			c->children[side ^ 1] = -1 - numleafs;
+			c->children[side ^ 1] = -1 - map->numleafs;
 
 		// planes
-		p = &box_planes[i * 2];
+		p = &w->box_planes[i * 2];
 		p->type = i >> 1;
 		p->signbits = 0;
 		VectorClear (p->normal);
 		p->normal[i >> 1] = 1;
 
-		p = &box_planes[i * 2 + 1];
+		p = &w->box_planes[i * 2 + 1];
 		p->type = 3 + (i >> 1);
 		p->signbits = 0;
 		VectorClear (p->normal);
 		p->normal[i >> 1] = -1;
+
+		// flattened nodes
+		f = &w->box_fnodes[i];
+		f->plane = w->box_planes[i * 2];
+		f->children[side] = -1 - map->emptyleaf;
+		if (i != 5)
+			f->children[side ^ 1] = i + 1;
+		else
+			f->children[side ^ 1] = -1 - map->numleafs;
+		f->orignum = w->box_headnode + i;
 	}
 }
 
@@ -768,6 +1266,9 @@ BSP trees instead of being compared directly.
 */
 int	CM_HeadnodeForBox (vec3_t mins, vec3_t maxs)
 {
+	cmodel_world_t *w = CM_World ();
+	cplane_t *box_planes = w->box_planes;
+
 	box_planes[0].dist = maxs[0];
 	box_planes[1].dist = -maxs[0];
 	box_planes[2].dist = mins[0];
@@ -781,7 +1282,14 @@ int	CM_HeadnodeForBox (vec3_t mins, vec3_t maxs)
 	box_planes[10].dist = mins[2];
 	box_planes[11].dist = -mins[2];
 
-	return box_headnode;
+	w->box_fnodes[0].plane.dist = box_planes[0].dist;
+	w->box_fnodes[1].plane.dist = box_planes[2].dist;
+	w->box_fnodes[2].plane.dist = box_planes[4].dist;
+	w->box_fnodes[3].plane.dist = box_planes[6].dist;
+	w->box_fnodes[4].plane.dist = box_planes[8].dist;
+	w->box_fnodes[5].plane.dist = box_planes[10].dist;
+
+	return w->box_headnode;
 }
 
 
@@ -791,7 +1299,7 @@ CM_PointLeafnum_r
 
 ==================
 */
-int CM_PointLeafnum_r (vec3_t p, int num)
+static int CM_PointLeafnum_r (cmodel_world_t *w, vec3_t p, int num)
 {
 	float		d;
 	cnode_t		*node;
@@ -799,7 +1307,7 @@ int CM_PointLeafnum_r (vec3_t p, int num)
 
 	while (num >= 0)
 	{
-		node = map_nodes + num;
+		node = CM_Node (w, num);
 		plane = node->plane;
 
 		if (plane->type < 3)
@@ -809,7 +1317,53 @@ int CM_PointLeafnum_r (vec3_t p, int num)
 		if (d < 0)
 			num = node->children[1];
 		else
-			num = node->children[0];
+			num = node->children[0];
+	}
+
+	c_pointcontents++;		// optimize counter
+
+	return -1 - num;
+}
+
+
+/*
+==================
+CM_FlatHeadnode
+
+Returns the flattened nodes to walk from a bsp headnode and the flattened number to start at
+==================
+*/
+static cfnode_t *CM_FlatHeadnode (cmodel_world_t *w, int headnode, int *num)
+{
+	if (headnode >= w->map->numnodes)
+	{
+		// the box hull has its own
+		*num = headnode - w->map->numnodes;
+		return w->box_fnodes;
+	}
+
+	*num = (headnode < 0) ? headnode : w->map->flatnum[headnode];
+	return w->map->fnodes;
+}
+
+
+static int CM_FlatPointLeafnum (cmodel_world_t *w, vec3_t p, int headnode)
+{
+	int			num;
+	cfnode_t	*nodes = CM_FlatHeadnode (w, headnode, &num);
+	cfnode_t	*node;
+	float		d;
+
+	while (num >= 0)
+	{
+		node = &nodes[num];
+
+		if (node->plane.type < 3)
+			d = p[node->plane.type] - node->plane.dist;
+		else
+			d = DotProduct (node->plane.normal, p) - node->plane.dist;
+
+		num = node->children[d < 0];
 	}
 
 	c_pointcontents++;		// optimize counter
@@ -817,11 +1371,22 @@ int CM_PointLeafnum_r (vec3_t p, int num)
 	return -1 - num;
 }
 
+
+static int CM_HeadnodeLeafnum (cmodel_world_t *w, vec3_t p, int headnode)
+{
+	if (cm_flatnodes->value)
+		return CM_FlatPointLeafnum (w, p, headnode);
+	else return CM_PointLeafnum_r (w, p, headnode);
+}
+
+
 int CM_PointLeafnum (vec3_t p)
 {
-	if (!numplanes)
+	cmodel_world_t *w = CM_World ();
+
+	if (!w->map->numplanes)
 		return 0;		// sound may call this without map loaded
-	return CM_PointLeafnum_r (p, 0);
+	return CM_HeadnodeLeafnum (w, p, 0);
 }
 
 
@@ -833,12 +1398,7 @@ CM_BoxLeafnums
 Fills in a list of all the leafs touched
 =============
 */
-int		leaf_count, leaf_maxcount;
-int		*leaf_list;
-float	*leaf_mins, *leaf_maxs;
-int		leaf_topnode;
-
-void CM_BoxLeafnums_r (int nodenum)
+static void CM_BoxLeafnums_r (cmodel_world_t *w, int nodenum)
 {
 	cplane_t	*plane;
 	cnode_t		*node;
@@ -848,19 +1408,19 @@ void CM_BoxLeafnums_r (int nodenum)
 	{
 		if (nodenum < 0)
 		{
-			if (leaf_count >= leaf_maxcount)
+			if (w->leaf_count >= w->leaf_maxcount)
 			{
 				// Com_Printf ("CM_BoxLeafnums_r: overflow\n");
 				return;
 			}
 
-			leaf_list[leaf_count++] = -1 - nodenum;
+			w->leaf_list[w->leaf_count++] = -1 - nodenum;
 			return;
 		}
 
-		node = &map_nodes[nodenum];
+		node = CM_Node (w, nodenum);
 		plane = node->plane;
-		s = BoxOnPlaneSide (leaf_mins, leaf_maxs, plane);
+		s = BoxOnPlaneSide (w->leaf_mins, w->leaf_maxs, plane);
 
 		if (s == 1)
 			nodenum = node->children[0];
@@ -869,37 +1429,84 @@ void CM_BoxLeafnums_r (int nodenum)
 		else
 		{
 			// go down both
-			if (leaf_topnode == -1)
-				leaf_topnode = nodenum;
-			CM_BoxLeafnums_r (node->children[0]);
+			if (w->leaf_topnode == -1)
+				w->leaf_topnode = nodenum;
+			CM_BoxLeafnums_r (w, node->children[0]);
+			nodenum = node->children[1];
+		}
+	}
+}
+
+
+static void CM_FlatBoxLeafnums (cmodel_world_t *w, int headnode)
+{
+	int			stack[CM_MAXDEPTH];
+	int			sp = 0;
+	int			nodenum;
+	cfnode_t	*nodes = CM_FlatHeadnode (w, headnode, &nodenum);
+	cfnode_t	*node;
+	int			s;
+
+	while (1)
+	{
+		if (nodenum < 0)
+		{
+			if (w->leaf_count < w->leaf_maxcount)
+				w->leaf_list[w->leaf_count++] = -1 - nodenum;
+			else if (w->leaf_topnode != -1)
+				return;		// nothing more can change
+
+			// carry on with the back side of the last node that went down both
+			if (!sp) return;
+			nodenum = stack[--sp];
+			continue;
+		}
+
+		node = &nodes[nodenum];
+		s = BoxOnPlaneSide (w->leaf_mins, w->leaf_maxs, &node->plane);
+
+		if (s == 1)
+			nodenum = node->children[0];
+		else if (s == 2)
 			nodenum = node->children[1];
+		else
+		{
+			// go down both
+			if (w->leaf_topnode == -1)
+				w->leaf_topnode = node->orignum;
+			stack[sp++] = node->children[1];
+			nodenum = node->children[0];
 		}
 	}
 }
 
 
-int	CM_BoxLeafnums_headnode (vec3_t mins, vec3_t maxs, int *list, int listsize, int headnode, int *topnode)
+static int	CM_BoxLeafnums_headnode (cmodel_world_t *w, vec3_t mins, vec3_t maxs, int *list, int listsize, int headnode, int *topnode)
 {
-	leaf_list = list;
-	leaf_count = 0;
-	leaf_maxcount = listsize;
-	leaf_mins = mins;
-	leaf_maxs = maxs;
+	w->leaf_list = list;
+	w->leaf_count = 0;
+	w->leaf_maxcount = listsize;
+	w->leaf_mins = mins;
+	w->leaf_maxs = maxs;
 
-	leaf_topnode = -1;
+	w->leaf_topnode = -1;
 
-	CM_BoxLeafnums_r (headnode);
+	if (cm_flatnodes->value)
+		CM_FlatBoxLeafnums (w, headnode);
+	else CM_BoxLeafnums_r (w, headnode);
 
 	if (topnode)
-		*topnode = leaf_topnode;
+		*topnode = w->leaf_topnode;
 
-	return leaf_count;
+	return w->leaf_count;
 }
 
 int	CM_BoxLeafnums (vec3_t mins, vec3_t maxs, int *list, int listsize, int *topnode)
 {
-	return CM_BoxLeafnums_headnode (mins, maxs, list,
-		listsize, map_cmodels[0].headnode, topnode);
+	cmodel_world_t *w = CM_World ();
+
+	return CM_BoxLeafnums_headnode (w, mins, maxs, list,
+		listsize, w->map->cmodels[0].headnode, topnode);
 }
 
 
@@ -912,14 +1519,15 @@ CM_PointContents
 */
 int CM_PointContents (vec3_t p, int headnode)
 {
+	cmodel_world_t *w = CM_World ();
 	int		l;
 
-	if (!numnodes)	// map not loaded
+	if (!w->map->numnodes)	// map not loaded
 		return 0;
 
-	l = CM_PointLeafnum_r (p, headnode);
+	l = CM_HeadnodeLeafnum (w, p, headnode);
 
-	return map_leafs[l].contents;
+	return CM_Leaf (w, l)->contents;
 }
 
 /*
@@ -932,6 +1540,7 @@ rotating entities
 */
 int	CM_TransformedPointContents (vec3_t p, int headnode, vec3_t origin, vec3_t angles)
 {
+	cmodel_world_t *w = CM_World ();
 	vec3_t		p_l;
 	vec3_t		temp;
 	vec3_t		forward, right, up;
@@ -941,7 +1550,7 @@ int	CM_TransformedPointContents (vec3_t p, int headnode, vec3_t origin, vec3_t a
 	VectorSubtract (p, origin, p_l);
 
 	// rotate start and end into the models frame of reference
-	if (headnode != box_headnode &&
+	if (headnode != w->box_headnode &&
 		(angles[0] || angles[1] || angles[2]))
 	{
 		AngleVectors (angles, forward, right, up);
@@ -952,9 +1561,9 @@ int	CM_TransformedPointContents (vec3_t p, int headnode, vec3_t origin, vec3_t a
 		p_l[2] = DotProduct (temp, up);
 	}
 
-	l = CM_PointLeafnum_r (p_l, headnode);
+	l = CM_HeadnodeLeafnum (w, p_l, headnode);
 
-	return map_leafs[l].contents;
+	return CM_Leaf (w, l)->contents;
 }
 
 
@@ -969,20 +1578,12 @@ BOX TRACING
 // 1/32 epsilon to keep floating point happy
 #define	DIST_EPSILON	(0.03125)
 
-vec3_t	trace_start, trace_end;
-vec3_t	trace_mins, trace_maxs;
-vec3_t	trace_extents;
-
-trace_t	trace_trace;
-int		trace_contents;
-qboolean	trace_ispoint;		// optimized case
-
 /*
 ================
 CM_ClipBoxToBrush
 ================
 */
-void CM_ClipBoxToBrush (vec3_t mins, vec3_t maxs, vec3_t p1, vec3_t p2,
+static void CM_ClipBoxToBrush (cmodel_world_t *w, vec3_t mins, vec3_t maxs, vec3_t p1, vec3_t p2,
 	trace_t *trace, cbrush_t *brush)
 {
 	int			i, j;
@@ -994,6 +1595,7 @@ void CM_ClipBoxToBrush (vec3_t mins, vec3_t maxs, vec3_t p1, vec3_t p2,
 	qboolean	getout, startout;
 	float		f;
 	cbrushside_t	*side, *leadside;
+	cbrushside_t	*sides;
 
 	enterfrac = -1;
 	leavefrac = 1;
@@ -1007,14 +1609,15 @@ void CM_ClipBoxToBrush (vec3_t mins, vec3_t maxs, vec3_t p1, vec3_t p2,
 	getout = false;
 	startout = false;
 	leadside = NULL;
+	sides = CM_BrushSides (w, brush);
 
 	for (i = 0; i < brush->numsides; i++)
 	{
-		side = &map_brushsides[brush->firstbrushside + i];
+		side = &sides[i];
 		plane = side->plane;
 
 		// FIXME: special case for axial
-		if (!trace_ispoint)
+		if (!w->trace_ispoint)
 		{
 			// general box case
 			// push the plane out apropriately for mins/maxs
@@ -1098,7 +1701,7 @@ void CM_ClipBoxToBrush (vec3_t mins, vec3_t maxs, vec3_t p1, vec3_t p2,
 CM_TestBoxInBrush
 ================
 */
-void CM_TestBoxInBrush (vec3_t mins, vec3_t maxs, vec3_t p1,
+static void CM_TestBoxInBrush (cmodel_world_t *w, vec3_t mins, vec3_t maxs, vec3_t p1,
 	trace_t *trace, cbrush_t *brush)
 {
 	int			i, j;
@@ -1106,15 +1709,16 @@ void CM_TestBoxInBrush (vec3_t mins, vec3_t maxs, vec3_t p1,
 	float		dist;
 	vec3_t		ofs;
 	float		d1;
-	cbrushside_t	*side;
+	cbrushside_t	*sides;
 
 	if (!brush->numsides)
 		return;
 
+	sides = CM_BrushSides (w, brush);
+
 	for (i = 0; i < brush->numsides; i++)
 	{
-		side = &map_brushsides[brush->firstbrushside + i];
-		plane = side->plane;
+		plane = sides[i].plane;
 
 		// FIXME: special case for axial
 
@@ -1153,29 +1757,31 @@ void CM_TestBoxInBrush (vec3_t mins, vec3_t maxs, vec3_t p1,
 CM_TraceToLeaf
 ================
 */
-void CM_TraceToLeaf (int leafnum)
+static void CM_TraceToLeaf (cmodel_world_t *w, int leafnum)
 {
 	int			k;
 	int			brushnum;
 	cleaf_t		*leaf;
 	cbrush_t	*b;
+	unsigned short	*leafbrushes;
 
-	leaf = &map_leafs[leafnum];
-	if (!(leaf->contents & trace_contents))
+	leaf = CM_Leaf (w, leafnum);
+	if (!(leaf->contents & w->trace_contents))
 		return;
+	leafbrushes = CM_LeafBrushes (w, leaf);
 	// trace line against all brushes in the leaf
 	for (k = 0; k < leaf->numleafbrushes; k++)
 	{
-		brushnum = map_leafbrushes[leaf->firstleafbrush + k];
-		b = &map_brushes[brushnum];
-		if (b->checkcount == checkcount)
+		brushnum = leafbrushes[k];
+		if (w->brushcheckcount[brushnum] == w->checkcount)
 			continue;	// already checked this brush in another leaf
-		b->checkcount = checkcount;
+		w->brushcheckcount[brushnum] = w->checkcount;
 
-		if (!(b->contents & trace_contents))
+		b = CM_Brush (w, brushnum);
+		if (!(b->contents & w->trace_contents))
 			continue;
-		CM_ClipBoxToBrush (trace_mins, trace_maxs, trace_start, trace_end, &trace_trace, b);
-		if (!trace_trace.fraction)
+		CM_ClipBoxToBrush (w, w->trace_mins, w->trace_maxs, w->trace_start, w->trace_end, &w->trace_trace, b);
+		if (!w->trace_trace.fraction)
 			return;
 	}
 
@@ -1187,29 +1793,31 @@ void CM_TraceToLeaf (int leafnum)
 CM_TestInLeaf
 ================
 */
-void CM_TestInLeaf (int leafnum)
+static void CM_TestInLeaf (cmodel_world_t *w, int leafnum)
 {
 	int			k;
 	int			brushnum;
 	cleaf_t		*leaf;
 	cbrush_t	*b;
+	unsigned short	*leafbrushes;
 
-	leaf = &map_leafs[leafnum];
-	if (!(leaf->contents & trace_contents))
+	leaf = CM_Leaf (w, leafnum);
+	if (!(leaf->contents & w->trace_contents))
 		return;
+	leafbrushes = CM_LeafBrushes (w, leaf);
 	// trace line against all brushes in the leaf
 	for (k = 0; k < leaf->numleafbrushes; k++)
 	{
-		brushnum = map_leafbrushes[leaf->firstleafbrush + k];
-		b = &map_brushes[brushnum];
-		if (b->checkcount == checkcount)
+		brushnum = leafbrushes[k];
+		if (w->brushcheckcount[brushnum] == w->checkcount)
 			continue;	// already checked this brush in another leaf
-		b->checkcount = checkcount;
+		w->brushcheckcount[brushnum] = w->checkcount;
 
-		if (!(b->contents & trace_contents))
+		b = CM_Brush (w, brushnum);
+		if (!(b->contents & w->trace_contents))
 			continue;
-		CM_TestBoxInBrush (trace_mins, trace_maxs, trace_start, &trace_trace, b);
-		if (!trace_trace.fraction)
+		CM_TestBoxInBrush (w, w->trace_mins, w->trace_maxs, w->trace_start, &w->trace_trace, b);
+		if (!w->trace_trace.fraction)
 			return;
 	}
 
@@ -1222,7 +1830,7 @@ CM_RecursiveHullCheck
 
 ==================
 */
-void CM_RecursiveHullCheck (int num, float p1f, float p2f, vec3_t p1, vec3_t p2)
+static void CM_RecursiveHullCheck (cmodel_world_t *w, int num, float p1f, float p2f, vec3_t p1, vec3_t p2)
 {
 	cnode_t		*node;
 	cplane_t	*plane;
@@ -1234,55 +1842,55 @@ void CM_RecursiveHullCheck (int num, float p1f, float p2f, vec3_t p1, vec3_t p2)
 	int			side;
 	float		midf;
 
-	if (trace_trace.fraction <= p1f)
+	if (w->trace_trace.fraction <= p1f)
 		return;		// already hit something nearer
 
 	// if < 0, we are in a leaf node
 	if (num < 0)
 	{
-		CM_TraceToLeaf (-1 - num);
+		CM_TraceToLeaf (w, -1 - num);
 		return;
 	}
 
 	// find the point distances to the seperating plane
 	// and the offset for the size of the box
-	node = map_nodes + num;
+	node = CM_Node (w, num);
 	plane = node->plane;
 
 	if (plane->type < 3)
 	{
 		t1 = p1[plane->type] - plane->dist;
 		t2 = p2[plane->type] - plane->dist;
-		offset = trace_extents[plane->type];
+		offset = w->trace_extents[plane->type];
 	}
 	else
 	{
 		t1 = DotProduct (plane->normal, p1) - plane->dist;
 		t2 = DotProduct (plane->normal, p2) - plane->dist;
-		if (trace_ispoint)
+		if (w->trace_ispoint)
 			offset = 0;
 		else
-			offset = fabs (trace_extents[0] * plane->normal[0]) +
-			fabs (trace_extents[1] * plane->normal[1]) +
-			fabs (trace_extents[2] * plane->normal[2]);
+			offset = fabs (w->trace_extents[0] * plane->normal[0]) +
+			fabs (w->trace_extents[1] * plane->normal[1]) +
+			fabs (w->trace_extents[2] * plane->normal[2]);
 	}
 
 
 #if 0
-	CM_RecursiveHullCheck (node->children[0], p1f, p2f, p1, p2);
-	CM_RecursiveHullCheck (node->children[1], p1f, p2f, p1, p2);
+	CM_RecursiveHullCheck (w, node->children[0], p1f, p2f, p1, p2);
+	CM_RecursiveHullCheck (w, node->children[1], p1f, p2f, p1, p2);
 	return;
 #endif
 
 	// see which sides we need to consider
 	if (t1 >= offset && t2 >= offset)
 	{
-		CM_RecursiveHullCheck (node->children[0], p1f, p2f, p1, p2);
+		CM_RecursiveHullCheck (w, node->children[0], p1f, p2f, p1, p2);
 		return;
 	}
 	if (t1 < -offset && t2 < -offset)
 	{
-		CM_RecursiveHullCheck (node->children[1], p1f, p2f, p1, p2);
+		CM_RecursiveHullCheck (w, node->children[1], p1f, p2f, p1, p2);
 		return;
 	}
 
@@ -1319,7 +1927,7 @@ void CM_RecursiveHullCheck (int num, float p1f, float p2f, vec3_t p1, vec3_t p2)
 	for (i = 0; i < 3; i++)
 		mid[i] = p1[i] + frac * (p2[i] - p1[i]);
 
-	CM_RecursiveHullCheck (node->children[side], p1f, midf, p1, mid);
+	CM_RecursiveHullCheck (w, node->children[side], p1f, midf, p1, mid);
 
 
 	// go past the node
@@ -1333,7 +1941,148 @@ void CM_RecursiveHullCheck (int num, float p1f, float p2f, vec3_t p1, vec3_t p2)
 	for (i = 0; i < 3; i++)
 		mid[i] = p1[i] + frac2 * (p2[i] - p1[i]);
 
-	CM_RecursiveHullCheck (node->children[side ^ 1], midf, p2f, mid, p2);
+	CM_RecursiveHullCheck (w, node->children[side ^ 1], midf, p2f, mid, p2);
+}
+
+
+/*
+==================
+CM_FlatHullCheck
+
+CM_RecursiveHullCheck over the flattened nodes; the far side of each node that the move crosses is stacked and
+only done once everything on the near side is
+==================
+*/
+typedef struct chullcheck_s
+{
+	int			num;
+	float		p1f, p2f;
+	vec3_t		p1, p2;
+} chullcheck_t;
+
+static void CM_FlatHullCheck (cmodel_world_t *w, int headnode, vec3_t start, vec3_t end)
+{
+	chullcheck_t	stack[CM_MAXDEPTH];
+	chullcheck_t	hc, *far;
+	int			sp = 0;
+	cfnode_t	*nodes = CM_FlatHeadnode (w, headnode, &hc.num);
+	cfnode_t	*node;
+	cplane_t	*plane;
+	float		t1, t2, offset;
+	float		frac, frac2;
+	float		idist;
+	int			i;
+	int			side;
+
+	hc.p1f = 0;
+	hc.p2f = 1;
+	VectorCopy (start, hc.p1);
+	VectorCopy (end, hc.p2);
+
+	for (;;)
+	{
+		if (w->trace_trace.fraction <= hc.p1f)
+		{
+			// already hit something nearer
+		}
+		else if (hc.num < 0)
+		{
+			// we are in a leaf node
+			CM_TraceToLeaf (w, -1 - hc.num);
+		}
+		else
+		{
+			// find the point distances to the seperating plane
+			// and the offset for the size of the box
+			node = &nodes[hc.num];
+			plane = &node->plane;
+
+			if (plane->type < 3)
+			{
+				t1 = hc.p1[plane->type] - plane->dist;
+				t2 = hc.p2[plane->type] - plane->dist;
+				offset = w->trace_extents[plane->type];
+			}
+			else
+			{
+				t1 = DotProduct (plane->normal, hc.p1) - plane->dist;
+				t2 = DotProduct (plane->normal, hc.p2) - plane->dist;
+				if (w->trace_ispoint)
+					offset = 0;
+				else
+					offset = fabs (w->trace_extents[0] * plane->normal[0]) +
+					fabs (w->trace_extents[1] * plane->normal[1]) +
+					fabs (w->trace_extents[2] * plane->normal[2]);
+			}
+
+			// see which sides we need to consider
+			if (t1 >= offset && t2 >= offset)
+			{
+				hc.num = node->children[0];
+				continue;
+			}
+			if (t1 < -offset && t2 < -offset)
+			{
+				hc.num = node->children[1];
+				continue;
+			}
+
+			// put the crosspoint DIST_EPSILON pixels on the near side
+			if (t1 < t2)
+			{
+				idist = 1.0 / (t1 - t2);
+				side = 1;
+				frac2 = (t1 + offset + DIST_EPSILON) * idist;
+				frac = (t1 - offset + DIST_EPSILON) * idist;
+			}
+			else if (t1 > t2)
+			{
+				idist = 1.0 / (t1 - t2);
+				side = 0;
+				frac2 = (t1 - offset - DIST_EPSILON) * idist;
+				frac = (t1 + offset + DIST_EPSILON) * idist;
+			}
+			else
+			{
+				side = 0;
+				frac = 1;
+				frac2 = 0;
+			}
+
+			// stack the move past the node
+			if (frac2 < 0)
+				frac2 = 0;
+			if (frac2 > 1)
+				frac2 = 1;
+
+			far = &stack[sp++];
+			far->num = node->children[side ^ 1];
+			far->p1f = hc.p1f + (hc.p2f - hc.p1f) * frac2;
+			far->p2f = hc.p2f;
+
+			for (i = 0; i < 3; i++)
+				far->p1[i] = hc.p1[i] + frac2 * (hc.p2[i] - hc.p1[i]);
+
+			VectorCopy (hc.p2, far->p2);
+
+			// and carry on with the move up to the node
+			if (frac < 0)
+				frac = 0;
+			if (frac > 1)
+				frac = 1;
+
+			hc.num = node->children[side];
+			hc.p2f = hc.p1f + (hc.p2f - hc.p1f) * frac;
+
+			for (i = 0; i < 3; i++)
+				hc.p2[i] = hc.p1[i] + frac * (hc.p2[i] - hc.p1[i]);
+
+			continue;
+		}
+
+		if (!sp) break;
+		hc = stack[--sp];
+	}
 }
 
 
@@ -1349,25 +2098,26 @@ trace_t		CM_BoxTrace (vec3_t start, vec3_t end,
 	vec3_t mins, vec3_t maxs,
 	int headnode, int brushmask)
 {
+	cmodel_world_t *w = CM_World ();
 	int		i;
 
-	checkcount++;		// for multi-check avoidance
+	w->checkcount++;		// for multi-check avoidance
 
 	c_traces++;			// for statistics, may be zeroed
 
 	// fill in a default trace
-	memset (&trace_trace, 0, sizeof (trace_trace));
-	trace_trace.fraction = 1;
-	trace_trace.surface = &(nullsurface.c);
+	memset (&w->trace_trace, 0, sizeof (w->trace_trace));
+	w->trace_trace.fraction = 1;
+	w->trace_trace.surface = &(nullsurface.c);
 
-	if (!numnodes)	// map not loaded
-		return trace_trace;
+	if (!w->map->numnodes)	// map not loaded
+		return w->trace_trace;
 
-	trace_contents = brushmask;
-	VectorCopy (start, trace_start);
-	VectorCopy (end, trace_end);
-	VectorCopy (mins, trace_mins);
-	VectorCopy (maxs, trace_maxs);
+	w->trace_contents = brushmask;
+	VectorCopy (start, w->trace_start);
+	VectorCopy (end, w->trace_end);
+	VectorCopy (mins, w->trace_mins);
+	VectorCopy (maxs, w->trace_maxs);
 
 	// check for position test special case
 	if (start[0] == end[0] && start[1] == end[1] && start[2] == end[2])
@@ -1385,44 +2135,46 @@ trace_t		CM_BoxTrace (vec3_t start, vec3_t end,
 			c2[i] += 1;
 		}
 
-		numleafs = CM_BoxLeafnums_headnode (c1, c2, leafs, 1024, headnode, &topnode);
+		numleafs = CM_BoxLeafnums_headnode (w, c1, c2, leafs, 1024, headnode, &topnode);
 		for (i = 0; i < numleafs; i++)
 		{
-			CM_TestInLeaf (leafs[i]);
-			if (trace_trace.allsolid)
+			CM_TestInLeaf (w, leafs[i]);
+			if (w->trace_trace.allsolid)
 				break;
 		}
-		VectorCopy (start, trace_trace.endpos);
-		return trace_trace;
+		VectorCopy (start, w->trace_trace.endpos);
+		return w->trace_trace;
 	}
 
 	// check for point special case
 	if (mins[0] == 0 && mins[1] == 0 && mins[2] == 0 && maxs[0] == 0 && maxs[1] == 0 && maxs[2] == 0)
 	{
-		trace_ispoint = true;
-		VectorClear (trace_extents);
+		w->trace_ispoint = true;
+		VectorClear (w->trace_extents);
 	}
 	else
 	{
-		trace_ispoint = false;
-		trace_extents[0] = -mins[0] > maxs[0] ? -mins[0] : maxs[0];
-		trace_extents[1] = -mins[1] > maxs[1] ? -mins[1] : maxs[1];
-		trace_extents[2] = -mins[2] > maxs[2] ? -mins[2] : maxs[2];
+		w->trace_ispoint = false;
+		w->trace_extents[0] = -mins[0] > maxs[0] ? -mins[0] : maxs[0];
+		w->trace_extents[1] = -mins[1] > maxs[1] ? -mins[1] : maxs[1];
+		w->trace_extents[2] = -mins[2] > maxs[2] ? -mins[2] : maxs[2];
 	}
 
 	// general sweeping through world
-	CM_RecursiveHullCheck (headnode, 0, 1, start, end);
+	if (cm_flatnodes->value)
+		CM_FlatHullCheck (w, headnode, start, end);
+	else CM_RecursiveHullCheck (w, headnode, 0, 1, start, end);
 
-	if (trace_trace.fraction == 1)
+	if (w->trace_trace.fraction == 1)
 	{
-		VectorCopy (end, trace_trace.endpos);
+		VectorCopy (end, w->trace_trace.endpos);
 	}
 	else
 	{
 		for (i = 0; i < 3; i++)
-			trace_trace.endpos[i] = start[i] + trace_trace.fraction * (end[i] - start[i]);
+			w->trace_trace.endpos[i] = start[i] + w->trace_trace.fraction * (end[i] - start[i]);
 	}
-	return trace_trace;
+	return w->trace_trace;
 }
 
 
@@ -1456,7 +2208,7 @@ trace_t		CM_TransformedBoxTrace (vec3_t start, vec3_t end,
 	VectorSubtract (end, origin, end_l);
 
 	// rotate start and end into the models frame of reference
-	if (headnode != box_headnode &&
+	if (headnode != CM_World ()->box_headnode &&
 		(angles[0] || angles[1] || angles[2]))
 		rotated = true;
 	else
@@ -1518,16 +2270,16 @@ PVS / PHS
 CM_DecompressVis
 ===================
 */
-void CM_DecompressVis (byte *in, byte *out)
+static void CM_DecompressVis (cmap_t *map, byte *in, byte *out)
 {
 	int		c;
 	byte	*out_p;
 	int		row;
 
-	row = (numclusters + 7) >> 3;
+	row = (map->numclusters + 7) >> 3;
 	out_p = out;
 
-	if (!in || !numvisibility)
+	if (!in || !map->numvisibility)
 	{
 		// no vis info, so make all visible
 		while (row)
@@ -1561,25 +2313,32 @@ void CM_DecompressVis (byte *in, byte *out)
 	} while (out_p - out < row);
 }
 
-byte	pvsrow[MAX_MAP_LEAFS / 8];
-byte	phsrow[MAX_MAP_LEAFS / 8];
-
 byte *CM_ClusterPVS (int cluster)
 {
+	cmodel_world_t *w = CM_World ();
+	cmap_t	*map = w->map;
+
 	if (cluster == -1)
-		memset (pvsrow, 0, (numclusters + 7) >> 3);
+		memset (w->pvsrow, 0, (map->numclusters + 7) >> 3);
+	else if (!map->numvisibility)
+		CM_DecompressVis (map, NULL, w->pvsrow);
 	else
-		CM_DecompressVis (map_visibility + map_vis->bitofs[cluster][DVIS_PVS], pvsrow);
-	return pvsrow;
+		CM_DecompressVis (map, map->visibility + map->vis->bitofs[cluster][DVIS_PVS], w->pvsrow);
+	return w->pvsrow;
 }
 
 byte *CM_ClusterPHS (int cluster)
 {
+	cmodel_world_t *w = CM_World ();
+	cmap_t	*map = w->map;
+
 	if (cluster == -1)
-		memset (phsrow, 0, (numclusters + 7) >> 3);
+		memset (w->phsrow, 0, (map->numclusters + 7) >> 3);
+	else if (!map->numvisibility)
+		CM_DecompressVis (map, NULL, w->phsrow);
 	else
-		CM_DecompressVis (map_visibility + map_vis->bitofs[cluster][DVIS_PHS], phsrow);
-	return phsrow;
+		CM_DecompressVis (map, map->visibility + map->vis->bitofs[cluster][DVIS_PHS], w->phsrow);
+	return w->phsrow;
 }
 
 
@@ -1591,25 +2350,27 @@ AREAPORTALS
 ===============================================================================
 */
 
-void FloodArea_r (carea_t *area, int floodnum)
+static void FloodArea_r (cmodel_world_t *w, int areanum, int floodnum)
 {
 	int		i;
 	dareaportal_t	*p;
+	carea_t	*area = &w->map->areas[areanum];
+	careaflood_t *flood = &w->areaflood[areanum];
 
-	if (area->floodvalid == floodvalid)
+	if (flood->floodvalid == w->floodvalid)
 	{
-		if (area->floodnum == floodnum)
+		if (flood->floodnum == floodnum)
 			return;
 		Com_Error (ERR_DROP, "FloodArea_r: reflooded");
 	}
 
-	area->floodnum = floodnum;
-	area->floodvalid = floodvalid;
-	p = &map_areaportals[area->firstareaportal];
+	flood->floodnum = floodnum;
+	flood->floodvalid = w->floodvalid;
+	p = &w->map->areaportals[area->firstareaportal];
 	for (i = 0; i < area->numareaportals; i++, p++)
 	{
-		if (portalopen[p->portalnum])
-			FloodArea_r (&map_areas[p->otherarea], floodnum);
+		if (w->portalopen[p->portalnum])
+			FloodArea_r (w, p->otherarea, floodnum);
 	}
 }
 
@@ -1620,46 +2381,48 @@ FloodAreaConnections
 
 ====================
 */
-void FloodAreaConnections (void)
+static void FloodAreaConnections (cmodel_world_t *w)
 {
 	int		i;
-	carea_t	*area;
 	int		floodnum;
 
 	// all current floods are now invalid
-	floodvalid++;
+	w->floodvalid++;
 	floodnum = 0;
 
 	// area 0 is not used
-	for (i = 1; i < numareas; i++)
+	for (i = 1; i < w->map->numareas; i++)
 	{
-		area = &map_areas[i];
-		if (area->floodvalid == floodvalid)
+		if (w->areaflood[i].floodvalid == w->floodvalid)
 			continue;		// already flooded into
 		floodnum++;
-		FloodArea_r (area, floodnum);
+		FloodArea_r (w, i, floodnum);
 	}
 
 }
 
 void CM_SetAreaPortalState (int portalnum, qboolean open)
 {
-	if (portalnum > numareaportals)
+	cmodel_world_t *w = CM_World ();
+
+	if (portalnum > w->map->numareaportals)
 		Com_Error (ERR_DROP, "areaportal > numareaportals");
 
-	portalopen[portalnum] = open;
-	FloodAreaConnections ();
+	w->portalopen[portalnum] = open;
+	FloodAreaConnections (w);
 }
 
 qboolean	CM_AreasConnected (int area1, int area2)
 {
+	cmodel_world_t *w = CM_World ();
+
 	if (map_noareas->value)
 		return true;
 
-	if (area1 > numareas || area2 > numareas)
+	if (area1 > w->map->numareas || area2 > w->map->numareas)
 		Com_Error (ERR_DROP, "area > numareas");
 
-	if (map_areas[area1].floodnum == map_areas[area2].floodnum)
+	if (w->areaflood[area1].floodnum == w->areaflood[area2].floodnum)
 		return true;
 	return false;
 }
@@ -1677,11 +2440,12 @@ This is used by the client refreshes to cull visibility
 */
 int CM_WriteAreaBits (byte *buffer, int area)
 {
+	cmodel_world_t *w = CM_World ();
 	int		i;
 	int		floodnum;
 	int		bytes;
 
-	bytes = (numareas + 7) >> 3;
+	bytes = (w->map->numareas + 7) >> 3;
 
 	if (map_noareas->value)
 	{
@@ -1692,10 +2456,10 @@ int CM_WriteAreaBits (byte *buffer, int area)
 	{
 		memset (buffer, 0, bytes);
 
-		floodnum = map_areas[area].floodnum;
-		for (i = 0; i < numareas; i++)
+		floodnum = w->areaflood[area].floodnum;
+		for (i = 0; i < w->map->numareas; i++)
 		{
-			if (map_areas[i].floodnum == floodnum || !area)
+			if (w->areaflood[i].floodnum == floodnum || !area)
 				buffer[i >> 3] |= 1 << (i & 7);
 		}
 	}
@@ -1713,7 +2477,9 @@ Writes the portal state to a savegame file
 */
 void CM_WritePortalState (FILE *f)
 {
-	fwrite (portalopen, sizeof (portalopen), 1, f);
+	cmodel_world_t *w = CM_World ();
+
+	fwrite (w->portalopen, sizeof (w->portalopen), 1, f);
 }
 
 /*
@@ -1726,8 +2492,10 @@ and recalculates the area connections
 */
 void CM_ReadPortalState (FILE *f)
 {
-	FS_Read (portalopen, sizeof (portalopen), f);
-	FloodAreaConnections ();
+	cmodel_world_t *w = CM_World ();
+
+	FS_Read (w->portalopen, sizeof (w->portalopen), f);
+	FloodAreaConnections (w);
 }
 
 /*
@@ -1738,7 +2506,7 @@ Returns true if any leaf under headnode has a cluster that
 is potentially visible
 =============
 */
-qboolean CM_HeadnodeVisible (int nodenum, byte *visbits)
+static qboolean CM_HeadnodeVisible_r (cmap_t *map, int nodenum, byte *visbits)
 {
 	int		leafnum;
 	int		cluster;
@@ -1747,7 +2515,7 @@ qboolean CM_HeadnodeVisible (int nodenum, byte *visbits)
 	if (nodenum < 0)
 	{
 		leafnum = -1 - nodenum;
-		cluster = map_leafs[leafnum].cluster;
+		cluster = map->leafs[leafnum].cluster;
 		if (cluster == -1)
 			return false;
 		if (visbits[cluster >> 3] & (1 << (cluster & 7)))
@@ -1755,9 +2523,331 @@ qboolean CM_HeadnodeVisible (int nodenum, byte *visbits)
 		return false;
 	}
 
-	node = &map_nodes[nodenum];
-	if (CM_HeadnodeVisible (node->children[0], visbits))
+	node = &map->nodes[nodenum];
+	if (CM_HeadnodeVisible_r (map, node->children[0], visbits))
 		return true;
-	return CM_HeadnodeVisible (node->children[1], visbits);
+	return CM_HeadnodeVisible_r (map, node->children[1], visbits);
+}
+
+static qboolean CM_FlatHeadnodeVisible (cmodel_world_t *w, int headnode, byte *visbits)
+{
+	int			stack[CM_MAXDEPTH];
+	int			sp = 0;
+	int			nodenum;
+	int			cluster;
+	cfnode_t	*nodes = CM_FlatHeadnode (w, headnode, &nodenum);
+
+	while (1)
+	{
+		if (nodenum < 0)
+		{
+			cluster = CM_Leaf (w, -1 - nodenum)->cluster;
+			if (cluster != -1 && (visbits[cluster >> 3] & (1 << (cluster & 7))))
+				return true;
+
+			if (!sp) return false;
+			nodenum = stack[--sp];
+		}
+		else
+		{
+			stack[sp++] = nodes[nodenum].children[1];
+			nodenum = nodes[nodenum].children[0];
+		}
+	}
+}
+
+qboolean CM_HeadnodeVisible (int nodenum, byte *visbits)
+{
+	cmodel_world_t *w = CM_World ();
+
+	if (cm_flatnodes->value)
+		return CM_FlatHeadnodeVisible (w, nodenum, visbits);
+	else return CM_HeadnodeVisible_r (w->map, nodenum, visbits);
+}
+
+
+/*
+===============================================================================
+
+BENCHMARK
+
+===============================================================================
+*/
+
+#define CMBENCH_PASSES	5
+
+static unsigned cmbench_seed;
+
+static float CM_BenchRandom (float lo, float hi)
+{
+	cmbench_seed = cmbench_seed * 1103515245 + 12345;
+	return lo + (hi - lo) * (float) ((cmbench_seed >> 8) & 0xffff) / 65535.0f;
+}
+
+
+/*
+=============
+CM_Bench_f
+
+Times point leaf lookups and traces through the current map (1000000 lookups and a tenth as many traces unless
+another count is given) over both the bsp node tree and the flattened nodes, and checks that both give the same
+results
+=============
+*/
+void CM_Bench_f (void)
+{
+	cmodel_world_t *w = CM_World ();
+	cmap_t		*map = w->map;
+	int			numpoints = (Cmd_Argc () > 1) ? atoi (Cmd_Argv (1)) : 1000000;
+	int			numtraces;
+	int			mode, pass, i, j;
+	int			pointtime[2] = {0, 0}, tracetime[2] = {0, 0};
+	int			mismatches = 0;
+	float		oldflat = cm_flatnodes->value;
+	vec3_t		*points, *ends;
+	int			*leafs[2];
+	trace_t		*traces[2];
+	vec3_t		playermins = {-16, -16, -24}, playermaxs = {16, 16, 32};
+	vec3_t		pointmins = {0, 0, 0}, pointmaxs = {0, 0, 0};
+
+	if (!map->numnodes)
+	{
+		Com_Printf ("cmbench: no map loaded\n");
+		return;
+	}
+
+	if (numpoints < 10)
+	{
+		Com_Printf ("usage: cmbench [numpoints]\n");
+		return;
+	}
+
+	numtraces = numpoints / 10;
+
+	points = (vec3_t *) Zone_Alloc (numpoints * sizeof (vec3_t));
+	ends = (vec3_t *) Zone_Alloc (numtraces * sizeof (vec3_t));
+
+	for (i = 0; i < 2; i++)
+	{
+		leafs[i] = (int *) Zone_Alloc (numpoints * sizeof (int));
+		traces[i] = (trace_t *) Zone_Alloc (numtraces * sizeof (trace_t));
+	}
+
+	// random points inside the world model, and moves from them of up to 1024 units in any direction
+	cmbench_seed = 1;
+
+	for (i = 0; i < numpoints; i++)
+		for (j = 0; j < 3; j++)
+			points[i][j] = CM_BenchRandom (map->cmodels[0].mins[j], map->cmodels[0].maxs[j]);
+
+	for (i = 0; i < numtraces; i++)
+		for (j = 0; j < 3; j++)
+			ends[i][j] = points[i][j] + CM_BenchRandom (-1024, 1024);
+
+	for (pass = 0; pass < CMBENCH_PASSES; pass++)
+	{
+		for (mode = 0; mode < 2; mode++)
+		{
+			int t0, t1, t2;
+
+			Cvar_SetValue ("cm_flatnodes", mode);
+
+			t0 = Sys_Milliseconds ();
+			for (i = 0; i < numpoints; i++) leafs[mode][i] = CM_PointLeafnum (points[i]);
+			t1 = Sys_Milliseconds ();
+
+			// alternate point and player-sized traces
+			for (i = 0; i < numtraces; i++)
+			{
+				if (i & 1)
+					traces[mode][i] = CM_BoxTrace (points[i], ends[i], playermins, playermaxs, 0, MASK_PLAYERSOLID);
+				else traces[mode][i] = CM_BoxTrace (points[i], ends[i], pointmins, pointmaxs, 0, MASK_SHOT);
+			}
+			t2 = Sys_Milliseconds ();
+
+			pointtime[mode] += t1 - t0;
+			tracetime[mode] += t2 - t1;
+		}
+	}
+
+	Cvar_SetValue ("cm_flatnodes", oldflat);
+
+	for (i = 0; i < numpoints; i++)
+		if (leafs[0][i] != leafs[1][i])
+			mismatches++;
+
+	for (i = 0; i < numtraces; i++)
+	{
+		trace_t *t0 = &traces[0][i];
+		trace_t *t1 = &traces[1][i];
+
+		if (t0->fraction != t1->fraction || t0->allsolid != t1->allsolid || t0->startsolid != t1->startsolid || t0->contents != t1->contents || t0->surface != t1->surface)
+			mismatches++;
+		else if (!VectorCompare (t0->endpos, t1->endpos) || !VectorCompare (t0->plane.normal, t1->plane.normal))
+			mismatches++;
+	}
+
+	Com_Printf ("%s: %i nodes, depth %i; %i point lookups and %i traces, %i passes\n", map->name, map->numnodes, map->maxdepth, numpoints, numtraces, CMBENCH_PASSES);
+	Com_Printf ("node tree: %5i ms points, %5i ms traces\n", pointtime[0], tracetime[0]);
+	Com_Printf ("flattened: %5i ms points, %5i ms traces\n", pointtime[1], tracetime[1]);
+	Com_Printf ("%i mismatches\n", mismatches);
+
+	for (i = 0; i < 2; i++)
+	{
+		Zone_Free (traces[i]);
+		Zone_Free (leafs[i]);
+	}
+
+	Zone_Free (ends);
+	Zone_Free (points);
+}
+
+
+/*
+=============
+CM_CheckBSPHeader
+
+returns why a bsp file in memory can't be parsed, or NULL if its header and lump bounds are good; the lump
+contents are still checked by the loaders
+=============
+*/
+static char *CM_CheckBSPHeader (unsigned *buf, int length)
+{
+	dheader_t	header;
+	int			i;
+
+	if (length < (int) sizeof (dheader_t))
+		return "too short for a bsp header";
+
+	header = *(dheader_t *) buf;
+	LittleLongArray (&header, sizeof (dheader_t) / 4);
+
+	if (header.ident != IDBSPHEADER)
+		return "not a bsp file";
+
+	if (header.version != BSPVERSION)
+		return va ("wrong version number (%i should be %i)", header.version, BSPVERSION);
+
+	for (i = 0; i < HEADER_LUMPS; i++)
+	{
+		lump_t *l = &header.lumps[i];
+
+		// compared against what's left after the offset so that a huge length can't wrap around
+		if (l->fileofs < 0 || l->filelen < 0 || l->fileofs > length || l->filelen > length - l->fileofs)
+			return va ("lump %i is out of bounds", i);
+	}
+
+	return NULL;
+}
+
+
+// a run that was dropped out of by a bad lump leaves these to be freed by the next one
+static unsigned	*cm_benchfile = NULL;
+static unsigned	*cm_benchscratch = NULL;
+
+
+static void CM_FreeLoadBench (void)
+{
+	if (cm_benchscratch) Zone_Free (cm_benchscratch);
+	if (cm_benchfile) FS_FreeFile (cm_benchfile);
+
+	cm_benchscratch = NULL;
+	cm_benchfile = NULL;
+}
+
+
+/*
+=============
+CM_LoadBench_f
+
+Times building a map's collision data from a copy of the bsp already in memory (20 times unless another count
+is given), so that the file read doesn't swamp the lump loaders
+=============
+*/
+void CM_LoadBench_f (void)
+{
+	char		name[MAX_QPATH];
+	int			count = (Cmd_Argc () > 2) ? atoi (Cmd_Argv (2)) : 20;
+	unsigned	*file, *scratch;
+	int			length, i;
+	double		total = 0, best = 0;
+	char		*error;
+
+	if (Cmd_Argc () < 2)
+	{
+		Com_Printf ("usage: cmloadbench <map> [count]\n");
+		return;
+	}
+
+	// a bare map name is looked for in maps/
+	if (strchr (Cmd_Argv (1), '/'))
+		Com_sprintf (name, sizeof (name), "%s", Cmd_Argv (1));
+	else Com_sprintf (name, sizeof (name), "maps/%s.bsp", Cmd_Argv (1));
+
+	CM_FreeLoadBench ();
+
+	if ((length = FS_LoadFile (name, (void **) &file)) == -1 || !file)
+	{
+		Com_Printf ("cmloadbench: couldn't load %s\n", name);
+		return;
+	}
+
+	// anything the user names is timed so catch what would otherwise drop the game
+	if ((error = CM_CheckBSPHeader (file, length)) != NULL)
+	{
+		Com_Printf ("cmloadbench: %s: %s\n", name, error);
+		FS_FreeFile (file);
+		return;
+	}
+
+	if (count < 1) count = 1;
+
+	cm_benchfile = file;
+	cm_benchscratch = scratch = (unsigned *) Zone_Alloc (length);
+
+	for (i = 0; i < count; i++)
+	{
+		double t;
+
+		// the lumps are swapped in place on big endian hosts so every pass starts from a clean copy
+		memcpy (scratch, file, length);
+
+		t = Sys_Microseconds ();
+		CMod_ParseBSP (name, scratch, length);
+		t = Sys_Microseconds () - t;
+
+		// never went on the list of maps
+		CM_FreeMap (cm_loadingmap);
+		cm_loadingmap = NULL;
+
+		total += t;
+
+		if (!i || t < best)
+			best = t;
+	}
+
+	Com_Printf ("%s: %i kb, %i loads, %0.3f ms average, %0.3f ms best, %s endian\n", name, length >> 10, count, total * 0.001 / count, best * 0.001, Q_BIGENDIAN ? "big" : "little");
+
+	CM_FreeLoadBench ();
 }
 
+
+void CM_Init (void)
+{
+#ifdef _WIN32
+	InitializeCriticalSection (&cm_mapslock);
+#endif
+
+	// one leaf, area, cluster and model with everything else empty
+	cm_nullmap.numleafs = 1;
+	cm_nullmap.leafs = &cm_nullleaf;
+	cm_nullmap.numareas = 1;
+	cm_nullmap.areas = &cm_nullarea;
+	cm_nullmap.numclusters = 1;
+	cm_nullmap.numcmodels = 1;
+	cm_nullmap.cmodels = &cm_nullcmodel;
+
+	cm_flatnodes = Cvar_Get ("cm_flatnodes", "1", 0, NULL);
+	Cmd_AddCommand ("cmbench", CM_Bench_f);
+	Cmd_AddCommand ("cmloadbench", CM_LoadBench_f);
+}
@@ -459,6 +459,7 @@ Can delta from either a baseline or a previous packet_entity
 void MSG_WriteDeltaEntity (entity_state_t *from, entity_state_t *to, sizebuf_t *msg, qboolean force, qboolean newentity)
 {
 	int		bits;
+	msgcursor_t	c;
 
 	if (!to->number)
 		Com_Error (ERR_FATAL, "Unset entity number");
@@ -558,94 +559,263 @@ void MSG_WriteDeltaEntity (entity_state_t *from, entity_state_t *to, sizebuf_t *
 	else if (bits & 0x0000ff00)
 		bits |= U_MOREBITS1;
 
-	MSG_WriteByte (msg, bits & 255);
+	MSG_BeginWriteCursor (&c, msg, MSG_MAX_DELTAENTITY);
+
+	MSG_PutByte (&c, bits & 255);
 
 	if (bits & 0xff000000)
 	{
-		MSG_WriteByte (msg, (bits >> 8) & 255);
-		MSG_WriteByte (msg, (bits >> 16) & 255);
-		MSG_WriteByte (msg, (bits >> 24) & 255);
+		MSG_PutByte (&c, (bits >> 8) & 255);
+		MSG_PutByte (&c, (bits >> 16) & 255);
+		MSG_PutByte (&c, (bits >> 24) & 255);
 	}
 	else if (bits & 0x00ff0000)
 	{
-		MSG_WriteByte (msg, (bits >> 8) & 255);
-		MSG_WriteByte (msg, (bits >> 16) & 255);
+		MSG_PutByte (&c, (bits >> 8) & 255);
+		MSG_PutByte (&c, (bits >> 16) & 255);
 	}
 	else if (bits & 0x0000ff00)
 	{
-		MSG_WriteByte (msg, (bits >> 8) & 255);
+		MSG_PutByte (&c, (bits >> 8) & 255);
 	}
 
 	//----------
 
 	if (bits & U_NUMBER16)
-		MSG_WriteShort (msg, to->number);
+		MSG_PutShort (&c, to->number);
 	else
-		MSG_WriteByte (msg, to->number);
+		MSG_PutByte (&c, to->number);
 
 	if (bits & U_MODEL)
-		MSG_WriteByte (msg, to->modelindex);
+		MSG_PutByte (&c, to->modelindex);
 	if (bits & U_MODEL2)
-		MSG_WriteByte (msg, to->modelindex2);
+		MSG_PutByte (&c, to->modelindex2);
 	if (bits & U_MODEL3)
-		MSG_WriteByte (msg, to->modelindex3);
+		MSG_PutByte (&c, to->modelindex3);
 	if (bits & U_MODEL4)
-		MSG_WriteByte (msg, to->modelindex4);
+		MSG_PutByte (&c, to->modelindex4);
 
 	if (bits & U_FRAME8)
-		MSG_WriteByte (msg, to->frame);
+		MSG_PutByte (&c, to->frame);
 	if (bits & U_FRAME16)
-		MSG_WriteShort (msg, to->frame);
+		MSG_PutShort (&c, to->frame);
 
 	if ((bits & U_SKIN8) && (bits & U_SKIN16))		//used for laser colors
-		MSG_WriteLong (msg, to->skinnum);
+		MSG_PutLong (&c, to->skinnum);
 	else if (bits & U_SKIN8)
-		MSG_WriteByte (msg, to->skinnum);
+		MSG_PutByte (&c, to->skinnum);
 	else if (bits & U_SKIN16)
-		MSG_WriteShort (msg, to->skinnum);
+		MSG_PutShort (&c, to->skinnum);
 
 
 	if ((bits & (U_EFFECTS8 | U_EFFECTS16)) == (U_EFFECTS8 | U_EFFECTS16))
-		MSG_WriteLong (msg, to->effects);
+		MSG_PutLong (&c, to->effects);
 	else if (bits & U_EFFECTS8)
-		MSG_WriteByte (msg, to->effects);
+		MSG_PutByte (&c, to->effects);
 	else if (bits & U_EFFECTS16)
-		MSG_WriteShort (msg, to->effects);
+		MSG_PutShort (&c, to->effects);
 
 	if ((bits & (U_RENDERFX8 | U_RENDERFX16)) == (U_RENDERFX8 | U_RENDERFX16))
-		MSG_WriteLong (msg, to->renderfx);
+		MSG_PutLong (&c, to->renderfx);
 	else if (bits & U_RENDERFX8)
-		MSG_WriteByte (msg, to->renderfx);
+		MSG_PutByte (&c, to->renderfx);
 	else if (bits & U_RENDERFX16)
-		MSG_WriteShort (msg, to->renderfx);
+		MSG_PutShort (&c, to->renderfx);
 
 	if (bits & U_ORIGIN1)
-		MSG_WriteCoord (msg, to->origin[0]);
+		MSG_PutCoord (&c, to->origin[0]);
 	if (bits & U_ORIGIN2)
-		MSG_WriteCoord (msg, to->origin[1]);
+		MSG_PutCoord (&c, to->origin[1]);
 	if (bits & U_ORIGIN3)
-		MSG_WriteCoord (msg, to->origin[2]);
+		MSG_PutCoord (&c, to->origin[2]);
 
 	if (bits & U_ANGLE1)
-		MSG_WriteAngle (msg, to->angles[0]);
+		MSG_PutAngle (&c, to->angles[0]);
 	if (bits & U_ANGLE2)
-		MSG_WriteAngle (msg, to->angles[1]);
+		MSG_PutAngle (&c, to->angles[1]);
 	if (bits & U_ANGLE3)
-		MSG_WriteAngle (msg, to->angles[2]);
+		MSG_PutAngle (&c, to->angles[2]);
 
 	if (bits & U_OLDORIGIN)
 	{
-		MSG_WriteCoord (msg, to->old_origin[0]);
-		MSG_WriteCoord (msg, to->old_origin[1]);
-		MSG_WriteCoord (msg, to->old_origin[2]);
+		MSG_PutCoord (&c, to->old_origin[0]);
+		MSG_PutCoord (&c, to->old_origin[1]);
+		MSG_PutCoord (&c, to->old_origin[2]);
 	}
 
 	if (bits & U_SOUND)
-		MSG_WriteByte (msg, to->sound);
+		MSG_PutByte (&c, to->sound);
 	if (bits & U_EVENT)
-		MSG_WriteByte (msg, to->event);
+		MSG_PutByte (&c, to->event);
 	if (bits & U_SOLID)
-		MSG_WriteShort (msg, to->solid);
+		MSG_PutShort (&c, to->solid);
+
+	MSG_EndWriteCursor (&c, msg);
+}
+
+
+/*
+==================
+MSG_WriteDeltaPlayerstate
+
+Writes the body of an svc_playerinfo; the stats are always sent as a delta
+==================
+*/
+void MSG_WriteDeltaPlayerstate (player_state_t *ops, player_state_t *ps, sizebuf_t *msg)
+{
+	int				i;
+	int				pflags;
+	int				statbits;
+	msgcursor_t		c;
+
+	// determine what needs to be sent
+	pflags = 0;
+
+	if (ps->pmove.pm_type != ops->pmove.pm_type)
+		pflags |= PS_M_TYPE;
+
+	if (ps->pmove.origin[0] != ops->pmove.origin[0] || ps->pmove.origin[1] != ops->pmove.origin[1] || ps->pmove.origin[2] != ops->pmove.origin[2])
+		pflags |= PS_M_ORIGIN;
+
+	if (ps->pmove.velocity[0] != ops->pmove.velocity[0] || ps->pmove.velocity[1] != ops->pmove.velocity[1] || ps->pmove.velocity[2] != ops->pmove.velocity[2])
+		pflags |= PS_M_VELOCITY;
+
+	if (ps->pmove.pm_time != ops->pmove.pm_time)
+		pflags |= PS_M_TIME;
+
+	if (ps->pmove.pm_flags != ops->pmove.pm_flags)
+		pflags |= PS_M_FLAGS;
+
+	if (ps->pmove.gravity != ops->pmove.gravity)
+		pflags |= PS_M_GRAVITY;
+
+	if (ps->pmove.delta_angles[0] != ops->pmove.delta_angles[0] || ps->pmove.delta_angles[1] != ops->pmove.delta_angles[1] || ps->pmove.delta_angles[2] != ops->pmove.delta_angles[2])
+		pflags |= PS_M_DELTA_ANGLES;
+
+
+	if (ps->viewoffset[0] != ops->viewoffset[0] || ps->viewoffset[1] != ops->viewoffset[1] || ps->viewoffset[2] != ops->viewoffset[2])
+		pflags |= PS_VIEWOFFSET;
+
+	if (ps->viewangles[0] != ops->viewangles[0] || ps->viewangles[1] != ops->viewangles[1] || ps->viewangles[2] != ops->viewangles[2])
+		pflags |= PS_VIEWANGLES;
+
+	if (ps->kick_angles[0] != ops->kick_angles[0] || ps->kick_angles[1] != ops->kick_angles[1] || ps->kick_angles[2] != ops->kick_angles[2])
+		pflags |= PS_KICKANGLES;
+
+	if (ps->blend[0] != ops->blend[0] || ps->blend[1] != ops->blend[1] || ps->blend[2] != ops->blend[2] || ps->blend[3] != ops->blend[3])
+		pflags |= PS_BLEND;
+
+	if (ps->fov != ops->fov)
+		pflags |= PS_FOV;
+
+	if (ps->rdflags != ops->rdflags)
+		pflags |= PS_RDFLAGS;
+
+	if (ps->gunframe != ops->gunframe)
+		pflags |= PS_WEAPONFRAME;
+
+	pflags |= PS_WEAPONINDEX;
+
+	// write it
+	MSG_BeginWriteCursor (&c, msg, MSG_MAX_PLAYERSTATE);
+
+	MSG_PutShort (&c, pflags);
+
+	// write the pmove_state_t
+	if (pflags & PS_M_TYPE)
+		MSG_PutByte (&c, ps->pmove.pm_type);
+
+	if (pflags & PS_M_ORIGIN)
+	{
+		MSG_PutShort (&c, ps->pmove.origin[0]);
+		MSG_PutShort (&c, ps->pmove.origin[1]);
+		MSG_PutShort (&c, ps->pmove.origin[2]);
+	}
+
+	if (pflags & PS_M_VELOCITY)
+	{
+		MSG_PutShort (&c, ps->pmove.velocity[0]);
+		MSG_PutShort (&c, ps->pmove.velocity[1]);
+		MSG_PutShort (&c, ps->pmove.velocity[2]);
+	}
+
+	if (pflags & PS_M_TIME)
+		MSG_PutByte (&c, ps->pmove.pm_time);
+
+	if (pflags & PS_M_FLAGS)
+		MSG_PutByte (&c, ps->pmove.pm_flags);
+
+	if (pflags & PS_M_GRAVITY)
+		MSG_PutShort (&c, ps->pmove.gravity);
+
+	if (pflags & PS_M_DELTA_ANGLES)
+	{
+		MSG_PutShort (&c, ps->pmove.delta_angles[0]);
+		MSG_PutShort (&c, ps->pmove.delta_angles[1]);
+		MSG_PutShort (&c, ps->pmove.delta_angles[2]);
+	}
+
+	// write the rest of the player_state_t
+	if (pflags & PS_VIEWOFFSET)
+	{
+		MSG_PutChar (&c, ps->viewoffset[0] * 4);
+		MSG_PutChar (&c, ps->viewoffset[1] * 4);
+		MSG_PutChar (&c, ps->viewoffset[2] * 4);
+	}
+
+	if (pflags & PS_VIEWANGLES)
+	{
+		MSG_PutAngle16 (&c, ps->viewangles[0]);
+		MSG_PutAngle16 (&c, ps->viewangles[1]);
+		MSG_PutAngle16 (&c, ps->viewangles[2]);
+	}
+
+	if (pflags & PS_KICKANGLES)
+	{
+		MSG_PutChar (&c, ps->kick_angles[0] * 4);
+		MSG_PutChar (&c, ps->kick_angles[1] * 4);
+		MSG_PutChar (&c, ps->kick_angles[2] * 4);
+	}
+
+	if (pflags & PS_WEAPONINDEX)
+	{
+		MSG_PutByte (&c, ps->gunindex);
+	}
+
+	if (pflags & PS_WEAPONFRAME)
+	{
+		MSG_PutByte (&c, ps->gunframe);
+		MSG_PutChar (&c, ps->gunoffset[0] * 4);
+		MSG_PutChar (&c, ps->gunoffset[1] * 4);
+		MSG_PutChar (&c, ps->gunoffset[2] * 4);
+		MSG_PutChar (&c, ps->gunangles[0] * 4);
+		MSG_PutChar (&c, ps->gunangles[1] * 4);
+		MSG_PutChar (&c, ps->gunangles[2] * 4);
+	}
+
+	if (pflags & PS_BLEND)
+	{
+		MSG_PutByte (&c, ps->blend[0] * 255);
+		MSG_PutByte (&c, ps->blend[1] * 255);
+		MSG_PutByte (&c, ps->blend[2] * 255);
+		MSG_PutByte (&c, ps->blend[3] * 255);
+	}
+	if (pflags & PS_FOV)
+		MSG_PutByte (&c, ps->fov);
+	if (pflags & PS_RDFLAGS)
+		MSG_PutByte (&c, ps->rdflags);
+
+	// send stats
+	statbits = 0;
+	for (i = 0; i < MAX_STATS; i++)
+		if (ps->stats[i] != ops->stats[i])
+			statbits |= 1 << i;
+	MSG_PutLong (&c, statbits);
+	for (i = 0; i < MAX_STATS; i++)
+		if (statbits & (1 << i))
+			MSG_PutShort (&c, ps->stats[i]);
+
+	MSG_EndWriteCursor (&c, msg);
 }
 
 
@@ -1258,6 +1428,134 @@ void Com_Error_f (void)
 }
 
 
+/*
+=============
+Com_IndexBench_f
+
+Registers a synthetic precache list (5000 assets unless another count is given) twice, as happens over a map
+change, once with the linear strcmp scans the registries used to do and once through a name index, and checks
+that both put every asset in the same slot
+=============
+*/
+#define INDEXBENCH_PASSES	10
+
+static int Com_IndexBenchLinear (char (*registry)[MAX_QPATH], int *numregistered, char *name)
+{
+	int i;
+
+	// see if already registered
+	for (i = 0; i < *numregistered; i++)
+		if (!strcmp (registry[i], name))
+			return i;
+
+	// find a free slot
+	for (i = 0; i < *numregistered; i++)
+		if (!registry[i][0])
+			break;
+
+	if (i == *numregistered)
+		(*numregistered)++;
+
+	strcpy (registry[i], name);
+	return i;
+}
+
+
+static int Com_IndexBenchHashed (char (*registry)[MAX_QPATH], nameindex_t *ni, char *name)
+{
+	int i;
+
+	// see if already registered
+	for (i = NameIndex_Find (ni, name); i != -1; i = NameIndex_FindNext (ni, i))
+		if (!strcmp (registry[i], name))
+			return i;
+
+	// find a free slot
+	if ((i = NameIndex_Alloc (ni, name)) != -1)
+		strcpy (registry[i], name);
+
+	return i;
+}
+
+
+void Com_IndexBench_f (void)
+{
+	static char *prefixes[] = {"models/bench/asset%i/tris.md2", "sound/bench/asset%i.wav", "textures/bench/asset%i.wal", "pics/bench/asset%i.pcx"};
+	int numassets = (Cmd_Argc () > 1) ? atoi (Cmd_Argv (1)) : 5000;
+	char (*list)[MAX_QPATH];
+	char (*registry)[MAX_QPATH];
+	int *linearslots, *hashedslots;
+	int numregistered;
+	nameindex_t ni;
+	int i, pass, mismatches;
+	int linear[2] = {0, 0}, hashed[2] = {0, 0};
+
+	if (numassets < 1)
+	{
+		Com_Printf ("usage: indexbench [numassets]\n");
+		return;
+	}
+
+	list = Zone_Alloc (numassets * MAX_QPATH);
+	registry = Zone_Alloc (numassets * MAX_QPATH);
+	linearslots = Zone_Alloc (numassets * sizeof (int));
+	hashedslots = Zone_Alloc (numassets * sizeof (int));
+
+	ni.numslots = numassets;
+	ni.storage = Zone_Alloc (NAMEINDEX_STORAGE (numassets) * sizeof (int));
+
+	// precache lists mix models, sounds and images, and names within a type share long common prefixes
+	for (i = 0; i < numassets; i++)
+		Com_sprintf (list[i], MAX_QPATH, prefixes[i & 3], i >> 2);
+
+	for (pass = 0; pass < INDEXBENCH_PASSES; pass++)
+	{
+		int t0, t1, t2;
+
+		// linear scans; the first registration is all misses and the second all hits
+		memset (registry, 0, numassets * MAX_QPATH);
+		numregistered = 0;
+
+		t0 = Sys_Milliseconds ();
+		for (i = 0; i < numassets; i++) linearslots[i] = Com_IndexBenchLinear (registry, &numregistered, list[i]);
+		t1 = Sys_Milliseconds ();
+		for (i = 0; i < numassets; i++) Com_IndexBenchLinear (registry, &numregistered, list[i]);
+		t2 = Sys_Milliseconds ();
+
+		linear[0] += t1 - t0;
+		linear[1] += t2 - t1;
+
+		// name index
+		memset (registry, 0, numassets * MAX_QPATH);
+		NameIndex_Clear (&ni);
+
+		t0 = Sys_Milliseconds ();
+		for (i = 0; i < numassets; i++) hashedslots[i] = Com_IndexBenchHashed (registry, &ni, list[i]);
+		t1 = Sys_Milliseconds ();
+		for (i = 0; i < numassets; i++) Com_IndexBenchHashed (registry, &ni, list[i]);
+		t2 = Sys_Milliseconds ();
+
+		hashed[0] += t1 - t0;
+		hashed[1] += t2 - t1;
+	}
+
+	for (i = 0, mismatches = 0; i < numassets; i++)
+		if (linearslots[i] != hashedslots[i])
+			mismatches++;
+
+	Com_Printf ("%i assets, %i passes\n", numassets, INDEXBENCH_PASSES);
+	Com_Printf ("linear : %5i ms register, %5i ms re-register\n", linear[0], linear[1]);
+	Com_Printf ("indexed: %5i ms register, %5i ms re-register\n", hashed[0], hashed[1]);
+	Com_Printf ("%i slot mismatches\n", mismatches);
+
+	Zone_Free (ni.storage);
+	Zone_Free (hashedslots);
+	Zone_Free (linearslots);
+	Zone_Free (registry);
+	Zone_Free (list);
+}
+
+
 /*
 =================
 Qcommon_Init
@@ -1302,6 +1600,10 @@ void Qcommon_Init (int argc, char **argv)
 
 	// init commands and vars
 	Cmd_AddCommand ("error", Com_Error_f);
+	Cmd_AddCommand ("indexbench", Com_IndexBench_f);
+	Cmd_AddCommand ("zonestats", Z_Stats_f);
+	Load_Init ();
+	CM_Init ();
 
 	developer = Cvar_Get ("developer", "0", 0, NULL);
 	timescale = Cvar_Get ("timescale", "1", CVAR_CHEAT, NULL);
@@ -1358,7 +1660,12 @@ void Qcommon_Frame (int msec)
 	char	*s;
 
 	if (setjmp (abortframe))
+	{
+		// the whole frame is abandoned so no loader can still be using the main thread's load memory,
+		// but one that was dropped out of mid-load (e.g. while building lightmaps) never released its mark
+		Load_FreeMemory ();
 		return;			// an ERR_DROP was thrown
+	}
 
 	if (fixedtime->value)
 		msec = fixedtime->value;
@@ -403,6 +403,44 @@ int FS_LoadFile (char *path, void **buffer)
 }
 
 
+/*
+============
+FS_LoadTempFile
+
+As FS_LoadFile but the file is loaded into load memory for the calling thread, so it's released with the rest of
+the loader's temporary memory rather than by FS_FreeFile.  If it won't fit the buffer is NULL but the length is
+still returned, so the caller can fall back to FS_LoadFile.
+============
+*/
+int FS_LoadTempFile (char *path, void **buffer)
+{
+	FILE	*h;
+	int		len;
+
+	// look for it in the filesystem or pack files
+	if ((len = FS_FOpenFile (path, &h)) == -1 || !h)
+	{
+		*buffer = NULL;
+		return -1;
+	}
+
+	if (!Load_HasRoom (len))
+	{
+		fclose (h);
+		*buffer = NULL;
+		return len;
+	}
+
+	*buffer = Load_AllocMemory (len);
+
+	FS_Read (*buffer, len, h);
+
+	fclose (h);
+
+	return len;
+}
+
+
 /*
 =============
 FS_FreeFile
@@ -719,6 +757,82 @@ char **FS_ListFiles (char *findname, int *numfiles, unsigned musthave, unsigned
 	return list;
 }
 
+/*
+===============
+FS_ListPackFiles
+
+Lists every file in the currently loaded PAKs whose name ends in extension; the same name in more than
+one PAK is only listed once.  The list is NULL-terminated and should be released with FS_FreeFileList.
+===============
+*/
+static int FS_SortFileName (char **n1, char **n2)
+{
+	return strcmp (*n1, *n2);
+}
+
+
+char **FS_ListPackFiles (char *extension, int *numfiles)
+{
+	searchpath_t *s;
+	char **list;
+	int i, nfiles = 0;
+	int extlen = strlen (extension);
+
+	// count an upper bound for the list size
+	for (s = fs_searchpaths; s; s = s->next)
+		if (s->pack)
+			nfiles += s->pack->numfiles;
+
+	// add space for a guard
+	list = Zone_Alloc (sizeof (char *) * (nfiles + 1));
+	nfiles = 0;
+
+	for (s = fs_searchpaths; s; s = s->next)
+	{
+		if (!s->pack) continue;
+
+		for (i = 0; i < s->pack->numfiles; i++)
+		{
+			char *name = s->pack->files[i].name;
+			int len = strlen (name);
+
+			// the PAK files dir was forced to lower-case at load-time
+			if (len > extlen && !stricmp (name + len - extlen, extension))
+				list[nfiles++] = name;
+		}
+	}
+
+	// sort so that names overridden by a later PAK can be collapsed
+	qsort (list, nfiles, sizeof (char *), (sortfunc_t) FS_SortFileName);
+
+	for (i = 0, *numfiles = 0; i < nfiles; i++)
+	{
+		if (*numfiles && !strcmp (list[*numfiles - 1], list[i])) continue;
+		list[(*numfiles)++] = list[i];
+	}
+
+	for (i = 0; i < *numfiles; i++)
+		list[i] = CopyString (list[i]);
+
+	list[*numfiles] = NULL;
+
+	return list;
+}
+
+
+void FS_FreeFileList (char **list)
+{
+	int i;
+
+	if (!list) return;
+
+	for (i = 0; list[i]; i++)
+		Zone_Free (list[i]);
+
+	Zone_Free (list);
+}
+
+
 /*
 ===============
 FS_Dir_f
@@ -247,7 +247,7 @@ void Netchan_Transmit (netchan_t *chan, int length, byte *data)
 
 	// send the qport if we are a client
 	if (chan->sock == NS_CLIENT)
-		MSG_WriteShort (&send, qport->value);
+		MSG_WriteShort (&send, chan->qport);
 
 	// copy the reliable message to the packet first
 	if (send_reliable)
@@ -23,12 +23,14 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "wsipx.h"
 #include "qcommon.h"
 
-#define	MAX_LOOPBACK	4
+// windowed downloads send a burst of chunks in one server frame; must be a power of 2
+#define	MAX_LOOPBACK	16
 
 typedef struct loopmsg_s
 {
 	byte	data[MAX_MSGLEN];
 	int		datalen;
+	int		port;
 } loopmsg_t;
 
 typedef struct loopback_s
@@ -43,6 +45,16 @@ static cvar_t	*noudp;
 static cvar_t	*noipx;
 
 loopback_t	loopbacks[2];
+
+// running totals for profiling, by netsrc_t
+int			net_bytessent[2];
+
+// simulated clients from the load generator each get their own loopport; loopport 0 is the local player.  packets from the
+// server to a port go to that port's queue, and everything sent to the server from any port shares one larger queue
+static loopback_t	*loopports[MAX_LOOPPORTS + 1];
+static loopmsg_t	*looptoserver = NULL;
+static int			looptoserver_size = 0;
+static int			looptoserver_get, looptoserver_send;
 int			ip_sockets[2];
 int			ipx_sockets[2];
 
@@ -106,7 +118,7 @@ qboolean	NET_CompareAdr (netadr_t a, netadr_t b)
 		return false;
 
 	if (a.type == NA_LOOPBACK)
-		return TRUE;
+		return (a.loopport == b.loopport);
 
 	if (a.type == NA_IP)
 	{
@@ -138,8 +150,9 @@ qboolean	NET_CompareBaseAdr (netadr_t a, netadr_t b)
 	if (a.type != b.type)
 		return false;
 
+	// loopback ports are separate endpoints rather than translated ports, so they're always compared
 	if (a.type == NA_LOOPBACK)
-		return TRUE;
+		return (a.loopport == b.loopport);
 
 	if (a.type == NA_IP)
 	{
@@ -163,7 +176,9 @@ char	*NET_AdrToString (netadr_t a)
 {
 	static	char	s[64];
 
-	if (a.type == NA_LOOPBACK)
+	if (a.type == NA_LOOPBACK && a.loopport)
+		Com_sprintf (s, sizeof (s), "loopback:%i", a.loopport);
+	else if (a.type == NA_LOOPBACK)
 		Com_sprintf (s, sizeof (s), "loopback");
 	else if (a.type == NA_IP)
 		Com_sprintf (s, sizeof (s), "%i.%i.%i.%i:%i", a.ip[0], a.ip[1], a.ip[2], a.ip[3], ntohs (a.port));
@@ -318,12 +333,61 @@ qboolean	NET_GetLoopPacket (netsrc_t sock, netadr_t *net_from, sizebuf_t *net_me
 }
 
 
+static qboolean NET_GetLoopPortPacketToServer (netadr_t *net_from, sizebuf_t *net_message)
+{
+	loopmsg_t *msg;
+
+	if (!looptoserver)
+		return false;
+
+	if (looptoserver_send - looptoserver_get > looptoserver_size)
+		looptoserver_get = looptoserver_send - looptoserver_size;
+
+	if (looptoserver_get >= looptoserver_send)
+		return false;
+
+	msg = &looptoserver[looptoserver_get & (looptoserver_size - 1)];
+	looptoserver_get++;
+
+	memcpy (net_message->data, msg->data, msg->datalen);
+	net_message->cursize = msg->datalen;
+	memset (net_from, 0, sizeof (*net_from));
+	net_from->type = NA_LOOPBACK;
+	net_from->loopport = msg->port;
+	return true;
+}
+
+
 void NET_SendLoopPacket (netsrc_t sock, int length, void *data, netadr_t to)
 {
 	int		i;
 	loopback_t	*loop;
 
-	loop = &loopbacks[sock ^ 1];
+	// the port field is ignored for loopback; "localhost" usually has PORT_SERVER filled in by the client
+	if (to.loopport)
+	{
+		// from a simulated client to the server; the port on the client's netchan names itself rather than the server
+		if (sock == NS_CLIENT)
+		{
+			loopmsg_t *msg;
+
+			if (!looptoserver)
+				return;
+
+			msg = &looptoserver[looptoserver_send & (looptoserver_size - 1)];
+			looptoserver_send++;
+
+			memcpy (msg->data, data, length);
+			msg->datalen = length;
+			msg->port = to.loopport;
+			return;
+		}
+
+		// from the server to a simulated client that may have gone away
+		if (to.loopport > MAX_LOOPPORTS || (loop = loopports[to.loopport]) == NULL)
+			return;
+	}
+	else loop = &loopbacks[sock ^ 1];
 
 	i = loop->send & (MAX_LOOPBACK - 1);
 	loop->send++;
@@ -332,6 +396,86 @@ void NET_SendLoopPacket (netsrc_t sock, int length, void *data, netadr_t to)
 	loop->msgs[i].datalen = length;
 }
 
+
+/*
+====================
+NET_OpenLoopPorts
+
+creates loopback ports 1 to numports for simulated clients
+====================
+*/
+void NET_OpenLoopPorts (int numports)
+{
+	int i;
+
+	NET_CloseLoopPorts ();
+
+	if (numports < 1) return;
+	if (numports > MAX_LOOPPORTS) numports = MAX_LOOPPORTS;
+
+	for (i = 1; i <= numports; i++)
+		loopports[i] = (loopback_t *) Zone_Alloc (sizeof (loopback_t));
+
+	// leave room for a few packets from every port between server reads; must be a power of 2
+	for (looptoserver_size = MAX_LOOPBACK; looptoserver_size < numports * MAX_LOOPBACK; looptoserver_size <<= 1);
+
+	looptoserver = (loopmsg_t *) Zone_Alloc (looptoserver_size * sizeof (loopmsg_t));
+	looptoserver_get = looptoserver_send = 0;
+}
+
+
+void NET_CloseLoopPorts (void)
+{
+	int i;
+
+	for (i = 1; i <= MAX_LOOPPORTS; i++)
+	{
+		if (loopports[i])
+		{
+			Zone_Free (loopports[i]);
+			loopports[i] = NULL;
+		}
+	}
+
+	if (looptoserver)
+	{
+		Zone_Free (looptoserver);
+		looptoserver = NULL;
+	}
+
+	looptoserver_size = 0;
+}
+
+
+/*
+====================
+NET_GetLoopPortPacket
+
+reads the next packet sent by the server to a simulated client
+====================
+*/
+qboolean NET_GetLoopPortPacket (int port, sizebuf_t *net_message)
+{
+	int		i;
+	loopback_t	*loop;
+
+	if (port < 1 || port > MAX_LOOPPORTS || (loop = loopports[port]) == NULL)
+		return false;
+
+	if (loop->send - loop->get > MAX_LOOPBACK)
+		loop->get = loop->send - MAX_LOOPBACK;
+
+	if (loop->get >= loop->send)
+		return false;
+
+	i = loop->get & (MAX_LOOPBACK - 1);
+	loop->get++;
+
+	memcpy (net_message->data, loop->msgs[i].data, loop->msgs[i].datalen);
+	net_message->cursize = loop->msgs[i].datalen;
+	return true;
+}
+
 //=============================================================================
 
 qboolean	NET_GetPacket (netsrc_t sock, netadr_t *net_from, sizebuf_t *net_message)
@@ -346,6 +490,9 @@ qboolean	NET_GetPacket (netsrc_t sock, netadr_t *net_from, sizebuf_t *net_messag
 	if (NET_GetLoopPacket (sock, net_from, net_message))
 		return true;
 
+	if (sock == NS_SERVER && NET_GetLoopPortPacketToServer (net_from, net_message))
+		return true;
+
 	for (protocol = 0; protocol < 2; protocol++)
 	{
 		if (protocol == 0)
@@ -395,6 +542,8 @@ void NET_SendPacket (netsrc_t sock, int length, void *data, netadr_t to)
 	struct sockaddr	addr;
 	int		net_socket;
 
+	net_bytessent[sock] += length;
+
 	if (to.type == NA_LOOPBACK)
 	{
 		NET_SendLoopPacket (sock, length, data, to);
@@ -636,108 +636,49 @@ BYTE ORDER FUNCTIONS
 ============================================================================
 */
 
-qboolean	bigendien;
-
-// can't just use function pointers, or dll linkage can
-// mess up when qcommon is included in multiple places
-short (*_BigShort) (short l);
-short (*_LittleShort) (short l);
-int (*_BigLong) (int l);
-int (*_LittleLong) (int l);
-float (*_BigFloat) (float l);
-float (*_LittleFloat) (float l);
-
-short	BigShort (short l) { return _BigShort (l); }
-short	LittleShort (short l) { return _LittleShort (l); }
-int		BigLong (int l) { return _BigLong (l); }
-int		LittleLong (int l) { return _LittleLong (l); }
-float	BigFloat (float l) { return _BigFloat (l); }
-float	LittleFloat (float l) { return _LittleFloat (l); }
-
-short   ShortSwap (short l)
-{
-	byte    b1, b2;
-
-	b1 = l & 255;
-	b2 = (l >> 8) & 255;
-
-	return (b1 << 8) + b2;
-}
+qboolean	bigendien = Q_BIGENDIAN;
 
-short	ShortNoSwap (short l)
-{
-	return l;
-}
+/*
+================
+ShortSwapArray
+LongSwapArray
 
-int    LongSwap (int l)
+plain loops over unsigned values with no calls in them, so that the compiler can vectorize them
+================
+*/
+void ShortSwapArray (void *data, int count)
 {
-	byte    b1, b2, b3, b4;
+	unsigned short *s = (unsigned short *) data;
+	int i;
 
-	b1 = l & 255;
-	b2 = (l >> 8) & 255;
-	b3 = (l >> 16) & 255;
-	b4 = (l >> 24) & 255;
-
-	return ((int) b1 << 24) + ((int) b2 << 16) + ((int) b3 << 8) + b4;
+	for (i = 0; i < count; i++)
+		s[i] = (unsigned short) ((s[i] >> 8) | (s[i] << 8));
 }
 
-int	LongNoSwap (int l)
-{
-	return l;
-}
 
-float FloatSwap (float f)
+void LongSwapArray (void *data, int count)
 {
-	union
-	{
-		float	f;
-		byte	b[4];
-	} dat1, dat2;
-
+	unsigned *l = (unsigned *) data;
+	int i;
 
-	dat1.f = f;
-	dat2.b[0] = dat1.b[3];
-	dat2.b[1] = dat1.b[2];
-	dat2.b[2] = dat1.b[1];
-	dat2.b[3] = dat1.b[0];
-	return dat2.f;
+	for (i = 0; i < count; i++)
+		l[i] = (l[i] >> 24) | ((l[i] >> 8) & 0xff00) | ((l[i] << 8) & 0xff0000) | (l[i] << 24);
 }
 
-float FloatNoSwap (float f)
-{
-	return f;
-}
 
 /*
 ================
 Swap_Init
+
+the byte order is chosen when compiling, and a build for the wrong one would read every file as garbage
 ================
 */
 void Swap_Init (void)
 {
 	byte	swaptest[2] = {1, 0};
 
-	// set the byte swapping variables in a portable manner	
-	if (*(short *) swaptest == 1)
-	{
-		bigendien = false;
-		_BigShort = ShortSwap;
-		_LittleShort = ShortNoSwap;
-		_BigLong = LongSwap;
-		_LittleLong = LongNoSwap;
-		_BigFloat = FloatSwap;
-		_LittleFloat = FloatNoSwap;
-	}
-	else
-	{
-		bigendien = true;
-		_BigShort = ShortNoSwap;
-		_LittleShort = ShortSwap;
-		_BigLong = LongNoSwap;
-		_LittleLong = LongSwap;
-		_BigFloat = FloatNoSwap;
-		_LittleFloat = FloatSwap;
-	}
+	if ((*(short *) swaptest != 1) != Q_BIGENDIAN)
+		Sys_Error ("Swap_Init: built for the wrong byte order");
 }
 
 
@@ -1107,6 +1048,146 @@ void Info_SetValueForKey (char *s, char *key, char *value)
 	*s = 0;
 }
 
+
+/*
+============================================================================
+
+NAME INDEX
+
+Each slot is in at most one hash chain; the chain heads and links hold slot + 1 so that zeroed storage is empty.
+Lookups still compare names in the registry because different names may share a hash.
+
+============================================================================
+*/
+
+#define NAMEINDEX_HEADS(ni)		((ni)->storage)
+#define NAMEINDEX_NEXT(ni)		((ni)->storage + (ni)->numslots)
+#define NAMEINDEX_HASHES(ni)	((unsigned *) (ni)->storage + (ni)->numslots * 2)
+#define NAMEINDEX_INUSE(ni)		((unsigned *) (ni)->storage + (ni)->numslots * 3)
+
+unsigned Com_HashName (const char *name)
+{
+	// FNV-1a
+	unsigned hash = 2166136261u;
+
+	while (*name)
+	{
+		hash ^= (byte) *name++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+
+void NameIndex_Clear (nameindex_t *ni)
+{
+	memset (ni->storage, 0, NAMEINDEX_STORAGE (ni->numslots) * sizeof (int));
+}
+
+
+static int NameIndex_Walk (nameindex_t *ni, int link, unsigned hash)
+{
+	int *next = NAMEINDEX_NEXT (ni);
+	unsigned *hashes = NAMEINDEX_HASHES (ni);
+
+	// skip over any slots whose names only share the bucket
+	for (; link; link = next[link - 1])
+		if (hashes[link - 1] == hash)
+			return link - 1;
+
+	return -1;
+}
+
+
+/*
+==================
+NameIndex_Find
+
+Returns the first in-use slot whose name may match, or -1; the caller must check the name and continue with
+NameIndex_FindNext if it doesn't
+==================
+*/
+int NameIndex_Find (nameindex_t *ni, const char *name)
+{
+	unsigned hash = Com_HashName (name);
+
+	return NameIndex_Walk (ni, NAMEINDEX_HEADS (ni)[hash % ni->numslots], hash);
+}
+
+
+int NameIndex_FindNext (nameindex_t *ni, int slot)
+{
+	return NameIndex_Walk (ni, NAMEINDEX_NEXT (ni)[slot], NAMEINDEX_HASHES (ni)[slot]);
+}
+
+
+/*
+==================
+NameIndex_Alloc
+
+Takes the lowest free slot for the name, which is the same slot a linear search for a free entry would find,
+or returns -1 if they're all in use
+==================
+*/
+int NameIndex_Alloc (nameindex_t *ni, const char *name)
+{
+	int *heads = NAMEINDEX_HEADS (ni);
+	unsigned *inuse = NAMEINDEX_INUSE (ni);
+	int i, slot;
+
+	for (i = 0; i < (ni->numslots + 31) >> 5; i++)
+	{
+		if (inuse[i] == 0xffffffff) continue;
+
+		for (slot = i << 5; inuse[i] & (1u << (slot & 31)); slot++);
+
+		if (slot >= ni->numslots) break;
+
+		inuse[i] |= (1u << (slot & 31));
+
+		// link it into its chain
+		NAMEINDEX_HASHES (ni)[slot] = Com_HashName (name);
+		NAMEINDEX_NEXT (ni)[slot] = heads[NAMEINDEX_HASHES (ni)[slot] % ni->numslots];
+		heads[NAMEINDEX_HASHES (ni)[slot] % ni->numslots] = slot + 1;
+
+		return slot;
+	}
+
+	return -1;
+}
+
+
+void NameIndex_Free (nameindex_t *ni, int slot)
+{
+	int *next = NAMEINDEX_NEXT (ni);
+	int *link;
+
+	if (!NameIndex_InUse (ni, slot)) return;
+
+	// unlink it from its chain
+	for (link = &NAMEINDEX_HEADS (ni)[NAMEINDEX_HASHES (ni)[slot] % ni->numslots]; *link; link = &next[*link - 1])
+	{
+		if (*link != slot + 1) continue;
+
+		*link = next[slot];
+		break;
+	}
+
+	next[slot] = 0;
+	NAMEINDEX_HASHES (ni)[slot] = 0;
+	NAMEINDEX_INUSE (ni)[slot >> 5] &= ~(1u << (slot & 31));
+}
+
+
+qboolean NameIndex_InUse (nameindex_t *ni, int slot)
+{
+	if (slot < 0 || slot >= ni->numslots) return false;
+
+	return (NAMEINDEX_INUSE (ni)[slot >> 5] & (1u << (slot & 31))) ? true : false;
+}
+
+
 //====================================================================
 
 
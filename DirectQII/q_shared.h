@@ -184,18 +184,92 @@ int Q_strncasecmp (char *s1, char *s2, int n);
 
 //=============================================
 
-short	BigShort (short l);
-short	LittleShort (short l);
-int		BigLong (int l);
-int		LittleLong (int l);
-float	BigFloat (float l);
-float	LittleFloat (float l);
+/*
+byte order is known when compiling, so on little endian hosts (everything this builds for) the Little functions
+are no-ops that inline away and the Big ones are a plain swap; Swap_Init only checks that the guess was right
+*/
+#if defined (__BIG_ENDIAN__) || (defined (__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define	Q_BIGENDIAN		1
+#else
+#define	Q_BIGENDIAN		0
+#endif
+
+static __inline short ShortSwap (short l)
+{
+	unsigned short u = l;
+	return (short) ((u >> 8) | (u << 8));
+}
+
+static __inline int LongSwap (int l)
+{
+	unsigned u = l;
+	return (int) ((u >> 24) | ((u >> 8) & 0xff00) | ((u << 8) & 0xff0000) | (u << 24));
+}
+
+static __inline float FloatSwap (float f)
+{
+	union {float f; int l;} u;
+
+	u.f = f;
+	u.l = LongSwap (u.l);
+
+	return u.f;
+}
+
+// swap whole arrays in place, for lumps that are all shorts or all longs and floats
+void ShortSwapArray (void *data, int count);
+void LongSwapArray (void *data, int count);
+
+#if Q_BIGENDIAN
+static __inline short BigShort (short l) {return l;}
+static __inline short LittleShort (short l) {return ShortSwap (l);}
+static __inline int BigLong (int l) {return l;}
+static __inline int LittleLong (int l) {return LongSwap (l);}
+static __inline float BigFloat (float l) {return l;}
+static __inline float LittleFloat (float l) {return FloatSwap (l);}
+static __inline void LittleShortArray (void *data, int count) {ShortSwapArray (data, count);}
+static __inline void LittleLongArray (void *data, int count) {LongSwapArray (data, count);}
+#else
+static __inline short BigShort (short l) {return ShortSwap (l);}
+static __inline short LittleShort (short l) {return l;}
+static __inline int BigLong (int l) {return LongSwap (l);}
+static __inline int LittleLong (int l) {return l;}
+static __inline float BigFloat (float l) {return FloatSwap (l);}
+static __inline float LittleFloat (float l) {return l;}
+static __inline void LittleShortArray (void *data, int count) {}
+static __inline void LittleLongArray (void *data, int count) {}
+#endif
 
 void Swap_Init (void);
 char	*va (char *format, ...);
 
 //=============================================
 
+//
+// name index
+//
+// hashed lookup and first-free-slot allocation for a fixed array of named slots, shared by the image, model,
+// buffer and sound registries; the registry keeps the names itself and the index tracks which slots are in use
+// and the hash of the name in each.  zeroed storage is an empty index so these can be declared statically.
+//
+#define NAMEINDEX_STORAGE(numslots)	((numslots) * 3 + (((numslots) + 31) >> 5))
+
+typedef struct nameindex_s
+{
+	int		numslots;
+	int		*storage;		// NAMEINDEX_STORAGE (numslots) ints
+} nameindex_t;
+
+unsigned Com_HashName (const char *name);
+void NameIndex_Clear (nameindex_t *ni);
+int NameIndex_Find (nameindex_t *ni, const char *name);
+int NameIndex_FindNext (nameindex_t *ni, int slot);
+int NameIndex_Alloc (nameindex_t *ni, const char *name);
+void NameIndex_Free (nameindex_t *ni, int slot);
+qboolean NameIndex_InUse (nameindex_t *ni, int slot);
+
+//=============================================
+
 //
 // key / value info strings
 //
@@ -221,6 +295,7 @@ SYSTEM SPECIFIC
 extern	int	sys_currmsec;
 
 int Sys_Milliseconds (void);
+double Sys_Microseconds (void);
 void Sys_Mkdir (char *path);
 
 
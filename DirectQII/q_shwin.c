@@ -60,6 +60,36 @@ int Sys_Milliseconds (void)
 }
 
 
+/*
+================
+Sys_Microseconds
+
+high-resolution timer for profiling; not a replacement for sys_currmsec and not used to advance time
+================
+*/
+double Sys_Microseconds (void)
+{
+	static qboolean first = true;
+	static __int64 qpcstart = 0;
+	static __int64 qpcfreq = 0;
+	__int64 qpcnow = 0;
+
+	if (first)
+	{
+		first = false;
+
+		QueryPerformanceCounter ((LARGE_INTEGER *) &qpcstart);
+		QueryPerformanceFrequency ((LARGE_INTEGER *) &qpcfreq);
+
+		return 0;
+	}
+
+	QueryPerformanceCounter ((LARGE_INTEGER *) &qpcnow);
+
+	return (double) (qpcnow - qpcstart) * 1000000.0 / (double) qpcfreq;
+}
+
+
 void Sys_Mkdir (char *path)
 {
 	_mkdir (path);
@@ -98,6 +98,7 @@ void SZ_Print (sizebuf_t *buf, char *data); // strcats onto the sizebuf
 
 struct usercmd_s;
 struct entity_state_s;
+struct player_state_s;
 
 void MSG_WriteChar (sizebuf_t *sb, int c);
 void MSG_WriteByte (sizebuf_t *sb, int c);
@@ -111,6 +112,7 @@ void MSG_WriteAngle (sizebuf_t *sb, float f);
 void MSG_WriteAngle16 (sizebuf_t *sb, float f);
 void MSG_WriteDeltaUsercmd (sizebuf_t *sb, struct usercmd_s *from, struct usercmd_s *cmd);
 void MSG_WriteDeltaEntity (struct entity_state_s *from, struct entity_state_s *to, sizebuf_t *msg, qboolean force, qboolean newentity);
+void MSG_WriteDeltaPlayerstate (struct player_state_s *from, struct player_state_s *to, sizebuf_t *msg);
 void MSG_WriteDir (sizebuf_t *sb, vec3_t vector);
 
 
@@ -134,16 +136,94 @@ void MSG_ReadDir (sizebuf_t *sb, vec3_t vector);
 
 void MSG_ReadData (sizebuf_t *sb, void *buffer, int size);
 
+/*
+==============================================================================
+
+MESSAGE CURSORS
+
+delta encoding and decoding make dozens of byte and short reads or writes
+per entity, and each of the functions above checks the buffer on its own.
+a cursor checks once for the most that a whole entity or playerstate can
+take and then just moves a pointer.  near the end of the buffer it works on
+a scratch copy instead: writes then go through SZ_Write so overflow is
+handled as before, and reads past the end see 0xff bytes and still leave
+readcount past cursize for the callers' end of message checks.
+
+==============================================================================
+*/
+
+// worst cases, with every field present
+#define	MSG_MAX_ENTITYBITS		6		// bit bytes and a 16 bit number
+#define	MSG_MAX_DELTAENTITY		44		// bits, number and fields
+#define	MSG_MAX_PLAYERSTATE		119		// flags, fields and all MAX_STATS stats
+
+#define	MSG_MAX_CURSOR			128
+
+typedef struct msgcursor_s
+{
+	byte	*p;			// next byte to read or write
+	byte	*start;
+	byte	scratch[MSG_MAX_CURSOR];
+} msgcursor_t;
+
+
+static __inline void MSG_BeginWriteCursor (msgcursor_t *c, sizebuf_t *sb, int maxlen)
+{
+	if (sb->cursize + maxlen <= sb->maxsize)
+		c->start = c->p = sb->data + sb->cursize;
+	else c->start = c->p = c->scratch;
+}
+
+static __inline void MSG_EndWriteCursor (msgcursor_t *c, sizebuf_t *sb)
+{
+	if (c->start == c->scratch)
+		SZ_Write (sb, c->scratch, c->p - c->start);
+	else sb->cursize += c->p - c->start;
+}
+
+static __inline void MSG_BeginReadCursor (msgcursor_t *c, sizebuf_t *sb, int maxlen)
+{
+	int left = sb->cursize - sb->readcount;
+
+	if (left >= maxlen)
+		c->start = c->p = sb->data + sb->readcount;
+	else
+	{
+		memset (c->scratch, 0xff, maxlen);
+
+		if (left > 0)
+			memcpy (c->scratch, sb->data + sb->readcount, left);
+
+		c->start = c->p = c->scratch;
+	}
+}
+
+static __inline void MSG_EndReadCursor (msgcursor_t *c, sizebuf_t *sb)
+{
+	sb->readcount += c->p - c->start;
+}
+
+static __inline void MSG_PutByte (msgcursor_t *c, int b) {*c->p++ = b;}
+static __inline void MSG_PutChar (msgcursor_t *c, int b) {*c->p++ = b;}
+static __inline void MSG_PutShort (msgcursor_t *c, int s) {c->p[0] = s & 0xff; c->p[1] = s >> 8; c->p += 2;}
+static __inline void MSG_PutLong (msgcursor_t *c, int l) {c->p[0] = l & 0xff; c->p[1] = (l >> 8) & 0xff; c->p[2] = (l >> 16) & 0xff; c->p[3] = l >> 24; c->p += 4;}
+static __inline void MSG_PutCoord (msgcursor_t *c, float f) {MSG_PutShort (c, (int) (f * 8));}
+static __inline void MSG_PutAngle (msgcursor_t *c, float f) {MSG_PutByte (c, (int) (f * 256 / 360) & 255);}
+static __inline void MSG_PutAngle16 (msgcursor_t *c, float f) {MSG_PutShort (c, ANGLE2SHORT (f));}
+
+static __inline int MSG_GetByte (msgcursor_t *c) {return *c->p++;}
+static __inline int MSG_GetChar (msgcursor_t *c) {return (signed char) *c->p++;}
+static __inline int MSG_GetShort (msgcursor_t *c) {int s = (short) (c->p[0] | (c->p[1] << 8)); c->p += 2; return s;}
+static __inline int MSG_GetLong (msgcursor_t *c) {int l = c->p[0] | (c->p[1] << 8) | (c->p[2] << 16) | (c->p[3] << 24); c->p += 4; return l;}
+static __inline float MSG_GetCoord (msgcursor_t *c) {return MSG_GetShort (c) * (1.0 / 8);}
+static __inline float MSG_GetAngle (msgcursor_t *c) {return MSG_GetChar (c) * (360.0 / 256);}
+static __inline float MSG_GetAngle16 (msgcursor_t *c) {return SHORT2ANGLE (MSG_GetShort (c));}
+
 //============================================================================
 
 extern qboolean  bigendien;
 
-extern short BigShort (short l);
-extern short LittleShort (short l);
-extern int BigLong (int l);
-extern int LittleLong (int l);
-extern float BigFloat (float l);
-extern float LittleFloat (float l);
+// the byte order functions are inlined from q_shared.h
 
 //============================================================================
 
@@ -232,7 +312,8 @@ enum svc_ops_e
 	svc_playerinfo,				// variable
 	svc_packetentities,			// [...]
 	svc_deltapacketentities,	// [...]
-	svc_frame
+	svc_frame,
+	svc_downloadchunk			// [byte] id [long] filesize [long] offset [short] size [size bytes]
 };
 
 //==============================================
@@ -246,9 +327,15 @@ enum clc_ops_e
 	clc_nop,
 	clc_move,				// [[usercmd_t]
 	clc_userinfo,			// [[userinfo string]
-	clc_stringcmd			// [string] message
+	clc_stringcmd,			// [string] message
+	clc_downloadack			// [byte] id [long] first missing chunk [long] bits for the chunks after it
 };
 
+// windowed downloads send chunks of a file over the unreliable datagram and the client acknowledges them selectively;
+// a client asks for one with a window after the offset ("download <file> <offset> <window>") and older servers ignore it
+#define	DOWNLOAD_CHUNK		1024	// bytes in a chunk
+#define	DOWNLOAD_WINDOW		32		// most chunks in flight; one bit each in a clc_downloadack, must be a power of 2
+
 //==============================================
 
 // plyer_state_t communication
@@ -548,6 +635,9 @@ typedef struct netadr_s
 	byte	ipx[10];
 
 	unsigned short	port;
+
+	// NA_LOOPBACK only: 1 to MAX_LOOPPORTS for a simulated client, 0 for the local client and server
+	unsigned short	loopport;
 } netadr_t;
 
 void NET_Init (void);
@@ -565,6 +655,14 @@ char *NET_AdrToString (netadr_t a);
 qboolean NET_StringToAdr (char *s, netadr_t *a);
 void NET_Sleep (int msec);
 
+extern int net_bytessent[2];
+
+#define	MAX_LOOPPORTS	512		// simulated clients, both players and relay spectators
+
+void NET_OpenLoopPorts (int numports);
+void NET_CloseLoopPorts (void);
+qboolean NET_GetLoopPortPacket (int port, sizebuf_t *net_message);
+
 //============================================================================
 
 #define	OLD_AVG		0.99		// total = oldtotal * OLD_AVG + new * (1 - OLD_AVG)
@@ -630,6 +728,15 @@ CMODEL
 ==============================================================
 */
 
+// a collision world; every CM_ call goes to the world bound to the calling thread, which starts out as a
+// default world shared by the client and the local server.  worlds with the same map loaded share its data.
+typedef struct cmodel_world_s cmodel_world_t;
+
+cmodel_world_t *CM_CreateWorld (void);
+void CM_FreeWorld (cmodel_world_t *world);
+cmodel_world_t *CM_BindWorld (cmodel_world_t *world); // NULL binds the default world; returns the previous one
+
+void CM_Init (void);
 
 cmodel_t *CM_LoadMap (char *name, qboolean clientload, unsigned *checksum);
 cmodel_t *CM_InlineModel (char *name); // *1, *2, etc
@@ -708,6 +815,10 @@ int FS_LoadFile (char *path, void **buffer);
 // a null buffer will just return the file length without loading
 // a -1 length is not present
 
+int FS_LoadTempFile (char *path, void **buffer);
+// loads into the calling thread's load memory; release with Load_FreeToMark instead of FS_FreeFile
+// a file too big for what's left of load memory isn't loaded, but its length is still returned
+
 void FS_Read (void *buffer, int len, FILE *f);
 // properly handles partial reads
 
@@ -715,6 +826,10 @@ void FS_FreeFile (void *buffer);
 
 void FS_CreatePath (char *path);
 
+char **FS_ListPackFiles (char *extension, int *numfiles);
+void FS_FreeFileList (char **list);
+// NULL-terminated list of every name in the loaded PAKs with the given extension
+
 
 /*
 ==============================================================
@@ -760,10 +875,20 @@ void Z_Free (void *ptr);
 void *Z_TagAlloc (int size, int tag);
 void Z_FreeTags (int tag);
 void Z_Init (void);
+void Z_Stats_f (void);
 
 void *Zone_Alloc (int size);
 void Zone_Free (void *ptr);
 
+// temporary memory for loading, from an arena that belongs to the calling thread
+void Load_Init (void);
+void *Load_AllocMemory (int size);
+qboolean Load_HasRoom (int size);
+void Load_FreeMemory (void);
+int Load_GetMark (void);
+void Load_FreeToMark (int mark);
+void Load_ShutdownThread (void);
+
 void Qcommon_Init (int argc, char **argv);
 void Qcommon_Frame (int msec);
 void Qcommon_Shutdown (void);
@@ -438,3 +438,46 @@ typedef struct darea_s {
 	int		firstareaportal;
 } darea_t;
 
+
+
+/*
+========================================================================
+
+.DMI demo index file format
+
+written next to a .dm2 while it's recorded.  every message after the
+startup messages has its file offset and the server time of the last
+frame it carried; keyframes name a message that playback can resume at
+and hold a snapshot, stored as length prefixed messages the same as the
+demo, that puts the client into the state that message deltas from
+
+========================================================================
+*/
+
+#define IDDEMOINDEXHEADER	(('X' << 24) + ('I' << 16) + ('M' << 8) + 'D') // little-endian "DMIX"
+#define DEMOINDEX_VERSION	1
+
+typedef struct
+{
+	int			ident;
+	int			version;
+	int			interval;		// msec between keyframes
+	int			nummessages;
+	int			ofsmessages;
+	int			numkeyframes;
+	int			ofskeyframes;
+} dmiheader_t;
+
+typedef struct
+{
+	int			offset;			// from the start of the .dm2
+	int			time;
+} dmimessage_t;
+
+typedef struct
+{
+	int			message;		// first message to play after the snapshot
+	int			time;			// server time of the snapshot's frame
+	int			ofssnapshot;
+	int			snapshotlen;
+} dmikeyframe_t;
@@ -54,6 +54,7 @@ typedef struct vidmenu_s
 } vidmenu_t;
 
 
+// the scene lists grow as needed so these are just sizes to start from
 #define	MAX_DLIGHTS		64
 #define	MAX_ENTITIES	256
 #define	MAX_PARTICLES	32768
@@ -233,6 +234,9 @@ typedef struct refimport_s
 	// loading temp allocations
 	void (*Load_FreeMemory) (void);
 	void *(*Load_AllocMemory) (int size);
+	int (*Load_GetMark) (void);
+	void (*Load_FreeToMark) (int mark);
+	void (*Load_ShutdownThread) (void);
 
 	void (*Cmd_AddCommand) (char *name, void (*cmd) (void));
 	void (*Cmd_RemoveCommand) (char *name);
@@ -250,6 +254,10 @@ typedef struct refimport_s
 	int (*FS_LoadFile) (char *name, void **buf);
 	void (*FS_FreeFile) (void *buf);
 
+	// NULL-terminated list of every file in the loaded PAKs with the given extension
+	char **(*FS_ListPackFiles) (char *extension, int *numfiles);
+	void (*FS_FreeFileList) (char **list);
+
 	// gamedir will be the current directory that generated
 	// files should be stored to, ie: "f:\quake\id1"
 	char *(*FS_Gamedir) (void);
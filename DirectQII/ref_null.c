@@ -0,0 +1,125 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// ref_null.c -- a refresh that draws nothing, for running headless (vid_null 1)
+
+#include "client.h"
+
+static refimport_t nri;
+
+// the client never looks inside models or images, it only checks them against NULL, so everything registers as this
+static int null_registered;
+
+
+static int RNull_Init (void *hinstance, void *wndproc)
+{
+	nri.Con_Printf (PRINT_ALL, "null refresh; nothing will be drawn\n");
+	return 0;
+}
+
+static void RNull_Shutdown (void) {}
+static void RNull_BeginRegistration (char *map) {}
+static struct model_s *RNull_RegisterModel (char *name) {return (struct model_s *) &null_registered;}
+static struct image_s *RNull_RegisterImage (char *name) {return (struct image_s *) &null_registered;}
+static void RNull_SetSky (char *name, float rotate, vec3_t axis) {}
+static void RNull_EndRegistration (void) {}
+static void RNull_RenderFrame (refdef_t *fd) {}
+static void RNull_DrawConsoleBackground (int x, int y, int w, int h, char *pic, int alpha) {}
+static void RNull_DrawStretchPic (int x, int y, int w, int h, char *pic) {}
+static void RNull_DrawPic (int x, int y, char *name) {}
+static void RNull_DrawFill (int x, int y, int w, int h, int c) {}
+static void RNull_DrawFadeScreen (void) {}
+static void RNull_Clear (void) {}
+static void RNull_DrawChar (int x, int y, int num) {}
+static void RNull_DrawString (void) {}
+static void RNull_DrawField (int x, int y, int color, int width, int value) {}
+static void RNull_DrawStretchRaw (int cols, int rows, byte *data, int frame, const unsigned char *palette) {}
+static void RNull_Set2D (void) {}
+static void RNull_EndFrame (int scrflags) {}
+static void RNull_AppActivate (qboolean activate) {}
+static void RNull_EnumerateVideoModes (void) {}
+static void RNull_CaptureScreenshot (char *checkname) {}
+
+
+static qboolean RNull_DrawGetPicSize (int *w, int *h, char *name)
+{
+	*w = *h = 0;
+	return false;
+}
+
+
+static void RNull_BeginFrame (viddef_t *vd, int scrflags)
+{
+	// the client still lays out the 2d screen and sizes the refdef from these
+	vd->width = vd->conwidth = nri.Cvar_Get ("vid_width", "640", CVAR_ARCHIVE | CVAR_VIDEO, NULL)->value;
+	vd->height = vd->conheight = nri.Cvar_Get ("vid_height", "480", CVAR_ARCHIVE | CVAR_VIDEO, NULL)->value;
+}
+
+
+/*
+==============
+GetNullRefAPI
+==============
+*/
+refexport_t GetNullRefAPI (refimport_t rimp)
+{
+	refexport_t nre;
+
+	nri = rimp;
+
+	memset (&nre, 0, sizeof (nre));
+
+	nre.api_version = API_VERSION;
+
+	nre.Init = RNull_Init;
+	nre.Shutdown = RNull_Shutdown;
+
+	nre.BeginRegistration = RNull_BeginRegistration;
+	nre.RegisterModel = RNull_RegisterModel;
+	nre.RegisterSkin = RNull_RegisterImage;
+	nre.RegisterPic = RNull_RegisterImage;
+	nre.SetSky = RNull_SetSky;
+	nre.EndRegistration = RNull_EndRegistration;
+
+	nre.RenderFrame = RNull_RenderFrame;
+
+	nre.DrawConsoleBackground = RNull_DrawConsoleBackground;
+	nre.DrawGetPicSize = RNull_DrawGetPicSize;
+	nre.DrawStretchPic = RNull_DrawStretchPic;
+	nre.DrawPic = RNull_DrawPic;
+	nre.DrawFill = RNull_DrawFill;
+	nre.DrawFadeScreen = RNull_DrawFadeScreen;
+	nre.Clear = RNull_Clear;
+
+	nre.DrawChar = RNull_DrawChar;
+	nre.DrawString = RNull_DrawString;
+	nre.DrawField = RNull_DrawField;
+	nre.DrawStretchRaw = RNull_DrawStretchRaw;
+
+	nre.BeginFrame = RNull_BeginFrame;
+	nre.Set2D = RNull_Set2D;
+	nre.EndFrame = RNull_EndFrame;
+
+	nre.AppActivate = RNull_AppActivate;
+	nre.EnumerateVideoModes = RNull_EnumerateVideoModes;
+	nre.CaptureScreenshot = RNull_CaptureScreenshot;
+
+	return nre;
+}
+
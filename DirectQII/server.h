@@ -66,6 +66,20 @@ typedef struct server_s
 	// demo server information
 	FILE		*demofile;
 	qboolean	timedemo;		// don't time sync
+
+	// demo seeking, from the .dmi recorded with the demo
+	int				demobase;			// file offset of the demo, which may be inside a pak
+	byte			*demoindex;
+	dmimessage_t	*demomessages;
+	int				numdemomessages;
+	dmikeyframe_t	*demokeyframes;
+	int				numdemokeyframes;
+	int				demointerval;
+
+	byte		*demosnapshot;		// keyframe messages still to send
+	int			demosnapshotlen;
+	qboolean	demoseeking;		// catching up to demoseektime
+	int			demoseektime;
 } server_t;
 
 #define EDICT_NUM(n) ((edict_t *) ((byte *) ge->edicts + ge->edict_size * (n)))
@@ -88,6 +102,7 @@ typedef struct client_frame_s
 	int					num_entities;
 	int					first_entity;		// into the circular sv_packet_entities[]
 	int					senttime;			// for ping calculations
+	int					framenum;			// sv.framenum it was built for, so relay spectators can share it
 } client_frame_t;
 
 #define	LATENCY_COUNTS	16
@@ -111,6 +126,7 @@ typedef struct client_s
 	int				message_size[RATE_MESSAGES];	// used to rate drop packets
 	int				rate;
 	int				surpressCount;		// number of messages rate supressed
+	int				ratedrops;			// total messages rate supressed on this connection
 
 	edict_t			*edict;				// EDICT_NUM(clientnum + 1)
 	char			name[32];			// extracted from userinfo, high bits masked
@@ -127,11 +143,26 @@ typedef struct client_s
 	int				downloadsize;		// total bytes (can't use EOF because of paks)
 	int				downloadcount;		// bytes sent
 
+	// windowed downloads (see SV_SendDownloadChunks); downloadwindow is 0 for the nextdl protocol
+	int				downloadid;
+	int				downloadwindow;
+	int				downloadchunks;
+	int				downloadbase;		// first chunk not acknowledged
+	int				downloadnext;		// first chunk never sent
+	int				downloadsent[DOWNLOAD_WINDOW];	// svs.realtime each chunk in the window last went out, -1 once acknowledged
+	int				downloadrtt;		// smoothed from the acknowledgements, msec
+	int				downloadresent;
+
 	int				lastmessage;		// sv.framenum when packet was last received
 	int				lastconnect;
 
 	int				challenge;			// challenge of this user, randomly generated
 
+	// relay spectators (see sv_relay.c) have a slot past maxclients and no edict
+	qboolean		relay;
+	int				relayview;			// slot of the player being watched
+	int				relaystart;			// first frame sent from that view; older ones can't be delta'd from
+
 	netchan_t		netchan;
 } client_t;
 
@@ -166,7 +197,8 @@ typedef struct server_static_s
 	int			spawncount;					// incremented each server start
 	// used to check late spawns
 
-	client_t	*clients;					// [maxclients->value];
+	client_t	*clients;					// [numslots]
+	int			numslots;					// maxclients->value players followed by the relay spectators
 	int			num_client_entities;		// maxclients->value * UPDATE_BACKUP * MAX_PACKET_ENTITIES
 	int			next_client_entities;		// next client_entity to use
 	entity_state_t	*client_entities;		// [num_client_entities]
@@ -179,6 +211,10 @@ typedef struct server_static_s
 	FILE		*demofile;
 	sizebuf_t	demo_multicast;
 	byte		demo_multicast_buf[MAX_MSGLEN];
+
+	// unreliable multicasts of the current frame, shared by all relay spectators
+	sizebuf_t	relay_multicast;
+	byte		relay_multicast_buf[MAX_MSGLEN];
 } server_static_t;
 
 //=============================================================================
@@ -250,6 +286,15 @@ void SV_FlushRedirect (int sv_redirected, char *outputbuf);
 void SV_DemoCompleted (void);
 void SV_SendClientMessages (void);
 
+//
+// sv_demo.c
+//
+void SV_OpenDemo (void);
+void SV_CloseDemo (void);
+int SV_ReadDemoMessage (byte *msgbuf);
+qboolean SV_DemoSeeking (void);
+void SV_DemoSeek_f (void);
+
 void SV_Multicast (vec3_t origin, multicast_t to);
 void SV_StartSound (vec3_t origin, edict_t *entity, int channel,
 	int soundindex, float volume,
@@ -263,6 +308,7 @@ void SV_BroadcastCommand (char *fmt, ...);
 //
 void SV_Nextserver (void);
 void SV_ExecuteClientMessage (client_t *cl);
+void SV_New_f (void);
 
 //
 // sv_ccmds.c
@@ -270,10 +316,81 @@ void SV_ExecuteClientMessage (client_t *cl);
 void SV_ReadLevelFile (void);
 void SV_Status_f (void);
 
+//
+// sv_perf.c
+//
+typedef enum svperfphase_s
+{
+	SVP_READ,
+	SVP_PINGS,
+	SVP_MSEC,
+	SVP_GAME,
+	SVP_SEND,
+	SVP_DEMO,
+	SVP_HEARTBEAT,
+	SVP_PREP,
+	SVP_NUMPHASES
+} svperfphase_t;
+
+typedef struct svperfsample_s
+{
+	float	phases[SVP_NUMPHASES];	// ms
+	float	total;
+	int		traces;
+	int		links;
+	int		bytes;
+	int		deltahits;
+	int		deltamisses;
+} svperfsample_t;
+
+// bumped by the world code as it runs and cleared each tick
+typedef struct svperfcount_s
+{
+	int		traces;
+	int		links;
+	int		deltahits;			// entity deltas copied from the shared cache in sv_ents.c
+	int		deltamisses;		// and encoded
+} svperfcount_t;
+
+extern	svperfcount_t	sv_perfcount;
+extern	char	*sv_perfphasenames[SVP_NUMPHASES];
+
+void SV_InitPerf (void);
+void SV_PerfBegin (int phase);
+void SV_PerfEnd (int phase);
+void SV_PerfEndTick (void);
+void SV_PerfNewServer (void);
+void SV_Perf_f (void);
+
+//
+// sv_loadgen.c
+//
+void SV_InitLoadGen (void);
+void SV_LoadGen_Frame (void);
+void SV_LoadGen_Tick (svperfsample_t *sample);
+void SV_LoadGen_Shutdown (void);
+
+//
+// sv_relay.c
+//
+#define	MAX_RELAYS	1024
+
+extern	cvar_t		*sv_relay_max;
+
+void SV_InitRelay (void);
+qboolean SV_RelayConnect (client_t *cl, char *userinfo);
+int SV_RelayPickView (client_t *cl);
+void SV_SendRelayDatagram (client_t *cl);
+void SV_RelayView_f (void);
+void SV_RelayStats (int *encoded, int *sent);
+
 //
 // sv_ents.c
 //
+extern	cvar_t		*sv_deltacache;
+
 void SV_WriteFrameToClient (client_t *client, sizebuf_t *msg);
+void SV_EmitPacketEntities (client_frame_t *from, client_frame_t *to, sizebuf_t *msg);
 void SV_RecordDemoMessage (void);
 void SV_BuildClientFrame (client_t *client);
 
@@ -24,7 +24,6 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 void S_Play (void);
 void S_SoundList (void);
-void S_Update_ ();
 void S_StopAllSounds (void);
 
 
@@ -64,6 +63,10 @@ int   		paintedtime; 	// sample PAIRS
 sfx_t		known_sfx[MAX_SFX];
 int			num_sfx;
 
+// name lookups and free slots for known_sfx
+static int	sfx_indexdata[NAMEINDEX_STORAGE (MAX_SFX)];
+static nameindex_t sfx_index = {MAX_SFX, sfx_indexdata};
+
 #define		MAX_PLAYSOUNDS	128
 playsound_t	s_playsounds[MAX_PLAYSOUNDS];
 playsound_t	s_freeplays;
@@ -75,6 +78,15 @@ cvar_t		*s_volume;
 cvar_t		*s_testsound;
 cvar_t		*s_show;
 cvar_t		*s_mixahead;
+cvar_t		*s_voices;
+cvar_t		*s_mixthread;
+
+// from the last S_AllocateVoices
+int			s_numrealvoices;
+int			s_numvirtualvoices;
+
+// tells the mixer which sound a channel is playing
+static int	s_channelserial = 0;
 
 
 int		s_rawend;
@@ -101,6 +113,11 @@ void S_SoundInfo_f (void)
 	Com_Printf ("%5d submission_chunk\n", dma.submission_chunk);
 	Com_Printf ("%5d speed\n", dma.speed);
 	Com_Printf ("0x%x dma buffer\n", dma.buffer);
+	Com_Printf ("%5d channels\n", MAX_CHANNELS);
+	Com_Printf ("%5d real voices\n", s_numrealvoices);
+	Com_Printf ("%5d virtual voices\n", s_numvirtualvoices);
+	Com_Printf ("%5d mixer overflows\n", s_mixeroverflows);
+	Com_Printf ("mixing on %s\n", s_mixerthread ? "its own thread" : "the main thread");
 }
 
 
@@ -116,6 +133,10 @@ void S_Init (void)
 
 	Com_Printf ("\n------- sound initialization -------\n");
 
+	// the benchmark doesn't need a device so it's there even with s_initsound 0
+	if (!Cmd_Exists ("s_resamplebench"))
+		Cmd_AddCommand ("s_resamplebench", S_ResampleBench_f);
+
 	if (!cv->value)
 		Com_Printf ("not initializing.\n");
 	else
@@ -124,19 +145,29 @@ void S_Init (void)
 		s_mixahead = Cvar_Get ("s_mixahead", "0.2", CVAR_ARCHIVE, NULL);
 		s_show = Cvar_Get ("s_show", "0", 0, NULL);
 		s_testsound = Cvar_Get ("s_testsound", "0", 0, NULL);
+		s_voices = Cvar_Get ("s_voices", va ("%i", MAX_VOICES), CVAR_ARCHIVE, NULL);
+		s_resample = Cvar_Get ("s_resample", "1", CVAR_ARCHIVE, NULL);
+		s_soundcache = Cvar_Get ("s_soundcache", "8192", CVAR_ARCHIVE, NULL);
+		s_mixthread = Cvar_Get ("s_mixthread", "1", CVAR_ARCHIVE, NULL);
 
 		Cmd_AddCommand ("play", S_Play);
 		Cmd_AddCommand ("stopsound", S_StopAllSounds);
 		Cmd_AddCommand ("soundlist", S_SoundList);
 		Cmd_AddCommand ("soundinfo", S_SoundInfo_f);
+		Cmd_AddCommand ("soundcache", S_SoundCache_f);
+		Cmd_AddCommand ("music", S_Music_f);
 
 		if (!SNDDMA_Init ())
 			return;
 
-		S_InitScaletable ();
+		S_InitScaletable (s_volume->value);
+		s_volume->modified = false;
 
 		sound_started = 1;
+		s_mixerfailed = false;
+		s_mixerwrapped = false;
 		num_sfx = 0;
+		NameIndex_Clear (&sfx_index);
 
 		soundtime = 0;
 		paintedtime = 0;
@@ -144,6 +175,10 @@ void S_Init (void)
 		Com_Printf ("sound sampling rate: %i\n", dma.speed);
 
 		S_StopAllSounds ();
+
+		// everything after this goes to the mixer through the command queue
+		if (s_mixthread->value && SNDDMA_StartMixer ())
+			Com_Printf ("mixing on its own thread\n");
 	}
 
 	Com_Printf ("------------------------------------\n");
@@ -162,6 +197,7 @@ void S_Shutdown (void)
 	if (!sound_started)
 		return;
 
+	SNDDMA_StopMixer ();
 	SNDDMA_Shutdown ();
 
 	sound_started = 0;
@@ -170,18 +206,24 @@ void S_Shutdown (void)
 	Cmd_RemoveCommand ("stopsound");
 	Cmd_RemoveCommand ("soundlist");
 	Cmd_RemoveCommand ("soundinfo");
+	Cmd_RemoveCommand ("soundcache");
+	Cmd_RemoveCommand ("music");
+
+	S_StopStream ();
 
-	// free all sounds
+	// free all sounds; their data stays cached in case the restart is at the same rate
 	for (i = 0, sfx = known_sfx; i < num_sfx; i++, sfx++)
 	{
 		if (!sfx->name[0])
 			continue;
-		if (sfx->cache)
-			Zone_Free (sfx->cache);
+		S_ReleaseSound (sfx);
 		memset (sfx, 0, sizeof (*sfx));
 	}
 
+	S_TrimSoundCache ();
+
 	num_sfx = 0;
+	NameIndex_Clear (&sfx_index);
 }
 
 
@@ -209,7 +251,7 @@ sfx_t *S_FindName (char *name, qboolean create)
 		Com_Error (ERR_FATAL, "Sound name too long: %s", name);
 
 	// see if already loaded
-	for (i = 0; i < num_sfx; i++)
+	for (i = NameIndex_Find (&sfx_index, name); i != -1; i = NameIndex_FindNext (&sfx_index, i))
 		if (!strcmp (known_sfx[i].name, name))
 		{
 			return &known_sfx[i];
@@ -219,17 +261,11 @@ sfx_t *S_FindName (char *name, qboolean create)
 		return NULL;
 
 	// find a free sfx
-	for (i = 0; i < num_sfx; i++)
-		if (!known_sfx[i].name[0])
-			//			registration_sequence < s_registration_sequence)
-			break;
+	if ((i = NameIndex_Alloc (&sfx_index, name)) == -1)
+		Com_Error (ERR_FATAL, "S_FindName: out of sfx_t");
 
-	if (i == num_sfx)
-	{
-		if (num_sfx == MAX_SFX)
-			Com_Error (ERR_FATAL, "S_FindName: out of sfx_t");
-		num_sfx++;
-	}
+	if (i >= num_sfx)
+		num_sfx = i + 1;
 
 	sfx = &known_sfx[i];
 	memset (sfx, 0, sizeof (*sfx));
@@ -256,16 +292,11 @@ sfx_t *S_AliasName (char *aliasname, char *truename)
 	strcpy (s, truename);
 
 	// find a free sfx
-	for (i = 0; i < num_sfx; i++)
-		if (!known_sfx[i].name[0])
-			break;
+	if ((i = NameIndex_Alloc (&sfx_index, aliasname)) == -1)
+		Com_Error (ERR_FATAL, "S_FindName: out of sfx_t");
 
-	if (i == num_sfx)
-	{
-		if (num_sfx == MAX_SFX)
-			Com_Error (ERR_FATAL, "S_FindName: out of sfx_t");
-		num_sfx++;
-	}
+	if (i >= num_sfx)
+		num_sfx = i + 1;
 
 	sfx = &known_sfx[i];
 	memset (sfx, 0, sizeof (*sfx));
@@ -320,7 +351,7 @@ S_EndRegistration
 */
 void S_EndRegistration (void)
 {
-	int		i;
+	int		i, j;
 	sfx_t	*sfx;
 
 	// free any sounds not from this registration sequence
@@ -330,9 +361,18 @@ void S_EndRegistration (void)
 			continue;
 		if (sfx->registration_sequence != s_registration_sequence)
 		{
-			// don't need this sound
-			if (sfx->cache)	// it is possible to have a leftover
-				Zone_Free (sfx->cache);	// from a server that didn't finish loading
+			// don't need this sound, but it may be back on the next map
+			for (j = 0; j < MAX_CHANNELS; j++)
+			{
+				if (channels[j].sfx == sfx)
+				{
+					memset (&channels[j], 0, sizeof (channels[j]));
+					S_QueueChannel (SNDCMD_STOP, &channels[j], 0);
+				}
+			}
+
+			S_ReleaseSound (sfx);
+			NameIndex_Free (&sfx_index, i);
 			memset (sfx, 0, sizeof (*sfx));
 		}
 	}
@@ -345,6 +385,17 @@ void S_EndRegistration (void)
 		S_LoadSound (sfx);
 	}
 
+	if (sound_started)
+	{
+		// the mixer has to be done with anything that's about to be freed
+		S_CommitCommands ();
+
+		SNDDMA_LockMixer ();
+		S_ApplyCommands ();
+		S_TrimSoundCache ();
+		SNDDMA_UnlockMixer ();
+	}
+
 	s_registering = false;
 }
 
@@ -361,6 +412,7 @@ channel_t *S_PickChannel (int entnum, int entchannel)
 	int			ch_idx;
 	int			first_to_die;
 	int			life_left;
+	int			priority, lowest_priority;
 	channel_t	*ch;
 
 	if (entchannel < 0)
@@ -369,6 +421,7 @@ channel_t *S_PickChannel (int entnum, int entchannel)
 	// Check for replacement sound, or find the best one to replace
 	first_to_die = -1;
 	life_left = 0x7fffffff;
+	lowest_priority = 0x7fffffff;
 
 	for (ch_idx = 0; ch_idx < MAX_CHANNELS; ch_idx++)
 	{
@@ -384,8 +437,12 @@ channel_t *S_PickChannel (int entnum, int entchannel)
 		if (channels[ch_idx].entnum == cl.playernum + 1 && entnum != cl.playernum + 1 && channels[ch_idx].sfx)
 			continue;
 
-		if (channels[ch_idx].end - paintedtime < life_left)
+		// a free channel, else the least audible, else the one closest to finishing
+		priority = channels[ch_idx].sfx ? channels[ch_idx].priority : -1;
+
+		if (priority < lowest_priority || (priority == lowest_priority && channels[ch_idx].end - paintedtime < life_left))
 		{
+			lowest_priority = priority;
 			life_left = channels[ch_idx].end - paintedtime;
 			first_to_die = ch_idx;
 		}
@@ -454,6 +511,38 @@ void S_SpatializeOrigin (vec3_t origin, float master_vol, float dist_mult, int *
 		*left_vol = 0;
 }
 
+/*
+=================
+S_SpatializeOrigins
+
+S_SpatializeOrigin for a batch of origins held as separate x, y and z arrays so that the loop has no
+branches on the data and can be vectorized; the cls.state check is left to the caller
+=================
+*/
+void S_SpatializeOrigins (int count, float *x, float *y, float *z, float master_vol, float dist_mult, int *left_vol, int *right_vol)
+{
+	int i;
+
+	// no attenuation = no spatialization
+	float sepscale = (dma.channels == 1 || !dist_mult) ? 0.0f : 0.5f;
+
+	for (i = 0; i < count; i++)
+	{
+		float dx = x[i] - listener_origin[0];
+		float dy = y[i] - listener_origin[1];
+		float dz = z[i] - listener_origin[2];
+		float dist = sqrt (dx * dx + dy * dy + dz * dz);
+		float dot = (dist > 0) ? (dx * listener_right[0] + dy * listener_right[1] + dz * listener_right[2]) / dist : 0;
+		float atten = (dist > SOUND_FULLVOLUME) ? 1.0f - (dist - SOUND_FULLVOLUME) * dist_mult : 1.0f;
+		int rvol = (int) (master_vol * atten * (sepscale ? sepscale * (1.0f + dot) : 1.0f));
+		int lvol = (int) (master_vol * atten * (sepscale ? sepscale * (1.0f - dot) : 1.0f));
+
+		right_vol[i] = (rvol < 0) ? 0 : rvol;
+		left_vol[i] = (lvol < 0) ? 0 : lvol;
+	}
+}
+
+
 /*
 =================
 S_Spatialize
@@ -482,6 +571,136 @@ void S_Spatialize (channel_t *ch)
 }
 
 
+/*
+==============================================================================
+
+VIRTUAL VOICES
+
+every playing sound has a channel but only the s_voices most audible ones are
+mixed; the rest advance their position in S_PaintChannels without being
+painted, so they pick up at the right point if they get a real voice later.
+priority is the louder of the spatialized left and right volumes, which
+already takes in distance, attenuation and master volume, and the player's
+own sounds always come first.
+
+==============================================================================
+*/
+
+static int S_ChannelPriority (channel_t *ch)
+{
+	if (!ch->sfx)
+		return -1;
+
+	// anything coming from the view entity always gets a voice
+	if (ch->entnum == cl.playernum + 1)
+		return 256;
+
+	return (ch->leftvol > ch->rightvol) ? ch->leftvol : ch->rightvol;
+}
+
+
+static int S_MaxVoices (void)
+{
+	if (s_voices->value < 1)
+		Cvar_SetValue ("s_voices", 1);
+	else if (s_voices->value > MAX_CHANNELS)
+		Cvar_SetValue ("s_voices", MAX_CHANNELS);
+
+	return (int) s_voices->value;
+}
+
+
+/*
+=================
+S_AssignVoice
+
+for channels started between updates; takes a real voice from a less audible channel if they're all in use
+=================
+*/
+void S_AssignVoice (channel_t *ch)
+{
+	int			i;
+	int			numreal = 0;
+	channel_t	*lowest = NULL;
+
+	ch->priority = S_ChannelPriority (ch);
+	ch->realvoice = false;
+
+	// inaudible sounds stay virtual
+	if (ch->priority <= 0)
+		return;
+
+	for (i = 0; i < MAX_CHANNELS; i++)
+	{
+		channel_t *other = &channels[i];
+
+		if (other == ch || !other->sfx || !other->realvoice)
+			continue;
+
+		numreal++;
+
+		if (!lowest || other->priority < lowest->priority)
+			lowest = other;
+	}
+
+	if (numreal < S_MaxVoices ())
+		ch->realvoice = true;
+	else if (lowest && lowest->priority < ch->priority)
+	{
+		lowest->realvoice = false;
+		ch->realvoice = true;
+	}
+}
+
+
+static int S_VoiceSortFunc (const channel_t **a, const channel_t **b)
+{
+	// most audible first
+	return (*b)->priority - (*a)->priority;
+}
+
+
+/*
+=================
+S_AllocateVoices
+
+called once per update after everything has been spatialized; the most audible channels get the real voices
+=================
+*/
+static void S_AllocateVoices (void)
+{
+	static channel_t *audible[MAX_CHANNELS];
+	int i, numaudible = 0, numactive = 0;
+	int maxvoices = S_MaxVoices ();
+
+	for (i = 0; i < MAX_CHANNELS; i++)
+	{
+		channel_t *ch = &channels[i];
+
+		ch->realvoice = false;
+
+		if (!ch->sfx)
+			continue;
+
+		numactive++;
+
+		if ((ch->priority = S_ChannelPriority (ch)) > 0)
+			audible[numaudible++] = ch;
+	}
+
+	// no need to sort if everything fits
+	if (numaudible > maxvoices)
+		qsort (audible, numaudible, sizeof (channel_t *), (sortfunc_t) S_VoiceSortFunc);
+	else maxvoices = numaudible;
+
+	for (i = 0; i < maxvoices; i++)
+		audible[i]->realvoice = true;
+
+	s_numrealvoices = maxvoices;
+	s_numvirtualvoices = numactive - maxvoices;
+}
+
+
 /*
 =================
 S_AllocPlaysound
@@ -560,10 +779,14 @@ void S_IssuePlaysound (playsound_t *ps)
 	ch->fixed_origin = ps->fixed_origin;
 
 	S_Spatialize (ch);
+	S_AssignVoice (ch);
 
 	ch->pos = 0;
 	sc = S_LoadSound (ch->sfx);
-	ch->end = paintedtime + sc->length;
+	ch->end = ((ps->begin > paintedtime) ? ps->begin : paintedtime) + sc->length;
+	ch->serial = ++s_channelserial;
+
+	S_QueueChannel (SNDCMD_START, ch, ps->begin);
 
 	// free the playsound
 	S_FreePlaysound (ps);
@@ -744,22 +967,18 @@ S_ClearBuffer
 */
 void S_ClearBuffer (void)
 {
-	int		clear;
+	sndcmd_t	cmd;
 
 	if (!sound_started)
 		return;
 
 	s_rawend = 0;
 
-	if (dma.samplebits == 8)
-		clear = 0x80;
-	else
-		clear = 0;
+	memset (&cmd, 0, sizeof (cmd));
+	cmd.type = SNDCMD_CLEARBUFFER;
 
-	SNDDMA_BeginPainting ();
-	if (dma.buffer)
-		memset (dma.buffer, clear, dma.samples * dma.samplebits / 8);
-	SNDDMA_Submit ();
+	S_QueueCommand (&cmd);
+	S_CommitCommands ();
 }
 
 /*
@@ -772,6 +991,7 @@ void CDAudio_Stop (void);
 void S_StopAllSounds (void)
 {
 	int		i;
+	sndcmd_t	cmd;
 
 	// this should also stop music
 	CDAudio_Stop ();
@@ -795,6 +1015,10 @@ void S_StopAllSounds (void)
 	// clear all the channels
 	memset (channels, 0, sizeof (channels));
 
+	memset (&cmd, 0, sizeof (cmd));
+	cmd.type = SNDCMD_STOPALL;
+	S_QueueCommand (&cmd);
+
 	S_ClearBuffer ();
 }
 
@@ -809,13 +1033,20 @@ as the entities are sent to the client
 */
 void S_AddLoopSounds (void)
 {
-	int			i, j;
-	int			sounds[MAX_EDICTS];
-	int			left, right, left_total, right_total;
+	// looping entities in SoA form for S_SpatializeOrigins
+	static float	loop_x[MAX_EDICTS], loop_y[MAX_EDICTS], loop_z[MAX_EDICTS];
+	static int		loop_sound[MAX_EDICTS];
+	static int		loop_left[MAX_EDICTS], loop_right[MAX_EDICTS];
+
+	// per-sound accumulators and the sounds in the order they were first seen
+	static int		left_total[MAX_SOUNDS], right_total[MAX_SOUNDS];
+	static int		sound_order[MAX_SOUNDS];
+
+	int			i;
+	int			numloops, numsounds;
 	channel_t	*ch;
 	sfx_t		*sfx;
 	sfxcache_t	*sc;
-	int			num;
 	entity_state_t	*ent;
 
 	if (cl_paused->value)
@@ -827,64 +1058,77 @@ void S_AddLoopSounds (void)
 	if (!cl.sound_prepped)
 		return;
 
-	for (i = 0; i < cl.frame.num_entities; i++)
+	// gather every entity with a playable looping sound
+	for (i = 0, numloops = 0, numsounds = 0; i < cl.frame.num_entities; i++)
 	{
-		num = (cl.frame.parse_entities + i)&(MAX_PARSE_ENTITIES - 1);
-		ent = &cl_parse_entities[num];
-		sounds[i] = ent->sound;
-	}
+		ent = &cl_parse_entities[(cl.frame.parse_entities + i) & (MAX_PARSE_ENTITIES - 1)];
 
-	for (i = 0; i < cl.frame.num_entities; i++)
-	{
-		if (!sounds[i])
+		if (!ent->sound)
 			continue;
 
-		sfx = cl.sound_precache[sounds[i]];
-		if (!sfx)
+		if ((sfx = cl.sound_precache[ent->sound]) == NULL)
 			continue;		// bad sound effect
-		sc = sfx->cache;
-		if (!sc)
+		if (!sfx->cache)
 			continue;
 
-		num = (cl.frame.parse_entities + i)&(MAX_PARSE_ENTITIES - 1);
-		ent = &cl_parse_entities[num];
+		loop_x[numloops] = ent->origin[0];
+		loop_y[numloops] = ent->origin[1];
+		loop_z[numloops] = ent->origin[2];
+		loop_sound[numloops] = ent->sound;
+		numloops++;
 
-		// find the total contribution of all sounds of this type
-		S_SpatializeOrigin (ent->origin, 255.0, SOUND_LOOPATTENUATE,
-			&left_total, &right_total);
-		for (j = i + 1; j < cl.frame.num_entities; j++)
+		// the first entity with this sound; channels are allocated in this order
+		if (!left_total[ent->sound] && !right_total[ent->sound])
 		{
-			if (sounds[j] != sounds[i])
-				continue;
-			sounds[j] = 0;	// don't check this again later
+			left_total[ent->sound] = right_total[ent->sound] = -1;
+			sound_order[numsounds++] = ent->sound;
+		}
+	}
 
-			num = (cl.frame.parse_entities + j)&(MAX_PARSE_ENTITIES - 1);
-			ent = &cl_parse_entities[num];
+	S_SpatializeOrigins (numloops, loop_x, loop_y, loop_z, 255.0, SOUND_LOOPATTENUATE, loop_left, loop_right);
 
-			S_SpatializeOrigin (ent->origin, 255.0, SOUND_LOOPATTENUATE,
-				&left, &right);
-			left_total += left;
-			right_total += right;
-		}
+	// find the total contribution of all sounds of each type
+	for (i = 0; i < numsounds; i++)
+		left_total[sound_order[i]] = right_total[sound_order[i]] = 0;
+
+	for (i = 0; i < numloops; i++)
+	{
+		left_total[loop_sound[i]] += loop_left[i];
+		right_total[loop_sound[i]] += loop_right[i];
+	}
+
+	for (i = 0; i < numsounds; i++)
+	{
+		int sound = sound_order[i];
+		int left = left_total[sound];
+		int right = right_total[sound];
+
+		// leave the accumulators clear for the next frame
+		left_total[sound] = right_total[sound] = 0;
 
-		if (left_total == 0 && right_total == 0)
+		if (left == 0 && right == 0)
 			continue;		// not audible
 
 		// allocate a channel
-		ch = S_PickChannel (0, 0);
-		if (!ch)
+		if ((ch = S_PickChannel (0, 0)) == NULL)
+		{
+			// clear the rest too
+			for (; i < numsounds; i++)
+				left_total[sound_order[i]] = right_total[sound_order[i]] = 0;
+
 			return;
+		}
+
+		sfx = cl.sound_precache[sound];
+		sc = sfx->cache;
 
-		if (left_total > 255)
-			left_total = 255;
-		if (right_total > 255)
-			right_total = 255;
-		ch->leftvol = left_total;
-		ch->rightvol = right_total;
+		ch->leftvol = (left > 255) ? 255 : left;
+		ch->rightvol = (right > 255) ? 255 : right;
 		ch->autosound = true;	// remove next frame
 		ch->sfx = sfx;
 		ch->pos = paintedtime % sc->length;
 		ch->end = paintedtime + sc->length - ch->pos;
+		ch->priority = S_ChannelPriority (ch);
 	}
 }
 
@@ -894,21 +1138,22 @@ void S_AddLoopSounds (void)
 ============
 S_RawSamples
 
-Cinematic streaming and voice over network
+Cinematic streaming and voice over network; music streams pass their own volume
 ============
 */
-void S_RawSamples (int samples, int rate, int width, int channels, byte *data)
+void S_RawSamplesVolume (int samples, int rate, int width, int channels, byte *data, float volume)
 {
 	// we could do scale tables for this stuff
 	int		i;
 	int		src, dst;
 	float	scale;
+	int		rawend;
 
 	if (!sound_started)
 		return;
 
-	if (s_rawend < paintedtime)
-		s_rawend = paintedtime;
+	// the mixer may be reading the ring, so nothing new is visible to it until the end
+	rawend = (s_rawend < paintedtime) ? paintedtime : s_rawend;
 
 	scale = (float) rate / dma.speed;
 
@@ -920,10 +1165,10 @@ void S_RawSamples (int samples, int rate, int width, int channels, byte *data)
 			// optimized case
 			for (i = 0; i < samples; i++)
 			{
-				dst = s_rawend & (MAX_RAW_SAMPLES - 1);
-				s_rawend++;
-				s_rawsamples[dst].left = (LittleShort (((short *) data)[i * 2]) << 8) * s_volume->value;
-				s_rawsamples[dst].right = (LittleShort (((short *) data)[i * 2 + 1]) << 8) * s_volume->value;
+				dst = rawend & (MAX_RAW_SAMPLES - 1);
+				rawend++;
+				s_rawsamples[dst].left = (LittleShort (((short *) data)[i * 2]) << 8) * volume;
+				s_rawsamples[dst].right = (LittleShort (((short *) data)[i * 2 + 1]) << 8) * volume;
 			}
 		}
 		else
@@ -935,10 +1180,10 @@ void S_RawSamples (int samples, int rate, int width, int channels, byte *data)
 				if (src >= samples)
 					break;
 
-				dst = s_rawend & (MAX_RAW_SAMPLES - 1);
-				s_rawend++;
-				s_rawsamples[dst].left = (LittleShort (((short *) data)[src * 2]) << 8) * s_volume->value;
-				s_rawsamples[dst].right = (LittleShort (((short *) data)[src * 2 + 1]) << 8) * s_volume->value;
+				dst = rawend & (MAX_RAW_SAMPLES - 1);
+				rawend++;
+				s_rawsamples[dst].left = (LittleShort (((short *) data)[src * 2]) << 8) * volume;
+				s_rawsamples[dst].right = (LittleShort (((short *) data)[src * 2 + 1]) << 8) * volume;
 			}
 		}
 	}
@@ -951,10 +1196,10 @@ void S_RawSamples (int samples, int rate, int width, int channels, byte *data)
 			if (src >= samples)
 				break;
 
-			dst = s_rawend & (MAX_RAW_SAMPLES - 1);
-			s_rawend++;
-			s_rawsamples[dst].left = (LittleShort (((short *) data)[src]) << 8) * s_volume->value;
-			s_rawsamples[dst].right = (LittleShort (((short *) data)[src]) << 8) * s_volume->value;
+			dst = rawend & (MAX_RAW_SAMPLES - 1);
+			rawend++;
+			s_rawsamples[dst].left = (LittleShort (((short *) data)[src]) << 8) * volume;
+			s_rawsamples[dst].right = (LittleShort (((short *) data)[src]) << 8) * volume;
 		}
 	}
 	else if (channels == 2 && width == 1)
@@ -966,10 +1211,10 @@ void S_RawSamples (int samples, int rate, int width, int channels, byte *data)
 			if (src >= samples)
 				break;
 
-			dst = s_rawend & (MAX_RAW_SAMPLES - 1);
-			s_rawend++;
-			s_rawsamples[dst].left = (((char *) data)[src * 2] << 16) * s_volume->value;
-			s_rawsamples[dst].right = (((char *) data)[src * 2 + 1] << 16) * s_volume->value;
+			dst = rawend & (MAX_RAW_SAMPLES - 1);
+			rawend++;
+			s_rawsamples[dst].left = (((char *) data)[src * 2] << 16) * volume;
+			s_rawsamples[dst].right = (((char *) data)[src * 2 + 1] << 16) * volume;
 		}
 	}
 	else if (channels == 1 && width == 1)
@@ -981,12 +1226,20 @@ void S_RawSamples (int samples, int rate, int width, int channels, byte *data)
 			if (src >= samples)
 				break;
 
-			dst = s_rawend & (MAX_RAW_SAMPLES - 1);
-			s_rawend++;
-			s_rawsamples[dst].left = ((((byte *) data)[src] - 128) << 16) * s_volume->value;
-			s_rawsamples[dst].right = ((((byte *) data)[src] - 128) << 16) * s_volume->value;
+			dst = rawend & (MAX_RAW_SAMPLES - 1);
+			rawend++;
+			s_rawsamples[dst].left = ((((byte *) data)[src] - 128) << 16) * volume;
+			s_rawsamples[dst].right = ((((byte *) data)[src] - 128) << 16) * volume;
 		}
 	}
+
+	s_rawend = rawend;
+}
+
+
+void S_RawSamples (int samples, int rate, int width, int channels, byte *data)
+{
+	S_RawSamplesVolume (samples, rate, width, channels, data, s_volume->value);
 }
 
 
@@ -1006,21 +1259,47 @@ void S_Update (vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
 	channel_t	*ch;
 	channel_t	*combine;
 
+	playsound_t	*ps;
+	sndcmd_t	cmd;
+
 	if (!sound_started)
 		return;
 
+	// the mixer can't shut sound down or stop sounds itself
+	if (s_mixerfailed)
+	{
+		Com_Printf ("lost the sound device: Lock failed with error '%s'\n", SNDDMA_FailReason ());
+		S_Shutdown ();
+		return;
+	}
+
+	if (s_mixerwrapped)
+	{
+		s_mixerwrapped = false;
+		S_StopAllSounds ();
+	}
+
 	// if the laoding plaque is up, clear everything
 	// out to make sure we aren't looping a dirty
-	// dma buffer while loading
+	// dma buffer while loading; a mixer thread keeps
+	// painting so it has nothing to clear
 	if (cls.disable_screen)
 	{
-		S_ClearBuffer ();
+		if (!s_mixerthread)
+			S_ClearBuffer ();
 		return;
 	}
 
 	// rebuild scale tables if volume is modified
 	if (s_volume->modified)
-		S_InitScaletable ();
+	{
+		memset (&cmd, 0, sizeof (cmd));
+		cmd.type = SNDCMD_VOLUME;
+		cmd.volume = s_volume->value;
+
+		S_QueueCommand (&cmd);
+		s_volume->modified = false;
+	}
 
 	VectorCopy (origin, listener_origin);
 	VectorCopy (forward, listener_forward);
@@ -1041,17 +1320,34 @@ void S_Update (vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
 			memset (ch, 0, sizeof (*ch));
 			continue;
 		}
+
+		// the mixer stops one-shot sounds when they run out
+		if (S_MixerFinished (ch))
+		{
+			memset (ch, 0, sizeof (*ch));
+			continue;
+		}
+
 		S_Spatialize (ch);         // respatialize channel
-		if (!ch->leftvol && !ch->rightvol)
+
+		// inaudible sounds are kept as virtual voices in case they come back into range, unless they loop forever
+		if (!ch->leftvol && !ch->rightvol && ch->sfx->cache && ch->sfx->cache->loopstart >= 0)
 		{
 			memset (ch, 0, sizeof (*ch));
 			continue;
 		}
 	}
 
+	// start any playsounds; the mixer holds back the ones that begin later
+	while ((ps = s_pendingplays.next) != &s_pendingplays)
+		S_IssuePlaysound (ps);
+
 	// add loopsounds
 	S_AddLoopSounds ();
 
+	// hand out the real voices
+	S_AllocateVoices ();
+
 	// debugging output
 	if (s_show->value)
 	{
@@ -1064,11 +1360,27 @@ void S_Update (vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
 				total++;
 			}
 
-		Com_Printf ("----(%i)---- painted: %i\n", total, paintedtime);
+		Com_Printf ("----(%i)---- painted: %i, %i real voices, %i virtual\n", total, paintedtime, s_numrealvoices, s_numvirtualvoices);
+	}
+
+	// top up the raw samples from any music
+	S_UpdateStream ();
+
+	// send the frame to the mixer
+	for (i = 0, ch = channels; i < MAX_CHANNELS; i++, ch++)
+	{
+		if (!ch->sfx)
+			S_QueueChannel (SNDCMD_STOP, ch, 0);
+		else if (ch->autosound)
+			S_QueueChannel (SNDCMD_START, ch, 0);
+		else S_QueueChannel (SNDCMD_UPDATE, ch, 0);
 	}
 
+	S_CommitCommands ();
+
 	// mix some sound
-	S_Update_ ();
+	if (!s_mixerthread)
+		S_MixerFrame ();
 }
 
 void GetSoundtime (void)
@@ -1090,10 +1402,11 @@ void GetSoundtime (void)
 
 		if (paintedtime > 0x40000000)
 		{
-			// time to chop things off to avoid 32 bit limits
+			// time to chop things off to avoid 32 bit limits; the client stops its own channels when it sees this
 			buffers = 0;
 			paintedtime = fullsamples;
-			S_StopAllSounds ();
+			S_StopAllVoices ();
+			s_mixerwrapped = true;
 		}
 	}
 	oldsamplepos = samplepos;
@@ -1121,7 +1434,8 @@ void S_Update_ (void)
 	// check to make sure that we haven't overshot
 	if (paintedtime < soundtime)
 	{
-		Com_DPrintf ("S_Update_ : overflow\n");
+		// counted rather than printed since this is usually on the mixer thread
+		s_mixeroverflows++;
 		paintedtime = soundtime;
 	}
 
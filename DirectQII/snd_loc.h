@@ -87,6 +87,9 @@ typedef struct channel_s
 	int			master_vol;		// 0-255 master volume
 	qboolean	fixed_origin;	// use origin instead of fetching entnum's origin
 	qboolean	autosound;		// from an entity->sound, cleared each frame
+	int			priority;		// from S_ChannelPriority; -1 for a free channel
+	qboolean	realvoice;		// mixed; virtual voices only keep time until they're audible enough to get a real one
+	int			serial;			// from the last SNDCMD_START, so the mixer can say when a one-shot sound has finished
 } channel_t;
 
 typedef struct wavinfo_s
@@ -121,9 +124,22 @@ void SNDDMA_BeginPainting (void);
 
 void SNDDMA_Submit (void);
 
+// what made SNDDMA_BeginPainting set s_mixerfailed
+const char *SNDDMA_FailReason (void);
+
+// runs S_MixerFrame on its own thread; without one, S_Update mixes inline
+qboolean SNDDMA_StartMixer (void);
+void SNDDMA_StopMixer (void);
+
+// keeps the mixer thread out while the dma buffer or sound data is changed under it
+void SNDDMA_LockMixer (void);
+void SNDDMA_UnlockMixer (void);
+
 //====================================================================
 
-#define	MAX_CHANNELS			32
+// channels are virtual voices; at most s_voices of them are mixed
+#define	MAX_CHANNELS			128
+#define	MAX_VOICES				32
 extern	channel_t   channels[MAX_CHANNELS];
 
 extern	int		paintedtime;
@@ -135,7 +151,7 @@ extern	vec3_t	listener_up;
 extern	dma_t	dma;
 extern	playsound_t	s_pendingplays;
 
-#define	MAX_RAW_SAMPLES	8192
+#define	MAX_RAW_SAMPLES	16384
 extern	portable_samplepair_t	s_rawsamples[MAX_RAW_SAMPLES];
 
 extern cvar_t	*s_volume;
@@ -143,19 +159,91 @@ extern cvar_t	*s_nosound;
 extern cvar_t	*s_show;
 extern cvar_t	*s_mixahead;
 extern cvar_t	*s_testsound;
+extern cvar_t	*s_resample;
+extern cvar_t	*s_soundcache;
+
+extern int		sound_started;
 
 wavinfo_t GetWavinfo (char *name, byte *wav, int wavlength);
 
-void S_InitScaletable (void);
+void S_RawSamplesVolume (int samples, int rate, int width, int channels, byte *data, float volume);
+
+// snd_stream.c
+void S_UpdateStream (void);
+void S_Music_f (void);
+
+void S_InitScaletable (float volume);
 
 sfxcache_t *S_LoadSound (sfx_t *s);
 
+// converted sound data is shared and outlives the sfx_t that loaded it
+void S_ReleaseSound (sfx_t *sfx);
+void S_TrimSoundCache (void);
+void S_SoundCache_f (void);
+void S_ResampleBench_f (void);
+
 void S_IssuePlaysound (playsound_t *ps);
 
 void S_PaintChannels (int endtime);
 
+/*
+====================================================================
+
+MIXER COMMANDS
+
+the client frame owns channels[] and tells the mixer what to play through a
+single-producer, single-consumer queue; the mixer owns its own copy of each
+channel along with paintedtime, the dma buffer and the paint buffer.
+
+====================================================================
+*/
+
+typedef enum
+{
+	SNDCMD_START,			// (re)start a channel
+	SNDCMD_UPDATE,			// new spatialization and voice
+	SNDCMD_STOP,
+	SNDCMD_STOPALL,
+	SNDCMD_CLEARBUFFER,		// silence the dma buffer
+	SNDCMD_VOLUME			// rebuild the scale table
+} sndcmdtype_t;
+
+typedef struct sndcmd_s
+{
+	sndcmdtype_t	type;
+	int			channel;
+	sfxcache_t	*sc;
+	int			begin;			// sample time to start at; autosounds start in phase with paintedtime instead
+	int			serial;
+	int			leftvol;
+	int			rightvol;
+	qboolean	realvoice;
+	qboolean	autosound;
+	float		volume;
+} sndcmd_t;
+
+// client side; commands aren't seen by the mixer until they're committed
+void S_QueueCommand (sndcmd_t *cmd);
+void S_QueueChannel (sndcmdtype_t type, channel_t *ch, int begin);
+void S_CommitCommands (void);
+qboolean S_MixerFinished (channel_t *ch);
+
+// mixer side
+void S_ApplyCommands (void);
+void S_StopAllVoices (void);
+void S_MixerFrame (void);
+void S_Update_ (void);
+
+extern qboolean s_mixerthread;		// S_MixerFrame runs on its own thread
+extern qboolean	s_mixerfailed;		// the device was lost; the client shuts sound down
+extern qboolean	s_mixerwrapped;		// paintedtime was reset; the client stops everything
+extern int		s_mixeroverflows;
+
 // picks a channel based on priorities, empty slots, number of channels
 channel_t *S_PickChannel (int entnum, int entchannel);
 
 // spatializes a channel
 void S_Spatialize (channel_t *ch);
+
+// gives a newly started channel a real voice if it's audible enough
+void S_AssignVoice (channel_t *ch);
@@ -22,56 +22,227 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "client.h"
 #include "snd_loc.h"
 
-int			cache_full_cycle;
+/*
+==============================================================================
+
+RESAMPLING
+
+sounds are converted to the output rate once when they're loaded.  the
+default is a windowed-sinc filter evaluated as a polyphase table, which
+doesn't alias when decimating and doesn't zipper when upsampling the 11k
+sounds most of the game uses; s_resample 0 gives the old nearest-neighbour
+decimation.
+
+==============================================================================
+*/
+
+#if defined (_M_IX86) || defined (_M_X64) || defined (__SSE__)
+#include <xmmintrin.h>
+#define SND_SSE
+#endif
+
+#define	SINC_TAPS		16		// per phase; must be a multiple of 4 for the SSE kernel
+#define	SINC_PHASES		256		// sub-sample positions in the table
+
+cvar_t *s_resample;
+cvar_t *s_soundcache;
+
+// the bench turns this off to time the scalar kernel
+static qboolean snd_usesse = true;
+
+// one row of SINC_TAPS weights per phase, rebuilt when the cutoff changes
+static float snd_sinctable[SINC_PHASES][SINC_TAPS];
+static float snd_sinccutoff = 0;
+
+
+static void S_BuildSincTable (float cutoff)
+{
+	int phase, tap;
+
+	if (cutoff == snd_sinccutoff)
+		return;
+
+	for (phase = 0; phase < SINC_PHASES; phase++)
+	{
+		float *row = snd_sinctable[phase];
+		double sum = 0;
+
+		for (tap = 0; tap < SINC_TAPS; tap++)
+		{
+			// distance from the output position to this input sample, in input samples
+			double x = (tap - (SINC_TAPS / 2 - 1)) - (double) phase / SINC_PHASES;
+			double w = (x / (SINC_TAPS / 2) + 1) * 0.5;	// blackman window over [-taps/2, taps/2]
+			double s = (x == 0) ? 1 : sin (M_PI * x * cutoff) / (M_PI * x * cutoff);
+
+			if (w < 0 || w > 1)
+				row[tap] = 0;
+			else row[tap] = s * (0.42 - 0.5 * cos (2 * M_PI * w) + 0.08 * cos (4 * M_PI * w));
+
+			sum += row[tap];
+		}
+
+		// unity gain at every phase so there's no ripple at DC
+		for (tap = 0; tap < SINC_TAPS; tap++)
+			row[tap] /= sum;
+	}
+
+	snd_sinccutoff = cutoff;
+}
+
+
+static float S_SincKernel (const float *in, const float *row)
+{
+#ifdef SND_SSE
+	if (snd_usesse)
+	{
+		__m128 acc = _mm_mul_ps (_mm_loadu_ps (&in[0]), _mm_loadu_ps (&row[0]));
+		float out[4];
+		int tap;
+
+		for (tap = 4; tap < SINC_TAPS; tap += 4)
+			acc = _mm_add_ps (acc, _mm_mul_ps (_mm_loadu_ps (&in[tap]), _mm_loadu_ps (&row[tap])));
+
+		_mm_storeu_ps (out, acc);
+
+		return (out[0] + out[1]) + (out[2] + out[3]);
+	}
+	else
+#endif
+	{
+		float acc[4] = {0, 0, 0, 0};
+		int tap;
+
+		// same summation order as the SSE kernel
+		for (tap = 0; tap < SINC_TAPS; tap += 4)
+		{
+			acc[0] += in[tap + 0] * row[tap + 0];
+			acc[1] += in[tap + 1] * row[tap + 1];
+			acc[2] += in[tap + 2] * row[tap + 2];
+			acc[3] += in[tap + 3] * row[tap + 3];
+		}
+
+		return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+	}
+}
+
+
+/*
+================
+S_ResampledLength
+================
+*/
+int S_ResampledLength (int samples, int inrate, int outrate)
+{
+	float stepscale = (float) inrate / outrate;	// this is usually 0.5, 1, or 2
+
+	return samples / stepscale;
+}
+
+
+/*
+================
+S_ResampledSize
+
+bytes of sample data ResampleSfx will write; the filtered path always produces 16 bit
+================
+*/
+int S_ResampledSize (wavinfo_t *info, int outrate, int quality)
+{
+	int width = (quality && info->rate != outrate) ? 2 : info->width;
+
+	return S_ResampledLength (info->samples, info->rate, outrate) * width;
+}
 
-byte *S_Alloc (int size);
 
 /*
 ================
 ResampleSfx
+
+sc comes in with the wav's length, loopstart, rate and width and goes out at outrate
 ================
 */
-void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, byte *data)
+void ResampleSfx (sfxcache_t *sc, byte *data, int outrate, int quality)
 {
+	int		inrate = sc->speed;
+	int		inwidth = sc->width;
+	int		incount = sc->length;
 	int		outcount;
-	int		srcsample;
-	float	stepscale;
 	int		i;
-	int		sample, samplefrac, fracstep;
-	sfxcache_t	*sc;
 
-	sc = sfx->cache;
-	if (!sc)
-		return;
-
-	stepscale = (float) inrate / dma.speed;	// this is usually 0.5, 1, or 2
-
-	outcount = sc->length / stepscale;
+	outcount = S_ResampledLength (sc->length, inrate, outrate);
 	sc->length = outcount;
 
 	if (sc->loopstart != -1)
-		sc->loopstart = sc->loopstart / stepscale;
+		sc->loopstart = S_ResampledLength (sc->loopstart, inrate, outrate);
 
-	sc->speed = dma.speed;
-	sc->width = inwidth;
+	sc->speed = outrate;
 	sc->stereo = 0;
 
-	// resample / decimate to the current source rate
-	if (stepscale == 1 && inwidth == 1 && sc->width == 1)
+	if (inrate == outrate)
 	{
-		// fast special case
+		// no rate change; just convert to what the mixer expects
+		if (inwidth == 2)
+		{
+			for (i = 0; i < outcount; i++)
+				((short *) sc->data)[i] = LittleShort (((short *) data)[i]);
+		}
+		else
+		{
+			for (i = 0; i < outcount; i++)
+				((signed char *) sc->data)[i] = (int) ((unsigned char) (data[i]) - 128);
+		}
+	}
+	else if (quality)
+	{
+		// windowed sinc; the input goes to float with enough silence either side to run the filter off the ends
+		int		mark = Load_GetMark ();
+		float	*in = (float *) Load_AllocMemory ((incount + SINC_TAPS * 2) * sizeof (float));
+		double	step = (double) inrate / outrate;
+
+		memset (in, 0, (incount + SINC_TAPS * 2) * sizeof (float));
+
+		for (i = 0; i < incount; i++)
+		{
+			if (inwidth == 2)
+				in[i + SINC_TAPS] = LittleShort (((short *) data)[i]);
+			else
+				in[i + SINC_TAPS] = (int) ((unsigned char) (data[i]) - 128) << 8;
+		}
+
+		// cut off below the lower of the two nyquist frequencies
+		S_BuildSincTable (step > 1 ? 1.0f / step : 1.0f);
+
 		for (i = 0; i < outcount; i++)
-			((signed char *) sc->data)[i] = (int) ((unsigned char) (data[i]) - 128);
+		{
+			// the source position is recomputed rather than stepped so long sounds don't drift
+			double pos = i * step;
+			int whole = (int) pos;
+			int phase = (int) ((pos - whole) * SINC_PHASES);
+			float f = S_SincKernel (&in[whole + SINC_TAPS - (SINC_TAPS / 2 - 1)], snd_sinctable[phase]);
+			int sample = (f < 0) ? (int) (f - 0.5f) : (int) (f + 0.5f);
+
+			if (sample > 32767)
+				sample = 32767;
+			else if (sample < -32768)
+				sample = -32768;
+
+			((short *) sc->data)[i] = sample;
+		}
+
+		sc->width = 2;
+		Load_FreeToMark (mark);
 	}
 	else
 	{
-		// general case
+		// resample / decimate to the current source rate
+		int sample, samplefrac, fracstep;
+
 		samplefrac = 0;
-		fracstep = stepscale * 256;
+		fracstep = ((float) inrate / outrate) * 256;
 
 		for (i = 0; i < outcount; i++)
 		{
-			srcsample = samplefrac >> 8;
+			int srcsample = samplefrac >> 8;
 			samplefrac += fracstep;
 
 			if (inwidth == 2)
@@ -87,6 +258,194 @@ void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, byte *data)
 	}
 }
 
+
+/*
+==============================================================================
+
+SOUND CACHE
+
+resampled sound data is owned here rather than by the sfx_t, keyed by file,
+output rate and resampler, so a sound that drops out of one map's precache
+and comes back in the next, or that survives a snd_restart at the same rate,
+is reused instead of being loaded and converted again.  entries nothing
+refers to are kept up to s_soundcache kilobytes and then the least recently
+used are freed.
+
+==============================================================================
+*/
+
+#define	MAX_SNDCACHE	1024	// at least twice MAX_SFX so there are always unreferenced entries to evict
+
+typedef struct sndcache_s
+{
+	char		path[MAX_QPATH];
+	int			speed;
+	int			quality;
+	int			size;
+	int			refcount;		// sfx_t that point at this
+	int			lastused;		// snd_cachesequence when last released
+	sfxcache_t	*cache;
+} sndcache_t;
+
+static sndcache_t snd_cache[MAX_SNDCACHE];
+static int snd_cacheindexdata[NAMEINDEX_STORAGE (MAX_SNDCACHE)];
+static nameindex_t snd_cacheindex = {MAX_SNDCACHE, snd_cacheindexdata};
+static int snd_cachesequence = 0;
+
+static int snd_cachehits = 0;
+static int snd_cachemisses = 0;
+
+
+static void S_FreeCacheEntry (int i)
+{
+	Zone_Free (snd_cache[i].cache);
+	NameIndex_Free (&snd_cacheindex, i);
+	memset (&snd_cache[i], 0, sizeof (snd_cache[i]));
+}
+
+
+/*
+================
+S_TrimSoundCache
+
+frees unreferenced entries, oldest first, until they fit in s_soundcache; limit -1 uses the cvar
+================
+*/
+static void S_TrimSoundCacheTo (int limit, int needslots)
+{
+	for (;;)
+	{
+		int i, oldest = -1, unused = 0, freeslots = 0;
+
+		for (i = 0; i < MAX_SNDCACHE; i++)
+		{
+			if (!NameIndex_InUse (&snd_cacheindex, i))
+			{
+				freeslots++;
+				continue;
+			}
+
+			if (snd_cache[i].refcount)
+				continue;
+
+			unused += snd_cache[i].size;
+
+			if (oldest == -1 || snd_cache[i].lastused < snd_cache[oldest].lastused)
+				oldest = i;
+		}
+
+		if (oldest == -1 || (unused <= limit && freeslots >= needslots))
+			return;
+
+		S_FreeCacheEntry (oldest);
+	}
+}
+
+
+void S_TrimSoundCache (void)
+{
+	S_TrimSoundCacheTo (s_soundcache->value * 1024, 0);
+}
+
+
+/*
+================
+S_ReleaseSound
+
+drops the sfx_t's reference to its data; the data stays cached until it's trimmed
+================
+*/
+void S_ReleaseSound (sfx_t *sfx)
+{
+	int i;
+
+	if (!sfx->cache)
+		return;
+
+	for (i = 0; i < MAX_SNDCACHE; i++)
+	{
+		if (snd_cache[i].cache != sfx->cache)
+			continue;
+
+		if (snd_cache[i].refcount > 0)
+			snd_cache[i].refcount--;
+
+		snd_cache[i].lastused = ++snd_cachesequence;
+		break;
+	}
+
+	sfx->cache = NULL;
+}
+
+
+static sfxcache_t *S_FindCachedSound (char *path, int speed, int quality)
+{
+	int i;
+
+	for (i = NameIndex_Find (&snd_cacheindex, path); i != -1; i = NameIndex_FindNext (&snd_cacheindex, i))
+	{
+		sndcache_t *sc = &snd_cache[i];
+
+		if (sc->speed == speed && sc->quality == quality && !strcmp (sc->path, path))
+		{
+			sc->refcount++;
+			return sc->cache;
+		}
+	}
+
+	return NULL;
+}
+
+
+static void S_AddCachedSound (char *path, int speed, int quality, sfxcache_t *cache, int size)
+{
+	int i;
+
+	// there's always an unreferenced entry to make room with
+	if ((i = NameIndex_Alloc (&snd_cacheindex, path)) == -1)
+	{
+		S_TrimSoundCacheTo (0x7fffffff, 1);
+
+		if ((i = NameIndex_Alloc (&snd_cacheindex, path)) == -1)
+			Com_Error (ERR_FATAL, "S_AddCachedSound: out of cache entries");
+	}
+
+	strcpy (snd_cache[i].path, path);
+	snd_cache[i].speed = speed;
+	snd_cache[i].quality = quality;
+	snd_cache[i].size = size;
+	snd_cache[i].refcount = 1;
+	snd_cache[i].lastused = ++snd_cachesequence;
+	snd_cache[i].cache = cache;
+}
+
+
+/*
+================
+S_SoundCache_f
+================
+*/
+void S_SoundCache_f (void)
+{
+	int i, entries = 0, referenced = 0, total = 0, unused = 0;
+
+	for (i = 0; i < MAX_SNDCACHE; i++)
+	{
+		if (!NameIndex_InUse (&snd_cacheindex, i))
+			continue;
+
+		entries++;
+		total += snd_cache[i].size;
+
+		if (snd_cache[i].refcount)
+			referenced++;
+		else unused += snd_cache[i].size;
+	}
+
+	Com_Printf ("%i cached sounds (%i in use), %i kb, %i kb unreferenced\n", entries, referenced, total >> 10, unused >> 10);
+	Com_Printf ("%i hits, %i misses\n", snd_cachehits, snd_cachemisses);
+}
+
 //=============================================================================
 
 /*
@@ -100,10 +459,12 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	byte	*data;
 	wavinfo_t	info;
 	int		len;
-	float	stepscale;
 	sfxcache_t	*sc;
 	int		size;
 	char	*name;
+	int		mark;
+	int		quality;
+	qboolean	zonefile = false;
 
 	if (s->name[0] == '*')
 		return NULL;
@@ -125,9 +486,27 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	else
 		Com_sprintf (namebuffer, sizeof (namebuffer), "sound/%s", name);
 
+	quality = s_resample->value ? 1 : 0;
+
+	// see if it's been converted to this rate before
+	if ((sc = s->cache = S_FindCachedSound (namebuffer, dma.speed, quality)) != NULL)
+	{
+		snd_cachehits++;
+		return sc;
+	}
+
 	//	Com_Printf ("loading %s\n",namebuffer);
 
-	size = FS_LoadFile (namebuffer, (void **) &data);
+	// the file is only needed until it's been resampled into the cache so it goes in load memory, unless it's
+	// too big for what's left of that
+	mark = Load_GetMark ();
+	size = FS_LoadTempFile (namebuffer, (void **) &data);
+
+	if (!data && size > 0)
+	{
+		size = FS_LoadFile (namebuffer, (void **) &data);
+		zonefile = true;
+	}
 
 	if (!data)
 	{
@@ -139,34 +518,128 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	if (info.channels != 1)
 	{
 		Com_Printf ("%s is a stereo sample\n", s->name);
-		FS_FreeFile (data);
-		return NULL;
-	}
-
-	stepscale = (float) info.rate / dma.speed;
 
-	len = info.samples / stepscale;
-	len = len * info.width * info.channels;
+		if (zonefile)
+			FS_FreeFile (data);
+		else Load_FreeToMark (mark);
 
-	sc = s->cache = Zone_Alloc (len + sizeof (sfxcache_t));
-
-	if (!sc)
-	{
-		FS_FreeFile (data);
 		return NULL;
 	}
 
+	len = S_ResampledSize (&info, dma.speed, quality);
+
+	sc = Zone_Alloc (len + sizeof (sfxcache_t));
+
 	sc->length = info.samples;
 	sc->loopstart = info.loopstart;
 	sc->speed = info.rate;
 	sc->width = info.width;
 	sc->stereo = info.channels;
 
-	ResampleSfx (s, sc->speed, sc->width, data + info.dataofs);
+	ResampleSfx (sc, data + info.dataofs, dma.speed, quality);
+
+	if (zonefile)
+		FS_FreeFile (data);
+	else Load_FreeToMark (mark);
+
+	S_AddCachedSound (namebuffer, dma.speed, quality, sc, len + sizeof (sfxcache_t));
+	snd_cachemisses++;
+
+	return s->cache = sc;
+}
+
+
+/*
+==============
+S_ResampleBench_f
+
+converts every wav in the paks with each resampler; doesn't need a sound device
+==============
+*/
+void S_ResampleBench_f (void)
+{
+	char	**list;
+	int		numfiles, numsounds = 0, i;
+	int		outrate = (Cmd_Argc () > 1) ? atoi (Cmd_Argv (1)) : 44100;
+	double	times[3] = {0, 0, 0};
+	int		insamples = 0, outsamples = 0, maxdiff = 0;
+
+	if (outrate < 8000)
+	{
+		Com_Printf ("usage: s_resamplebench [rate]\n");
+		return;
+	}
+
+	if ((list = FS_ListPackFiles (".wav", &numfiles)) == NULL)
+		return;
+
+	for (i = 0; i < numfiles; i++)
+	{
+		int mark = Load_GetMark ();
+		byte *data;
+		int size = FS_LoadTempFile (list[i], (void **) &data);
+		sfxcache_t *sc[3];
+		wavinfo_t info;
+		int pass, j;
+
+		if (!data)
+			continue;
+
+		info = GetWavinfo (list[i], data, size);
+
+		if (info.channels != 1 || !info.rate || !info.width)
+		{
+			Load_FreeToMark (mark);
+			continue;
+		}
+
+		// nearest, sinc scalar and sinc SSE
+		for (pass = 0; pass < 3; pass++)
+		{
+			double t0;
+
+			sc[pass] = (sfxcache_t *) Load_AllocMemory (S_ResampledSize (&info, outrate, pass > 0) + sizeof (sfxcache_t));
+			sc[pass]->length = info.samples;
+			sc[pass]->loopstart = info.loopstart;
+			sc[pass]->speed = info.rate;
+			sc[pass]->width = info.width;
+
+			snd_usesse = (pass == 2);
+
+			t0 = Sys_Microseconds ();
+			ResampleSfx (sc[pass], data + info.dataofs, outrate, pass > 0);
+			times[pass] += Sys_Microseconds () - t0;
+		}
+
+		snd_usesse = true;
+
+		// the two kernels should agree to within rounding
+		if (sc[1]->width == 2)
+		{
+			for (j = 0; j < sc[1]->length; j++)
+			{
+				int diff = abs (((short *) sc[1]->data)[j] - ((short *) sc[2]->data)[j]);
+
+				if (diff > maxdiff)
+					maxdiff = diff;
+			}
+		}
+
+		insamples += info.samples;
+		outsamples += sc[0]->length;
+		numsounds++;
+
+		Load_FreeToMark (mark);
+	}
 
-	FS_FreeFile (data);
+	FS_FreeFileList (list);
 
-	return sc;
+	Com_Printf ("%i sounds, %i samples resampled to %i at %i hz\n", numsounds, insamples, outsamples, outrate);
+	Com_Printf ("nearest    : %8.2f ms\n", times[0] * 0.001);
+	Com_Printf ("sinc       : %8.2f ms\n", times[1] * 0.001);
+#ifdef SND_SSE
+	Com_Printf ("sinc (SSE) : %8.2f ms, max difference %i\n", times[2] * 0.001, maxdiff);
+#endif
 }
 
 
@@ -222,16 +222,221 @@ CHANNEL MIXING
 void S_PaintChannelFrom8 (channel_t *ch, sfxcache_t *sc, int endtime, int offset);
 void S_PaintChannelFrom16 (channel_t *ch, sfxcache_t *sc, int endtime, int offset);
 
+// the mixer's copy of each channel
+typedef struct mixvoice_s
+{
+	channel_t	ch;				// leftvol, rightvol, pos and end as the paint functions expect
+	sfxcache_t	*sc;			// NULL if not playing
+	int			begin;			// sample time it starts at
+} mixvoice_t;
+
+static mixvoice_t mixvoices[MAX_CHANNELS];
+
+// the serial of each channel's last one-shot sound to run out, written by the mixer and read by the client
+static volatile int mixfinished[MAX_CHANNELS];
+
+#define	SNDCMD_QUEUE	2048	// must be a power of 2 and hold at least a frame's worth
+
+static sndcmd_t s_cmdqueue[SNDCMD_QUEUE];
+
+// msvc gives volatile accesses acquire/release semantics, which is all the ordering the queue needs
+static volatile int s_cmdhead = 0;		// written by the client when it commits
+static volatile int s_cmdtail = 0;		// written by the mixer
+static int s_cmdwrite = 0;				// client's uncommitted position
+
+qboolean s_mixerthread = false;
+qboolean s_mixerfailed = false;
+qboolean s_mixerwrapped = false;
+int s_mixeroverflows = 0;
+
+
+/*
+===================
+S_QueueCommand
+===================
+*/
+void S_QueueCommand (sndcmd_t *cmd)
+{
+	// full; apply what's there now rather than wait for the mixer to come round
+	if (s_cmdwrite - s_cmdtail >= SNDCMD_QUEUE)
+	{
+		S_CommitCommands ();
+
+		SNDDMA_LockMixer ();
+		S_ApplyCommands ();
+		SNDDMA_UnlockMixer ();
+	}
+
+	s_cmdqueue[s_cmdwrite & (SNDCMD_QUEUE - 1)] = *cmd;
+	s_cmdwrite++;
+}
+
+
+void S_QueueChannel (sndcmdtype_t type, channel_t *ch, int begin)
+{
+	sndcmd_t cmd;
+
+	cmd.type = type;
+	cmd.channel = ch - channels;
+	cmd.sc = ch->sfx ? ch->sfx->cache : NULL;
+	cmd.begin = begin;
+	cmd.serial = ch->serial;
+	cmd.leftvol = ch->leftvol;
+	cmd.rightvol = ch->rightvol;
+	cmd.realvoice = ch->realvoice;
+	cmd.autosound = ch->autosound;
+	cmd.volume = 0;
+
+	S_QueueCommand (&cmd);
+}
+
+
+/*
+===================
+S_CommitCommands
+
+makes everything queued since the last commit visible to the mixer at once, so it never mixes a half-updated
+frame; without a mixer thread the commands are applied straight away
+===================
+*/
+void S_CommitCommands (void)
+{
+	s_cmdhead = s_cmdwrite;
+
+	if (!s_mixerthread)
+		S_ApplyCommands ();
+}
+
+
+qboolean S_MixerFinished (channel_t *ch)
+{
+	return ch->serial && mixfinished[ch - channels] == ch->serial;
+}
+
+
+static void S_ClearDMABuffer (void)
+{
+	int clear = (dma.samplebits == 8) ? 0x80 : 0;
+
+	SNDDMA_BeginPainting ();
+
+	if (dma.buffer)
+		memset (dma.buffer, clear, dma.samples * dma.samplebits / 8);
+
+	SNDDMA_Submit ();
+}
+
+
+/*
+===================
+S_ApplyCommands
+
+mixer side; also run by the client with the mixer locked when it needs everything applied now
+===================
+*/
+void S_ApplyCommands (void)
+{
+	int head = s_cmdhead;
+
+	while (s_cmdtail != head)
+	{
+		sndcmd_t *cmd = &s_cmdqueue[s_cmdtail & (SNDCMD_QUEUE - 1)];
+		mixvoice_t *v = &mixvoices[cmd->channel & (MAX_CHANNELS - 1)];
+
+		switch (cmd->type)
+		{
+		case SNDCMD_START:
+			if (!cmd->sc)
+			{
+				v->sc = NULL;
+				break;
+			}
+
+			v->sc = cmd->sc;
+			v->ch.leftvol = cmd->leftvol;
+			v->ch.rightvol = cmd->rightvol;
+			v->ch.realvoice = cmd->realvoice;
+			v->ch.autosound = cmd->autosound;
+			v->ch.serial = cmd->serial;
+
+			if (cmd->autosound)
+			{
+				// looping entity sounds are restarted every frame and have to stay in phase
+				v->begin = paintedtime;
+				v->ch.pos = paintedtime % v->sc->length;
+				v->ch.end = paintedtime + v->sc->length - v->ch.pos;
+			}
+			else
+			{
+				// a sound due before the mixer got to it starts now
+				v->begin = (cmd->begin > paintedtime) ? cmd->begin : paintedtime;
+				v->ch.pos = 0;
+				v->ch.end = v->begin + v->sc->length;
+			}
+			break;
+
+		case SNDCMD_UPDATE:
+			if (v->sc)
+			{
+				v->ch.leftvol = cmd->leftvol;
+				v->ch.rightvol = cmd->rightvol;
+				v->ch.realvoice = cmd->realvoice;
+			}
+			break;
+
+		case SNDCMD_STOP:
+			v->sc = NULL;
+			break;
+
+		case SNDCMD_STOPALL:
+			S_StopAllVoices ();
+			break;
+
+		case SNDCMD_CLEARBUFFER:
+			S_ClearDMABuffer ();
+			break;
+
+		case SNDCMD_VOLUME:
+			S_InitScaletable (cmd->volume);
+			break;
+		}
+
+		s_cmdtail++;
+	}
+}
+
+
+void S_StopAllVoices (void)
+{
+	memset (mixvoices, 0, sizeof (mixvoices));
+}
+
+
+/*
+===================
+S_MixerFrame
+
+one pass of the mixer; called every few milliseconds by the mixer thread, or once a frame by S_Update
+===================
+*/
+void S_MixerFrame (void)
+{
+	if (s_mixerfailed)
+		return;
+
+	S_ApplyCommands ();
+	S_Update_ ();
+}
+
+
 void S_PaintChannels (int endtime)
 {
 	int 	i;
 	int 	end;
-	channel_t *ch;
+	mixvoice_t	*v;
+	channel_t	*ch;
 	sfxcache_t	*sc;
 	int		ltime, count;
-	playsound_t	*ps;
-
-	snd_vol = s_volume->value * 256;
 
 	//Com_Printf ("%i to %i\n", paintedtime, endtime);
 	while (paintedtime < endtime)
@@ -241,23 +446,6 @@ void S_PaintChannels (int endtime)
 		if (endtime - paintedtime > PAINTBUFFER_SIZE)
 			end = paintedtime + PAINTBUFFER_SIZE;
 
-		// start any playsounds
-		while (1)
-		{
-			ps = s_pendingplays.next;
-			if (ps == &s_pendingplays)
-				break;	// no more pending sounds
-			if (ps->begin <= paintedtime)
-			{
-				S_IssuePlaysound (ps);
-				continue;
-			}
-
-			if (ps->begin < end)
-				end = ps->begin;		// stop here
-			break;
-		}
-
 		// clear the paint buffer
 		if (s_rawend < paintedtime)
 		{
@@ -290,14 +478,17 @@ void S_PaintChannels (int endtime)
 
 
 		// paint in the channels.
-		ch = channels;
-		for (i = 0; i < MAX_CHANNELS; i++, ch++)
+		v = mixvoices;
+		for (i = 0; i < MAX_CHANNELS; i++, v++)
 		{
-			ltime = paintedtime;
+			ch = &v->ch;
+
+			// sounds started with a time offset wait for it
+			ltime = (v->begin > paintedtime) ? v->begin : paintedtime;
 
 			while (ltime < end)
 			{
-				if (!ch->sfx || (!ch->leftvol && !ch->rightvol))
+				if (!(sc = v->sc))
 					break;
 
 				// max painting is to the end of the buffer
@@ -307,13 +498,12 @@ void S_PaintChannels (int endtime)
 				if (ch->end - ltime < count)
 					count = ch->end - ltime;
 
-				sc = S_LoadSound (ch->sfx);
-				if (!sc)
-					break;
-
-				if (count > 0 && ch->sfx)
+				if (count > 0)
 				{
-					if (sc->width == 1)// FIXME; 8 bit asm is wrong now
+					// virtual voices just keep time
+					if (!ch->realvoice || (!ch->leftvol && !ch->rightvol))
+						ch->pos += count;
+					else if (sc->width == 1)// FIXME; 8 bit asm is wrong now
 						S_PaintChannelFrom8 (ch, sc, count, ltime - paintedtime);
 					else
 						S_PaintChannelFrom16 (ch, sc, count, ltime - paintedtime);
@@ -338,7 +528,8 @@ void S_PaintChannels (int endtime)
 					else
 					{
 						// channel just stopped
-						ch->sfx = NULL;
+						mixfinished[i] = ch->serial;
+						v->sc = NULL;
 					}
 				}
 			}
@@ -350,15 +541,16 @@ void S_PaintChannels (int endtime)
 	}
 }
 
-void S_InitScaletable (void)
+void S_InitScaletable (float volume)
 {
 	int		i, j;
 	int		scale;
 
-	s_volume->modified = false;
+	snd_vol = volume * 256;
+
 	for (i = 0; i < 32; i++)
 	{
-		scale = i * 8 * 256 * s_volume->value;
+		scale = i * 8 * 256 * volume;
 		for (j = 0; j < 256; j++)
 			snd_scaletable[i][j] = ((signed char) j) * scale;
 	}
@@ -0,0 +1,355 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// snd_stream.c -- long sounds streamed from the filesystem through the raw sample path
+
+#include "client.h"
+#include "snd_loc.h"
+
+/*
+==============================================================================
+
+STREAMING
+
+music and other long sounds aren't loaded into an sfxcache_t; the file is
+kept open and read a chunk at a time each frame, just far enough ahead to
+keep the s_rawsamples ring topped up, so a stream costs the same memory
+however long it is.  cinematics use the same ring and take priority.
+
+==============================================================================
+*/
+
+#define	STREAM_CHUNK	16384	// most bytes read from the file at once
+
+// how full to keep the ring; the slack covers rounding when S_RawSamples resamples
+#define	STREAM_TARGET	(MAX_RAW_SAMPLES - 1024)
+
+typedef struct sndstream_s
+{
+	FILE		*file;
+	char		name[MAX_QPATH];
+	int			rate;
+	int			width;
+	int			channels;
+	int			datastart;		// file offset of the first sample
+	int			datalength;		// bytes of samples
+	int			remaining;		// bytes left before the end or the loop
+	qboolean	looping;
+	qboolean	paused;
+} sndstream_t;
+
+static sndstream_t s_stream;
+static byte s_streambuffer[STREAM_CHUNK];
+
+static cvar_t *s_bgmvolume;
+
+
+static qboolean S_StreamRead (void *buffer, int len)
+{
+	return fread (buffer, 1, len, s_stream.file) == len;
+}
+
+
+static int S_StreamLittleLong (byte *b)
+{
+	return b[0] | (b[1] << 8) | (b[2] << 16) | (b[3] << 24);
+}
+
+
+/*
+=================
+S_OpenStreamWav
+
+GetWavinfo wants the whole file in memory, so the header is walked here one chunk at a time instead
+=================
+*/
+static qboolean S_OpenStreamWav (int filelength)
+{
+	byte	header[16];
+	int		base = ftell (s_stream.file);
+	int		pos = 12;
+
+	if (!S_StreamRead (header, 12) || strncmp (header, "RIFF", 4) || strncmp (header + 8, "WAVE", 4))
+	{
+		Com_Printf ("%s: missing RIFF/WAVE chunks\n", s_stream.name);
+		return false;
+	}
+
+	while (pos + 8 <= filelength)
+	{
+		int chunklen;
+
+		if (!S_StreamRead (header, 8))
+			break;
+
+		chunklen = S_StreamLittleLong (header + 4);
+		pos += 8;
+
+		if (chunklen < 0)
+			break;
+
+		if (!strncmp (header, "fmt ", 4))
+		{
+			if (chunklen < 16 || !S_StreamRead (header, 16))
+				break;
+
+			if ((header[0] | (header[1] << 8)) != 1)
+			{
+				Com_Printf ("%s: Microsoft PCM format only\n", s_stream.name);
+				return false;
+			}
+
+			s_stream.channels = header[2] | (header[3] << 8);
+			s_stream.rate = S_StreamLittleLong (header + 4);
+			s_stream.width = (header[14] | (header[15] << 8)) / 8;
+
+			// skip anything after the basic format
+			fseek (s_stream.file, base + pos + ((chunklen + 1) & ~1), SEEK_SET);
+		}
+		else if (!strncmp (header, "data", 4))
+		{
+			if (!s_stream.rate)
+				break;
+
+			s_stream.datastart = base + pos;
+			s_stream.datalength = (pos + chunklen > filelength) ? filelength - pos : chunklen;
+
+			if (s_stream.channels < 1 || s_stream.channels > 2 || s_stream.width < 1 || s_stream.width > 2)
+			{
+				Com_Printf ("%s: only 8 or 16 bit mono or stereo can be streamed\n", s_stream.name);
+				return false;
+			}
+
+			// whole samples only
+			s_stream.datalength -= s_stream.datalength % (s_stream.width * s_stream.channels);
+
+			return true;
+		}
+		else fseek (s_stream.file, base + pos + ((chunklen + 1) & ~1), SEEK_SET);
+
+		pos += (chunklen + 1) & ~1;
+	}
+
+	Com_Printf ("%s: missing fmt or data chunk\n", s_stream.name);
+	return false;
+}
+
+
+static void S_RewindStream (void)
+{
+	fseek (s_stream.file, s_stream.datastart, SEEK_SET);
+	s_stream.remaining = s_stream.datalength;
+}
+
+
+/*
+=================
+S_StopStream
+=================
+*/
+void S_StopStream (void)
+{
+	if (s_stream.file)
+		FS_FCloseFile (s_stream.file);
+
+	memset (&s_stream, 0, sizeof (s_stream));
+}
+
+
+/*
+=================
+S_StartStream
+
+name is a full game path
+=================
+*/
+qboolean S_StartStream (char *name, qboolean looping)
+{
+	int len;
+
+	S_StopStream ();
+
+	if (!sound_started)
+		return false;
+
+	if ((len = FS_FOpenFile (name, &s_stream.file)) == -1 || !s_stream.file)
+	{
+		s_stream.file = NULL;
+		return false;
+	}
+
+	Com_sprintf (s_stream.name, sizeof (s_stream.name), "%s", name);
+
+	// shared with the cd player, which may not have registered it yet
+	s_bgmvolume = Cvar_Get ("bgmvolume", "0.7", CVAR_ARCHIVE, NULL);
+
+	if (!S_OpenStreamWav (len))
+	{
+		S_StopStream ();
+		return false;
+	}
+
+	s_stream.looping = looping;
+	S_RewindStream ();
+
+	return true;
+}
+
+
+void S_PauseStream (qboolean paused)
+{
+	s_stream.paused = paused;
+}
+
+
+// false once a stream has finished or sound has been restarted
+qboolean S_StreamPlaying (void)
+{
+	return s_stream.file != NULL;
+}
+
+
+/*
+=================
+S_UpdateStream
+
+called each frame from S_Update to read far enough ahead of the mixer
+=================
+*/
+void S_UpdateStream (void)
+{
+	int framesize;
+
+	if (!s_stream.file || s_stream.paused)
+		return;
+
+	// cinematic sound has the ring
+	if (cl.cinematictime > 0)
+		return;
+
+	framesize = s_stream.width * s_stream.channels;
+
+	for (;;)
+	{
+		int queued = (s_rawend > paintedtime) ? s_rawend - paintedtime : 0;
+		int room = STREAM_TARGET - queued;
+		int frames;
+
+		if (room <= 0)
+			break;
+
+		// input frames that fill the room at the output rate
+		frames = (int) ((double) room * s_stream.rate / dma.speed);
+
+		if (frames > STREAM_CHUNK / framesize)
+			frames = STREAM_CHUNK / framesize;
+
+		if (frames > s_stream.remaining / framesize)
+			frames = s_stream.remaining / framesize;
+
+		if (frames < 1)
+		{
+			if (s_stream.remaining >= framesize)
+				break;
+
+			if (!s_stream.looping)
+			{
+				S_StopStream ();
+				return;
+			}
+
+			S_RewindStream ();
+			continue;
+		}
+
+		if (!S_StreamRead (s_streambuffer, frames * framesize))
+		{
+			Com_Printf ("%s: read error\n", s_stream.name);
+			S_StopStream ();
+			return;
+		}
+
+		s_stream.remaining -= frames * framesize;
+
+		// wav 8 bit is unsigned but the raw sample path takes 8 bit stereo as signed
+		if (s_stream.width == 1 && s_stream.channels == 2)
+		{
+			int i;
+
+			for (i = 0; i < frames * 2; i++)
+				s_streambuffer[i] ^= 0x80;
+		}
+
+		S_RawSamplesVolume (frames, s_stream.rate, s_stream.width, s_stream.channels, s_streambuffer, s_volume->value * s_bgmvolume->value);
+	}
+}
+
+
+/*
+=================
+S_Music_f
+=================
+*/
+void S_Music_f (void)
+{
+	char	name[MAX_QPATH];
+	char	*arg;
+
+	if (Cmd_Argc () < 2)
+	{
+		if (s_stream.file)
+		{
+			Com_Printf (
+				"%s%s: %i hz, %i bit %s, %i of %i kb left\n",
+				s_stream.name,
+				s_stream.paused ? " (paused)" : "",
+				s_stream.rate,
+				s_stream.width * 8,
+				s_stream.channels == 2 ? "stereo" : "mono",
+				s_stream.remaining >> 10,
+				s_stream.datalength >> 10
+			);
+		}
+		else Com_Printf ("usage: music <file> [once] | stop | pause | resume\n");
+
+		return;
+	}
+
+	arg = Cmd_Argv (1);
+
+	if (!Q_strcasecmp (arg, "stop"))
+		S_StopStream ();
+	else if (!Q_strcasecmp (arg, "pause"))
+		S_PauseStream (true);
+	else if (!Q_strcasecmp (arg, "resume"))
+		S_PauseStream (false);
+	else
+	{
+		// relative to music/ unless a directory is given, and .wav is assumed
+		if (strchr (arg, '/'))
+			Com_sprintf (name, sizeof (name), "%s", arg);
+		else Com_sprintf (name, sizeof (name), "music/%s", arg);
+
+		if (!strrchr (name, '.') && strlen (name) + 4 < sizeof (name))
+			strcat (name, ".wav");
+
+		if (!S_StartStream (name, Q_strcasecmp (Cmd_Argv (2), "once") != 0))
+			Com_Printf ("couldn't stream %s\n", name);
+	}
+}
@@ -19,6 +19,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 
 #include <float.h>
+#include <process.h>
 
 #include "client.h"
 #include "snd_loc.h"
@@ -54,6 +55,11 @@ MMTIME	mmstarttime;
 IDirectSound8 *ds_Object;
 LPDIRECTSOUNDBUFFER ds_Buffer;
 
+// s_null mixes into memory with no device, for running headless
+static qboolean snd_isnull = false;
+static byte *snd_nullbuffer = NULL;
+static double snd_nullstart;
+
 qboolean SNDDMA_InitDirect (void);
 
 void FreeSound (void);
@@ -217,9 +223,43 @@ void FreeSound (void)
 	ds_Buffer = NULL;
 	lpData = NULL;
 
+	if (snd_nullbuffer)
+	{
+		Zone_Free (snd_nullbuffer);
+		snd_nullbuffer = NULL;
+	}
+
+	snd_isnull = false;
 	dsound_init = false;
 }
 
+
+/*
+==================
+SNDDMA_InitNull
+
+a buffer in memory that plays back in real time, so the whole mixer runs without a sound device
+==================
+*/
+static qboolean SNDDMA_InitNull (void)
+{
+	memset ((void *) &dma, 0, sizeof (dma));
+
+	dma.channels = 2;
+	dma.samplebits = 16;
+	dma.speed = 22050;
+	dma.samples = SECONDARY_BUFFER_SIZE / (dma.samplebits / 8);
+	dma.submission_chunk = 1;
+
+	snd_nullbuffer = (byte *) Zone_Alloc (SECONDARY_BUFFER_SIZE);
+	snd_nullstart = Sys_Microseconds ();
+	snd_isnull = true;
+
+	Com_Printf ("null sound device; mixing without output\n");
+
+	return true;
+}
+
 /*
 ==================
 SNDDMA_InitDirect
@@ -301,6 +341,10 @@ int SNDDMA_Init (void)
 
 	memset ((void *) &dma, 0, sizeof (dma));
 
+	// there's no window for DirectSound to attach to when the refresh is null
+	if (Cvar_Get ("s_null", "0", 0, NULL)->value || Cvar_VariableValue ("vid_null"))
+		return SNDDMA_InitNull ();
+
 	// assume DirectSound won't initialize
 	dsound_init = 0;
 	stat = SIS_FAILURE;
@@ -350,9 +394,17 @@ how many sample are required to fill it up.
 int SNDDMA_GetDMAPos (void)
 {
 	MMTIME	mmtime;
-	int		s;
+	int		s = 0;
 	DWORD	dwWrite;
 
+	if (snd_isnull)
+	{
+		// mono samples played since the buffer was created
+		double played = (Sys_Microseconds () - snd_nullstart) * 0.000001 * dma.speed;
+
+		return (int) fmod (played, dma.samples / dma.channels) * dma.channels;
+	}
+
 	if (dsound_init)
 	{
 		mmtime.wType = TIME_SAMPLES;
@@ -374,6 +426,10 @@ Makes sure dma.buffer is valid
 ===============
 */
 DWORD	locksize;
+
+// the error that set s_mixerfailed; it's reported from S_Update as the mixer thread mustn't print
+static HRESULT ds_lockerror = DS_OK;
+
 void SNDDMA_BeginPainting (void)
 {
 	int		reps;
@@ -382,12 +438,21 @@ void SNDDMA_BeginPainting (void)
 	HRESULT	hresult;
 	DWORD	dwStatus;
 
+	if (snd_isnull)
+	{
+		dma.buffer = snd_nullbuffer;
+		return;
+	}
+
+	// SNDDMA_Submit has already unlocked the previous one, so nothing may be painted into it
+	dma.buffer = NULL;
+
 	if (!ds_Buffer)
 		return;
 
 	// if the buffer was lost or stopped, restore it and/or restart it
 	if (ds_Buffer->lpVtbl->GetStatus (ds_Buffer, &dwStatus) != DS_OK)
-		Com_Printf ("Couldn't get sound buffer status\n");
+		return;
 
 	if (dwStatus & DSBSTATUS_BUFFERLOST)
 		ds_Buffer->lpVtbl->Restore (ds_Buffer);
@@ -398,14 +463,14 @@ void SNDDMA_BeginPainting (void)
 	// lock the dsound buffer
 
 	reps = 0;
-	dma.buffer = NULL;
 
 	while ((hresult = ds_Buffer->lpVtbl->Lock (ds_Buffer, 0, gSndBufSize, &pbuf, &locksize, &pbuf2, &dwSize2, 0)) != DS_OK)
 	{
 		if (hresult != DSERR_BUFFERLOST)
 		{
-			Com_Printf ("S_TransferStereo16: Lock failed with error '%s'\n", DSoundError (hresult));
-			S_Shutdown ();
+			// this is usually on the mixer thread, so S_Update reports it and shuts sound down
+			ds_lockerror = hresult;
+			s_mixerfailed = true;
 			return;
 		}
 		else
@@ -419,6 +484,12 @@ void SNDDMA_BeginPainting (void)
 	dma.buffer = (unsigned char *) pbuf;
 }
 
+const char *SNDDMA_FailReason (void)
+{
+	return DSoundError (ds_lockerror);
+}
+
+
 /*
 ==============
 SNDDMA_Submit
@@ -462,6 +533,9 @@ between a deactivate and an activate.
 */
 void S_Activate (qboolean active)
 {
+	// the mixer thread mustn't be holding the buffer while it's replaced
+	SNDDMA_LockMixer ();
+
 	if (active)
 	{
 		if (ds_Object && cl_hwnd && snd_isdirect)
@@ -476,5 +550,105 @@ void S_Activate (qboolean active)
 			DS_DestroyBuffers ();
 		}
 	}
+
+	SNDDMA_UnlockMixer ();
+}
+
+
+/*
+==============================================================================
+
+MIXER THREAD
+
+S_MixerFrame runs every MIXER_PERIOD milliseconds whatever the client frame
+is doing, so a long frame doesn't underrun the dma buffer.  the client only
+talks to it through the command queue in snd_mix.c; the lock is held for each
+pass of the mixer and is only taken by the client for the rare things that
+can't go through the queue.
+
+==============================================================================
+*/
+
+#define	MIXER_PERIOD	5
+
+static HANDLE snd_mixthread = NULL;
+static HANDLE snd_mixwake = NULL;
+static CRITICAL_SECTION snd_mixlock;
+static volatile qboolean snd_mixquit = false;
+
+
+static unsigned __stdcall SNDDMA_MixerThread (void *arg)
+{
+	while (!snd_mixquit)
+	{
+		EnterCriticalSection (&snd_mixlock);
+		S_MixerFrame ();
+		LeaveCriticalSection (&snd_mixlock);
+
+		WaitForSingleObject (snd_mixwake, MIXER_PERIOD);
+	}
+
+	return 0;
+}
+
+
+qboolean SNDDMA_StartMixer (void)
+{
+	if (snd_mixthread)
+		return true;
+
+	InitializeCriticalSection (&snd_mixlock);
+
+	snd_mixquit = false;
+	snd_mixwake = CreateEvent (NULL, FALSE, FALSE, NULL);
+
+	if ((snd_mixthread = (HANDLE) _beginthreadex (NULL, 0, SNDDMA_MixerThread, NULL, 0, NULL)) == NULL)
+	{
+		Com_Printf ("couldn't start the mixer thread\n");
+		CloseHandle (snd_mixwake);
+		DeleteCriticalSection (&snd_mixlock);
+		snd_mixwake = NULL;
+		return false;
+	}
+
+	// the mixer is waited on far more tightly than the client frame
+	SetThreadPriority (snd_mixthread, THREAD_PRIORITY_ABOVE_NORMAL);
+
+	s_mixerthread = true;
+
+	return true;
+}
+
+
+void SNDDMA_StopMixer (void)
+{
+	if (!snd_mixthread)
+		return;
+
+	snd_mixquit = true;
+	SetEvent (snd_mixwake);
+	WaitForSingleObject (snd_mixthread, INFINITE);
+
+	CloseHandle (snd_mixthread);
+	CloseHandle (snd_mixwake);
+	DeleteCriticalSection (&snd_mixlock);
+
+	snd_mixthread = NULL;
+	snd_mixwake = NULL;
+	s_mixerthread = false;
+}
+
+
+void SNDDMA_LockMixer (void)
+{
+	if (snd_mixthread)
+		EnterCriticalSection (&snd_mixlock);
+}
+
+
+void SNDDMA_UnlockMixer (void)
+{
+	if (snd_mixthread)
+		LeaveCriticalSection (&snd_mixlock);
 }
 
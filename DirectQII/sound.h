@@ -29,6 +29,12 @@ void S_StartLocalSound (char *s);
 
 void S_RawSamples (int samples, int rate, int width, int channels, byte *data);
 
+// long sounds read from the filesystem as they play instead of being loaded
+qboolean S_StartStream (char *name, qboolean looping);
+void S_StopStream (void);
+void S_PauseStream (qboolean paused);
+qboolean S_StreamPlaying (void);
+
 void S_StopAllSounds (void);
 void S_Update (vec3_t origin, vec3_t v_forward, vec3_t v_right, vec3_t v_up);
 
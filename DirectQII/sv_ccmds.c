@@ -789,6 +789,17 @@ void SV_Status_f (void)
 
 		Com_Printf ("\n");
 	}
+
+	// relay spectators aren't in the game so they're only counted
+	for (j = 0; i < svs.numslots; i++, cl++)
+	{
+		if (cl->state == cs_connected || cl->state == cs_spawned)
+			j++;
+	}
+
+	if (j)
+		Com_Printf ("%i relay spectators\n", j);
+
 	Com_Printf ("\n");
 }
 
@@ -818,7 +829,7 @@ void SV_ConSay_f (void)
 
 	strcat (text, p);
 
-	for (j = 0, client = svs.clients; j < maxclients->value; j++, client++)
+	for (j = 0, client = svs.clients; j < svs.numslots; j++, client++)
 	{
 		if (client->state != cs_spawned)
 			continue;
@@ -1031,6 +1042,7 @@ void SV_InitOperatorCommands (void)
 
 	Cmd_AddCommand ("map", SV_Map_f);
 	Cmd_AddCommand ("demomap", SV_DemoMap_f);
+	Cmd_AddCommand ("demoseek", SV_DemoSeek_f);
 	Cmd_AddCommand ("gamemap", SV_GameMap_f);
 	Cmd_AddCommand ("setmaster", SV_SetMaster_f);
 
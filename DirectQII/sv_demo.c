@@ -0,0 +1,338 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// sv_demo.c -- demo playback and seeking
+
+#include "server.h"
+
+/*
+==============================================================================
+
+DEMO PLAYBACK
+
+demos are played by the server, which reads one message a frame and sends
+it on unchanged.  if the demo was recorded with an index (see
+cl_demoindex.c) "demoseek" can jump anywhere in it: the server sends the
+snapshot of the last keyframe before the target, carries on from the
+message that keyframe names, and sends messages as fast as the client will
+take them until it reaches the target time.
+
+==============================================================================
+*/
+
+/*
+==================
+SV_LoadDemoIndex
+
+name is the game path of the .dm2; a missing or damaged index just means the demo can't be seeked
+==================
+*/
+static void SV_LoadDemoIndex (char *name)
+{
+	char		indexname[MAX_QPATH];
+	byte		*buf;
+	dmiheader_t	*header;
+	int			len, i;
+
+	COM_StripExtension (name, indexname);
+	strcat (indexname, ".dmi");
+
+	if ((len = FS_LoadFile (indexname, (void **) &buf)) < 0 || !buf)
+		return;
+
+	header = (dmiheader_t *) buf;
+
+	if (len < sizeof (dmiheader_t))
+		goto bad;
+
+	LittleLongArray (header, sizeof (dmiheader_t) / 4);
+
+	if (header->ident != IDDEMOINDEXHEADER || header->version != DEMOINDEX_VERSION)
+		goto bad;
+
+	// an index that was never finished has no tables
+	if (header->nummessages < 1 || header->numkeyframes < 1 || header->interval < 1)
+		goto bad;
+
+	// compared against what's left after the offset so that a huge count can't wrap around
+	if (header->ofsmessages < (int) sizeof (dmiheader_t) || header->ofsmessages > len)
+		goto bad;
+
+	if (header->nummessages > (len - header->ofsmessages) / (int) sizeof (dmimessage_t))
+		goto bad;
+
+	if (header->ofskeyframes < (int) sizeof (dmiheader_t) || header->ofskeyframes > len)
+		goto bad;
+
+	if (header->numkeyframes > (len - header->ofskeyframes) / (int) sizeof (dmikeyframe_t))
+		goto bad;
+
+	sv.demomessages = (dmimessage_t *) (buf + header->ofsmessages);
+	sv.numdemomessages = header->nummessages;
+
+	sv.demokeyframes = (dmikeyframe_t *) (buf + header->ofskeyframes);
+	sv.numdemokeyframes = header->numkeyframes;
+
+	sv.demointerval = header->interval;
+
+	LittleLongArray (sv.demomessages, sv.numdemomessages * sizeof (dmimessage_t) / 4);
+	LittleLongArray (sv.demokeyframes, sv.numdemokeyframes * sizeof (dmikeyframe_t) / 4);
+
+	for (i = 0; i < sv.numdemokeyframes; i++)
+	{
+		dmikeyframe_t *k = &sv.demokeyframes[i];
+
+		if (k->message < 0 || k->message >= sv.numdemomessages)
+			goto bad;
+
+		if (k->ofssnapshot < (int) sizeof (dmiheader_t) || k->ofssnapshot > len)
+			goto bad;
+
+		if (k->snapshotlen < 0 || k->snapshotlen > len - k->ofssnapshot)
+			goto bad;
+	}
+
+	sv.demoindex = buf;
+	return;
+
+bad:
+	Com_Printf ("%s is damaged and will be ignored\n", indexname);
+
+	sv.demomessages = NULL;
+	sv.demokeyframes = NULL;
+	sv.numdemomessages = sv.numdemokeyframes = 0;
+
+	FS_FreeFile (buf);
+}
+
+
+/*
+==================
+SV_OpenDemo
+==================
+*/
+void SV_OpenDemo (void)
+{
+	char		name[MAX_OSPATH];
+
+	Com_sprintf (name, sizeof (name), "demos/%s", sv.name);
+	FS_FOpenFile (name, &sv.demofile);
+	if (!sv.demofile)
+		Com_Error (ERR_DROP, "Couldn't open %s\n", name);
+
+	// offsets in the index are from the start of the demo, which may be inside a pak
+	sv.demobase = ftell (sv.demofile);
+
+	SV_LoadDemoIndex (name);
+}
+
+
+/*
+==================
+SV_CloseDemo
+==================
+*/
+void SV_CloseDemo (void)
+{
+	if (sv.demofile)
+		fclose (sv.demofile);
+
+	if (sv.demoindex)
+		FS_FreeFile (sv.demoindex);
+
+	sv.demofile = NULL;
+	sv.demoindex = NULL;
+	sv.demomessages = NULL;
+	sv.demokeyframes = NULL;
+	sv.numdemomessages = sv.numdemokeyframes = 0;
+	sv.demosnapshot = NULL;
+	sv.demosnapshotlen = 0;
+	sv.demoseeking = false;
+}
+
+
+// the last indexed message at or before offset, or -1 if it's before all of them
+static int SV_DemoMessageAt (int offset)
+{
+	int lo = 0, hi = sv.numdemomessages - 1;
+	int found = -1;
+
+	while (lo <= hi)
+	{
+		int mid = (lo + hi) >> 1;
+
+		if (sv.demomessages[mid].offset <= offset)
+		{
+			found = mid;
+			lo = mid + 1;
+		}
+		else hi = mid - 1;
+	}
+
+	return found;
+}
+
+
+// the server time of the frame the client was last sent
+static int SV_DemoTime (void)
+{
+	int m = SV_DemoMessageAt (ftell (sv.demofile) - sv.demobase - 1);
+
+	return (m < 0) ? sv.demokeyframes[0].time : sv.demomessages[m].time;
+}
+
+
+/*
+==================
+SV_ReadDemoMessage
+
+returns the length of the next message to send, or -1 at the end of the demo
+==================
+*/
+int SV_ReadDemoMessage (byte *msgbuf)
+{
+	int msglen;
+
+	// a seek sends the keyframe's snapshot before going back to the file
+	if (sv.demosnapshotlen > 0)
+	{
+		memcpy (&msglen, sv.demosnapshot, 4);
+		msglen = LittleLong (msglen);
+
+		if (msglen < 0 || msglen > MAX_MSGLEN || msglen + 4 > sv.demosnapshotlen)
+			Com_Error (ERR_DROP, "SV_ReadDemoMessage: bad snapshot in demo index");
+
+		memcpy (msgbuf, sv.demosnapshot + 4, msglen);
+
+		sv.demosnapshot += msglen + 4;
+		sv.demosnapshotlen -= msglen + 4;
+
+		return msglen;
+	}
+
+	// stop catching up at the first message from the target time on
+	if (sv.demoseeking)
+	{
+		int m = SV_DemoMessageAt (ftell (sv.demofile) - sv.demobase);
+
+		if (m < 0 || sv.demomessages[m].time >= sv.demoseektime)
+			sv.demoseeking = false;
+	}
+
+	// get the next message
+	if (fread (&msglen, 4, 1, sv.demofile) != 1)
+		return -1;
+
+	msglen = LittleLong (msglen);
+
+	if (msglen == -1)
+		return -1;
+
+	if (msglen > MAX_MSGLEN)
+		Com_Error (ERR_DROP, "SV_ReadDemoMessage: msglen > MAX_MSGLEN");
+
+	if (fread (msgbuf, msglen, 1, sv.demofile) != 1)
+		return -1;
+
+	return msglen;
+}
+
+
+/*
+==================
+SV_DemoSeeking
+
+true while a seek is still catching up, when messages go out without waiting for the frame time
+==================
+*/
+qboolean SV_DemoSeeking (void)
+{
+	return sv.state == ss_demo && !sv_paused->value && (sv.demoseeking || sv.demosnapshotlen > 0);
+}
+
+
+/*
+==================
+SV_DemoSeek_f
+
+demoseek <seconds> from the start of the demo, or +/-<seconds> from where it is now
+==================
+*/
+void SV_DemoSeek_f (void)
+{
+	dmikeyframe_t	*k;
+	char			*arg;
+	int				start, end, now, target;
+	int				i;
+
+	if (sv.state != ss_demo || !sv.demofile)
+	{
+		Com_Printf ("Not playing a demo.\n");
+		return;
+	}
+
+	if (!sv.demoindex)
+	{
+		Com_Printf ("%s has no index and can't be seeked\n", sv.name);
+		return;
+	}
+
+	start = sv.demokeyframes[0].time;
+	end = sv.demomessages[sv.numdemomessages - 1].time;
+	now = SV_DemoTime ();
+
+	if (Cmd_Argc () != 2)
+	{
+		Com_Printf ("demoseek <seconds> | +<seconds> | -<seconds>\n");
+		Com_Printf ("at %0.1f of %0.1f seconds\n", (now - start) * 0.001, (end - start) * 0.001);
+		return;
+	}
+
+	arg = Cmd_Argv (1);
+
+	if (arg[0] == '+' || arg[0] == '-')
+		target = now + atof (arg) * 1000;
+	else target = start + atof (arg) * 1000;
+
+	if (target < start) target = start;
+	if (target > end) target = end;
+
+	// keyframes are written at close to even intervals so start from a guess
+	i = (target - start) / sv.demointerval;
+
+	if (i < 0) i = 0;
+	if (i > sv.numdemokeyframes - 1) i = sv.numdemokeyframes - 1;
+
+	while (i > 0 && sv.demokeyframes[i].time > target)
+		i--;
+
+	while (i < sv.numdemokeyframes - 1 && sv.demokeyframes[i + 1].time <= target)
+		i++;
+
+	k = &sv.demokeyframes[i];
+
+	sv.demosnapshot = sv.demoindex + k->ofssnapshot;
+	sv.demosnapshotlen = k->snapshotlen;
+
+	fseek (sv.demofile, sv.demobase + sv.demomessages[k->message].offset, SEEK_SET);
+
+	sv.demoseeking = true;
+	sv.demoseektime = target;
+}
+
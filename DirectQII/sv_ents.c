@@ -20,6 +20,114 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "server.h"
 
+/*
+=============================================================================
+
+Shared entity deltas
+
+clients that see the same entity and acknowledged the same frame delta it
+from the same state, so the bytes for each entity and delta frame are kept
+for the rest of the server frame and copied for everyone after the first.
+both states are still compared on a hit, as a client's copy can differ
+(its own missiles aren't solid to it), and a mismatch is just encoded.
+
+=============================================================================
+*/
+
+#define	DELTA_HASHSIZE		1024	// must be a power of 2
+#define	DELTA_MAXENTRIES	4096
+#define	DELTA_MAXBYTES		65536
+
+typedef struct deltaentry_s
+{
+	entity_state_t		from;
+	entity_state_t		to;
+	int					fromframe;		// -1 from the baseline
+	int					ofs;			// into sv_deltabytes
+	int					len;			// 0 if nothing changed
+	struct deltaentry_s	*next;
+} deltaentry_t;
+
+static deltaentry_t *sv_deltahash[DELTA_HASHSIZE];
+static deltaentry_t sv_deltaentries[DELTA_MAXENTRIES];
+static int sv_numdeltaentries = 0;
+
+static byte sv_deltabytes[DELTA_MAXBYTES];
+static int sv_deltabyteslen = 0;
+
+static int sv_deltaframenum = -1;		// the server frame the cache is for
+
+cvar_t *sv_deltacache;
+
+
+/*
+=============
+SV_WriteDeltaEntity
+
+MSG_WriteDeltaEntity through the cache; the force and newentity flags follow from the entity number
+and whether it's from the baseline, so they aren't part of the key
+=============
+*/
+static void SV_WriteDeltaEntity (entity_state_t *from, entity_state_t *to, int fromframe, sizebuf_t *msg, qboolean force, qboolean newentity)
+{
+	deltaentry_t	*d;
+	int				hash, start;
+
+	if (!sv_deltacache->value)
+	{
+		MSG_WriteDeltaEntity (from, to, msg, force, newentity);
+		return;
+	}
+
+	if (sv_deltaframenum != sv.framenum)
+	{
+		memset (sv_deltahash, 0, sizeof (sv_deltahash));
+		sv_numdeltaentries = 0;
+		sv_deltabyteslen = 0;
+		sv_deltaframenum = sv.framenum;
+	}
+
+	hash = (to->number * 31 + fromframe) & (DELTA_HASHSIZE - 1);
+
+	for (d = sv_deltahash[hash]; d; d = d->next)
+	{
+		if (d->to.number != to->number || d->fromframe != fromframe)
+			continue;
+
+		if (memcmp (&d->to, to, sizeof (*to)) || memcmp (&d->from, from, sizeof (*from)))
+			continue;
+
+		if (d->len)
+			SZ_Write (msg, sv_deltabytes + d->ofs, d->len);
+
+		sv_perfcount.deltahits++;
+		return;
+	}
+
+	start = msg->cursize;
+	MSG_WriteDeltaEntity (from, to, msg, force, newentity);
+	sv_perfcount.deltamisses++;
+
+	// an overflow clears the message so there's nothing to keep
+	if (msg->overflowed || sv_numdeltaentries == DELTA_MAXENTRIES || sv_deltabyteslen + msg->cursize - start > DELTA_MAXBYTES)
+		return;
+
+	d = &sv_deltaentries[sv_numdeltaentries++];
+
+	d->from = *from;
+	d->to = *to;
+	d->fromframe = fromframe;
+	d->ofs = sv_deltabyteslen;
+	d->len = msg->cursize - start;
+
+	memcpy (sv_deltabytes + d->ofs, msg->data + start, d->len);
+	sv_deltabyteslen += d->len;
+
+	d->next = sv_deltahash[hash];
+	sv_deltahash[hash] = d;
+}
+
+
 /*
 =============================================================================
 
@@ -82,7 +190,7 @@ void SV_EmitPacketEntities (client_frame_t *from, client_frame_t *to, sizebuf_t
 			// in any bytes being emited if the entity has not changed at all
 			// note that players are always 'newentities', this updates their oldorigin always
 			// and prevents warping
-			MSG_WriteDeltaEntity (oldent, newent, msg, false, newent->number <= maxclients->value);
+			SV_WriteDeltaEntity (oldent, newent, from->framenum, msg, false, newent->number <= maxclients->value);
 			oldindex++;
 			newindex++;
 			continue;
@@ -91,7 +199,7 @@ void SV_EmitPacketEntities (client_frame_t *from, client_frame_t *to, sizebuf_t
 		if (newnum < oldnum)
 		{
 			// this is a new entity, send it from the baseline
-			MSG_WriteDeltaEntity (&sv.baselines[newnum], newent, msg, true, true);
+			SV_WriteDeltaEntity (&sv.baselines[newnum], newent, -1, msg, true, true);
 			newindex++;
 			continue;
 		}
@@ -135,166 +243,13 @@ SV_WritePlayerstateToClient
 */
 void SV_WritePlayerstateToClient (client_frame_t *from, client_frame_t *to, sizebuf_t *msg)
 {
-	int				i;
-	int				pflags;
-	player_state_t	*ps, *ops;
 	player_state_t	dummy;
-	int				statbits;
 
-	ps = &to->ps;
 	if (!from)
-	{
 		memset (&dummy, 0, sizeof (dummy));
-		ops = &dummy;
-	}
-	else
-		ops = &from->ps;
-
-	// determine what needs to be sent
-	pflags = 0;
-
-	if (ps->pmove.pm_type != ops->pmove.pm_type)
-		pflags |= PS_M_TYPE;
-
-	if (ps->pmove.origin[0] != ops->pmove.origin[0] || ps->pmove.origin[1] != ops->pmove.origin[1] || ps->pmove.origin[2] != ops->pmove.origin[2])
-		pflags |= PS_M_ORIGIN;
-
-	if (ps->pmove.velocity[0] != ops->pmove.velocity[0] || ps->pmove.velocity[1] != ops->pmove.velocity[1] || ps->pmove.velocity[2] != ops->pmove.velocity[2])
-		pflags |= PS_M_VELOCITY;
-
-	if (ps->pmove.pm_time != ops->pmove.pm_time)
-		pflags |= PS_M_TIME;
-
-	if (ps->pmove.pm_flags != ops->pmove.pm_flags)
-		pflags |= PS_M_FLAGS;
-
-	if (ps->pmove.gravity != ops->pmove.gravity)
-		pflags |= PS_M_GRAVITY;
-
-	if (ps->pmove.delta_angles[0] != ops->pmove.delta_angles[0] || ps->pmove.delta_angles[1] != ops->pmove.delta_angles[1] || ps->pmove.delta_angles[2] != ops->pmove.delta_angles[2])
-		pflags |= PS_M_DELTA_ANGLES;
-
-
-	if (ps->viewoffset[0] != ops->viewoffset[0] || ps->viewoffset[1] != ops->viewoffset[1] || ps->viewoffset[2] != ops->viewoffset[2])
-		pflags |= PS_VIEWOFFSET;
-
-	if (ps->viewangles[0] != ops->viewangles[0] || ps->viewangles[1] != ops->viewangles[1] || ps->viewangles[2] != ops->viewangles[2])
-		pflags |= PS_VIEWANGLES;
 
-	if (ps->kick_angles[0] != ops->kick_angles[0] || ps->kick_angles[1] != ops->kick_angles[1] || ps->kick_angles[2] != ops->kick_angles[2])
-		pflags |= PS_KICKANGLES;
-
-	if (ps->blend[0] != ops->blend[0] || ps->blend[1] != ops->blend[1] || ps->blend[2] != ops->blend[2] || ps->blend[3] != ops->blend[3])
-		pflags |= PS_BLEND;
-
-	if (ps->fov != ops->fov)
-		pflags |= PS_FOV;
-
-	if (ps->rdflags != ops->rdflags)
-		pflags |= PS_RDFLAGS;
-
-	if (ps->gunframe != ops->gunframe)
-		pflags |= PS_WEAPONFRAME;
-
-	pflags |= PS_WEAPONINDEX;
-
-	// write it
 	MSG_WriteByte (msg, svc_playerinfo);
-	MSG_WriteShort (msg, pflags);
-
-	// write the pmove_state_t
-	if (pflags & PS_M_TYPE)
-		MSG_WriteByte (msg, ps->pmove.pm_type);
-
-	if (pflags & PS_M_ORIGIN)
-	{
-		MSG_WriteShort (msg, ps->pmove.origin[0]);
-		MSG_WriteShort (msg, ps->pmove.origin[1]);
-		MSG_WriteShort (msg, ps->pmove.origin[2]);
-	}
-
-	if (pflags & PS_M_VELOCITY)
-	{
-		MSG_WriteShort (msg, ps->pmove.velocity[0]);
-		MSG_WriteShort (msg, ps->pmove.velocity[1]);
-		MSG_WriteShort (msg, ps->pmove.velocity[2]);
-	}
-
-	if (pflags & PS_M_TIME)
-		MSG_WriteByte (msg, ps->pmove.pm_time);
-
-	if (pflags & PS_M_FLAGS)
-		MSG_WriteByte (msg, ps->pmove.pm_flags);
-
-	if (pflags & PS_M_GRAVITY)
-		MSG_WriteShort (msg, ps->pmove.gravity);
-
-	if (pflags & PS_M_DELTA_ANGLES)
-	{
-		MSG_WriteShort (msg, ps->pmove.delta_angles[0]);
-		MSG_WriteShort (msg, ps->pmove.delta_angles[1]);
-		MSG_WriteShort (msg, ps->pmove.delta_angles[2]);
-	}
-
-	// write the rest of the player_state_t
-	if (pflags & PS_VIEWOFFSET)
-	{
-		MSG_WriteChar (msg, ps->viewoffset[0] * 4);
-		MSG_WriteChar (msg, ps->viewoffset[1] * 4);
-		MSG_WriteChar (msg, ps->viewoffset[2] * 4);
-	}
-
-	if (pflags & PS_VIEWANGLES)
-	{
-		MSG_WriteAngle16 (msg, ps->viewangles[0]);
-		MSG_WriteAngle16 (msg, ps->viewangles[1]);
-		MSG_WriteAngle16 (msg, ps->viewangles[2]);
-	}
-
-	if (pflags & PS_KICKANGLES)
-	{
-		MSG_WriteChar (msg, ps->kick_angles[0] * 4);
-		MSG_WriteChar (msg, ps->kick_angles[1] * 4);
-		MSG_WriteChar (msg, ps->kick_angles[2] * 4);
-	}
-
-	if (pflags & PS_WEAPONINDEX)
-	{
-		MSG_WriteByte (msg, ps->gunindex);
-	}
-
-	if (pflags & PS_WEAPONFRAME)
-	{
-		MSG_WriteByte (msg, ps->gunframe);
-		MSG_WriteChar (msg, ps->gunoffset[0] * 4);
-		MSG_WriteChar (msg, ps->gunoffset[1] * 4);
-		MSG_WriteChar (msg, ps->gunoffset[2] * 4);
-		MSG_WriteChar (msg, ps->gunangles[0] * 4);
-		MSG_WriteChar (msg, ps->gunangles[1] * 4);
-		MSG_WriteChar (msg, ps->gunangles[2] * 4);
-	}
-
-	if (pflags & PS_BLEND)
-	{
-		MSG_WriteByte (msg, ps->blend[0] * 255);
-		MSG_WriteByte (msg, ps->blend[1] * 255);
-		MSG_WriteByte (msg, ps->blend[2] * 255);
-		MSG_WriteByte (msg, ps->blend[3] * 255);
-	}
-	if (pflags & PS_FOV)
-		MSG_WriteByte (msg, ps->fov);
-	if (pflags & PS_RDFLAGS)
-		MSG_WriteByte (msg, ps->rdflags);
-
-	// send stats
-	statbits = 0;
-	for (i = 0; i < MAX_STATS; i++)
-		if (ps->stats[i] != ops->stats[i])
-			statbits |= 1 << i;
-	MSG_WriteLong (msg, statbits);
-	for (i = 0; i < MAX_STATS; i++)
-		if (statbits & (1 << i))
-			MSG_WriteShort (msg, ps->stats[i]);
+	MSG_WriteDeltaPlayerstate (from ? &from->ps : &dummy, &to->ps, msg);
 }
 
 
@@ -442,6 +397,7 @@ void SV_BuildClientFrame (client_t *client)
 	frame = &client->frames[sv.framenum & UPDATE_MASK];
 
 	frame->senttime = svs.realtime; // save it for ping calc later
+	frame->framenum = sv.framenum;
 
 	// find the client's PVS
 	for (i = 0; i < 3; i++)
@@ -168,7 +168,7 @@ clients along with it.
 */
 void SV_SpawnServer (char *server, char *spawnpoint, server_state_t serverstate, qboolean attractloop, qboolean loadgame)
 {
-	int			i;
+	int			i, j;
 	unsigned	checksum;
 
 	if (attractloop)
@@ -177,8 +177,7 @@ void SV_SpawnServer (char *server, char *spawnpoint, server_state_t serverstate,
 	Com_Printf ("------- Server Initialization -------\n");
 
 	Com_DPrintf ("SpawnServer: %s\n", server);
-	if (sv.demofile)
-		fclose (sv.demofile);
+	SV_CloseDemo ();
 
 	svs.spawncount++;		// any partially connected client will be
 	// restarted
@@ -188,6 +187,7 @@ void SV_SpawnServer (char *server, char *spawnpoint, server_state_t serverstate,
 	// wipe the entire per-level structure
 	memset (&sv, 0, sizeof (sv));
 	svs.realtime = 0;
+	SV_PerfNewServer ();
 	sv.loadgame = loadgame;
 	sv.attractloop = attractloop;
 
@@ -209,12 +209,16 @@ void SV_SpawnServer (char *server, char *spawnpoint, server_state_t serverstate,
 	strcpy (sv.name, server);
 
 	// leave slots at start for clients only
-	for (i = 0; i<maxclients->value; i++)
+	for (i = 0; i < svs.numslots; i++)
 	{
 		// needs to reconnect
 		if (svs.clients[i].state > cs_connected)
 			svs.clients[i].state = cs_connected;
 		svs.clients[i].lastframe = -1;
+
+		// frame numbers start over, so relay spectators mustn't take old frames for new ones
+		for (j = 0; j < UPDATE_BACKUP; j++)
+			svs.clients[i].frames[j].framenum = -1;
 	}
 
 	sv.time = 1000;
@@ -336,13 +340,23 @@ void SV_InitGame (void)
 		Cvar_FullSet ("maxclients", "1", CVAR_SERVERINFO | CVAR_LATCH);
 	}
 
+	// relay spectators go after the players
+	if (sv_relay_max->value < 0)
+		Cvar_FullSet ("sv_relay_max", "0", CVAR_LATCH);
+	else if (sv_relay_max->value > MAX_RELAYS)
+		Cvar_FullSet ("sv_relay_max", va ("%i", MAX_RELAYS), CVAR_LATCH);
+
 	svs.spawncount = rand ();
-	svs.clients = Zone_Alloc (sizeof (client_t) * maxclients->value);
+	svs.numslots = maxclients->value + sv_relay_max->value;
+	svs.clients = Zone_Alloc (sizeof (client_t) * svs.numslots);
 	svs.num_client_entities = maxclients->value * UPDATE_BACKUP * 64;
 	svs.client_entities = Zone_Alloc (sizeof (entity_state_t) * svs.num_client_entities);
 
+	SZ_Init (&svs.relay_multicast, svs.relay_multicast_buf, sizeof (svs.relay_multicast_buf));
+	svs.relay_multicast.allowoverflow = true;
+
 	// init network stuff
-	NET_Config ((maxclients->value > 1));
+	NET_Config ((maxclients->value > 1 || svs.numslots > maxclients->value));
 
 	// heartbeats will always be sent to the id master
 	svs.last_heartbeat = -99999;		// send immediately
@@ -0,0 +1,1047 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// sv_loadgen.c -- simulated clients for putting load on the server
+
+#include "server.h"
+
+/*
+==============================================================================
+
+LOAD GENERATOR
+
+"loadgen <numclients> [seconds]" connects simulated clients to the running
+server over their own loopback ports (see NET_OpenLoopPorts), so nothing
+touches the network.  each one goes through getchallenge/connect/new/begin,
+then sends scripted moves built the same way as CL_SendCmd and acknowledges
+frames so that the server delta compresses against them.
+
+the simulated clients don't parse what the server sends them; they run in
+the server's frame straight after SV_ReadPackets, so any packet they take
+off their port came from the last SV_SendClientMessages and sv.framenum is
+the frame it carried.  configstrings and baselines are never requested.
+
+when the run ends the server tick time (from sv_perf.c), bytes per client
+and drop rates are printed.
+
+"dlbench <file> [window] [rtt] [loss]" is a run with one simulated client
+that stays connecting and downloads a file instead, either windowed or with
+nextdl when the window is 0.  everything the server sends it is held back
+for rtt milliseconds and loss percent of it is thrown away (from a fixed
+seed, so runs repeat), and the time to get the whole file is reported.  the
+latency only has the resolution of the server's frames, so it's best run
+on a listen server.
+
+"relaybench <spectators> [players] [seconds]" is the same with relay
+spectators (see sv_relay.c) added after the players, spread over the
+players and the local one.  running it with more and more spectators
+should leave the game phase where it is and add no more than a copy and a
+send per spectator to the send phase; compare with loadgen, where every
+client has its own frame built.
+
+==============================================================================
+*/
+
+// only the last three commands go in each move
+#define	LG_CMDBACKUP	4
+
+// qports for simulated clients are their loopback port with this added so that they're easy to spot
+#define	LG_QPORTBASE	0x4000
+
+typedef enum lgstate_s
+{
+	lg_rejected,
+	lg_challenging,
+	lg_connecting,
+	lg_connected,
+	lg_spawned
+} lgstate_t;
+
+typedef struct lgbot_s
+{
+	lgstate_t	state;
+	int			port;
+	int			challenge;
+	int			lastsend;			// svs.realtime
+	int			lastrequest;		// svs.realtime of the last connectionless packet or new/begin
+	int			lastframe;			// for delta compression, -1 if none
+	client_t	*client;			// our slot on the server once connected
+
+	netchan_t	netchan;
+	usercmd_t	cmds[LG_CMDBACKUP];
+
+	// stats
+	int			bytesin;
+	int			packetsin;
+	int			packetsout;
+	int			dropped;
+} lgbot_t;
+
+typedef struct lgstage_s
+{
+	double		total;
+	double		min;
+	double		max;
+} lgstage_t;
+
+static lgbot_t *lg_bots = NULL;
+static int lg_numbots = 0;
+static int lg_numplayers = 0;	// the bots after these are relay spectators
+static int lg_starttime = 0;
+static int lg_endtime = 0;		// 0 runs until "loadgen stop"
+static int lg_ticks = 0;
+static qboolean lg_stopping = false;
+
+static lgstage_t lg_stages[SVP_NUMPHASES];
+static lgstage_t lg_tick;
+
+// relay totals when the run started
+static int lg_relayencoded = 0;
+static int lg_relaysent = 0;
+
+static double lg_deltahits = 0;
+static double lg_deltamisses = 0;
+
+static byte lg_msgbuf[MAX_MSGLEN];
+static sizebuf_t lg_msg;
+
+// packets held back by the download benchmark; must be a power of 2
+#define	LG_MAXDELAYED	256
+
+typedef struct lgpacket_s
+{
+	int			time;				// svs.realtime it's delivered
+	int			length;
+	byte		data[MAX_MSGLEN];
+} lgpacket_t;
+
+typedef struct lgdownload_s
+{
+	char		name[MAX_QPATH];
+	int			window;				// 0 for nextdl
+	int			latency;
+	int			loss;
+	unsigned	seed;
+
+	int			id;
+	int			chunks;				// 0 before the first windowed chunk
+	int			base;				// first chunk not received
+	byte		*received;			// a bit for each chunk
+	qboolean	acknow;
+
+	int			starttime;
+	int			endtime;
+	int			bytes;
+	int			lost;
+	int			duplicates;
+	qboolean	done;
+
+	lgpacket_t	*delayed;
+	int			delayedget, delayedsend;
+} lgdownload_t;
+
+static lgdownload_t *lg_download = NULL;
+
+cvar_t *loadgen_fps;
+
+
+static void SV_LoadGen_AccumulateStage (lgstage_t *s, float ms)
+{
+	if (!lg_ticks || ms < s->min) s->min = ms;
+	if (!lg_ticks || ms > s->max) s->max = ms;
+
+	s->total += ms;
+}
+
+
+/*
+==================
+SV_LoadGen_Tick
+
+the profiler hands over every server tick; totals are kept for the whole run
+==================
+*/
+void SV_LoadGen_Tick (svperfsample_t *sample)
+{
+	int phase;
+
+	if (!lg_bots) return;
+
+	for (phase = 0; phase < SVP_NUMPHASES; phase++)
+		SV_LoadGen_AccumulateStage (&lg_stages[phase], sample->phases[phase]);
+
+	SV_LoadGen_AccumulateStage (&lg_tick, sample->total);
+
+	lg_deltahits += sample->deltahits;
+	lg_deltamisses += sample->deltamisses;
+
+	lg_ticks++;
+}
+
+
+static void SV_LoadGen_Report (void)
+{
+	int i, phase;
+	int seconds = svs.realtime - lg_starttime;
+	double bytesin = 0, packetsin = 0, packetsout = 0, dropped = 0, ratedrops = 0;
+	int connected = 0;
+
+	if (seconds < 1) seconds = 1;
+
+	for (i = 0; i < lg_numbots; i++)
+	{
+		lgbot_t *bot = &lg_bots[i];
+
+		if (bot->state < lg_connected)
+			continue;
+
+		bytesin += bot->bytesin;
+		packetsin += bot->packetsin;
+		packetsout += bot->packetsout;
+		dropped += bot->dropped;
+
+		if (bot->client)
+			ratedrops += bot->client->ratedrops;
+
+		connected++;
+	}
+
+	Com_Printf ("loadgen: %i of %i clients connected for %0.1f seconds, %i server ticks\n", connected, lg_numbots, seconds / 1000.0, lg_ticks);
+
+	if (lg_ticks)
+	{
+		Com_Printf ("phase (ms)     min      avg      max\n");
+
+		for (phase = 0; phase < SVP_NUMPHASES; phase++)
+		{
+			lgstage_t *s = &lg_stages[phase];
+
+			Com_Printf ("%-10s %8.3f %8.3f %8.3f\n", sv_perfphasenames[phase], s->min, s->total / lg_ticks, s->max);
+		}
+
+		Com_Printf ("%-10s %8.3f %8.3f %8.3f\n", "tick", lg_tick.min, lg_tick.total / lg_ticks, lg_tick.max);
+	}
+
+	if (lg_deltahits + lg_deltamisses > 0)
+	{
+		Com_Printf (
+			"entity deltas: %0.0f per tick, %0.1f%% copied from the shared cache\n",
+			(lg_deltahits + lg_deltamisses) / (lg_ticks ? lg_ticks : 1),
+			(lg_deltahits * 100.0) / (lg_deltahits + lg_deltamisses)
+		);
+	}
+
+	if (connected)
+	{
+		Com_Printf (
+			"per client: %0.0f bytes/sec down, %0.1f packets/sec down, %0.1f packets/sec up\n",
+			(bytesin * 1000.0) / (connected * seconds),
+			(packetsin * 1000.0) / (connected * seconds),
+			(packetsout * 1000.0) / (connected * seconds)
+		);
+
+		Com_Printf (
+			"dropped: %0.0f packets in transit (%0.2f%%), %0.0f frames rate suppressed (%0.2f%%)\n",
+			dropped,
+			(dropped + packetsin) > 0 ? (dropped * 100.0) / (dropped + packetsin) : 0.0,
+			ratedrops,
+			(ratedrops + packetsin) > 0 ? (ratedrops * 100.0) / (ratedrops + packetsin) : 0.0
+		);
+	}
+
+	if (lg_numplayers < lg_numbots)
+	{
+		int encoded, sent;
+
+		SV_RelayStats (&encoded, &sent);
+
+		encoded -= lg_relayencoded;
+		sent -= lg_relaysent;
+
+		Com_Printf (
+			"relay: %i spectators, %i frames sent from %i encodes, %0.1f spectators per encode\n",
+			lg_numbots - lg_numplayers,
+			sent,
+			encoded,
+			encoded ? (double) sent / encoded : 0.0
+		);
+	}
+}
+
+
+/*
+==================
+SV_LoadGen_Shutdown
+
+ends a run immediately without sending disconnects; the server is going away
+==================
+*/
+void SV_LoadGen_Shutdown (void)
+{
+	if (!lg_bots) return;
+
+	if (!lg_stopping)
+		SV_LoadGen_Report ();
+
+	Zone_Free (lg_bots);
+	lg_bots = NULL;
+	lg_numbots = 0;
+	lg_stopping = false;
+
+	if (lg_download)
+	{
+		if (lg_download->received)
+			Zone_Free (lg_download->received);
+
+		Zone_Free (lg_download->delayed);
+		Zone_Free (lg_download);
+		lg_download = NULL;
+	}
+
+	NET_CloseLoopPorts ();
+}
+
+
+// disconnects like CL_Disconnect; the ports stay open until the server has read them
+static void SV_LoadGen_Stop (void)
+{
+	int i;
+	byte final[32];
+
+	if (!lg_bots || lg_stopping) return;
+
+	SV_LoadGen_Report ();
+
+	final[0] = clc_stringcmd;
+	strcpy ((char *) final + 1, "disconnect");
+
+	for (i = 0; i < lg_numbots; i++)
+	{
+		lgbot_t *bot = &lg_bots[i];
+
+		if (bot->state < lg_connected)
+			continue;
+
+		Netchan_Transmit (&bot->netchan, strlen (final), final);
+		Netchan_Transmit (&bot->netchan, strlen (final), final);
+		Netchan_Transmit (&bot->netchan, strlen (final), final);
+	}
+
+	lg_stopping = true;
+}
+
+
+static void SV_LoadGen_RequestSpawn (lgbot_t *bot)
+{
+	MSG_WriteChar (&bot->netchan.message, clc_stringcmd);
+	MSG_WriteString (&bot->netchan.message, "new");
+	MSG_WriteChar (&bot->netchan.message, clc_stringcmd);
+	MSG_WriteString (&bot->netchan.message, va ("begin %i", svs.spawncount));
+
+	bot->lastrequest = svs.realtime;
+	bot->lastframe = -1;
+}
+
+
+static void SV_LoadGen_RequestDownload (lgbot_t *bot)
+{
+	MSG_WriteChar (&bot->netchan.message, clc_stringcmd);
+
+	if (lg_download->window)
+		MSG_WriteString (&bot->netchan.message, va ("download %s 0 %i", lg_download->name, lg_download->window));
+	else MSG_WriteString (&bot->netchan.message, va ("download %s", lg_download->name));
+
+	bot->lastrequest = svs.realtime;
+	lg_download->starttime = svs.realtime;
+}
+
+
+static void SV_LoadGen_ConnectionlessPacket (lgbot_t *bot)
+{
+	netadr_t adr;
+	char *s;
+	int i;
+
+	MSG_BeginReading (&lg_msg);
+	MSG_ReadLong (&lg_msg);	// skip the -1
+
+	s = MSG_ReadStringLine (&lg_msg);
+
+	memset (&adr, 0, sizeof (adr));
+	adr.type = NA_LOOPBACK;
+	adr.loopport = bot->port;
+
+	if (!strncmp (s, "challenge ", 10) && bot->state == lg_challenging)
+	{
+		char userinfo[MAX_INFO_STRING];
+
+		bot->challenge = atoi (s + 10);
+		bot->state = lg_connecting;
+		bot->lastrequest = svs.realtime;
+
+		Com_sprintf (userinfo, sizeof (userinfo), "\\name\\loadbot%i\\skin\\male/grunt\\rate\\25000\\msg\\1\\hand\\0\\fov\\90", bot->port);
+
+		// spectators are spread over the players, counting the local one
+		if (bot - lg_bots >= lg_numplayers)
+			Info_SetValueForKey (userinfo, "relay", va ("%i", (int) ((bot - lg_bots - lg_numplayers) % (lg_numplayers + 1)) + 1));
+		Netchan_OutOfBandPrint (NS_CLIENT, adr, "connect %i %i %i \"%s\"\n", PROTOCOL_VERSION, LG_QPORTBASE + bot->port, bot->challenge, userinfo);
+	}
+	else if (!strcmp (s, "client_connect") && bot->state == lg_connecting)
+	{
+		Netchan_Setup (NS_CLIENT, &bot->netchan, adr, LG_QPORTBASE + bot->port);
+		bot->state = lg_connected;
+
+		// find our slot so that we can follow level changes
+		for (i = 0; i < svs.numslots; i++)
+		{
+			if (svs.clients[i].state != cs_free && NET_CompareAdr (svs.clients[i].netchan.remote_address, adr))
+			{
+				bot->client = &svs.clients[i];
+				break;
+			}
+		}
+
+		if (lg_download)
+			SV_LoadGen_RequestDownload (bot);
+		else SV_LoadGen_RequestSpawn (bot);
+	}
+	else if (!strncmp (s, "print", 5))
+	{
+		// the server turned us away
+		Com_Printf ("loadbot%i: %s", bot->port, MSG_ReadString (&lg_msg));
+		bot->state = lg_rejected;
+	}
+}
+
+
+static void SV_LoadGen_ReadPackets (lgbot_t *bot)
+{
+	qboolean received = false;
+
+	while (NET_GetLoopPortPacket (bot->port, &lg_msg))
+	{
+		if (*(int *) lg_msg.data == -1)
+		{
+			SV_LoadGen_ConnectionlessPacket (bot);
+			continue;
+		}
+
+		if (bot->state < lg_connected)
+			continue;
+
+		if (!Netchan_Process (&bot->netchan, &lg_msg))
+			continue;
+
+		bot->bytesin += lg_msg.cursize;
+		bot->packetsin++;
+		bot->dropped += bot->netchan.dropped;
+		received = true;
+	}
+
+	// follow the server through level changes and kicks
+	if (bot->client && bot->state >= lg_connected)
+	{
+		if (bot->client->state == cs_free || bot->client->state == cs_zombie)
+			bot->state = lg_rejected;
+		else if (bot->client->state == cs_spawned)
+			bot->state = lg_spawned;
+		else if (bot->state == lg_spawned || svs.realtime - bot->lastrequest > 2000)
+		{
+			bot->state = lg_connected;
+			SV_LoadGen_RequestSpawn (bot);
+		}
+	}
+
+	// anything that arrived was sent by the last SV_SendClientMessages
+	if (received && bot->state == lg_spawned)
+		bot->lastframe = sv.framenum;
+}
+
+
+static void SV_LoadGen_DownloadDone (lgdownload_t *dl)
+{
+	int msec = svs.realtime - dl->starttime;
+
+	if (msec < 1) msec = 1;
+
+	dl->endtime = svs.realtime;
+	dl->done = true;
+
+	if (dl->window)
+		Com_Printf ("dlbench: %s, %i bytes in %0.2f seconds, %i chunks in flight", dl->name, dl->bytes, msec / 1000.0, dl->window);
+	else Com_Printf ("dlbench: %s, %i bytes in %0.2f seconds with nextdl", dl->name, dl->bytes, msec / 1000.0);
+
+	Com_Printf (", %i msec round trip, %i%% loss\n", dl->latency, dl->loss);
+	Com_Printf ("dlbench: %0.3f MB/s, %i packets lost, %i chunks received twice\n", (dl->bytes / (1024.0 * 1024.0)) / (msec / 1000.0), dl->lost, dl->duplicates);
+}
+
+
+static void SV_LoadGen_DownloadChunk (lgdownload_t *dl)
+{
+	int id = MSG_ReadByte (&lg_msg);
+	int filesize = MSG_ReadLong (&lg_msg);
+	int offset = MSG_ReadLong (&lg_msg);
+	int size = MSG_ReadShort (&lg_msg);
+	int chunk = offset / DOWNLOAD_CHUNK;
+
+	lg_msg.readcount += size;
+
+	// the same checks as CL_ParseDownloadChunk, without the file
+	if (!dl->chunks)
+	{
+		if (filesize <= 0)
+			return;
+
+		dl->id = id;
+		dl->chunks = (filesize + DOWNLOAD_CHUNK - 1) / DOWNLOAD_CHUNK;
+		dl->received = (byte *) Zone_Alloc ((dl->chunks + 7) >> 3);
+	}
+	else if (id != dl->id)
+		return;
+
+	if (offset < 0 || (offset % DOWNLOAD_CHUNK) || chunk >= dl->chunks)
+		return;
+
+	dl->acknow = true;
+
+	if (chunk < dl->base || (dl->received[chunk >> 3] & (1 << (chunk & 7))))
+	{
+		dl->duplicates++;
+		return;
+	}
+
+	dl->received[chunk >> 3] |= 1 << (chunk & 7);
+	dl->bytes += size;
+
+	while (dl->base < dl->chunks && (dl->received[dl->base >> 3] & (1 << (dl->base & 7))))
+		dl->base++;
+
+	if (dl->base == dl->chunks)
+		SV_LoadGen_DownloadDone (dl);
+}
+
+
+// nothing else is sent to a client that hasn't asked for "new"
+static void SV_LoadGen_ParseDownload (lgbot_t *bot)
+{
+	lgdownload_t *dl = lg_download;
+
+	while (!dl->done)
+	{
+		int size, percent;
+
+		switch (MSG_ReadByte (&lg_msg))
+		{
+		case svc_nop:
+			break;
+
+		case svc_print:
+			MSG_ReadByte (&lg_msg);
+			MSG_ReadString (&lg_msg);
+			break;
+
+		case svc_stufftext:
+			MSG_ReadString (&lg_msg);
+			break;
+
+		case svc_download:
+			size = MSG_ReadShort (&lg_msg);
+			percent = MSG_ReadByte (&lg_msg);
+
+			if (size == -1)
+			{
+				Com_Printf ("dlbench: the server refused %s; is allow_download set?\n", dl->name);
+				dl->done = true;
+				return;
+			}
+
+			lg_msg.readcount += size;
+			dl->bytes += size;
+
+			if (percent == 100)
+				SV_LoadGen_DownloadDone (dl);
+			else
+			{
+				MSG_WriteChar (&bot->netchan.message, clc_stringcmd);
+				MSG_WriteString (&bot->netchan.message, "nextdl");
+			}
+			break;
+
+		case svc_downloadchunk:
+			SV_LoadGen_DownloadChunk (dl);
+			break;
+
+		default:
+			// the end of the packet, or something we don't follow
+			return;
+		}
+	}
+}
+
+
+static unsigned SV_LoadGen_Random (lgdownload_t *dl)
+{
+	dl->seed = dl->seed * 1103515245 + 12345;
+	return (dl->seed >> 16) & 0x7fff;
+}
+
+
+/*
+==================
+SV_LoadGen_ReadDownloadPackets
+
+packets from the server wait out the round trip in a queue, which keeps them in order
+==================
+*/
+static void SV_LoadGen_ReadDownloadPackets (lgbot_t *bot)
+{
+	lgdownload_t *dl = lg_download;
+
+	while (NET_GetLoopPortPacket (bot->port, &lg_msg))
+	{
+		lgpacket_t *p;
+
+		if (*(int *) lg_msg.data == -1)
+		{
+			SV_LoadGen_ConnectionlessPacket (bot);
+			continue;
+		}
+
+		if (bot->state < lg_connected)
+			continue;
+
+		if ((int) (SV_LoadGen_Random (dl) % 100) < dl->loss || dl->delayedsend - dl->delayedget >= LG_MAXDELAYED)
+		{
+			dl->lost++;
+			continue;
+		}
+
+		p = &dl->delayed[dl->delayedsend++ & (LG_MAXDELAYED - 1)];
+		p->time = svs.realtime + dl->latency;
+		p->length = lg_msg.cursize;
+		memcpy (p->data, lg_msg.data, lg_msg.cursize);
+	}
+
+	while (dl->delayedget < dl->delayedsend && !dl->done)
+	{
+		lgpacket_t *p = &dl->delayed[dl->delayedget & (LG_MAXDELAYED - 1)];
+
+		if (p->time > svs.realtime)
+			break;
+
+		dl->delayedget++;
+
+		memcpy (lg_msg.data, p->data, p->length);
+		lg_msg.cursize = p->length;
+
+		if (!Netchan_Process (&bot->netchan, &lg_msg))
+			continue;
+
+		bot->bytesin += lg_msg.cursize;
+		bot->packetsin++;
+		bot->dropped += bot->netchan.dropped;
+
+		SV_LoadGen_ParseDownload (bot);
+	}
+
+	if (bot->client && bot->state >= lg_connected && (bot->client->state == cs_free || bot->client->state == cs_zombie))
+	{
+		Com_Printf ("dlbench: dropped by the server\n");
+		bot->state = lg_rejected;
+		dl->done = true;
+	}
+}
+
+
+static void SV_LoadGen_WriteDownloadAck (sizebuf_t *buf)
+{
+	lgdownload_t *dl = lg_download;
+	unsigned mask = 0;
+	int i;
+
+	if (!dl->chunks || !dl->acknow)
+		return;
+
+	for (i = 0; i < 32; i++)
+	{
+		int chunk = dl->base + 1 + i;
+
+		if (chunk < dl->chunks && (dl->received[chunk >> 3] & (1 << (chunk & 7))))
+			mask |= 1u << i;
+	}
+
+	MSG_WriteByte (buf, clc_downloadack);
+	MSG_WriteByte (buf, dl->id);
+	MSG_WriteLong (buf, dl->base);
+	MSG_WriteLong (buf, mask);
+
+	dl->acknow = false;
+}
+
+
+// moves for the simulated clients: run and strafe in circles, jump and fire every few seconds
+static void SV_LoadGen_ScriptCmd (lgbot_t *bot, usercmd_t *cmd, int msec)
+{
+	// stagger the clients so that they don't all do the same thing at once
+	int t = svs.realtime - lg_starttime + bot->port * 733;
+
+	memset (cmd, 0, sizeof (*cmd));
+
+	cmd->msec = msec;
+	cmd->angles[1] = ANGLE2SHORT ((t / 10) % 360);	// yaw
+	cmd->forwardmove = ((t % 4000) < 3000) ? 200 : -200;
+	cmd->sidemove = ((t / 1500) & 1) ? 150 : -150;
+	cmd->upmove = ((t % 3000) < 100) ? 200 : 0;
+	cmd->buttons = ((t % 5000) < 500) ? BUTTON_ATTACK : 0;
+	cmd->lightlevel = 128;
+}
+
+
+static void SV_LoadGen_SendCmd (lgbot_t *bot, int msec)
+{
+	sizebuf_t	buf;
+	byte		data[128];
+	usercmd_t	*cmd, *oldcmd;
+	usercmd_t	nullcmd;
+	int			checksumIndex;
+
+	SV_LoadGen_ScriptCmd (bot, &bot->cmds[bot->netchan.outgoing_sequence & (LG_CMDBACKUP - 1)], msec);
+
+	SZ_Init (&buf, data, sizeof (data));
+
+	// not in the game yet so just keep the reliable stream going
+	if (bot->state != lg_spawned)
+	{
+		if (lg_download)
+			SV_LoadGen_WriteDownloadAck (&buf);
+
+		Netchan_Transmit (&bot->netchan, buf.cursize, buf.data);
+		bot->packetsout++;
+		return;
+	}
+
+	// begin a client move command
+	MSG_WriteByte (&buf, clc_move);
+
+	// save the position for a checksum byte
+	checksumIndex = buf.cursize;
+	MSG_WriteByte (&buf, 0);
+
+	// let the server know what the last frame we got was, so the next message can be delta compressed
+	MSG_WriteLong (&buf, bot->lastframe);
+
+	// send this and the previous cmds in the message, so if the last packet was dropped, it can be recovered
+	cmd = &bot->cmds[(bot->netchan.outgoing_sequence - 2) & (LG_CMDBACKUP - 1)];
+	memset (&nullcmd, 0, sizeof (nullcmd));
+	MSG_WriteDeltaUsercmd (&buf, &nullcmd, cmd);
+	oldcmd = cmd;
+
+	cmd = &bot->cmds[(bot->netchan.outgoing_sequence - 1) & (LG_CMDBACKUP - 1)];
+	MSG_WriteDeltaUsercmd (&buf, oldcmd, cmd);
+	oldcmd = cmd;
+
+	cmd = &bot->cmds[bot->netchan.outgoing_sequence & (LG_CMDBACKUP - 1)];
+	MSG_WriteDeltaUsercmd (&buf, oldcmd, cmd);
+
+	// calculate a checksum over the move commands
+	buf.data[checksumIndex] = COM_BlockSequenceCRCByte (
+		buf.data + checksumIndex + 1, buf.cursize - checksumIndex - 1,
+		bot->netchan.outgoing_sequence);
+
+	// deliver the message
+	Netchan_Transmit (&bot->netchan, buf.cursize, buf.data);
+	bot->packetsout++;
+}
+
+
+/*
+==================
+SV_LoadGen_Frame
+
+runs every simulated client; called from SV_Frame straight after SV_ReadPackets
+==================
+*/
+void SV_LoadGen_Frame (void)
+{
+	int i;
+	int frametime;
+
+	if (!lg_bots) return;
+
+	// the disconnects went out last frame and have been read now
+	if (lg_stopping)
+	{
+		SV_LoadGen_Shutdown ();
+		return;
+	}
+
+	if (lg_endtime && svs.realtime >= lg_endtime)
+	{
+		SV_LoadGen_Stop ();
+		return;
+	}
+
+	if (loadgen_fps->value < 10)
+		Cvar_SetValue ("loadgen_fps", 10);
+	else if (loadgen_fps->value > 1000)
+		Cvar_SetValue ("loadgen_fps", 1000);
+
+	frametime = 1000 / (int) loadgen_fps->value;
+
+	for (i = 0; i < lg_numbots; i++)
+	{
+		lgbot_t *bot = &lg_bots[i];
+		int msec = svs.realtime - bot->lastsend;
+
+		if (bot->state == lg_rejected)
+			continue;
+
+		if (lg_download)
+			SV_LoadGen_ReadDownloadPackets (bot);
+		else SV_LoadGen_ReadPackets (bot);
+
+		if (bot->state == lg_challenging || bot->state == lg_connecting)
+		{
+			netadr_t adr;
+
+			// resend like CL_CheckForResend
+			if (svs.realtime - bot->lastrequest < 1000)
+				continue;
+
+			memset (&adr, 0, sizeof (adr));
+			adr.type = NA_LOOPBACK;
+			adr.loopport = bot->port;
+
+			bot->state = lg_challenging;
+			bot->lastrequest = svs.realtime;
+
+			Netchan_OutOfBandPrint (NS_CLIENT, adr, "getchallenge\n");
+			continue;
+		}
+
+		if (bot->state < lg_connected || msec < frametime)
+			continue;
+
+		SV_LoadGen_SendCmd (bot, (msec > 250) ? 250 : msec);
+		bot->lastsend = svs.realtime;
+	}
+
+	// the download benchmark ends itself
+	if (lg_download && (lg_download->done || lg_bots[0].state == lg_rejected))
+		SV_LoadGen_Stop ();
+}
+
+
+static void SV_LoadGen_Start (int numbots, int numplayers, int seconds)
+{
+	int i;
+
+	// a run that's still disconnecting is simply thrown away
+	SV_LoadGen_Shutdown ();
+
+	NET_OpenLoopPorts (numbots);
+
+	lg_bots = (lgbot_t *) Zone_Alloc (numbots * sizeof (lgbot_t));
+	lg_numbots = numbots;
+	lg_numplayers = numplayers;
+
+	for (i = 0; i < numbots; i++)
+	{
+		lg_bots[i].state = lg_challenging;
+		lg_bots[i].port = i + 1;
+		lg_bots[i].lastrequest = svs.realtime - 1000;	// ask for a challenge on the first frame
+		lg_bots[i].lastsend = svs.realtime;
+		lg_bots[i].lastframe = -1;
+	}
+
+	memset (lg_stages, 0, sizeof (lg_stages));
+	memset (&lg_tick, 0, sizeof (lg_tick));
+	lg_ticks = 0;
+	lg_deltahits = lg_deltamisses = 0;
+	SV_RelayStats (&lg_relayencoded, &lg_relaysent);
+	lg_starttime = svs.realtime;
+	lg_endtime = (seconds > 0) ? svs.realtime + seconds * 1000 : 0;
+}
+
+
+/*
+==================
+SV_LoadGen_f
+
+loadgen <numclients> [seconds]
+loadgen stop
+==================
+*/
+static void SV_LoadGen_f (void)
+{
+	int numbots, seconds;
+
+	if (Cmd_Argc () < 2)
+	{
+		Com_Printf ("usage: loadgen <numclients> [seconds] | loadgen stop\n");
+
+		if (lg_bots)
+			Com_Printf ("%i simulated clients running\n", lg_numbots);
+
+		return;
+	}
+
+	if (!Q_stricmp (Cmd_Argv (1), "stop"))
+	{
+		SV_LoadGen_Stop ();
+		return;
+	}
+
+	if (sv.state != ss_game)
+	{
+		Com_Printf ("loadgen: no game running\n");
+		return;
+	}
+
+	if ((numbots = atoi (Cmd_Argv (1))) < 1)
+	{
+		Com_Printf ("loadgen: bad number of clients\n");
+		return;
+	}
+
+	if (numbots > MAX_CLIENTS) numbots = MAX_CLIENTS;
+
+	// the local player uses a slot too
+	if (numbots >= maxclients->value)
+		Com_Printf ("loadgen: only %i client slots; raise maxclients for more\n", (int) maxclients->value);
+
+	seconds = (Cmd_Argc () > 2) ? atoi (Cmd_Argv (2)) : 0;
+
+	SV_LoadGen_Start (numbots, numbots, seconds);
+
+	Com_Printf ("loadgen: starting %i simulated clients\n", numbots);
+}
+
+
+/*
+==================
+SV_DownloadBench_f
+
+dlbench <file> [window] [rtt msec] [loss percent]
+==================
+*/
+static void SV_DownloadBench_f (void)
+{
+	lgdownload_t *dl;
+
+	if (Cmd_Argc () < 2)
+	{
+		Com_Printf ("usage: dlbench <file> [window] [rtt msec] [loss percent]\n");
+		Com_Printf ("window 0 uses nextdl; the default is %i chunks\n", DOWNLOAD_WINDOW);
+		return;
+	}
+
+	if (sv.state != ss_game)
+	{
+		Com_Printf ("dlbench: no game running\n");
+		return;
+	}
+
+	SV_LoadGen_Start (1, 1, 0);
+
+	dl = lg_download = (lgdownload_t *) Zone_Alloc (sizeof (lgdownload_t));
+	dl->delayed = (lgpacket_t *) Zone_Alloc (LG_MAXDELAYED * sizeof (lgpacket_t));
+	dl->seed = 1;
+
+	Com_sprintf (dl->name, sizeof (dl->name), "%s", Cmd_Argv (1));
+
+	dl->window = (Cmd_Argc () > 2) ? atoi (Cmd_Argv (2)) : DOWNLOAD_WINDOW;
+	dl->latency = (Cmd_Argc () > 3) ? atoi (Cmd_Argv (3)) : 0;
+	dl->loss = (Cmd_Argc () > 4) ? atoi (Cmd_Argv (4)) : 0;
+
+	if (dl->window < 0) dl->window = 0;
+	if (dl->window > DOWNLOAD_WINDOW) dl->window = DOWNLOAD_WINDOW;
+	if (dl->latency < 0) dl->latency = 0;
+	if (dl->loss < 0) dl->loss = 0;
+	if (dl->loss > 90) dl->loss = 90;
+
+	Com_Printf ("dlbench: downloading %s\n", dl->name);
+}
+
+
+/*
+==================
+SV_RelayBench_f
+
+relaybench <spectators> [players] [seconds]
+==================
+*/
+static void SV_RelayBench_f (void)
+{
+	int spectators, players, seconds;
+	int slots = svs.numslots - maxclients->value;
+
+	if (Cmd_Argc () < 2)
+	{
+		Com_Printf ("usage: relaybench <spectators> [players] [seconds]\n");
+		return;
+	}
+
+	if (sv.state != ss_game)
+	{
+		Com_Printf ("relaybench: no game running\n");
+		return;
+	}
+
+	if ((spectators = atoi (Cmd_Argv (1))) < 1)
+	{
+		Com_Printf ("relaybench: bad number of spectators\n");
+		return;
+	}
+
+	players = (Cmd_Argc () > 2) ? atoi (Cmd_Argv (2)) : 0;
+	seconds = (Cmd_Argc () > 3) ? atoi (Cmd_Argv (3)) : 30;
+
+	if (spectators > slots)
+	{
+		Com_Printf ("relaybench: only %i relay slots; set sv_relay_max and start a new game for more\n", slots);
+
+		if ((spectators = slots) < 1)
+			return;
+	}
+
+	// the local player uses a slot too
+	if (players < 0) players = 0;
+	if (players > maxclients->value - 1) players = maxclients->value - 1;
+
+	if (players + spectators > MAX_LOOPPORTS)
+		spectators = MAX_LOOPPORTS - players;
+
+	SV_LoadGen_Start (players + spectators, players, seconds);
+
+	Com_Printf ("relaybench: starting %i spectators and %i simulated players\n", spectators, players);
+}
+
+
+void SV_InitLoadGen (void)
+{
+	SZ_Init (&lg_msg, lg_msgbuf, sizeof (lg_msgbuf));
+
+	loadgen_fps = Cvar_Get ("loadgen_fps", "60", 0, NULL);
+
+	Cmd_AddCommand ("loadgen", SV_LoadGen_f);
+	Cmd_AddCommand ("dlbench", SV_DownloadBench_f);
+	Cmd_AddCommand ("relaybench", SV_RelayBench_f);
+}
+
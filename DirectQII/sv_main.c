@@ -72,7 +72,7 @@ void SV_DropClient (client_t *drop)
 	// add the disconnect
 	MSG_WriteByte (&drop->netchan.message, svc_disconnect);
 
-	if (drop->state == cs_spawned)
+	if (drop->state == cs_spawned && !drop->relay)
 	{
 		// call the prog function for removing a client
 		// this will remove the body, among other things
@@ -276,6 +276,7 @@ void SVC_DirectConnect (void)
 	int			version;
 	int			qport;
 	int			challenge;
+	int			first, last;
 
 	adr = net_from;
 
@@ -334,7 +335,7 @@ void SVC_DirectConnect (void)
 	memset (newcl, 0, sizeof (client_t));
 
 	// if there is already a slot for this ip, reuse it
-	for (i = 0, cl = svs.clients; i < maxclients->value; i++, cl++)
+	for (i = 0, cl = svs.clients; i < svs.numslots; i++, cl++)
 	{
 		if (cl->state == cs_free)
 			continue;
@@ -351,9 +352,21 @@ void SVC_DirectConnect (void)
 		}
 	}
 
+	// relay spectators have slots of their own after the players
+	if (*Info_ValueForKey (userinfo, "relay"))
+	{
+		first = maxclients->value;
+		last = svs.numslots;
+	}
+	else
+	{
+		first = 0;
+		last = maxclients->value;
+	}
+
 	// find a client slot
 	newcl = NULL;
-	for (i = 0, cl = svs.clients; i < maxclients->value; i++, cl++)
+	for (i = first, cl = svs.clients + first; i < last; i++, cl++)
 	{
 		if (cl->state == cs_free)
 		{
@@ -374,21 +387,35 @@ gotnewcl:
 	// this is the only place a client_t is ever initialized
 	*newcl = temp;
 	sv_client = newcl;
-	edictnum = (newcl - svs.clients) + 1;
-	ent = EDICT_NUM (edictnum);
-	newcl->edict = ent;
 	newcl->challenge = challenge; // save challenge for checksumming
 
-	// get the game a chance to reject this connection or modify the userinfo
-	if (!(ge->ClientConnect (ent, userinfo)))
+	// a reconnect keeps the kind of slot it had
+	if (newcl - svs.clients >= maxclients->value)
 	{
-		if (*Info_ValueForKey (userinfo, "rejmsg"))
-			Netchan_OutOfBandPrint (NS_SERVER, adr, "print\n%s\nConnection refused.\n",
-			Info_ValueForKey (userinfo, "rejmsg"));
-		else
-			Netchan_OutOfBandPrint (NS_SERVER, adr, "print\nConnection refused.\n");
-		Com_DPrintf ("Game rejected a connection.\n");
-		return;
+		if (!SV_RelayConnect (newcl, userinfo))
+		{
+			Netchan_OutOfBandPrint (NS_SERVER, adr, "print\n%s\nConnection refused.\n", Info_ValueForKey (userinfo, "rejmsg"));
+			Com_DPrintf ("Rejected a relay connection.\n");
+			return;
+		}
+	}
+	else
+	{
+		edictnum = (newcl - svs.clients) + 1;
+		ent = EDICT_NUM (edictnum);
+		newcl->edict = ent;
+
+		// get the game a chance to reject this connection or modify the userinfo
+		if (!(ge->ClientConnect (ent, userinfo)))
+		{
+			if (*Info_ValueForKey (userinfo, "rejmsg"))
+				Netchan_OutOfBandPrint (NS_SERVER, adr, "print\n%s\nConnection refused.\n",
+				Info_ValueForKey (userinfo, "rejmsg"));
+			else
+				Netchan_OutOfBandPrint (NS_SERVER, adr, "print\nConnection refused.\n");
+			Com_DPrintf ("Game rejected a connection.\n");
+			return;
+		}
 	}
 
 	// parse some info from the info strings
@@ -610,7 +637,7 @@ void SV_ReadPackets (void)
 		qport = MSG_ReadShort (&net_message) & 0xffff;
 
 		// check for packets from connected clients
-		for (i = 0, cl = svs.clients; i < maxclients->value; i++, cl++)
+		for (i = 0, cl = svs.clients; i < svs.numslots; i++, cl++)
 		{
 			if (cl->state == cs_free)
 				continue;
@@ -636,7 +663,7 @@ void SV_ReadPackets (void)
 			break;
 		}
 
-		if (i != maxclients->value)
+		if (i != svs.numslots)
 			continue;
 	}
 }
@@ -664,7 +691,7 @@ void SV_CheckTimeouts (void)
 	droppoint = svs.realtime - 1000 * timeout->value;
 	zombiepoint = svs.realtime - 1000 * zombietime->value;
 
-	for (i = 0, cl = svs.clients; i < maxclients->value; i++, cl++)
+	for (i = 0, cl = svs.clients; i < svs.numslots; i++, cl++)
 	{
 		// message times may be wrong across a changelevel
 		if (cl->lastmessage > svs.realtime)
@@ -758,10 +785,15 @@ void SV_Frame (int msec)
 	SV_CheckTimeouts ();
 
 	// get packets from clients
+	SV_PerfBegin (SVP_READ);
 	SV_ReadPackets ();
+	SV_PerfEnd (SVP_READ);
+
+	// simulated clients take what was sent to them last frame and send their moves for the next read
+	SV_LoadGen_Frame ();
 
 	// move autonomous things around if enough time has passed
-	if (!sv_timedemo->value && svs.realtime < sv.time)
+	if (!sv_timedemo->value && !SV_DemoSeeking () && svs.realtime < sv.time)
 	{
 		// never let the time get too far off
 		if (sv.time - svs.realtime > 100)
@@ -776,25 +808,41 @@ void SV_Frame (int msec)
 	}
 
 	// update ping based on the last known frame from all clients
+	SV_PerfBegin (SVP_PINGS);
 	SV_CalcPings ();
+	SV_PerfEnd (SVP_PINGS);
 
 	// give the clients some timeslices
+	SV_PerfBegin (SVP_MSEC);
 	SV_GiveMsec ();
+	SV_PerfEnd (SVP_MSEC);
 
 	// let everything in the world think and move
+	SV_PerfBegin (SVP_GAME);
 	SV_RunGameFrame ();
+	SV_PerfEnd (SVP_GAME);
 
 	// send messages back to the clients that had packets read this frame
+	SV_PerfBegin (SVP_SEND);
 	SV_SendClientMessages ();
+	SV_PerfEnd (SVP_SEND);
 
 	// save the entire world state if recording a serverdemo
+	SV_PerfBegin (SVP_DEMO);
 	SV_RecordDemoMessage ();
+	SV_PerfEnd (SVP_DEMO);
 
 	// send a heartbeat to the master if needed
+	SV_PerfBegin (SVP_HEARTBEAT);
 	Master_Heartbeat ();
+	SV_PerfEnd (SVP_HEARTBEAT);
 
 	// clear teleport flags, etc for next frame
+	SV_PerfBegin (SVP_PREP);
 	SV_PrepWorldFrame ();
+	SV_PerfEnd (SVP_PREP);
+
+	SV_PerfEndTick ();
 
 }
 
@@ -886,7 +934,8 @@ void SV_UserinfoChanged (client_t *cl)
 	int		i;
 
 	// call prog code to allow overrides
-	ge->ClientUserinfoChanged (cl->edict, cl->userinfo);
+	if (!cl->relay)
+		ge->ClientUserinfoChanged (cl->edict, cl->userinfo);
 
 	// name for C code
 	strncpy (cl->name, Info_ValueForKey (cl->userinfo, "name"), sizeof (cl->name) - 1);
@@ -930,6 +979,9 @@ Only called at quake2.exe startup, not for each game
 void SV_Init (void)
 {
 	SV_InitOperatorCommands ();
+	SV_InitPerf ();
+	SV_InitLoadGen ();
+	SV_InitRelay ();
 
 	rcon_password = Cvar_Get ("rcon_password", "", 0, NULL);
 	Cvar_Get ("skill", "1", 0, NULL);
@@ -958,6 +1010,8 @@ void SV_Init (void)
 
 	sv_airaccelerate = Cvar_Get ("sv_airaccelerate", "0", CVAR_LATCH, NULL);
 
+	sv_deltacache = Cvar_Get ("sv_deltacache", "1", 0, NULL);
+
 	public_server = Cvar_Get ("public", "0", 0, NULL);
 
 	sv_reconnect_limit = Cvar_Get ("sv_reconnect_limit", "3", CVAR_ARCHIVE, NULL);
@@ -992,11 +1046,11 @@ void SV_FinalMessage (char *message, qboolean reconnect)
 
 	// send it twice
 	// stagger the packets to crutch operating system limited buffers
-	for (i = 0, cl = svs.clients; i < maxclients->value; i++, cl++)
+	for (i = 0, cl = svs.clients; i < svs.numslots; i++, cl++)
 		if (cl->state >= cs_connected)
 			Netchan_Transmit (&cl->netchan, net_message.cursize, net_message.data);
 
-	for (i = 0, cl = svs.clients; i < maxclients->value; i++, cl++)
+	for (i = 0, cl = svs.clients; i < svs.numslots; i++, cl++)
 		if (cl->state >= cs_connected)
 			Netchan_Transmit (&cl->netchan, net_message.cursize, net_message.data);
 }
@@ -1013,6 +1067,9 @@ before Sys_Quit or Sys_Error
 */
 void SV_Shutdown (char *finalmsg, qboolean reconnect)
 {
+	// simulated clients hold pointers into svs.clients
+	SV_LoadGen_Shutdown ();
+
 	if (svs.clients)
 		SV_FinalMessage (finalmsg, reconnect);
 
@@ -1020,8 +1077,7 @@ void SV_Shutdown (char *finalmsg, qboolean reconnect)
 	SV_ShutdownGameProgs ();
 
 	// free current level
-	if (sv.demofile)
-		fclose (sv.demofile);
+	SV_CloseDemo ();
 	memset (&sv, 0, sizeof (sv));
 	Com_SetServerState (sv.state);
 
@@ -0,0 +1,263 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// sv_perf.c -- server tick profiler
+
+#include "server.h"
+
+/*
+==============================================================================
+
+SERVER TICK PROFILER
+
+every phase of SV_Frame is bracketed with SV_PerfBegin/SV_PerfEnd and every
+server tick is kept in a rolling window along with counts of traces, edict
+links, bytes sent and how many entity deltas came from the shared cache.
+nothing is sampled; every tick is recorded.
+
+"sv_perf" prints percentiles over the window (it's an ordinary server
+command so rcon can query it); "sv_perf_log <seconds>" prints the same
+summary periodically so it ends up in the logfile, and any tick that takes
+longer than sv_perf_overrun milliseconds is counted and logged.
+
+==============================================================================
+*/
+
+#define	SV_PERF_HISTORY		512		// must be a power of 2
+
+char *sv_perfphasenames[SVP_NUMPHASES] = {"read", "pings", "msec", "game", "send", "demo", "heartbeat", "prep"};
+
+svperfcount_t sv_perfcount;
+
+static svperfsample_t sv_perfhistory[SV_PERF_HISTORY];
+static int sv_perfticks = 0;
+
+// the tick currently being timed
+static svperfsample_t sv_perfcurrent;
+static double sv_perfstart[SVP_NUMPHASES];
+static int sv_perfbytes = 0;
+
+static int sv_perfoverruns = 0;
+static int sv_perflastlog = 0;
+
+cvar_t *sv_perf_log;
+cvar_t *sv_perf_overrun;
+
+
+/*
+==================
+SV_PerfBegin
+SV_PerfEnd
+
+read can run several times between ticks so the times are summed
+==================
+*/
+void SV_PerfBegin (int phase)
+{
+	sv_perfstart[phase] = Sys_Microseconds ();
+}
+
+
+void SV_PerfEnd (int phase)
+{
+	sv_perfcurrent.phases[phase] += (Sys_Microseconds () - sv_perfstart[phase]) * 0.001;
+}
+
+
+/*
+==================
+SV_PerfEndTick
+
+called at the end of each server tick to commit the sample
+==================
+*/
+void SV_PerfEndTick (void)
+{
+	svperfsample_t *s = &sv_perfhistory[sv_perfticks & (SV_PERF_HISTORY - 1)];
+	int phase;
+
+	sv_perfcurrent.total = 0;
+
+	for (phase = 0; phase < SVP_NUMPHASES; phase++)
+		sv_perfcurrent.total += sv_perfcurrent.phases[phase];
+
+	sv_perfcurrent.traces = sv_perfcount.traces;
+	sv_perfcurrent.links = sv_perfcount.links;
+	sv_perfcurrent.deltahits = sv_perfcount.deltahits;
+	sv_perfcurrent.deltamisses = sv_perfcount.deltamisses;
+	sv_perfcurrent.bytes = net_bytessent[NS_SERVER] - sv_perfbytes;
+
+	*s = sv_perfcurrent;
+	sv_perfticks++;
+
+	if (sv_perf_overrun->value > 0 && s->total > sv_perf_overrun->value)
+	{
+		sv_perfoverruns++;
+		Com_Printf ("sv_perf: frame %i took %0.2f ms (game %0.2f, send %0.2f)\n", sv.framenum, s->total, s->phases[SVP_GAME], s->phases[SVP_SEND]);
+	}
+
+	// simulated clients keep their own totals for the run
+	SV_LoadGen_Tick (s);
+
+	// start the next one
+	memset (&sv_perfcurrent, 0, sizeof (sv_perfcurrent));
+	memset (&sv_perfcount, 0, sizeof (sv_perfcount));
+	sv_perfbytes = net_bytessent[NS_SERVER];
+
+	if (sv_perf_log->value > 0 && svs.realtime - sv_perflastlog >= sv_perf_log->value * 1000)
+	{
+		SV_Perf_f ();
+		sv_perflastlog = svs.realtime;
+	}
+}
+
+
+static int SV_PerfSortFloat (const float *a, const float *b)
+{
+	if (*a < *b)
+		return -1;
+	else if (*a > *b)
+		return 1;
+	else return 0;
+}
+
+
+// nearest-rank percentile from a sorted list
+static float SV_PerfPercentile (float *sorted, int count, int pct)
+{
+	int rank = (pct * count + 99) / 100;
+
+	if (rank < 1) rank = 1;
+	if (rank > count) rank = count;
+
+	return sorted[rank - 1];
+}
+
+
+static void SV_PerfPrintRow (char *name, float *values, int count)
+{
+	double total = 0;
+	int i;
+
+	for (i = 0; i < count; i++)
+		total += values[i];
+
+	qsort (values, count, sizeof (float), (sortfunc_t) SV_PerfSortFloat);
+
+	Com_Printf (
+		"%-10s %9.3f %9.3f %9.3f %9.3f %9.3f\n",
+		name,
+		total / count,
+		SV_PerfPercentile (values, count, 50),
+		SV_PerfPercentile (values, count, 95),
+		SV_PerfPercentile (values, count, 99),
+		values[count - 1]
+	);
+}
+
+
+/*
+==================
+SV_Perf_f
+
+percentiles over the last SV_PERF_HISTORY ticks
+==================
+*/
+void SV_Perf_f (void)
+{
+	static float values[SV_PERF_HISTORY];
+	int count = (sv_perfticks < SV_PERF_HISTORY) ? sv_perfticks : SV_PERF_HISTORY;
+	int phase, i;
+
+	if (!count)
+	{
+		Com_Printf ("sv_perf: no server ticks yet\n");
+		return;
+	}
+
+	Com_Printf ("sv_perf: last %i of %i ticks, %i over %0.0f ms\n", count, sv_perfticks, sv_perfoverruns, sv_perf_overrun->value);
+	Com_Printf ("phase (ms)       avg       p50       p95       p99       max\n");
+
+	for (phase = 0; phase < SVP_NUMPHASES; phase++)
+	{
+		for (i = 0; i < count; i++)
+			values[i] = sv_perfhistory[i].phases[phase];
+
+		SV_PerfPrintRow (sv_perfphasenames[phase], values, count);
+	}
+
+	for (i = 0; i < count; i++) values[i] = sv_perfhistory[i].total;
+	SV_PerfPrintRow ("tick", values, count);
+
+	Com_Printf ("per tick\n");
+
+	for (i = 0; i < count; i++) values[i] = sv_perfhistory[i].traces;
+	SV_PerfPrintRow ("traces", values, count);
+
+	for (i = 0; i < count; i++) values[i] = sv_perfhistory[i].links;
+	SV_PerfPrintRow ("links", values, count);
+
+	for (i = 0; i < count; i++) values[i] = sv_perfhistory[i].bytes;
+	SV_PerfPrintRow ("bytes", values, count);
+
+	for (i = 0; i < count; i++) values[i] = sv_perfhistory[i].deltahits + sv_perfhistory[i].deltamisses;
+	SV_PerfPrintRow ("deltas", values, count);
+
+	// the share of entity deltas that were copied rather than encoded
+	for (i = 0; i < count; i++)
+	{
+		int deltas = sv_perfhistory[i].deltahits + sv_perfhistory[i].deltamisses;
+
+		values[i] = deltas ? (sv_perfhistory[i].deltahits * 100.0f) / deltas : 0;
+	}
+
+	SV_PerfPrintRow ("delta hit%", values, count);
+}
+
+
+static void SV_PerfReset_f (void)
+{
+	sv_perfticks = 0;
+	sv_perfoverruns = 0;
+	sv_perflastlog = svs.realtime;
+}
+
+
+/*
+==================
+SV_PerfNewServer
+
+svs.realtime starts again from 0 with each new server, so the periodic log has to as well
+==================
+*/
+void SV_PerfNewServer (void)
+{
+	sv_perflastlog = 0;
+}
+
+
+void SV_InitPerf (void)
+{
+	sv_perf_log = Cvar_Get ("sv_perf_log", "0", 0, NULL);
+	sv_perf_overrun = Cvar_Get ("sv_perf_overrun", "100", 0, NULL);
+
+	Cmd_AddCommand ("sv_perf", SV_Perf_f);
+	Cmd_AddCommand ("sv_perf_reset", SV_PerfReset_f);
+}
+
@@ -0,0 +1,362 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// sv_relay.c -- spectators that watch through a player's eyes without entering the game
+
+#include "server.h"
+
+/*
+==============================================================================
+
+RELAY SPECTATORS
+
+a client that connects with a "relay" userinfo key ("set relay 1 u") gets
+one of the sv_relay_max slots after the players and never enters the game:
+the game dll isn't told about it, it has no edict and its moves are not
+run.  the value is the slot of the player to watch plus one, or 0 for
+whoever comes first, and "cmd relayview [slot]" changes it later.
+
+a spectator is sent the frame that was built for the player it watches, so
+the world is walked once per player however many are watching.  each frame
+is encoded once per server frame for every player and delta base that is
+asked for, and every spectator that acknowledged the same frame gets a copy
+of the same bytes.  the unreliable multicasts are gathered unfiltered, the
+same as for serverrecord, and go to all of them.
+
+sv_relay_max is latched like maxclients and takes effect with the next game.
+
+==============================================================================
+*/
+
+#define	RELAY_MAXFRAMES		64		// encodings kept in a server frame; more still work but aren't shared
+
+typedef struct relayframe_s
+{
+	int			view;				// slot of the player it was built for
+	int			deltaframe;			// -1 for a full update
+	int			length;				// 0 if it overflowed
+	byte		data[MAX_MSGLEN];
+} relayframe_t;
+
+static relayframe_t relay_frames[RELAY_MAXFRAMES];
+static relayframe_t relay_uncached;
+static int relay_numframes = 0;
+static int relay_framenum = -1;		// the server frame relay_frames belong to
+
+// totals for relaybench
+static int relay_encoded = 0;
+static int relay_sent = 0;
+
+cvar_t *sv_relay_max;
+
+
+/*
+==================
+SV_RelayConnect
+
+called from SVC_DirectConnect in place of the game's ClientConnect
+==================
+*/
+qboolean SV_RelayConnect (client_t *cl, char *userinfo)
+{
+	char *password = Cvar_VariableString ("password");
+
+	// the game checks this for players
+	if (*password && strcmp (password, "none") && strcmp (password, Info_ValueForKey (userinfo, "password")))
+	{
+		Info_SetValueForKey (userinfo, "rejmsg", "Password required or incorrect.");
+		return false;
+	}
+
+	cl->relay = true;
+	cl->relayview = atoi (Info_ValueForKey (userinfo, "relay")) - 1;
+	cl->edict = NULL;
+
+	return true;
+}
+
+
+// the next spawned player after slot, or -1 if there are none
+static int SV_RelayNextPlayer (int slot)
+{
+	int i;
+
+	for (i = 1; i <= maxclients->value; i++)
+	{
+		int next = (slot + i) % (int) maxclients->value;
+
+		if (svs.clients[next].state == cs_spawned)
+			return next;
+	}
+
+	return -1;
+}
+
+
+/*
+==================
+SV_RelayPickView
+
+called from SV_New_f; a player who is still connecting is waited for rather than passed over
+==================
+*/
+int SV_RelayPickView (client_t *cl)
+{
+	int i;
+
+	if (cl->relayview >= 0 && cl->relayview < maxclients->value && svs.clients[cl->relayview].state >= cs_connected)
+		return cl->relayview;
+
+	for (i = 0; i < maxclients->value; i++)
+	{
+		if (svs.clients[i].state >= cs_connected)
+			return (cl->relayview = i);
+	}
+
+	// nobody yet; SV_RelayWatched moves on when someone spawns
+	return (cl->relayview = 0);
+}
+
+
+// the client number the spectator was given in the serverdata changes, so it starts over from "new"
+static void SV_RelaySetView (client_t *cl, int view)
+{
+	cl->relayview = view;
+	cl->state = cs_connected;
+	cl->lastframe = -1;
+
+	sv_client = cl;
+	SV_New_f ();
+}
+
+
+static client_t *SV_RelayWatched (client_t *cl)
+{
+	client_t *view = &svs.clients[cl->relayview];
+	int next;
+
+	if (view->state == cs_spawned)
+		return view;
+
+	// connecting, or coming back after a level change
+	if (view->state == cs_connected)
+		return NULL;
+
+	// they've gone, so follow someone else
+	if ((next = SV_RelayNextPlayer (cl->relayview)) >= 0)
+		SV_RelaySetView (cl, next);
+
+	return NULL;
+}
+
+
+static client_frame_t *SV_RelayViewFrame (client_t *view)
+{
+	client_frame_t *frame = &view->frames[sv.framenum & UPDATE_MASK];
+
+	// a player that was rate dropped didn't have one built
+	if (frame->framenum != sv.framenum)
+		SV_BuildClientFrame (view);
+
+	return (frame->framenum == sv.framenum) ? frame : NULL;
+}
+
+
+// the frame to delta from, which must have come from the same player and still be there
+static int SV_RelayDeltaFrame (client_t *cl, client_t *view)
+{
+	int lastframe = cl->lastframe;
+
+	if (lastframe <= 0 || lastframe < cl->relaystart)
+		return -1;
+
+	if (sv.framenum - lastframe >= (UPDATE_BACKUP - 3))
+		return -1;
+
+	if (view->frames[lastframe & UPDATE_MASK].framenum != lastframe)
+		return -1;
+
+	return lastframe;
+}
+
+
+/*
+==================
+SV_RelayFrame
+
+everything in a svc_frame after the header, which is the part that doesn't depend on the spectator
+==================
+*/
+static relayframe_t *SV_RelayFrame (client_t *view, client_frame_t *frame, int deltaframe)
+{
+	static player_state_t nullps;
+	relayframe_t	*rf;
+	client_frame_t	*oldframe;
+	player_state_t	oldps, ps;
+	sizebuf_t		msg;
+	int				viewnum = view - svs.clients;
+	int				i;
+
+	if (relay_framenum != sv.framenum)
+	{
+		relay_numframes = 0;
+		relay_framenum = sv.framenum;
+	}
+
+	for (i = 0, rf = relay_frames; i < relay_numframes; i++, rf++)
+	{
+		if (rf->view == viewnum && rf->deltaframe == deltaframe)
+			return rf;
+	}
+
+	if (relay_numframes < RELAY_MAXFRAMES)
+		rf = &relay_frames[relay_numframes++];
+	else rf = &relay_uncached;
+
+	rf->view = viewnum;
+	rf->deltaframe = deltaframe;
+
+	// leave room for the header
+	SZ_Init (&msg, rf->data, sizeof (rf->data) - 16);
+	msg.allowoverflow = true;
+
+	oldframe = (deltaframe > 0) ? &view->frames[deltaframe & UPDATE_MASK] : NULL;
+
+	// the spectator's moves are never run so it mustn't predict them
+	ps = frame->ps;
+	ps.pmove.pm_flags |= PMF_NO_PREDICTION;
+
+	if (oldframe)
+	{
+		oldps = oldframe->ps;
+		oldps.pmove.pm_flags |= PMF_NO_PREDICTION;
+	}
+	else oldps = nullps;
+
+	MSG_WriteByte (&msg, frame->areabytes);
+	SZ_Write (&msg, frame->areabits, frame->areabytes);
+
+	MSG_WriteByte (&msg, svc_playerinfo);
+	MSG_WriteDeltaPlayerstate (&oldps, &ps, &msg);
+
+	SV_EmitPacketEntities (oldframe, frame, &msg);
+
+	rf->length = msg.overflowed ? 0 : msg.cursize;
+	relay_encoded++;
+
+	return rf;
+}
+
+
+/*
+==================
+SV_SendRelayDatagram
+
+SV_SendClientDatagram for a relay spectator
+==================
+*/
+void SV_SendRelayDatagram (client_t *cl)
+{
+	byte			msg_buf[MAX_MSGLEN];
+	sizebuf_t		msg;
+	client_t		*view;
+	client_frame_t	*frame;
+	relayframe_t	*rf;
+	int				deltaframe;
+
+	SZ_Init (&msg, msg_buf, sizeof (msg_buf));
+
+	if ((view = SV_RelayWatched (cl)) != NULL && (frame = SV_RelayViewFrame (view)) != NULL)
+	{
+		deltaframe = SV_RelayDeltaFrame (cl, view);
+		rf = SV_RelayFrame (view, frame, deltaframe);
+
+		if (rf->length)
+		{
+			MSG_WriteByte (&msg, svc_frame);
+			MSG_WriteLong (&msg, sv.framenum);
+			MSG_WriteLong (&msg, deltaframe);
+			MSG_WriteByte (&msg, cl->surpressCount);
+			cl->surpressCount = 0;
+
+			SZ_Write (&msg, rf->data, rf->length);
+
+			// entity references in the multicasts need the frame, and they're dropped when there's no room
+			if (!svs.relay_multicast.overflowed && msg.cursize + svs.relay_multicast.cursize <= msg.maxsize)
+				SZ_Write (&msg, svs.relay_multicast.data, svs.relay_multicast.cursize);
+		}
+		else Com_Printf ("WARNING: msg overflowed for %s\n", cl->name);
+
+		relay_sent++;
+	}
+
+	// nothing is sent to the datagram of a client without an edict, but be sure
+	SZ_Clear (&cl->datagram);
+
+	Netchan_Transmit (&cl->netchan, msg.cursize, msg.data);
+
+	cl->frames[sv.framenum & UPDATE_MASK].senttime = svs.realtime;
+	cl->message_size[sv.framenum % RATE_MESSAGES] = msg.cursize;
+}
+
+
+/*
+==================
+SV_RelayView_f
+
+relayview [slot], or the next player without one
+==================
+*/
+void SV_RelayView_f (void)
+{
+	int view;
+
+	if (!sv_client->relay || sv_client->state != cs_spawned || sv.state != ss_game)
+		return;
+
+	if (Cmd_Argc () > 1)
+	{
+		view = atoi (Cmd_Argv (1));
+
+		if (view < 0 || view >= maxclients->value || svs.clients[view].state != cs_spawned)
+		{
+			SV_ClientPrintf (sv_client, PRINT_HIGH, "No player in slot %i.\n", view);
+			return;
+		}
+	}
+	else if ((view = SV_RelayNextPlayer (sv_client->relayview)) < 0)
+		return;
+
+	if (view != sv_client->relayview)
+		SV_RelaySetView (sv_client, view);
+}
+
+
+void SV_RelayStats (int *encoded, int *sent)
+{
+	*encoded = relay_encoded;
+	*sent = relay_sent;
+}
+
+
+void SV_InitRelay (void)
+{
+	sv_relay_max = Cvar_Get ("sv_relay_max", "0", CVAR_LATCH, NULL);
+}
+
@@ -110,7 +110,7 @@ void SV_BroadcastPrintf (int level, char *fmt, ...)
 		Com_Printf ("%s", copy);
 	}
 
-	for (i = 0, cl = svs.clients; i < maxclients->value; i++, cl++)
+	for (i = 0, cl = svs.clients; i < svs.numslots; i++, cl++)
 	{
 		if (level < cl->messagelevel)
 			continue;
@@ -239,6 +239,18 @@ void SV_Multicast (vec3_t origin, multicast_t to)
 			SZ_Write (&client->datagram, sv.multicast.data, sv.multicast.cursize);
 	}
 
+	// relay spectators get everything, like serverrecord; the unreliable part is shared by all of them
+	if (reliable)
+	{
+		for (; j < svs.numslots; j++, client++)
+		{
+			if (client->state == cs_connected || client->state == cs_spawned)
+				SZ_Write (&client->netchan.message, sv.multicast.data, sv.multicast.cursize);
+		}
+	}
+	else if (svs.numslots > maxclients->value)
+		SZ_Write (&svs.relay_multicast, sv.multicast.data, sv.multicast.cursize);
+
 	SZ_Clear (&sv.multicast);
 }
 
@@ -438,11 +450,7 @@ SV_DemoCompleted
 */
 void SV_DemoCompleted (void)
 {
-	if (sv.demofile)
-	{
-		fclose (sv.demofile);
-		sv.demofile = NULL;
-	}
+	SV_CloseDemo ();
 	SV_Nextserver ();
 }
 
@@ -460,8 +468,8 @@ qboolean SV_RateDrop (client_t *c)
 	int		total;
 	int		i;
 
-	// never drop over the loopback
-	if (c->netchan.remote_address.type == NA_LOOPBACK)
+	// never drop over the loopback, but simulated clients on loopback ports are treated like remote ones
+	if (c->netchan.remote_address.type == NA_LOOPBACK && !c->netchan.remote_address.loopport)
 		return false;
 
 	total = 0;
@@ -474,6 +482,7 @@ qboolean SV_RateDrop (client_t *c)
 	if (total > c->rate)
 	{
 		c->surpressCount++;
+		c->ratedrops++;
 		c->message_size[sv.framenum % RATE_MESSAGES] = 0;
 		return true;
 	}
@@ -481,6 +490,97 @@ qboolean SV_RateDrop (client_t *c)
 	return false;
 }
 
+/*
+=======================
+SV_SendDownloadChunk
+
+each chunk goes in a packet of its own so that it never has to share with a frame
+=======================
+*/
+static int SV_SendDownloadChunk (client_t *c, int chunk)
+{
+	sizebuf_t	msg;
+	byte		msgbuf[MAX_MSGLEN];
+	int			offset = chunk * DOWNLOAD_CHUNK;
+	int			size = c->downloadsize - offset;
+
+	if (size > DOWNLOAD_CHUNK)
+		size = DOWNLOAD_CHUNK;
+
+	SZ_Init (&msg, msgbuf, sizeof (msgbuf));
+
+	MSG_WriteByte (&msg, svc_downloadchunk);
+	MSG_WriteByte (&msg, c->downloadid);
+	MSG_WriteLong (&msg, c->downloadsize);
+	MSG_WriteLong (&msg, offset);
+	MSG_WriteShort (&msg, size);
+	SZ_Write (&msg, c->download + offset, size);
+
+	// a reliable message that's due goes first on its own, as there mightn't be room for both
+	if (Netchan_NeedReliable (&c->netchan))
+		Netchan_Transmit (&c->netchan, 0, NULL);
+
+	Netchan_Transmit (&c->netchan, msg.cursize, msg.data);
+
+	c->downloadsent[chunk & (DOWNLOAD_WINDOW - 1)] = svs.realtime;
+	c->message_size[sv.framenum % RATE_MESSAGES] += msg.cursize;
+
+	return msg.cursize;
+}
+
+
+/*
+=======================
+SV_SendDownloadChunks
+
+resends anything that hasn't been acknowledged in time, then opens the window as far as the rate allows
+=======================
+*/
+static void SV_SendDownloadChunks (client_t *c)
+{
+	int		total = 0;
+	int		rto, chunk, i;
+
+	if (!c->download || !c->downloadwindow)
+		return;
+
+	// nothing else counts against the rate for a client that's still connecting
+	if (c->state != cs_spawned)
+		c->message_size[sv.framenum % RATE_MESSAGES] = 0;
+
+	for (i = 0; i < RATE_MESSAGES; i++)
+		total += c->message_size[i];
+
+	// acks can only come back on a server frame, so allow one on top of the round trip
+	rto = c->downloadrtt * 2 + 100;
+
+	// a chunk always fits when nothing has been sent lately so that a tiny rate still makes progress
+	for (chunk = c->downloadbase; chunk < c->downloadnext; chunk++)
+	{
+		int sent = c->downloadsent[chunk & (DOWNLOAD_WINDOW - 1)];
+
+		if (sent == -1 || svs.realtime - sent < rto)
+			continue;
+
+		if (total && total + DOWNLOAD_CHUNK > c->rate)
+			return;
+
+		total += SV_SendDownloadChunk (c, chunk);
+		c->downloadresent++;
+	}
+
+	while (c->downloadnext < c->downloadchunks && c->downloadnext < c->downloadbase + c->downloadwindow)
+	{
+		if (total && total + DOWNLOAD_CHUNK > c->rate)
+			return;
+
+		total += SV_SendDownloadChunk (c, c->downloadnext++);
+	}
+}
+
+
+#define	DEMO_SEEK_BURST		4		// most demo messages sent in a frame after a seek; the loopback holds 16
+
 /*
 =======================
 SV_SendClientMessages
@@ -492,7 +592,7 @@ void SV_SendClientMessages (void)
 	client_t	*c;
 	int			msglen;
 	byte		msgbuf[MAX_MSGLEN];
-	int			r;
+	int			burst;
 
 	msglen = 0;
 
@@ -503,32 +603,29 @@ void SV_SendClientMessages (void)
 			msglen = 0;
 		else
 		{
-			// get the next message
-			r = fread (&msglen, 4, 1, sv.demofile);
-			if (r != 1)
+			for (burst = 1; ; burst++)
 			{
-				SV_DemoCompleted ();
-				return;
-			}
-			msglen = LittleLong (msglen);
-			if (msglen == -1)
-			{
-				SV_DemoCompleted ();
-				return;
-			}
-			if (msglen > MAX_MSGLEN)
-				Com_Error (ERR_DROP, "SV_SendClientMessages: msglen > MAX_MSGLEN");
-			r = fread (msgbuf, msglen, 1, sv.demofile);
-			if (r != 1)
-			{
-				SV_DemoCompleted ();
-				return;
+				if ((msglen = SV_ReadDemoMessage (msgbuf)) < 0)
+				{
+					SV_DemoCompleted ();
+					return;
+				}
+
+				if (!SV_DemoSeeking () || burst == DEMO_SEEK_BURST)
+					break;
+
+				// catching up after a seek, so the clients get several this frame
+				for (i = 0, c = svs.clients; i < svs.numslots; i++, c++)
+				{
+					if (c->state)
+						Netchan_Transmit (&c->netchan, msglen, msgbuf);
+				}
 			}
 		}
 	}
 
-	// send a message to each connected client
-	for (i = 0, c = svs.clients; i < maxclients->value; i++, c++)
+	// send a message to each connected client; relay spectators come last so the frames they share are built
+	for (i = 0, c = svs.clients; i < svs.numslots; i++, c++)
 	{
 		if (!c->state)
 			continue;
@@ -550,14 +647,22 @@ void SV_SendClientMessages (void)
 			if (SV_RateDrop (c))
 				continue;
 
-			SV_SendClientDatagram (c);
+			if (c->relay)
+				SV_SendRelayDatagram (c);
+			else SV_SendClientDatagram (c);
+
+			SV_SendDownloadChunks (c);
 		}
 		else
 		{
 			// just update reliable	if needed
 			if (c->netchan.message.cursize || sys_currmsec - c->netchan.last_sent > 1000)
 				Netchan_Transmit (&c->netchan, 0, NULL);
+
+			SV_SendDownloadChunks (c);
 		}
 	}
+
+	SZ_Clear (&svs.relay_multicast);
 }
 
@@ -32,21 +32,6 @@ sv_client and sv_player will be valid.
 ============================================================
 */
 
-/*
-==================
-SV_BeginDemoServer
-==================
-*/
-void SV_BeginDemoserver (void)
-{
-	char		name[MAX_OSPATH];
-
-	Com_sprintf (name, sizeof (name), "demos/%s", sv.name);
-	FS_FOpenFile (name, &sv.demofile);
-	if (!sv.demofile)
-		Com_Error (ERR_DROP, "Couldn't open %s\n", name);
-}
-
 /*
 ================
 SV_New_f
@@ -72,7 +57,7 @@ void SV_New_f (void)
 	// demo servers just dump the file message
 	if (sv.state == ss_demo)
 	{
-		SV_BeginDemoserver ();
+		SV_OpenDemo ();
 		return;
 	}
 
@@ -89,6 +74,8 @@ void SV_New_f (void)
 
 	if (sv.state == ss_cinematic || sv.state == ss_pic)
 		playernum = -1;
+	else if (sv_client->relay)
+		playernum = SV_RelayPickView (sv_client);
 	else
 		playernum = sv_client - svs.clients;
 	MSG_WriteShort (&sv_client->netchan.message, playernum);
@@ -97,7 +84,13 @@ void SV_New_f (void)
 	MSG_WriteString (&sv_client->netchan.message, sv.configstrings[CS_NAME]);
 
 	// game server
-	if (sv.state == ss_game)
+	if (sv.state == ss_game && sv_client->relay)
+	{
+		// relay spectators see the player's entity but aren't given it
+		MSG_WriteByte (&sv_client->netchan.message, svc_stufftext);
+		MSG_WriteString (&sv_client->netchan.message, va ("cmd configstrings %i 0\n", svs.spawncount));
+	}
+	else if (sv.state == ss_game)
 	{
 		// set up the entity for the client
 		ent = EDICT_NUM (playernum + 1);
@@ -244,6 +237,13 @@ void SV_Begin_f (void)
 
 	sv_client->state = cs_spawned;
 
+	// nothing from an earlier view can be delta'd from
+	if (sv_client->relay)
+	{
+		sv_client->relaystart = sv.framenum + 1;
+		return;
+	}
+
 	// call the game begin function
 	ge->ClientBegin (sv_player);
 
@@ -263,7 +263,8 @@ void SV_NextDownload_f (void)
 	int		percent;
 	int		size;
 
-	if (!sv_client->download)
+	// windowed downloads are acknowledged with clc_downloadack instead
+	if (!sv_client->download || sv_client->downloadwindow)
 		return;
 
 	r = sv_client->downloadsize - sv_client->downloadcount;
@@ -304,12 +305,21 @@ void SV_BeginDownload_f (void)
 	extern	cvar_t *allow_download_maps;
 	extern	int		file_from_pak; // ZOID did file come from pak?
 	int offset = 0;
+	int window = 0;
 
 	name = Cmd_Argv (1);
 
 	if (Cmd_Argc () > 2)
 		offset = atoi (Cmd_Argv (2)); // downloaded offset
 
+	if (Cmd_Argc () > 3)
+		window = atoi (Cmd_Argv (3)); // chunks in flight for a windowed download
+
+	if (window > DOWNLOAD_WINDOW)
+		window = DOWNLOAD_WINDOW;
+
+	sv_client->downloadwindow = 0;
+
 	// hacked by zoid to allow more conrol over download
 	// first off, no .. or global allow check
 	if (strstr (name, "..") || !allow_download->value ||
@@ -360,11 +370,91 @@ void SV_BeginDownload_f (void)
 		return;
 	}
 
+	// a file that's already all there goes the old way, which sends the 100% message straight away
+	if (window > 0 && sv_client->downloadcount < sv_client->downloadsize)
+	{
+		// ids tell the client which download a chunk or ack belongs to, and 0 is never used
+		sv_client->downloadid = (sv_client->downloadid % 255) + 1;
+		sv_client->downloadwindow = window;
+		sv_client->downloadchunks = (sv_client->downloadsize + DOWNLOAD_CHUNK - 1) / DOWNLOAD_CHUNK;
+
+		// start on the chunk holding the offset; the client writes it again
+		sv_client->downloadbase = sv_client->downloadnext = sv_client->downloadcount / DOWNLOAD_CHUNK;
+		sv_client->downloadresent = 0;
+
+		memset (sv_client->downloadsent, 0, sizeof (sv_client->downloadsent));
+
+		if (!sv_client->downloadrtt)
+			sv_client->downloadrtt = (sv_client->ping > 0) ? sv_client->ping : 200;
+
+		Com_DPrintf ("Downloading %s to %s, %i chunks in flight\n", name, sv_client->name, window);
+		return;
+	}
+
 	SV_NextDownload_f ();
 	Com_DPrintf ("Downloading %s to %s\n", name, sv_client->name);
 }
 
 
+static void SV_DownloadAcked (client_t *cl, int chunk)
+{
+	int *sent = &cl->downloadsent[chunk & (DOWNLOAD_WINDOW - 1)];
+
+	if (*sent == -1)
+		return;
+
+	// a chunk that was sent twice may be acknowledged for the first send, which only makes the estimate low
+	cl->downloadrtt = (cl->downloadrtt * 7 + (svs.realtime - *sent)) / 8;
+	*sent = -1;
+}
+
+
+/*
+==================
+SV_DownloadAck
+
+the client sends the first chunk it's missing and a bit for each of the chunks after that
+==================
+*/
+static void SV_DownloadAck (client_t *cl)
+{
+	int id = MSG_ReadByte (&net_message);
+	int base = MSG_ReadLong (&net_message);
+	unsigned mask = MSG_ReadLong (&net_message);
+	int chunk;
+
+	// acks for an earlier file are still in flight after a new download starts
+	if (!cl->download || !cl->downloadwindow || id != cl->downloadid)
+		return;
+
+	// it can't have anything we haven't sent
+	if (base > cl->downloadnext)
+		base = cl->downloadnext;
+
+	for (chunk = cl->downloadbase; chunk < base; chunk++)
+		SV_DownloadAcked (cl, chunk);
+
+	if (base > cl->downloadbase)
+		cl->downloadbase = base;
+
+	for (chunk = base + 1; mask; chunk++, mask >>= 1)
+	{
+		// an old ack can name chunks below the window whose slots have been reused
+		if ((mask & 1) && chunk >= cl->downloadbase && chunk < cl->downloadnext)
+			SV_DownloadAcked (cl, chunk);
+	}
+
+	if (cl->downloadbase < cl->downloadchunks)
+		return;
+
+	Com_DPrintf ("%s finished downloading, %i of %i chunks resent\n", cl->name, cl->downloadresent, cl->downloadchunks);
+
+	FS_FreeFile (cl->download);
+	cl->download = NULL;
+	cl->downloadwindow = 0;
+}
+
+
 
 //============================================================================
 
@@ -461,6 +551,8 @@ ucmd_t ucmds[] =
 	{"download", SV_BeginDownload_f},
 	{"nextdl", SV_NextDownload_f},
 
+	{"relayview", SV_RelayView_f},
+
 	{NULL, NULL}
 };
 
@@ -485,7 +577,7 @@ void SV_ExecuteUserCommand (char *s)
 			break;
 		}
 
-	if (!u->name && sv.state == ss_game)
+	if (!u->name && sv.state == ss_game && !sv_client->relay)
 		ge->ClientCommand (sv_player);
 
 	//	SV_EndRedirect ();
@@ -617,7 +709,8 @@ void SV_ExecuteClientMessage (client_t *cl)
 				return;
 			}
 
-			if (!sv_paused->value)
+			// relay spectators only acknowledge frames
+			if (!sv_paused->value && !cl->relay)
 			{
 				net_drop = cl->netchan.dropped;
 				if (net_drop < 20)
@@ -645,6 +738,10 @@ void SV_ExecuteClientMessage (client_t *cl)
 			cl->lastcmd = newcmd;
 			break;
 
+		case clc_downloadack:
+			SV_DownloadAck (cl);
+			break;
+
 		case clc_stringcmd:
 			s = MSG_ReadString (&net_message);
 
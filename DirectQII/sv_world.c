@@ -169,6 +169,8 @@ void SV_LinkEdict (edict_t *ent)
 	int			area;
 	int			topnode;
 
+	sv_perfcount.links++;
+
 	if (ent->area.prev)
 		SV_UnlinkEdict (ent);	// unlink from old position
 
@@ -616,6 +618,8 @@ trace_t SV_Trace (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, edict_t *p
 {
 	moveclip_t	clip;
 
+	sv_perfcount.traces++;
+
 	if (!mins)
 		mins = vec3_origin;
 	if (!maxs)
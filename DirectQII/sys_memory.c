@@ -34,163 +34,265 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 /*
 ==============================================================================
 
-ZONE MEMORY ALLOCATION
-
-using heap allocations to prevent a crash from a bad Z_Free when calling gi.FreeTags
-via ge->SpawnEntities during loading of eou7.cin (Z_FreeTags now just throws away
-the full heap rather than using individual Z_Free calls which makes it safe)
+for use in the engine - these just wrap standard HeapAlloc/HeapFree for the
+convenience of modules that don't include windows.h 
 
 ==============================================================================
 */
+void *Zone_Alloc (int size)
+{
+	return HeapAlloc (GetProcessHeap (), HEAP_ZERO_MEMORY, size);
+}
 
-// it's possible for games to exceed this (neither baseq2 nor ctf do) which would cause an error meaning we need to increase it
-#define MAX_ZONETAGS	1024
 
-typedef struct zone_s
+void Zone_Free (void *ptr)
 {
-	HANDLE hZone;
-	int tag;
-	int count;
-	int bytes;
-} zone_t;
+	HeapFree (GetProcessHeap (), 0, ptr);
+}
 
-zone_t z_zones[MAX_ZONETAGS];
 
 /*
-========================
-Z_Free
-========================
+==============================================================================
+
+LOAD MEMORY ALLOCATION
+
+Temporary memory used for loading is drawn down from an arena belonging to the calling thread, so that loaders on
+different threads never share a buffer.  Each arena reserves address space up front and commits it as it grows.
+
+Load_GetMark/Load_FreeToMark give scoped release so that a loader can free just what it used without throwing
+away memory an outer caller is still using; Load_FreeMemory releases everything in the thread's arena.  An
+ERR_DROP abandons any scopes that were open on the main thread, so Qcommon_Frame releases its arena when one lands.
+
+Allocations are always zeroed.  Memory that has never been handed out is known to be zero already, so only the
+part below the arena's high-water mark needs clearing; with load_poison set, released memory is filled with a
+pattern instead so that anything still pointing into it reads garbage rather than stale data.
+
+==============================================================================
 */
-void Z_Free (void *ptr)
+
+#define LOAD_BUFFER_SIZE		0x4000000	// main thread
+#define LOAD_THREAD_BUFFER_SIZE	0x1000000	// other threads
+#define LOAD_COMMIT_SIZE		0x100000
+#define LOAD_POISON				0xdd
+
+typedef struct loadarena_s
 {
-	// this exists but is not actually used directly by game code, so we can simplify greatly by just making it a nop
-}
+	byte *base;
+	int reserved;
+	int committed;
+	int mark;
+	int highwater;
 
+	// stats
+	int numallocs;
+	int numresets;
+	DWORD threadid;
 
-/*
-========================
-Z_FreeTags
-========================
-*/
-void Z_FreeTags (int tag)
+	struct loadarena_s *next;
+} loadarena_t;
+
+static __declspec (thread) loadarena_t *load_arena = NULL;
+
+static loadarena_t *load_arenas = NULL;
+static CRITICAL_SECTION load_arenalock;
+static DWORD load_mainthreadid = 0;
+
+cvar_t *load_poison = NULL;
+
+
+static loadarena_t *Load_GetArena (void)
 {
-	// this should never happen; if it does then we need to know
-	if (tag < 0 || tag >= MAX_ZONETAGS)
+	if (!load_arena)
 	{
-		Com_Error (ERR_FATAL, "Z_FreeTags: bad tag");
-		return;
+		loadarena_t *arena = (loadarena_t *) HeapAlloc (GetProcessHeap (), HEAP_ZERO_MEMORY, sizeof (loadarena_t));
+
+		arena->threadid = GetCurrentThreadId ();
+		arena->reserved = (arena->threadid == load_mainthreadid) ? LOAD_BUFFER_SIZE : LOAD_THREAD_BUFFER_SIZE;
+
+		if ((arena->base = (byte *) VirtualAlloc (NULL, arena->reserved, MEM_RESERVE, PAGE_NOACCESS)) == NULL)
+			Sys_Error ("Load_GetArena: failed to reserve %i bytes", arena->reserved);
+
+		// link it in for stats
+		EnterCriticalSection (&load_arenalock);
+		arena->next = load_arenas;
+		load_arenas = arena;
+		LeaveCriticalSection (&load_arenalock);
+
+		load_arena = arena;
 	}
 
-	// Com_Printf ("Z_FreeTags : Freeing %i kb in %i allocations from tag %i\n", (z_zones[tag].bytes + 512) / 1024, z_zones[tag].count, tag);
+	return load_arena;
+}
+
 
-	// destroy and fully clear the zone
-	HeapDestroy (z_zones[tag].hZone);
-	memset (&z_zones[tag], 0, sizeof (z_zones[tag]));
+int Load_GetMark (void)
+{
+	return Load_GetArena ()->mark;
 }
 
 
-/*
-========================
-Z_TagAlloc
-========================
-*/
-void *Z_TagAlloc (int size, int tag)
+void Load_FreeToMark (int mark)
 {
-	if (tag < 0 || tag >= MAX_ZONETAGS)
-	{
-		Com_Error (ERR_FATAL, "Z_TagAlloc: bad tag");
-		return NULL;
-	}
-	else
-	{
-		// get the correct zone
-		zone_t *z = &z_zones[tag];
+	loadarena_t *arena = Load_GetArena ();
+
+	if (mark < 0)
+		Sys_Error ("Load_FreeToMark: bad mark");
 
-		// create the heap if necessary
-		if (!z->hZone) z->hZone = HeapCreate (0, 0, 0);
-		if (!z->hZone) Com_Error (ERR_FATAL, "Z_TagAlloc: failed on HeapCreate");
+	// a Load_FreeMemory inside the scope has already released it
+	if (mark > arena->mark)
+		return;
 
-		// counts
-		z->bytes += size;
-		z->count++;
+	// future attempts to access the contents of the buffer should be errors
+	if (load_poison && load_poison->value && arena->mark > mark)
+		memset (arena->base + mark, LOAD_POISON, arena->mark - mark);
 
-		// return what we got
-		return HeapAlloc (z->hZone, HEAP_ZERO_MEMORY, size);
-	}
+	if (mark == 0 && arena->mark > 0)
+		arena->numresets++;
+
+	arena->mark = mark;
 }
 
 
-void Z_Init (void)
+void Load_FreeMemory (void)
 {
-	memset (z_zones, 0, sizeof (z_zones));
+	Load_FreeToMark (0);
 }
 
 
 /*
-==============================================================================
+================
+Load_HasRoom
 
-for use in the engine - these just wrap standard HeapAlloc/HeapFree for the
-convenience of modules that don't include windows.h 
-
-==============================================================================
+True if an allocation of size would fit in what's left of the calling thread's arena; Load_AllocMemory treats
+running out as fatal so callers that can go elsewhere for big allocations check first
+================
 */
-void *Zone_Alloc (int size)
+qboolean Load_HasRoom (int size)
 {
-	return HeapAlloc (GetProcessHeap (), HEAP_ZERO_MEMORY, size);
+	loadarena_t *arena = Load_GetArena ();
+
+	if (size < 0 || size > arena->reserved)
+		return false;
+
+	return arena->mark + ((size + 15) & ~15) < arena->reserved;
 }
 
 
-void Zone_Free (void *ptr)
+void *Load_AllocMemory (int size)
 {
-	HeapFree (GetProcessHeap (), 0, ptr);
-	HeapCompact (GetProcessHeap (), 0);
-}
+	loadarena_t *arena = Load_GetArena ();
+	byte *buf;
 
+	// 16-align all allocations
+	size = (size + 15) & ~15;
 
-/*
-==============================================================================
+	if (size < 0 || arena->mark + size >= arena->reserved)
+	{
+		Sys_Error ("Load_AllocMemory overflow");
+		return NULL;
+	}
 
-LOAD MEMORY ALLOCATION
+	// commit more of the reservation if needed
+	if (arena->mark + size > arena->committed)
+	{
+		int commit = ((arena->mark + size - arena->committed) + LOAD_COMMIT_SIZE - 1) & ~(LOAD_COMMIT_SIZE - 1);
 
-Temporary memory used for loading is a 64mb buffer; call Load_AllocMemory to draw down memory from the buffer, Load_FreeMemory when completed to reset the buffer
+		if (arena->committed + commit > arena->reserved)
+			commit = arena->reserved - arena->committed;
 
-==============================================================================
-*/
+		if (!VirtualAlloc (arena->base + arena->committed, commit, MEM_COMMIT, PAGE_READWRITE))
+			Sys_Error ("Load_AllocMemory: failed to commit %i bytes", commit);
 
-#define LOAD_BUFFER_SIZE 0x4000000
+		arena->committed += commit;
+	}
 
-byte load_buffer[LOAD_BUFFER_SIZE];
-int load_buffer_mark = 0;
+	buf = arena->base + arena->mark;
 
+	// anything above the high-water mark has never been used so is still zero
+	if (arena->mark < arena->highwater)
+		memset (buf, 0, ((arena->mark + size < arena->highwater) ? size : arena->highwater - arena->mark));
 
-void Load_FreeMemory (void)
+	arena->mark += size;
+	arena->numallocs++;
+
+	if (arena->mark > arena->highwater)
+		arena->highwater = arena->mark;
+
+	return buf;
+}
+
+
+/*
+================
+Load_ShutdownThread
+
+Releases the calling thread's arena; threads other than the main thread must call this before they exit
+================
+*/
+void Load_ShutdownThread (void)
 {
-	if (load_buffer_mark > 0)
+	loadarena_t **link;
+
+	if (!load_arena) return;
+
+	EnterCriticalSection (&load_arenalock);
+
+	for (link = &load_arenas; *link; link = &(*link)->next)
 	{
-		// future attempts to access the contents of the buffer should be errors
-		memset (load_buffer, 0, load_buffer_mark);
-		load_buffer_mark = 0;
+		if (*link != load_arena) continue;
+
+		*link = load_arena->next;
+		break;
 	}
+
+	LeaveCriticalSection (&load_arenalock);
+
+	VirtualFree (load_arena->base, 0, MEM_RELEASE);
+	HeapFree (GetProcessHeap (), 0, load_arena);
+
+	load_arena = NULL;
 }
 
 
-void *Load_AllocMemory (int size)
+void Load_MemInfo_f (void)
 {
-	// 16-align all allocations
-	size = (size + 15) & ~15;
+	loadarena_t *arena;
 
-	if (load_buffer_mark + size >= LOAD_BUFFER_SIZE)
-	{
-		Sys_Error ("Load_AllocMemory overflow");
-		return NULL;
-	}
-	else
+	Com_Printf ("  thread    used   high   committed  allocs  resets\n");
+
+	EnterCriticalSection (&load_arenalock);
+
+	for (arena = load_arenas; arena; arena = arena->next)
 	{
-		byte *buf = &load_buffer[load_buffer_mark];
-		load_buffer_mark += size;
-		memset (buf, 0, size);
-		return buf;
+		Com_Printf ("%8i %6ik %6ik %9ik %7i %7i%s\n",
+			(int) arena->threadid,
+			(arena->mark + 1023) / 1024,
+			(arena->highwater + 1023) / 1024,
+			(arena->committed + 1023) / 1024,
+			arena->numallocs,
+			arena->numresets,
+			(arena->threadid == load_mainthreadid) ? " (main)" : "");
 	}
+
+	LeaveCriticalSection (&load_arenalock);
+}
+
+
+/*
+================
+Load_Init
+
+Must be called from the main thread before anything is loaded
+================
+*/
+void Load_Init (void)
+{
+	// the load arena for this thread gets the full-sized reservation
+	InitializeCriticalSection (&load_arenalock);
+	load_mainthreadid = GetCurrentThreadId ();
+
+	load_poison = Cvar_Get ("load_poison", "0", 0, NULL);
+	Cmd_AddCommand ("loadmeminfo", Load_MemInfo_f);
 }
 
 
@@ -199,6 +301,9 @@ void Sys_SetupMemoryRefImports (refimport_t	*ri)
 	// so that we don't have namespace pollution with externing the Hunk_* funcs we register the OS-specific memory allocation functions separately here
 	ri->Load_FreeMemory = Load_FreeMemory;
 	ri->Load_AllocMemory = Load_AllocMemory;
+	ri->Load_GetMark = Load_GetMark;
+	ri->Load_FreeToMark = Load_FreeToMark;
+	ri->Load_ShutdownThread = Load_ShutdownThread;
 }
 
 
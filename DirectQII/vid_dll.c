@@ -38,6 +38,7 @@ cvar_t		*vid_fullscreen;
 
 cvar_t		*vid_width;
 cvar_t		*vid_height;
+cvar_t		*vid_null;
 
 // Global variables used internally by this module
 viddef_t	viddef;				// global video state; used by other modules
@@ -296,6 +297,7 @@ VID_LoadRefresh
 ==============
 */
 void Sys_SetupMemoryRefImports (refimport_t	*ri);
+refexport_t GetNullRefAPI (refimport_t rimp);
 
 qboolean VID_LoadRefresh (void)
 {
@@ -320,6 +322,8 @@ qboolean VID_LoadRefresh (void)
 	ri.SendKeyEvents = Sys_SendKeyEvents;
 	ri.FS_LoadFile = FS_LoadFile;
 	ri.FS_FreeFile = FS_FreeFile;
+	ri.FS_ListPackFiles = FS_ListPackFiles;
+	ri.FS_FreeFileList = FS_FreeFileList;
 	ri.FS_Gamedir = FS_Gamedir;
 	ri.Cvar_Get = Cvar_Get;
 	ri.Cvar_Set = Cvar_Set;
@@ -330,7 +334,10 @@ qboolean VID_LoadRefresh (void)
 
 	Sys_SetupMemoryRefImports (&ri);
 
-	re = GetRefAPI (ri);
+	// the null refresh creates no window or device so that timedemos can be run headless
+	if (vid_null->value)
+		re = GetNullRefAPI (ri);
+	else re = GetRefAPI (ri);
 
 	if (re.api_version != API_VERSION)
 	{
@@ -381,8 +388,8 @@ void VID_ResetMode (void)
 		return;
 	}
 
-	// update our window position
-	if (vid_xpos->modified || vid_ypos->modified)
+	// update our window position; there's no window with the null refresh
+	if (cl_hwnd && (vid_xpos->modified || vid_ypos->modified))
 	{
 		if (!vid_fullscreen->value)
 			VID_UpdateWindowPosAndSize (vid_xpos->value, vid_ypos->value);
@@ -391,7 +398,7 @@ void VID_ResetMode (void)
 		vid_ypos->modified = false;
 	}
 
-	if (!vid_fullscreen->value)
+	if (cl_hwnd && !vid_fullscreen->value)
 	{
 		// center the window, which seems reasonable to do after switching modes
 		VID_CenterWindow_f ();
@@ -421,6 +428,9 @@ void VID_Init (void)
 	vid_width = Cvar_Get ("vid_width", "640", CVAR_ARCHIVE | CVAR_VIDEO, NULL);
 	vid_height = Cvar_Get ("vid_height", "480", CVAR_ARCHIVE | CVAR_VIDEO, NULL);
 
+	// set from the command-line only
+	vid_null = Cvar_Get ("vid_null", "0", CVAR_NOSET, NULL);
+
 	// Add some console commands that we want to handle
 	Cmd_AddCommand ("vid_restart", VID_ResetMode);
 	Cmd_AddCommand ("vid_front", VID_Front_f);
@@ -0,0 +1,442 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// zone.c -- tagged game memory
+
+#include "qcommon.h"
+
+/*
+==============================================================================
+
+ZONE MEMORY ALLOCATION
+
+tagged allocations for the game dll are carved out of fixed-size chunks that
+belong to the tag.  each allocation is rounded up to a power-of-two size class
+and freed blocks go on a per-tag, per-class free list so that gi.TagFree is
+cheap and the memory is reused by the next allocation of the same class.
+anything too big for a class gets its own block on the tag's large list.
+
+Z_FreeTags never walks individual allocations - it just throws away the tag's
+chunks and large blocks.  every live chunk and large block is kept in a table
+sorted by address, and Z_Free only looks at a block header once it has found
+the pointer inside one of them, so a bad Z_Free from the game (see eou7.cin
+calling gi.FreeTags via ge->SpawnEntities) is ignored without touching memory
+that was never ours or has already been released.  only the C runtime is used
+so this is shared with a dedicated server on other platforms.
+
+==============================================================================
+*/
+
+// it's possible for games to exceed this (neither baseq2 nor ctf do) which would cause an error meaning we need to increase it
+#define MAX_ZONETAGS	1024
+
+// size classes are powers of two from 1 << Z_MINCLASSBITS to 1 << Z_MAXCLASSBITS including the block header
+#define Z_MINCLASSBITS	5
+#define Z_MAXCLASSBITS	13
+#define Z_NUMCLASSES	(Z_MAXCLASSBITS - Z_MINCLASSBITS + 1)
+#define Z_LARGECLASS	Z_NUMCLASSES
+
+// usable bytes in each chunk after its header; 64k in total per chunk
+#define Z_CHUNKSIZE		(65536 - (int) sizeof (zchunk_t))
+
+#define Z_MAGIC_USED	0x5a4f4e45
+#define Z_MAGIC_FREE	0x66726565
+
+// 16 bytes so that the memory handed back to the game keeps the alignment malloc gave us
+typedef struct zblock_s
+{
+	int magic;
+	short tag;
+	short sizeclass;
+	int size;
+	int pad;
+} zblock_t;
+
+// while a block is on a free list the link lives in the memory that was handed to the game
+#define Z_NEXTFREE(b)	(*(zblock_t **) ((b) + 1))
+
+typedef struct zlarge_s
+{
+	struct zlarge_s *prev;
+	struct zlarge_s *next;
+#if !defined (_WIN64) && !defined (__LP64__)
+	int pad[2];
+#endif
+	zblock_t block;
+} zlarge_t;
+
+typedef struct zchunk_s
+{
+	struct zchunk_s *next;
+	int used;
+#if !defined (_WIN64) && !defined (__LP64__)
+	int pad[2];
+#else
+	int pad;
+#endif
+} zchunk_t;
+
+typedef struct zone_s
+{
+	zchunk_t *chunks;
+	zlarge_t *large;
+	zblock_t *freeblocks[Z_NUMCLASSES];
+
+	// stats
+	int count;
+	int bytes;
+	int peakbytes;
+	int numchunks;
+	int numlarge;
+	int totalallocs;
+	int totalfrees;
+} zone_t;
+
+static zone_t z_zones[MAX_ZONETAGS];
+
+// the memory owned by each live chunk and large block, sorted by start
+typedef struct zrange_s
+{
+	byte *start;
+	byte *end;
+	int tag;
+} zrange_t;
+
+static zrange_t *z_ranges = NULL;
+static int z_numranges = 0;
+static int z_maxranges = 0;
+
+
+// the index of the first range that starts after p
+static int Z_RangeAfter (byte *p)
+{
+	int lo = 0;
+	int hi = z_numranges;
+
+	while (lo < hi)
+	{
+		int mid = (lo + hi) >> 1;
+
+		if (z_ranges[mid].start <= p)
+			lo = mid + 1;
+		else hi = mid;
+	}
+
+	return lo;
+}
+
+
+static void Z_AddRange (void *start, int size, int tag)
+{
+	int i = Z_RangeAfter ((byte *) start);
+
+	if (z_numranges == z_maxranges)
+	{
+		zrange_t *ranges = (zrange_t *) realloc (z_ranges, (z_maxranges + 256) * sizeof (zrange_t));
+
+		if (!ranges) Com_Error (ERR_FATAL, "Z_TagAlloc: failed to grow the range table");
+
+		z_ranges = ranges;
+		z_maxranges += 256;
+	}
+
+	memmove (&z_ranges[i + 1], &z_ranges[i], (z_numranges - i) * sizeof (zrange_t));
+
+	z_ranges[i].start = (byte *) start;
+	z_ranges[i].end = (byte *) start + size;
+	z_ranges[i].tag = tag;
+
+	z_numranges++;
+}
+
+
+static void Z_RemoveRange (int i)
+{
+	memmove (&z_ranges[i], &z_ranges[i + 1], (z_numranges - i - 1) * sizeof (zrange_t));
+	z_numranges--;
+}
+
+
+static int Z_SizeClass (int blocksize)
+{
+	int sizeclass;
+
+	for (sizeclass = 0; sizeclass < Z_NUMCLASSES; sizeclass++)
+		if (blocksize <= (1 << (sizeclass + Z_MINCLASSBITS)))
+			return sizeclass;
+
+	return Z_LARGECLASS;
+}
+
+
+static zblock_t *Z_AllocLarge (zone_t *z, int size, int tag)
+{
+	zlarge_t *lb = (zlarge_t *) malloc (sizeof (zlarge_t) + size);
+
+	if (!lb) Com_Error (ERR_FATAL, "Z_TagAlloc: failed to allocate %i bytes", size);
+
+	Z_AddRange (lb, sizeof (zlarge_t) + size, tag);
+
+	// link it in at the head of the large list
+	lb->prev = NULL;
+	if ((lb->next = z->large) != NULL) lb->next->prev = lb;
+	z->large = lb;
+	z->numlarge++;
+
+	return &lb->block;
+}
+
+
+static zblock_t *Z_AllocSmall (zone_t *z, int sizeclass, int tag)
+{
+	zblock_t *b;
+	int blocksize = 1 << (sizeclass + Z_MINCLASSBITS);
+
+	// reuse a freed block of the same class if one is available
+	if ((b = z->freeblocks[sizeclass]) != NULL)
+	{
+		z->freeblocks[sizeclass] = Z_NEXTFREE (b);
+		return b;
+	}
+
+	// start a new chunk if the current one can't hold it; any tail is wasted but is at most one class
+	if (!z->chunks || z->chunks->used + blocksize > Z_CHUNKSIZE)
+	{
+		zchunk_t *c = (zchunk_t *) malloc (sizeof (zchunk_t) + Z_CHUNKSIZE);
+
+		if (!c) Com_Error (ERR_FATAL, "Z_TagAlloc: failed to allocate a new chunk");
+
+		Z_AddRange (c, sizeof (zchunk_t) + Z_CHUNKSIZE, tag);
+
+		c->next = z->chunks;
+		c->used = 0;
+		z->chunks = c;
+		z->numchunks++;
+	}
+
+	// bump-allocate from the current chunk
+	b = (zblock_t *) ((byte *) (z->chunks + 1) + z->chunks->used);
+	z->chunks->used += blocksize;
+
+	return b;
+}
+
+
+/*
+========================
+Z_Free
+========================
+*/
+void Z_Free (void *ptr)
+{
+	zblock_t *b;
+	zone_t *z;
+	int range;
+
+	if (!ptr) return;
+
+	b = ((zblock_t *) ptr) - 1;
+	range = Z_RangeAfter ((byte *) ptr) - 1;
+
+	// pointers that aren't in a live chunk or large block are ignored without being looked at
+	if (range < 0 || (byte *) b < z_ranges[range].start || (byte *) ptr >= z_ranges[range].end)
+	{
+		Com_DPrintf ("Z_Free: bad pointer\n");
+		return;
+	}
+
+	// and inside one, double frees are ignored rather than corrupting the free lists
+	if (b->magic != Z_MAGIC_USED || b->tag != z_ranges[range].tag)
+	{
+		Com_DPrintf ("Z_Free: bad pointer\n");
+		return;
+	}
+
+	z = &z_zones[b->tag];
+
+	z->count--;
+	z->bytes -= b->size;
+	z->totalfrees++;
+
+	b->magic = Z_MAGIC_FREE;
+
+	if (b->sizeclass == Z_LARGECLASS)
+	{
+		zlarge_t *lb = (zlarge_t *) ((byte *) b - (sizeof (zlarge_t) - sizeof (zblock_t)));
+
+		// unlink and give it straight back
+		if (lb->prev) lb->prev->next = lb->next; else z->large = lb->next;
+		if (lb->next) lb->next->prev = lb->prev;
+
+		Z_RemoveRange (range);
+		z->numlarge--;
+		free (lb);
+	}
+	else
+	{
+		// put it on the free list for this class
+		Z_NEXTFREE (b) = z->freeblocks[b->sizeclass];
+		z->freeblocks[b->sizeclass] = b;
+	}
+}
+
+
+/*
+========================
+Z_FreeTags
+========================
+*/
+void Z_FreeTags (int tag)
+{
+	zone_t *z;
+	int i, j;
+
+	// this should never happen; if it does then we need to know
+	if (tag < 0 || tag >= MAX_ZONETAGS)
+	{
+		Com_Error (ERR_FATAL, "Z_FreeTags: bad tag");
+		return;
+	}
+
+	z = &z_zones[tag];
+
+	// Com_Printf ("Z_FreeTags : Freeing %i kb in %i allocations from tag %i\n", (z->bytes + 512) / 1024, z->count, tag);
+
+	// throw away the chunks and large blocks; individual allocations are never visited
+	while (z->chunks)
+	{
+		zchunk_t *next = z->chunks->next;
+		free (z->chunks);
+		z->chunks = next;
+	}
+
+	while (z->large)
+	{
+		zlarge_t *next = z->large->next;
+		free (z->large);
+		z->large = next;
+	}
+
+	// drop the tag's ranges in a single pass
+	for (i = 0, j = 0; i < z_numranges; i++)
+		if (z_ranges[i].tag != tag)
+			z_ranges[j++] = z_ranges[i];
+
+	z_numranges = j;
+
+	// fully clear the zone
+	memset (z, 0, sizeof (*z));
+}
+
+
+/*
+========================
+Z_TagAlloc
+========================
+*/
+void *Z_TagAlloc (int size, int tag)
+{
+	if (tag < 0 || tag >= MAX_ZONETAGS)
+	{
+		Com_Error (ERR_FATAL, "Z_TagAlloc: bad tag");
+		return NULL;
+	}
+	else if (size < 0)
+	{
+		Com_Error (ERR_FATAL, "Z_TagAlloc: bad size");
+		return NULL;
+	}
+	else
+	{
+		// get the correct zone
+		zone_t *z = &z_zones[tag];
+		int sizeclass = Z_SizeClass (size + sizeof (zblock_t));
+		zblock_t *b;
+
+		if (sizeclass == Z_LARGECLASS)
+			b = Z_AllocLarge (z, size, tag);
+		else b = Z_AllocSmall (z, sizeclass, tag);
+
+		b->magic = Z_MAGIC_USED;
+		b->tag = tag;
+		b->sizeclass = sizeclass;
+		b->size = size;
+
+		// counts
+		z->bytes += size;
+		z->count++;
+		z->totalallocs++;
+
+		if (z->bytes > z->peakbytes) z->peakbytes = z->bytes;
+
+		// game code expects zeroed memory
+		memset (b + 1, 0, size);
+
+		// return what we got
+		return (b + 1);
+	}
+}
+
+
+/*
+========================
+Z_Stats_f
+
+per-tag allocation statistics
+========================
+*/
+void Z_Stats_f (void)
+{
+	int i;
+	int totalbytes = 0;
+	int totalchunks = 0;
+
+	Com_Printf ("  tag  count       kb    peak kb  chunks  large    allocs     frees\n");
+
+	for (i = 0; i < MAX_ZONETAGS; i++)
+	{
+		zone_t *z = &z_zones[i];
+
+		if (!z->totalallocs) continue;
+
+		Com_Printf (
+			"%5i %6i %8i %10i %7i %6i %9i %9i\n",
+			i,
+			z->count,
+			(z->bytes + 512) / 1024,
+			(z->peakbytes + 512) / 1024,
+			z->numchunks,
+			z->numlarge,
+			z->totalallocs,
+			z->totalfrees
+		);
+
+		totalbytes += z->bytes;
+		totalchunks += z->numchunks;
+	}
+
+	Com_Printf ("%i kb in use, %i kb in chunks\n", (totalbytes + 512) / 1024, (totalchunks * (int) (sizeof (zchunk_t) + Z_CHUNKSIZE)) / 1024);
+}
+
+
+void Z_Init (void)
+{
+	memset (z_zones, 0, sizeof (z_zones));
+}
+
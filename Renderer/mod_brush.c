@@ -66,8 +66,6 @@ Mod_LoadVisibility
 */
 void Mod_LoadVisibility (lump_t *l, dbsp_t *bsp)
 {
-	int		i;
-
 	if (!l->filelen)
 	{
 		loadmodel->vis = NULL;
@@ -78,12 +76,7 @@ void Mod_LoadVisibility (lump_t *l, dbsp_t *bsp)
 	memcpy (loadmodel->vis, mod_base + l->fileofs, l->filelen);
 
 	loadmodel->vis->numclusters = LittleLong (loadmodel->vis->numclusters);
-
-	for (i = 0; i < loadmodel->vis->numclusters; i++)
-	{
-		loadmodel->vis->bitofs[i][0] = LittleLong (loadmodel->vis->bitofs[i][0]);
-		loadmodel->vis->bitofs[i][1] = LittleLong (loadmodel->vis->bitofs[i][1]);
-	}
+	LittleLongArray (loadmodel->vis->bitofs, loadmodel->vis->numclusters * 2);
 }
 
 
@@ -95,20 +88,13 @@ Mod_LoadVertexes
 void Mod_LoadVertexes (lump_t *l, dbsp_t *bsp)
 {
 	dvertex_t	*in = (dvertex_t *) (mod_base + l->fileofs);
-	int			i, count;
 
 	if (l->filelen % sizeof (dvertex_t))
 		ri.Sys_Error (ERR_DROP, "Mod_LoadVertexes: funny lump size in %s", loadmodel->name);
 
-	count = l->filelen / sizeof (dvertex_t);
+	// swapped in place and used straight from the file
+	LittleLongArray (in, l->filelen >> 2);
 	bsp->vertexes = in;
-
-	for (i = 0; i < count; i++, in++)
-	{
-		in->point[0] = LittleFloat (in->point[0]);
-		in->point[1] = LittleFloat (in->point[1]);
-		in->point[2] = LittleFloat (in->point[2]);
-	}
 }
 
 
@@ -132,20 +118,23 @@ void Mod_LoadSubmodels (lump_t *l, dbsp_t *bsp)
 	loadmodel->submodels = out;
 	loadmodel->numsubmodels = count;
 
+	// all floats and longs
+	LittleLongArray (in, l->filelen >> 2);
+
 	for (i = 0; i < count; i++, in++, out++)
 	{
 		for (j = 0; j < 3; j++)
 		{
 			// spread the mins / maxs by a pixel
-			out->mins[j] = LittleFloat (in->mins[j]) - 1;
-			out->maxs[j] = LittleFloat (in->maxs[j]) + 1;
-			out->origin[j] = LittleFloat (in->origin[j]);
+			out->mins[j] = in->mins[j] - 1;
+			out->maxs[j] = in->maxs[j] + 1;
+			out->origin[j] = in->origin[j];
 		}
 
 		out->radius = Mod_RadiusFromBounds (out->mins, out->maxs);
-		out->headnode = LittleLong (in->headnode);
-		out->firstface = LittleLong (in->firstface);
-		out->numfaces = LittleLong (in->numfaces);
+		out->headnode = in->headnode;
+		out->firstface = in->firstface;
+		out->numfaces = in->numfaces;
 	}
 }
 
@@ -157,19 +146,12 @@ Mod_LoadEdges
 void Mod_LoadEdges (lump_t *l, dbsp_t *bsp)
 {
 	dedge_t *in = (dedge_t *) (mod_base + l->fileofs);
-	int 	i, count;
 
 	if (l->filelen % sizeof (dedge_t))
 		ri.Sys_Error (ERR_DROP, "Mod_LoadEdges: funny lump size in %s", loadmodel->name);
 
-	count = l->filelen / sizeof (dedge_t);
+	LittleShortArray (in, l->filelen >> 1);
 	bsp->edges = in;
-
-	for (i = 0; i < count; i++, in++)
-	{
-		in->v[0] = (unsigned short) LittleShort (in->v[0]);
-		in->v[1] = (unsigned short) LittleShort (in->v[1]);
-	}
 }
 
 /*
@@ -507,17 +489,12 @@ Mod_LoadSurfedges
 */
 void Mod_LoadSurfedges (lump_t *l, dbsp_t *bsp)
 {
-	int		i, count;
 	int		*in = (int *) (mod_base + l->fileofs);
 
 	if (l->filelen % sizeof (int))
 		ri.Sys_Error (ERR_DROP, "Mod_LoadSurfedges: funny lump size in %s", loadmodel->name);
 
-	count = l->filelen / sizeof (int);
-
-	for (i = 0; i < count; i++)
-		in[i] = LittleLong (in[i]);
-
+	LittleLongArray (in, l->filelen >> 2);
 	bsp->surfedges = in;
 }
 
@@ -545,13 +522,16 @@ void Mod_LoadPlanes (lump_t *l, dbsp_t *bsp)
 	loadmodel->planes = out;
 	loadmodel->numplanes = count;
 
+	// all floats and longs
+	LittleLongArray (in, l->filelen >> 2);
+
 	for (i = 0; i < count; i++, in++, out++)
 	{
 		for (j = 0; j < 3; j++)
-			out->normal[j] = LittleFloat (in->normal[j]);
+			out->normal[j] = in->normal[j];
 
-		out->type = LittleLong (in->type);
-		out->dist = LittleFloat (in->dist);
+		out->type = in->type;
+		out->dist = in->dist;
 		out->signbits = Mod_SignbitsForPlane (out);
 	}
 }
@@ -614,8 +594,7 @@ void Mod_LoadBrushModel (model_t *mod, void *buffer)
 	// swap all the lumps
 	mod_base = (byte *) header;
 
-	for (i = 0; i < sizeof (dheader_t) / 4; i++)
-		((int *) header)[i] = LittleLong (((int *) header)[i]);
+	LittleLongArray (header, sizeof (dheader_t) / 4);
 
 	// load into heap
 	Mod_LoadVertexes (&header->lumps[LUMP_VERTEXES], &bsp);
@@ -565,9 +565,6 @@ void Draw_StretchRaw (int cols, int rows, byte *data, int frame, const unsigned
 		r_rawframe = frame;
 	}
 
-	// free any memory we may have used for loading it
-	ri.Load_FreeMemory ();
-
 	R_BindTexture (r_CinematicPic.SRV);
 
 	D_BindShaderBundle (d3d_DrawCinematicShader);
@@ -22,9 +22,15 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 
 // gamma-correct to 16-bit precision, average, then mix back down to 8-bit precision so that we don't lose ultra-darks in the correction process
-unsigned short image_mipgammatable[256];
-byte image_mipinversegamma[65536];
+// these are int and padded so that the AVX2 kernels can gather from them directly; the values are unchanged
+int image_mipgammatable[256];
+byte image_mipinversegamma[65536 + 4];
 
+// kernels for the image pipeline; see R_InitImageKernels
+imagekernels_t image_kernels;
+
+// opaque colour that mipmap haloes are filled to in R_FloodFillSkin, found once when the palette is loaded
+static int r_floodfillcolor = 0;
 
 byte Image_GammaVal8to8 (byte val, float gamma)
 {
@@ -74,6 +80,41 @@ unsigned short Image_GammaVal16to16 (unsigned short val, float gamma)
 }
 
 
+/*
+===============
+Image_BuildInverseGammaTable
+
+Image_GammaVal16to8 is monotonic so the 65536-entry table is just 256 runs of the same value; rather than evaluating
+powf for every entry we binary-search each run boundary and fill in between, which gives an identical table for
+about 1/16th of the cost.
+===============
+*/
+void Image_BuildInverseGammaTable (byte *table, float gamma)
+{
+	int lo = 0;
+
+	while (lo < 65536)
+	{
+		byte val = Image_GammaVal16to8 (lo, gamma);
+		int imin = lo + 1;
+		int imax = 65536;
+
+		// find the first entry past lo that has a different value
+		while (imin < imax)
+		{
+			int imid = (imin + imax) >> 1;
+
+			if (Image_GammaVal16to8 (imid, gamma) == val)
+				imin = imid + 1;
+			else imax = imid;
+		}
+
+		memset (&table[lo], val, imin - lo);
+		lo = imin;
+	}
+}
+
+
 int AverageMip (int _1, int _2, int _3, int _4)
 {
 	return (_1 + _2 + _3 + _4) >> 2;
@@ -104,11 +145,7 @@ LoadPCX
 void LoadPCX (char *filename, byte **pic, byte **palette, int *width, int *height)
 {
 	byte	*raw;
-	pcx_t	*pcx;
-	int		x, y;
 	int		len;
-	int		dataByte, runLength;
-	byte	*out, *pix;
 
 	*pic = NULL;
 	*palette = NULL;
@@ -122,6 +159,32 @@ void LoadPCX (char *filename, byte **pic, byte **palette, int *width, int *heigh
 		return;
 	}
 
+	if (!Image_DecodePCX (raw, len, pic, palette, width, height))
+		ri.Con_Printf (PRINT_DEVELOPER, "Bad pcx file %s\n", filename);
+
+	ri.FS_FreeFile (raw);
+}
+
+
+/*
+==============
+Image_DecodePCX
+
+Decodes a PCX that has already been loaded; this doesn't print or error so it may be run on a worker thread
+==============
+*/
+qboolean Image_DecodePCX (byte *raw, int len, byte **pic, byte **palette, int *width, int *height)
+{
+	pcx_t	*pcx;
+	int		x, y;
+	int		dataByte, runLength;
+	byte	*out, *pix;
+
+	*pic = NULL;
+
+	if (palette)
+		*palette = NULL;
+
 	// parse the PCX file
 	pcx = (pcx_t *) raw;
 
@@ -137,10 +200,7 @@ void LoadPCX (char *filename, byte **pic, byte **palette, int *width, int *heigh
 	raw = &pcx->data;
 
 	if (pcx->manufacturer != 0x0a || pcx->version != 5 || pcx->encoding != 1 || pcx->bits_per_pixel != 8)
-	{
-		ri.Con_Printf (PRINT_ALL, "Bad pcx file %s\n", filename);
-		return;
-	}
+		return false;
 
 	out = ri.Load_AllocMemory ((pcx->ymax + 1) * (pcx->xmax + 1));
 
@@ -180,11 +240,11 @@ void LoadPCX (char *filename, byte **pic, byte **palette, int *width, int *heigh
 
 	if (raw - (byte *) pcx > len)
 	{
-		ri.Con_Printf (PRINT_DEVELOPER, "PCX file %s was malformed", filename);
 		*pic = NULL;
+		return false;
 	}
 
-	ri.FS_FreeFile (pcx);
+	return true;
 }
 
 /*
@@ -202,18 +262,12 @@ Image_LoadTGA
 */
 byte *Image_LoadTGA (char *name, int *width, int *height)
 {
-	int		columns, rows, numPixels;
-	byte	*pixbuf;
-	int		row, column;
-	byte	*buf_p;
 	byte	*buffer;
-	int		length;
+	byte	*pic;
 	TargaHeader		*targa_header;
-	byte			*targa_rgba;
-	byte *pic = NULL;
 
 	// load the file
-	length = ri.FS_LoadFile (name, (void **) &buffer);
+	ri.FS_LoadFile (name, (void **) &buffer);
 
 	if (!buffer)
 	{
@@ -221,6 +275,38 @@ byte *Image_LoadTGA (char *name, int *width, int *height)
 		return NULL;
 	}
 
+	targa_header = (TargaHeader *) buffer;
+
+	if (targa_header->image_type != 2 && targa_header->image_type != 10)
+		ri.Sys_Error (ERR_DROP, "Image_LoadTGA: Only type 2 and 10 targa RGB images supported\n");
+
+	if (targa_header->colormap_type != 0 || (targa_header->pixel_size != 32 && targa_header->pixel_size != 24))
+		ri.Sys_Error (ERR_DROP, "Image_LoadTGA: Only 32 or 24 bit images supported (no colormaps)\n");
+
+	pic = Image_DecodeTGA (buffer, width, height);
+
+	ri.FS_FreeFile (buffer);
+	return pic;
+}
+
+
+/*
+=============
+Image_DecodeTGA
+
+Decodes a TGA that has already been loaded and had its type checked; this doesn't print or error so it may be run on a worker thread
+=============
+*/
+byte *Image_DecodeTGA (byte *buffer, int *width, int *height)
+{
+	int		columns, rows, numPixels;
+	byte	*pixbuf;
+	int		row, column;
+	byte	*buf_p;
+	TargaHeader		*targa_header;
+	byte			*targa_rgba;
+	byte *pic = NULL;
+
 	buf_p = buffer;
 
 	targa_header = (TargaHeader *) buf_p;
@@ -234,12 +320,6 @@ byte *Image_LoadTGA (char *name, int *width, int *height)
 	targa_header->width = LittleShort (targa_header->width);
 	targa_header->height = LittleShort (targa_header->height);
 
-	if (targa_header->image_type != 2 && targa_header->image_type != 10)
-		ri.Sys_Error (ERR_DROP, "Image_LoadTGA: Only type 2 and 10 targa RGB images supported\n");
-
-	if (targa_header->colormap_type != 0 || (targa_header->pixel_size != 32 && targa_header->pixel_size != 24))
-		ri.Sys_Error (ERR_DROP, "Image_LoadTGA: Only 32 or 24 bit images supported (no colormaps)\n");
-
 	columns = targa_header->width;
 	rows = targa_header->height;
 	numPixels = columns * rows;
@@ -395,7 +475,6 @@ breakOut:;
 		}
 	}
 
-	ri.FS_FreeFile (buffer);
 	return pic;
 }
 
@@ -443,23 +522,7 @@ void R_FloodFillSkin (byte *skin, int skinwidth, int skinheight)
 	byte				fillcolor = *skin; // assume this is the pixel to fill
 	floodfill_t			fifo[FLOODFILL_FIFO_SIZE];
 	int					inpt = 0, outpt = 0;
-	int					filledcolor = -1;
-	int					i;
-
-	if (filledcolor == -1)
-	{
-		filledcolor = 0;
-
-		// attempt to find opaque black
-		for (i = 0; i < 256; ++i)
-		{
-			if (d_8to24table_solid[i] == (255 << 0)) // alpha 1.0
-			{
-				filledcolor = i;
-				break;
-			}
-		}
-	}
+	int					filledcolor = r_floodfillcolor;
 
 	// can't fill to filled color or to transparent color (used as visited marker)
 	if ((fillcolor == filledcolor) || (fillcolor == 255))
@@ -497,7 +560,7 @@ unsigned *Image_ResampleToSize (unsigned *in, int inwidth, int inheight, int out
 		return in;
 	else
 	{
-		int i, j;
+		int i;
 
 		unsigned *out = (unsigned *) ri.Load_AllocMemory (outwidth * outheight * 4);
 		unsigned *p1 = (unsigned *) ri.Load_AllocMemory (outwidth * 4);
@@ -526,19 +589,7 @@ unsigned *Image_ResampleToSize (unsigned *in, int inwidth, int inheight, int out
 			unsigned *inrow0 = in + inwidth * (int) (((i + 0.25f) * inheight) / outheight);
 			unsigned *inrow1 = in + inwidth * (int) (((i + 0.75f) * inheight) / outheight);
 
-			for (j = 0; j < outwidth; j++)
-			{
-				byte *pix1 = (byte *) inrow0 + p1[j];
-				byte *pix2 = (byte *) inrow0 + p2[j];
-				byte *pix3 = (byte *) inrow1 + p1[j];
-				byte *pix4 = (byte *) inrow1 + p2[j];
-
-				// don't gamma correct the alpha channel
-				((byte *) &outrow[j])[0] = AverageMipGC (pix1[0], pix2[0], pix3[0], pix4[0]);
-				((byte *) &outrow[j])[1] = AverageMipGC (pix1[1], pix2[1], pix3[1], pix4[1]);
-				((byte *) &outrow[j])[2] = AverageMipGC (pix1[2], pix2[2], pix3[2], pix4[2]);
-				((byte *) &outrow[j])[3] = AverageMip   (pix1[3], pix2[3], pix3[3], pix4[3]);
-			}
+			image_kernels.ResampleRow (outrow, inrow0, inrow1, p1, p2, outwidth);
 		}
 
 		return out;
@@ -563,23 +614,11 @@ unsigned *Image_MipReduceBoxFilter (unsigned *data, int width, int height)
 	unsigned *trans = (unsigned *) ri.Load_AllocMemory ((width >> 1) * (height >> 1) * 4);
 	byte *in = (byte *) data;
 	byte *out = (byte *) trans;
-	int i, j;
-
-	// do this after otherwise it will interfere with the allocation size above
-	width <<= 2;
-	height >>= 1;
+	int i;
 
-	for (i = 0; i < height; i++, in += width)
-	{
-		for (j = 0; j < width; j += 8, out += 4, in += 8)
-		{
-			// don't gamma correct the alpha channel
-			out[0] = AverageMipGC (in[0], in[4], in[width + 0], in[width + 4]);
-			out[1] = AverageMipGC (in[1], in[5], in[width + 1], in[width + 5]);
-			out[2] = AverageMipGC (in[2], in[6], in[width + 2], in[width + 6]);
-			out[3] = AverageMip   (in[3], in[7], in[width + 3], in[width + 7]);
-		}
-	}
+	// each output row consumes two input rows
+	for (i = 0; i < (height >> 1); i++, in += (width << 3), out += (width << 1))
+		image_kernels.MipReduceBoxRow (out, in, width << 2, width >> 1);
 
 	return trans;
 }
@@ -632,7 +671,17 @@ int Draw_GetPalette (void)
 
 	// gamma-correct to 16-bit precision, average, then mix back down to 8-bit precision so that we don't lose ultra-darks in the correction process
 	for (i = 0; i < 256; i++) image_mipgammatable[i] = Image_GammaVal8to16 (i, 2.2f);
-	for (i = 0; i < 65536; i++) image_mipinversegamma[i] = Image_GammaVal16to8 (i, 1.0f / 2.2f);
+	Image_BuildInverseGammaTable (image_mipinversegamma, 1.0f / 2.2f);
+
+	// attempt to find opaque black for R_FloodFillSkin
+	for (i = 0, r_floodfillcolor = 0; i < 256; i++)
+	{
+		if (d_8to24table_solid[i] == (255 << 0)) // alpha 1.0
+		{
+			r_floodfillcolor = i;
+			break;
+		}
+	}
 
 	return 0;
 }
@@ -640,43 +689,77 @@ int Draw_GetPalette (void)
 
 unsigned *GL_Image8To32 (byte *data, int width, int height, unsigned *palette)
 {
-	unsigned	*trans = (unsigned *) ri.Load_AllocMemory (width * height * sizeof (unsigned));
-	int			i, s = width * height;
+	unsigned *trans = (unsigned *) ri.Load_AllocMemory (width * height * sizeof (unsigned));
+	image_kernels.Image8To32 (trans, data, width, height, palette);
+	return trans;
+}
 
-	for (i = 0; i < s; i++)
-	{
-		int p = data[i];
 
-		trans[i] = palette[p];
+byte *Image_Upscale8 (byte *in, int inwidth, int inheight)
+{
+	byte *out = (byte *) ri.Load_AllocMemory (inwidth * inheight * 4);
+	image_kernels.Upscale8 (out, in, inwidth, inheight);
+	return out;
+}
+
 
-		if (p == 255)
-		{
-			// transparent, so scan around for another color to avoid alpha fringes
-			// FIXME: do a full flood fill so mips work...
-			if (i > width && data[i - width] != 255)
-				p = data[i - width];
-			else if (i < s - width && data[i + width] != 255)
-				p = data[i + width];
-			else if (i > 0 && data[i - 1] != 255)
-				p = data[i - 1];
-			else if (i < s - 1 && data[i + 1] != 255)
-				p = data[i + 1];
-			else p = 0;
-
-			// copy rgb components
-			((byte *) &trans[i])[0] = ((byte *) &palette[p])[0];
-			((byte *) &trans[i])[1] = ((byte *) &palette[p])[1];
-			((byte *) &trans[i])[2] = ((byte *) &palette[p])[2];
-		}
+unsigned *Image_Upscale32 (unsigned *in, int inwidth, int inheight)
+{
+	unsigned *out = (unsigned *) ri.Load_AllocMemory (inwidth * inheight * 4 * sizeof (unsigned));
+	image_kernels.Upscale32 (out, in, inwidth, inheight);
+	return out;
+}
+
+
+/*
+====================================================================
+
+SCALAR IMAGE KERNELS
+
+these are the reference versions; the SIMD versions in r_imgsimd.c must give identical output
+
+====================================================================
+*/
+
+void Image_8To32Pixel (unsigned *trans, byte *data, int i, int width, int s, unsigned *palette)
+{
+	int p = data[i];
+
+	trans[i] = palette[p];
+
+	if (p == 255)
+	{
+		// transparent, so scan around for another color to avoid alpha fringes
+		// FIXME: do a full flood fill so mips work...
+		if (i > width && data[i - width] != 255)
+			p = data[i - width];
+		else if (i < s - width && data[i + width] != 255)
+			p = data[i + width];
+		else if (i > 0 && data[i - 1] != 255)
+			p = data[i - 1];
+		else if (i < s - 1 && data[i + 1] != 255)
+			p = data[i + 1];
+		else p = 0;
+
+		// copy rgb components
+		((byte *) &trans[i])[0] = ((byte *) &palette[p])[0];
+		((byte *) &trans[i])[1] = ((byte *) &palette[p])[1];
+		((byte *) &trans[i])[2] = ((byte *) &palette[p])[2];
 	}
+}
 
-	return trans;
+
+void Image_8To32_Scalar (unsigned *trans, byte *data, int width, int height, unsigned *palette)
+{
+	int i, s = width * height;
+
+	for (i = 0; i < s; i++)
+		Image_8To32Pixel (trans, data, i, width, s, palette);
 }
 
 
-byte *Image_Upscale8 (byte *in, int inwidth, int inheight)
+void Image_Upscale8_Scalar (byte *out, byte *in, int inwidth, int inheight)
 {
-	byte *out = (byte *) ri.Load_AllocMemory (inwidth * inheight * 4);
 	int outwidth = inwidth << 1;
 	int outheight = inheight << 1;
 	int outx, outy, inx, iny;
@@ -690,14 +773,11 @@ byte *Image_Upscale8 (byte *in, int inwidth, int inheight)
 			out[outy * outwidth + outx] = in[iny * inwidth + inx];
 		}
 	}
-
-	return out;
 }
 
 
-unsigned *Image_Upscale32 (unsigned *in, int inwidth, int inheight)
+void Image_Upscale32_Scalar (unsigned *out, unsigned *in, int inwidth, int inheight)
 {
-	unsigned *out = (unsigned *) ri.Load_AllocMemory (inwidth * inheight * 4 * sizeof (unsigned));
 	int outwidth = inwidth << 1;
 	int outheight = inheight << 1;
 	int outx, outy, inx, iny;
@@ -711,8 +791,41 @@ unsigned *Image_Upscale32 (unsigned *in, int inwidth, int inheight)
 			out[outy * outwidth + outx] = in[iny * inwidth + inx];
 		}
 	}
+}
 
-	return out;
+
+void Image_ResampleRow_Scalar (unsigned *outrow, unsigned *inrow0, unsigned *inrow1, unsigned *p1, unsigned *p2, int outwidth)
+{
+	int j;
+
+	for (j = 0; j < outwidth; j++)
+	{
+		byte *pix1 = (byte *) inrow0 + p1[j];
+		byte *pix2 = (byte *) inrow0 + p2[j];
+		byte *pix3 = (byte *) inrow1 + p1[j];
+		byte *pix4 = (byte *) inrow1 + p2[j];
+
+		// don't gamma correct the alpha channel
+		((byte *) &outrow[j])[0] = AverageMipGC (pix1[0], pix2[0], pix3[0], pix4[0]);
+		((byte *) &outrow[j])[1] = AverageMipGC (pix1[1], pix2[1], pix3[1], pix4[1]);
+		((byte *) &outrow[j])[2] = AverageMipGC (pix1[2], pix2[2], pix3[2], pix4[2]);
+		((byte *) &outrow[j])[3] = AverageMip   (pix1[3], pix2[3], pix3[3], pix4[3]);
+	}
+}
+
+
+void Image_MipReduceBoxRow_Scalar (byte *out, byte *in, int stride, int outwidth)
+{
+	int j;
+
+	for (j = 0; j < outwidth; j++, out += 4, in += 8)
+	{
+		// don't gamma correct the alpha channel
+		out[0] = AverageMipGC (in[0], in[4], in[stride + 0], in[stride + 4]);
+		out[1] = AverageMipGC (in[1], in[5], in[stride + 1], in[stride + 5]);
+		out[2] = AverageMipGC (in[2], in[6], in[stride + 2], in[stride + 6]);
+		out[3] = AverageMip   (in[3], in[7], in[stride + 3], in[stride + 7]);
+	}
 }
 
 
@@ -0,0 +1,604 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#include "r_local.h"
+
+#include <intrin.h>
+#include <immintrin.h>
+
+
+/*
+====================================================================
+
+SIMD IMAGE KERNELS
+
+All of these give output that is bit-identical to the scalar kernels in r_image.c; the filters are integer
+averages of table lookups so there is no rounding that could differ.  "imagebench" verifies this over the
+full set of images in the PAKs.
+
+The gamma-correct filters need a table lookup per channel so they only have AVX2 versions (using gathers);
+SSE2 is used for the palette expansion and the upscales, which are where most of the time goes with 8-bit
+textures anyway.
+
+MSVC allows AVX2 intrinsics without /arch:AVX2 so these are only ever called after R_GetCPUSIMDLevel has
+said it's safe to.
+
+====================================================================
+*/
+
+cvar_t *r_simd;
+
+
+int R_GetCPUSIMDLevel (void)
+{
+	int info[4];
+	int maxid;
+
+	__cpuid (info, 0);
+	maxid = info[0];
+
+	__cpuid (info, 1);
+
+	if (!(info[3] & (1 << 26)))
+		return SIMD_NONE;
+
+	// AVX2 requires both the CPU to support it and the OS to save the YMM registers
+	if ((info[2] & (1 << 27)) && (info[2] & (1 << 28)) && maxid >= 7)
+	{
+		if ((_xgetbv (0) & 6) == 6)
+		{
+			__cpuidex (info, 7, 0);
+
+			if (info[1] & (1 << 5))
+				return SIMD_AVX2;
+		}
+	}
+
+	return SIMD_SSE2;
+}
+
+
+/*
+====================================================================
+
+SSE2
+
+====================================================================
+*/
+
+static void Image_8To32_SSE2 (unsigned *trans, byte *data, int width, int height, unsigned *palette)
+{
+	int i, j, s = width * height;
+	__m128i transparent = _mm_set1_epi8 ((char) 255);
+
+	for (i = 0; i + 16 <= s; i += 16)
+	{
+		if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (_mm_loadu_si128 ((__m128i *) &data[i]), transparent)))
+		{
+			// blocks with transparent pixels need the neighbour scan
+			for (j = i; j < i + 16; j++)
+				Image_8To32Pixel (trans, data, j, width, s, palette);
+		}
+		else
+		{
+			// fully opaque blocks are straight lookups with no per-pixel test
+			for (j = i; j < i + 16; j += 4)
+				_mm_storeu_si128 ((__m128i *) &trans[j], _mm_setr_epi32 (palette[data[j]], palette[data[j + 1]], palette[data[j + 2]], palette[data[j + 3]]));
+		}
+	}
+
+	for (; i < s; i++)
+		Image_8To32Pixel (trans, data, i, width, s, palette);
+}
+
+
+static void Image_Upscale8_SSE2 (byte *out, byte *in, int inwidth, int inheight)
+{
+	int outwidth = inwidth << 1;
+	int x, y;
+
+	for (y = 0; y < inheight; y++, in += inwidth, out += (outwidth << 1))
+	{
+		byte *row0 = out;
+		byte *row1 = out + outwidth;
+
+		for (x = 0; x + 16 <= inwidth; x += 16)
+		{
+			__m128i v = _mm_loadu_si128 ((__m128i *) &in[x]);
+			__m128i lo = _mm_unpacklo_epi8 (v, v);
+			__m128i hi = _mm_unpackhi_epi8 (v, v);
+
+			_mm_storeu_si128 ((__m128i *) &row0[(x << 1) + 0], lo);
+			_mm_storeu_si128 ((__m128i *) &row0[(x << 1) + 16], hi);
+			_mm_storeu_si128 ((__m128i *) &row1[(x << 1) + 0], lo);
+			_mm_storeu_si128 ((__m128i *) &row1[(x << 1) + 16], hi);
+		}
+
+		for (; x < inwidth; x++)
+			row0[(x << 1) + 0] = row0[(x << 1) + 1] = row1[(x << 1) + 0] = row1[(x << 1) + 1] = in[x];
+	}
+}
+
+
+static void Image_Upscale32_SSE2 (unsigned *out, unsigned *in, int inwidth, int inheight)
+{
+	int outwidth = inwidth << 1;
+	int x, y;
+
+	for (y = 0; y < inheight; y++, in += inwidth, out += (outwidth << 1))
+	{
+		unsigned *row0 = out;
+		unsigned *row1 = out + outwidth;
+
+		for (x = 0; x + 4 <= inwidth; x += 4)
+		{
+			__m128i v = _mm_loadu_si128 ((__m128i *) &in[x]);
+			__m128i lo = _mm_unpacklo_epi32 (v, v);
+			__m128i hi = _mm_unpackhi_epi32 (v, v);
+
+			_mm_storeu_si128 ((__m128i *) &row0[(x << 1) + 0], lo);
+			_mm_storeu_si128 ((__m128i *) &row0[(x << 1) + 4], hi);
+			_mm_storeu_si128 ((__m128i *) &row1[(x << 1) + 0], lo);
+			_mm_storeu_si128 ((__m128i *) &row1[(x << 1) + 4], hi);
+		}
+
+		for (; x < inwidth; x++)
+			row0[(x << 1) + 0] = row0[(x << 1) + 1] = row1[(x << 1) + 0] = row1[(x << 1) + 1] = in[x];
+	}
+}
+
+
+/*
+====================================================================
+
+AVX2
+
+====================================================================
+*/
+
+static void Image_8To32_AVX2 (unsigned *trans, byte *data, int width, int height, unsigned *palette)
+{
+	int i, j, s = width * height;
+	__m128i transparent = _mm_set1_epi8 ((char) 255);
+
+	for (i = 0; i + 16 <= s; i += 16)
+	{
+		if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (_mm_loadu_si128 ((__m128i *) &data[i]), transparent)))
+		{
+			// blocks with transparent pixels need the neighbour scan
+			for (j = i; j < i + 16; j++)
+				Image_8To32Pixel (trans, data, j, width, s, palette);
+		}
+		else
+		{
+			// fully opaque blocks are gathered straight from the palette
+			__m256i idx0 = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((__m128i *) &data[i + 0]));
+			__m256i idx1 = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((__m128i *) &data[i + 8]));
+
+			_mm256_storeu_si256 ((__m256i *) &trans[i + 0], _mm256_i32gather_epi32 ((int *) palette, idx0, 4));
+			_mm256_storeu_si256 ((__m256i *) &trans[i + 8], _mm256_i32gather_epi32 ((int *) palette, idx1, 4));
+		}
+	}
+
+	_mm256_zeroupper ();
+
+	for (; i < s; i++)
+		Image_8To32Pixel (trans, data, i, width, s, palette);
+}
+
+
+static __m256i Image_GammaAverage_AVX2 (__m256i a, __m256i b, __m256i c, __m256i d)
+{
+	// a, b, c and d hold a single 8-bit channel in each 32-bit lane; this is AverageMipGC 8-wide
+	__m256i sum = _mm256_add_epi32 (
+		_mm256_add_epi32 (_mm256_i32gather_epi32 (image_mipgammatable, a, 4), _mm256_i32gather_epi32 (image_mipgammatable, b, 4)),
+		_mm256_add_epi32 (_mm256_i32gather_epi32 (image_mipgammatable, c, 4), _mm256_i32gather_epi32 (image_mipgammatable, d, 4))
+	);
+
+	// the inverse table is bytes so this reads 4 at a time and masks off the one we want; the table is padded so the last entry is safe
+	return _mm256_and_si256 (_mm256_i32gather_epi32 ((int *) image_mipinversegamma, _mm256_srli_epi32 (sum, 2), 1), _mm256_set1_epi32 (0xff));
+}
+
+
+static __m256i Image_AverageMip_AVX2 (__m256i a, __m256i b, __m256i c, __m256i d)
+{
+	__m256i mask = _mm256_set1_epi32 (0xff);
+	__m256i red, green, blue, alpha;
+
+	red = Image_GammaAverage_AVX2 (
+		_mm256_and_si256 (a, mask),
+		_mm256_and_si256 (b, mask),
+		_mm256_and_si256 (c, mask),
+		_mm256_and_si256 (d, mask)
+	);
+
+	green = Image_GammaAverage_AVX2 (
+		_mm256_and_si256 (_mm256_srli_epi32 (a, 8), mask),
+		_mm256_and_si256 (_mm256_srli_epi32 (b, 8), mask),
+		_mm256_and_si256 (_mm256_srli_epi32 (c, 8), mask),
+		_mm256_and_si256 (_mm256_srli_epi32 (d, 8), mask)
+	);
+
+	blue = Image_GammaAverage_AVX2 (
+		_mm256_and_si256 (_mm256_srli_epi32 (a, 16), mask),
+		_mm256_and_si256 (_mm256_srli_epi32 (b, 16), mask),
+		_mm256_and_si256 (_mm256_srli_epi32 (c, 16), mask),
+		_mm256_and_si256 (_mm256_srli_epi32 (d, 16), mask)
+	);
+
+	// don't gamma correct the alpha channel
+	alpha = _mm256_srli_epi32 (
+		_mm256_add_epi32 (
+			_mm256_add_epi32 (_mm256_srli_epi32 (a, 24), _mm256_srli_epi32 (b, 24)),
+			_mm256_add_epi32 (_mm256_srli_epi32 (c, 24), _mm256_srli_epi32 (d, 24))
+		),
+		2
+	);
+
+	return _mm256_or_si256 (
+		_mm256_or_si256 (red, _mm256_slli_epi32 (green, 8)),
+		_mm256_or_si256 (_mm256_slli_epi32 (blue, 16), _mm256_slli_epi32 (alpha, 24))
+	);
+}
+
+
+static void Image_ResampleRow_AVX2 (unsigned *outrow, unsigned *inrow0, unsigned *inrow1, unsigned *p1, unsigned *p2, int outwidth)
+{
+	int j;
+
+	for (j = 0; j + 8 <= outwidth; j += 8)
+	{
+		// p1 and p2 are byte offsets into the row
+		__m256i idx1 = _mm256_loadu_si256 ((__m256i *) &p1[j]);
+		__m256i idx2 = _mm256_loadu_si256 ((__m256i *) &p2[j]);
+
+		_mm256_storeu_si256 ((__m256i *) &outrow[j], Image_AverageMip_AVX2 (
+			_mm256_i32gather_epi32 ((int *) inrow0, idx1, 1),
+			_mm256_i32gather_epi32 ((int *) inrow0, idx2, 1),
+			_mm256_i32gather_epi32 ((int *) inrow1, idx1, 1),
+			_mm256_i32gather_epi32 ((int *) inrow1, idx2, 1)
+		));
+	}
+
+	_mm256_zeroupper ();
+
+	if (j < outwidth)
+		Image_ResampleRow_Scalar (outrow + j, inrow0, inrow1, p1 + j, p2 + j, outwidth - j);
+}
+
+
+static void Image_MipReduceBoxRow_AVX2 (byte *out, byte *in, int stride, int outwidth)
+{
+	unsigned *row0 = (unsigned *) in;
+	unsigned *row1 = (unsigned *) (in + stride);
+	unsigned *dst = (unsigned *) out;
+	int j;
+
+	for (j = 0; j + 8 <= outwidth; j += 8)
+	{
+		__m256 a0 = _mm256_castsi256_ps (_mm256_loadu_si256 ((__m256i *) &row0[(j << 1) + 0]));
+		__m256 a1 = _mm256_castsi256_ps (_mm256_loadu_si256 ((__m256i *) &row0[(j << 1) + 8]));
+		__m256 b0 = _mm256_castsi256_ps (_mm256_loadu_si256 ((__m256i *) &row1[(j << 1) + 0]));
+		__m256 b1 = _mm256_castsi256_ps (_mm256_loadu_si256 ((__m256i *) &row1[(j << 1) + 8]));
+
+		// split into even and odd pixels; the shuffle works per 128-bit lane so the permute puts the 64-bit pairs back in order
+		__m256i aeven = _mm256_permute4x64_epi64 (_mm256_castps_si256 (_mm256_shuffle_ps (a0, a1, _MM_SHUFFLE (2, 0, 2, 0))), _MM_SHUFFLE (3, 1, 2, 0));
+		__m256i aodd = _mm256_permute4x64_epi64 (_mm256_castps_si256 (_mm256_shuffle_ps (a0, a1, _MM_SHUFFLE (3, 1, 3, 1))), _MM_SHUFFLE (3, 1, 2, 0));
+		__m256i beven = _mm256_permute4x64_epi64 (_mm256_castps_si256 (_mm256_shuffle_ps (b0, b1, _MM_SHUFFLE (2, 0, 2, 0))), _MM_SHUFFLE (3, 1, 2, 0));
+		__m256i bodd = _mm256_permute4x64_epi64 (_mm256_castps_si256 (_mm256_shuffle_ps (b0, b1, _MM_SHUFFLE (3, 1, 3, 1))), _MM_SHUFFLE (3, 1, 2, 0));
+
+		_mm256_storeu_si256 ((__m256i *) &dst[j], Image_AverageMip_AVX2 (aeven, aodd, beven, bodd));
+	}
+
+	_mm256_zeroupper ();
+
+	if (j < outwidth)
+		Image_MipReduceBoxRow_Scalar (out + (j << 2), in + (j << 3), stride, outwidth - j);
+}
+
+
+/*
+====================================================================
+
+KERNEL SELECTION
+
+====================================================================
+*/
+
+void R_InitImageKernels (void)
+{
+	int level = R_GetCPUSIMDLevel ();
+
+	// r_simd can cap the level but not raise it above what the CPU supports; it's clamped to the known levels
+	// before it's converted so that any value gives a sensible one
+	if (r_simd)
+	{
+		int cap;
+
+		if (r_simd->value < SIMD_NONE)
+			cap = SIMD_NONE;
+		else if (r_simd->value > SIMD_AVX2)
+			cap = SIMD_AVX2;
+		else cap = (int) r_simd->value;
+
+		if (cap < level)
+			level = cap;
+	}
+
+	// the streaming workers call the kernels through this table so they must be idle while it changes
+	R_DrainTextureStream ();
+
+	// the scalar kernels are always the baseline so anything without a SIMD version falls back to them
+	image_kernels.name = "scalar";
+	image_kernels.Image8To32 = Image_8To32_Scalar;
+	image_kernels.Upscale8 = Image_Upscale8_Scalar;
+	image_kernels.Upscale32 = Image_Upscale32_Scalar;
+	image_kernels.ResampleRow = Image_ResampleRow_Scalar;
+	image_kernels.MipReduceBoxRow = Image_MipReduceBoxRow_Scalar;
+
+	if (level >= SIMD_SSE2)
+	{
+		image_kernels.name = "SSE2";
+		image_kernels.Image8To32 = Image_8To32_SSE2;
+		image_kernels.Upscale8 = Image_Upscale8_SSE2;
+		image_kernels.Upscale32 = Image_Upscale32_SSE2;
+	}
+
+	if (level >= SIMD_AVX2)
+	{
+		image_kernels.name = "AVX2";
+		image_kernels.Image8To32 = Image_8To32_AVX2;
+		image_kernels.ResampleRow = Image_ResampleRow_AVX2;
+		image_kernels.MipReduceBoxRow = Image_MipReduceBoxRow_AVX2;
+	}
+
+	ri.Con_Printf (PRINT_DEVELOPER, "Using %s image kernels\n", image_kernels.name);
+}
+
+
+/*
+====================================================================
+
+IMAGE PIPELINE BENCHMARK
+
+Runs every WAL/PCX/TGA in the PAKs through the same decode/expand/upscale/mipmap path as GL_LoadPic, without
+creating any textures, once with the scalar kernels and once with the currently selected ones; reports the
+time spent in each and any image where the output differs.
+
+====================================================================
+*/
+
+static double R_BenchTime (void)
+{
+	static __int64 qpcfreq = 0;
+	__int64 qpcnow;
+
+	if (!qpcfreq) QueryPerformanceFrequency ((LARGE_INTEGER *) &qpcfreq);
+	QueryPerformanceCounter ((LARGE_INTEGER *) &qpcnow);
+
+	return (double) qpcnow * 1000.0 / (double) qpcfreq;
+}
+
+
+static unsigned R_BenchHash (unsigned hash, byte *data, int len)
+{
+	// FNV-1a
+	while (len-- > 0)
+		hash = (hash ^ *data++) * 16777619;
+
+	return hash;
+}
+
+
+static qboolean R_BenchImage (char *name, unsigned *hash, double *time)
+{
+	D3D11_SUBRESOURCE_DATA srd[32];
+	unsigned *trans = NULL;
+	int width = 0, height = 0;
+	int len = strlen (name);
+	int i, numlevels;
+	double start;
+
+	if (!strcmp (name + len - 4, ".wal"))
+	{
+		miptex_t *mt;
+
+		ri.FS_LoadFile (name, (void **) &mt);
+
+		if (!mt) return false;
+
+		width = LittleLong (mt->width);
+		height = LittleLong (mt->height);
+
+		// same path as GL_LoadWal
+		start = R_BenchTime ();
+		trans = GL_Image8To32 (Image_Upscale8 ((byte *) mt + LittleLong (mt->offsets[0]), width, height), width << 1, height << 1, d_8to24table_solid);
+		ri.FS_FreeFile (mt);
+
+		width <<= 1;
+		height <<= 1;
+	}
+	else if (!strcmp (name + len - 4, ".pcx"))
+	{
+		byte *pic, *palette;
+		unsigned table[256];
+
+		LoadPCX (name, &pic, &palette, &width, &height);
+
+		if (!pic) return false;
+
+		// run them as skins, which is the longest path through GL_LoadPic
+		start = R_BenchTime ();
+		Image_QuakePalFromPCXPal (table, palette, TEX_RGBA8);
+		R_FloodFillSkin (pic, width, height);
+		trans = GL_Image8To32 (Image_Upscale8 (pic, width, height), width << 1, height << 1, table);
+
+		width <<= 1;
+		height <<= 1;
+	}
+	else if (!strcmp (name + len - 4, ".tga"))
+	{
+		TargaHeader *targa_header;
+
+		// Image_LoadTGA drops on types it can't handle so check them first
+		ri.FS_LoadFile (name, (void **) &targa_header);
+
+		if (!targa_header) return false;
+
+		if ((targa_header->image_type != 2 && targa_header->image_type != 10) || targa_header->colormap_type != 0 || (targa_header->pixel_size != 32 && targa_header->pixel_size != 24))
+		{
+			ri.FS_FreeFile (targa_header);
+			return false;
+		}
+
+		ri.FS_FreeFile (targa_header);
+
+		if ((trans = (unsigned *) Image_LoadTGA (name, &width, &height)) == NULL)
+			return false;
+
+		start = R_BenchTime ();
+	}
+	else return false;
+
+	if (width < 1 || height < 1)
+	{
+		ri.Load_FreeMemory ();
+		return false;
+	}
+
+	srd[0].pSysMem = trans;
+	srd[0].SysMemPitch = width << 2;
+	srd[0].SysMemSlicePitch = 0;
+
+	numlevels = R_BuildMipChain (srd, width, height);
+
+	*time += R_BenchTime () - start;
+
+	for (i = 0, *hash = 2166136261; i < numlevels; i++)
+	{
+		*hash = R_BenchHash (*hash, (byte *) srd[i].pSysMem, width * height * 4);
+
+		if ((width = width >> 1) < 1) width = 1;
+		if ((height = height >> 1) < 1) height = 1;
+	}
+
+	ri.Load_FreeMemory ();
+
+	return true;
+}
+
+
+static int R_BenchImageList (char **list, int numfiles, unsigned *hashes, double *time)
+{
+	int i, count = 0;
+
+	for (i = 0, *time = 0; i < numfiles; i++)
+	{
+		if (R_BenchImage (list[i], &hashes[i], time))
+			count++;
+		else hashes[i] = 0;
+	}
+
+	return count;
+}
+
+
+void R_ImageBench_f (void)
+{
+	char *exts[3] = {".wal", ".pcx", ".tga"};
+	char **lists[3];
+	int numfiles[3];
+	unsigned *scalarhash[3], *simdhash[3];
+	double scalartime = 0, simdtime = 0, passtime;
+	int i, j, count = 0, mismatches = 0;
+	imagekernels_t selected;
+	double start;
+
+	// verify the inverse gamma table against the brute-force version it replaced
+	byte *bruteforce;
+	double gammatime[2];
+
+	// the kernels and the gamma table are swapped out below while the streaming workers may be using them
+	R_DrainTextureStream ();
+
+	selected = image_kernels;
+	bruteforce = (byte *) ri.Load_AllocMemory (65536);
+
+	start = R_BenchTime ();
+	for (i = 0; i < 65536; i++) bruteforce[i] = Image_GammaVal16to8 (i, 1.0f / 2.2f);
+	gammatime[0] = R_BenchTime () - start;
+
+	start = R_BenchTime ();
+	Image_BuildInverseGammaTable (image_mipinversegamma, 1.0f / 2.2f);
+	gammatime[1] = R_BenchTime () - start;
+
+	ri.Con_Printf (PRINT_ALL, "inverse gamma table : %.2f ms brute force, %.2f ms searched, %s\n",
+		gammatime[0], gammatime[1], memcmp (bruteforce, image_mipinversegamma, 65536) ? "MISMATCH" : "identical");
+
+	ri.Load_FreeMemory ();
+
+	for (i = 0; i < 3; i++)
+	{
+		lists[i] = ri.FS_ListPackFiles (exts[i], &numfiles[i]);
+		scalarhash[i] = (unsigned *) HeapAlloc (hRefHeap, HEAP_ZERO_MEMORY, (numfiles[i] + 1) * sizeof (unsigned));
+		simdhash[i] = (unsigned *) HeapAlloc (hRefHeap, HEAP_ZERO_MEMORY, (numfiles[i] + 1) * sizeof (unsigned));
+	}
+
+	// reference pass
+	image_kernels.name = "scalar";
+	image_kernels.Image8To32 = Image_8To32_Scalar;
+	image_kernels.Upscale8 = Image_Upscale8_Scalar;
+	image_kernels.Upscale32 = Image_Upscale32_Scalar;
+	image_kernels.ResampleRow = Image_ResampleRow_Scalar;
+	image_kernels.MipReduceBoxRow = Image_MipReduceBoxRow_Scalar;
+
+	for (i = 0; i < 3; i++)
+	{
+		count += R_BenchImageList (lists[i], numfiles[i], scalarhash[i], &passtime);
+		scalartime += passtime;
+	}
+
+	// selected pass
+	image_kernels = selected;
+
+	for (i = 0; i < 3; i++)
+	{
+		R_BenchImageList (lists[i], numfiles[i], simdhash[i], &passtime);
+		simdtime += passtime;
+
+		for (j = 0; j < numfiles[i]; j++)
+		{
+			if (scalarhash[i][j] == simdhash[i][j]) continue;
+
+			ri.Con_Printf (PRINT_ALL, "%s : output differs from scalar\n", lists[i][j]);
+			mismatches++;
+		}
+	}
+
+	ri.Con_Printf (PRINT_ALL, "%i images : %.1f ms scalar, %.1f ms %s (%.2fx), %i mismatches\n",
+		count, scalartime, simdtime, image_kernels.name, (simdtime > 0) ? scalartime / simdtime : 0, mismatches);
+
+	for (i = 0; i < 3; i++)
+	{
+		HeapFree (hRefHeap, 0, scalarhash[i]);
+		HeapFree (hRefHeap, 0, simdhash[i]);
+		ri.FS_FreeFileList (lists[i]);
+	}
+}
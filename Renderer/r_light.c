@@ -265,6 +265,7 @@ static int lm_allocated[LIGHTMAP_SIZE];
 static texture_t d3d_Lightmaps[3];
 
 static lighttexel_t **lm_data[3];
+static int lm_loadmark = 0;
 
 static ID3D11Buffer *d3d_DLightConstants = NULL;
 
@@ -324,14 +325,12 @@ void R_BuildLightMap (msurface_t *surf, int ch, int smax, int tmax)
 	if (!lm_data[ch])
 	{
 		lm_data[ch] = (lighttexel_t **) ri.Load_AllocMemory (MAX_LIGHTMAPS * sizeof (lm_data[ch]));
-		memset (lm_data[ch], 0, MAX_LIGHTMAPS * sizeof (lm_data[ch]));
 	}
 
 	// create the texture if needed first time it's seen
 	if (!lm_data[ch][surf->lightmaptexturenum])
 	{
 		lm_data[ch][surf->lightmaptexturenum] = (lighttexel_t *) ri.Load_AllocMemory (LIGHTMAP_SIZE * LIGHTMAP_SIZE * sizeof (lighttexel_t));
-		memset (lm_data[ch][surf->lightmaptexturenum], 0, LIGHTMAP_SIZE * LIGHTMAP_SIZE * sizeof (lighttexel_t));
 	}
 
 	if (surf->samples)
@@ -437,6 +436,9 @@ void R_BeginBuildingLightmaps (model_t *m)
 	// begin with no lightmaps
 	r_currentlightmap = 0;
 
+	// lightmap data is built up in load memory over the whole map load
+	lm_loadmark = ri.Load_GetMark ();
+
 	// fixme - this is an awful place to have this; how about EndRegistration or something like that instead???
 	r_framecount = 1;
 }
@@ -480,7 +482,7 @@ void R_EndBuildingLightmaps (void)
 	memset (lm_allocated, 0, sizeof (lm_allocated));
 
 	// hand back memory
-	ri.Load_FreeMemory ();
+	ri.Load_FreeToMark (lm_loadmark);
 }
 
 
@@ -58,7 +58,8 @@ extern QMATRIX	r_view_matrix;
 extern QMATRIX	r_proj_matrix;
 extern QMATRIX	r_gun_matrix;
 extern QMATRIX	r_mvp_matrix;
-extern QMATRIX	r_local_matrix[MAX_ENTITIES];
+extern QMATRIX	*r_local_matrix;
+void R_ShutdownLocalMatrix (void);
 
 void R_PrepareAliasModel (entity_t *e, QMATRIX *localmatrix);
 void R_PrepareBrushModel (entity_t *e, QMATRIX *localmatrix);
@@ -422,6 +423,23 @@ void D_BindIndexBuffer (ID3D11Buffer *Buffer, DXGI_FORMAT Format);
 // textures marked disposable may be flushed on map changes
 #define TEX_DISPOSABLE		(1 << 30)
 
+int R_BuildMipChain (D3D11_SUBRESOURCE_DATA *srd, int width, int height);
+HRESULT R_TryCreateTexture32 (image_t *image, unsigned *data);
+unsigned *R_PrepareImageData (image_t *image, byte *pic, imagetype_t type, int bits, unsigned *palette);
+image_t *GL_FindFreeImage (char *name, int width, int height, imagetype_t type);
+void R_WalColor (float *color, byte *texels, int width, int height);
+
+extern image_t gltextures[MAX_GLTEXTURES];
+
+// texture streaming
+extern cvar_t *r_texturestream;
+
+void R_InitTextureStream (void);
+void R_ShutdownTextureStream (void);
+void R_DrainTextureStream (void);
+image_t *R_StreamImage (char *name, imagetype_t type, int texinfoflags);
+void R_FinishStreamedImage (image_t *image);
+void R_PumpTextureStream (void);
 void R_BindTexture (ID3D11ShaderResourceView *SRV);
 void R_BindTexArray (ID3D11ShaderResourceView *SRV);
 image_t *R_LoadTexArray (char *base);
@@ -443,6 +461,8 @@ typedef struct _TargaHeader
 
 byte *Image_LoadTGA (char *name, int *width, int *height);
 void LoadPCX (char *filename, byte **pic, byte **palette, int *width, int *height);
+byte *Image_DecodeTGA (byte *buffer, int *width, int *height);
+qboolean Image_DecodePCX (byte *raw, int len, byte **pic, byte **palette, int *width, int *height);
 
 unsigned *Image_ResampleToSize (unsigned *in, int inwidth, int inheight, int outwidth, int outheight);
 unsigned *Image_MipReduceLinearFilter (unsigned *in, int inwidth, int inheight);
@@ -456,6 +476,41 @@ void Image_QuakePalFromPCXPal (unsigned *qpal, const byte *pcxpal, int flags);
 byte *Image_Upscale8 (byte *in, int inwidth, int inheight);
 unsigned *Image_Upscale32 (unsigned *in, int inwidth, int inheight);
 
+// kernels for the image pipeline; the scalar versions in r_image.c are the reference and the SSE2/AVX2 versions in
+// r_imgsimd.c are selected at runtime by R_InitImageKernels depending on what the CPU supports and r_simd
+typedef struct imagekernels_s {
+	char *name;
+	void (*Image8To32) (unsigned *trans, byte *data, int width, int height, unsigned *palette);
+	void (*Upscale8) (byte *out, byte *in, int inwidth, int inheight);
+	void (*Upscale32) (unsigned *out, unsigned *in, int inwidth, int inheight);
+	void (*ResampleRow) (unsigned *outrow, unsigned *inrow0, unsigned *inrow1, unsigned *p1, unsigned *p2, int outwidth);
+	void (*MipReduceBoxRow) (byte *out, byte *in, int stride, int outwidth);
+} imagekernels_t;
+
+extern imagekernels_t image_kernels;
+extern int image_mipgammatable[256];
+extern byte image_mipinversegamma[65536 + 4];
+
+extern cvar_t *r_simd;
+
+#define SIMD_NONE	0
+#define SIMD_SSE2	1
+#define SIMD_AVX2	2
+
+int R_GetCPUSIMDLevel (void);
+void R_InitImageKernels (void);
+void R_ImageBench_f (void);
+
+int AverageMip (int _1, int _2, int _3, int _4);
+int AverageMipGC (int _1, int _2, int _3, int _4);
+
+void Image_8To32Pixel (unsigned *trans, byte *data, int i, int width, int s, unsigned *palette);
+void Image_8To32_Scalar (unsigned *trans, byte *data, int width, int height, unsigned *palette);
+void Image_Upscale8_Scalar (byte *out, byte *in, int inwidth, int inheight);
+void Image_Upscale32_Scalar (unsigned *out, unsigned *in, int inwidth, int inheight);
+void Image_ResampleRow_Scalar (unsigned *outrow, unsigned *inrow0, unsigned *inrow1, unsigned *p1, unsigned *p2, int outwidth);
+void Image_MipReduceBoxRow_Scalar (byte *out, byte *in, int stride, int outwidth);
+
 // helpers/etc
 void Image_CollapseRowPitch (unsigned *data, int width, int height, int pitch);
 void Image_Compress32To24 (byte *data, int width, int height);
@@ -467,6 +522,7 @@ byte Image_GammaVal8to8 (byte val, float gamma);
 unsigned short Image_GammaVal8to16 (byte val, float gamma);
 byte Image_GammaVal16to8 (unsigned short val, float gamma);
 unsigned short Image_GammaVal16to16 (unsigned short val, float gamma);
+void Image_BuildInverseGammaTable (byte *table, float gamma);
 void Image_ApplyTranslationRGB (byte *rgb, int size, byte *table);
 
 
@@ -121,7 +121,11 @@ QMATRIX	r_view_matrix;
 QMATRIX	r_proj_matrix;
 QMATRIX	r_gun_matrix;
 QMATRIX	r_mvp_matrix;
-QMATRIX r_local_matrix[MAX_ENTITIES];
+QMATRIX *r_local_matrix = NULL;
+
+// the client's entity limit is a cvar so this grows to fit the scene
+static int r_max_local_matrix = 0;
+static void *r_local_matrix_base = NULL;
 
 // view origin
 vec3_t	vup;
@@ -671,6 +675,46 @@ void R_RenderScene (void)
 }
 
 
+static void R_GrowLocalMatrix (int numentities)
+{
+	int newmax;
+
+	if (numentities <= r_max_local_matrix && r_local_matrix)
+		return;
+
+	newmax = r_max_local_matrix ? r_max_local_matrix : MAX_ENTITIES;
+
+	while (newmax < numentities)
+		newmax *= 2;
+
+	if (r_local_matrix_base)
+		HeapFree (hRefHeap, 0, r_local_matrix_base);
+
+	// 32-bit heaps only guarantee 8 byte alignment
+	r_local_matrix_base = HeapAlloc (hRefHeap, HEAP_ZERO_MEMORY, newmax * sizeof (QMATRIX) + 15);
+	r_local_matrix = (QMATRIX *) (((intptr_t) r_local_matrix_base + 15) & ~(intptr_t) 15);
+	r_max_local_matrix = newmax;
+}
+
+
+/*
+====================
+R_ShutdownLocalMatrix
+
+the heap goes away with the refresh, so this must be called before it does
+====================
+*/
+void R_ShutdownLocalMatrix (void)
+{
+	if (r_local_matrix_base && hRefHeap)
+		HeapFree (hRefHeap, 0, r_local_matrix_base);
+
+	r_local_matrix = NULL;
+	r_local_matrix_base = NULL;
+	r_max_local_matrix = 0;
+}
+
+
 /*
 ====================
 R_RenderFrame
@@ -681,9 +725,14 @@ void R_RenderFrame (refdef_t *fd)
 {
 	r_newrefdef = *fd;
 
+	R_GrowLocalMatrix (r_newrefdef.num_entities);
+
 	if (!r_worldmodel && !(r_newrefdef.rdflags & RDF_NOWORLDMODEL))
 		ri.Sys_Error (ERR_DROP, "R_RenderFrame: NULL worldmodel");
 
+	// pick up any textures that finished streaming since the last frame
+	R_PumpTextureStream ();
+
 	R_BindLightmaps ();
 
 	if (gl_finish->value)
@@ -54,6 +54,9 @@ __declspec(align(16)) typedef struct meshconstants_s {
 
 static aliasbuffers_t d3d_AliasBuffers[MAX_MOD_KNOWN];
 
+static int d3d_AliasIndexData[NAMEINDEX_STORAGE (MAX_MOD_KNOWN)];
+static nameindex_t d3d_AliasIndex = {MAX_MOD_KNOWN, d3d_AliasIndexData};
+
 static int d3d_MeshLightmapShader;
 static int d3d_MeshDynamicShader;
 static int d3d_MeshPowersuitShader;
@@ -105,6 +108,8 @@ void R_ShutdownMesh (void)
 
 		memset (set, 0, sizeof (aliasbuffers_t));
 	}
+
+	NameIndex_Clear (&d3d_AliasIndex);
 }
 
 
@@ -122,6 +127,7 @@ void R_FreeUnusedAliasBuffers (void)
 			SAFE_RELEASE (set->TexCoords);
 			SAFE_RELEASE (set->Indexes);
 
+			NameIndex_Free (&d3d_AliasIndex, i);
 			memset (set, 0, sizeof (aliasbuffers_t));
 		}
 	}
@@ -223,6 +229,7 @@ void D_CreateAliasBufferSet (model_t *mod, mmdl_t *hdr, dmdl_t *src)
 
 	int i, j;
 
+	int mark = ri.Load_GetMark ();
 	aliasmesh_t *dedupe = (aliasmesh_t *) ri.Load_AllocMemory (hdr->num_verts * sizeof (aliasmesh_t));
 	unsigned short *indexes = (unsigned short *) ri.Load_AllocMemory (hdr->num_indexes * sizeof (unsigned short));
 	unsigned short *optimized = (unsigned short *) ri.Load_AllocMemory (hdr->num_indexes * sizeof (unsigned short));
@@ -318,7 +325,7 @@ void D_CreateAliasBufferSet (model_t *mod, mmdl_t *hdr, dmdl_t *src)
 	D_CreateAliasIndexes (hdr, set, optimized);
 
 	// release memory used for loading and building
-	ri.Load_FreeMemory ();
+	ri.Load_FreeToMark (mark);
 }
 
 
@@ -327,7 +334,7 @@ int D_FindAliasBuffers (model_t *mod)
 	int i;
 
 	// see do we already have it
-	for (i = 0; i < MAX_MOD_KNOWN; i++)
+	for (i = NameIndex_Find (&d3d_AliasIndex, mod->name); i != -1; i = NameIndex_FindNext (&d3d_AliasIndex, i))
 	{
 		aliasbuffers_t *set = &d3d_AliasBuffers[i];
 
@@ -364,15 +371,10 @@ void D_MakeAliasBuffers (model_t *mod, dmdl_t *src)
 	if ((mod->bufferset = D_FindAliasBuffers (mod)) != -1) return;
 
 	// find the first free buffer
-	for (i = 0; i < MAX_MOD_KNOWN; i++)
+	if ((i = NameIndex_Alloc (&d3d_AliasIndex, mod->name)) != -1)
 	{
 		aliasbuffers_t *set = &d3d_AliasBuffers[i];
 
-		// already allocated
-		if (set->PolyVerts) continue;
-		if (set->TexCoords) continue;
-		if (set->Indexes) continue;
-
 		// cache the name so that we'll find it next time too
 		strcpy (set->Name, mod->name);
 
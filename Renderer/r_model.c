@@ -34,6 +34,10 @@ byte	mod_novis[MAX_MAP_LEAFS / 8];
 model_t	mod_known[MAX_MOD_KNOWN];
 int		mod_numknown;
 
+// name lookups and free slots for mod_known
+static int mod_indexdata[NAMEINDEX_STORAGE (MAX_MOD_KNOWN)];
+static nameindex_t mod_index = {MAX_MOD_KNOWN, mod_indexdata};
+
 // the inline * models from the current map are kept seperate
 model_t	mod_inline[MAX_MOD_KNOWN];
 
@@ -201,29 +205,20 @@ model_t *Mod_ForName (char *name, qboolean crash)
 	}
 
 	// search the currently loaded models
-	for (i = 0, mod = mod_known; i < mod_numknown; i++, mod++)
+	for (i = NameIndex_Find (&mod_index, name); i != -1; i = NameIndex_FindNext (&mod_index, i))
 	{
-		if (!mod->name[0])
-			continue;
-		if (!strcmp (mod->name, name))
-			return mod;
+		if (!strcmp (mod_known[i].name, name))
+			return &mod_known[i];
 	}
 
 	// find a free model slot spot
-	for (i = 0, mod = mod_known; i < mod_numknown; i++, mod++)
-	{
-		if (!mod->name[0])
-			break;	// free spot
-	}
+	if ((i = NameIndex_Alloc (&mod_index, name)) == -1)
+		ri.Sys_Error (ERR_DROP, "mod_numknown == MAX_MOD_KNOWN");
 
-	if (i == mod_numknown)
-	{
-		if (mod_numknown == MAX_MOD_KNOWN)
-			ri.Sys_Error (ERR_DROP, "mod_numknown == MAX_MOD_KNOWN");
-
-		mod_numknown++;
-	}
+	if (i >= mod_numknown)
+		mod_numknown = i + 1;
 
+	mod = &mod_known[i];
 	strcpy (mod->name, name);
 
 	// load the file
@@ -234,6 +229,7 @@ model_t *Mod_ForName (char *name, qboolean crash)
 		if (crash)
 			ri.Sys_Error (ERR_DROP, "Mod_ForName: %s not found", mod->name);
 
+		NameIndex_Free (&mod_index, i);
 		memset (mod->name, 0, sizeof (mod->name));
 		return NULL;
 	}
@@ -411,6 +407,7 @@ void R_EndRegistration (void)
 	R_FreeUnusedAliasBuffers ();
 	R_FreeUnusedSpriteBuffers ();
 	R_FreeUnusedImages ();
+	R_PumpTextureStream ();
 }
 
 
@@ -430,6 +427,7 @@ void Mod_Free (model_t *mod)
 		mod->hHeap = NULL;
 	}
 
+	NameIndex_Free (&mod_index, mod - mod_known);
 	memset (mod, 0, sizeof (*mod));
 }
 
@@ -447,6 +445,7 @@ void Mod_FreeAll (void)
 		Mod_Free (&mod_known[i]);
 
 	memset (mod_known, 0, sizeof (mod_known));
+	NameIndex_Clear (&mod_index);
 }
 
 
@@ -61,44 +61,54 @@ void R_InitParticles (void)
 
 void R_DrawParticles (void)
 {
-	D3D11_MAP mode = D3D11_MAP_WRITE_NO_OVERWRITE;
 	D3D11_MAPPED_SUBRESOURCE msr;
+	particle_t *particles = r_newrefdef.particles;
+	int numparticles = r_newrefdef.num_particles;
 
-	if (!r_newrefdef.num_particles)
+	if (!numparticles)
 		return;
 
-	if (r_FirstParticle + r_newrefdef.num_particles >= MAX_GPU_PARTICLES)
-	{
-		r_FirstParticle = 0;
-		mode = D3D11_MAP_WRITE_DISCARD;
-	}
+	// go to points for the geometry shader
+	// (we could alternatively attach an index buffer with indices 0|0|0|1|1|1|2|2|2 etc, and do triangle-to-quad expansion, which would be hellishly cute)
+	d3d_Context->lpVtbl->IASetPrimitiveTopology (d3d_Context, D3D11_PRIMITIVE_TOPOLOGY_POINTLIST);
+
+	// square particles can potentially expose a faster path by not using alpha blending
+	// but we might wish to add particle fade at some time so we can't do it (note: all particles in Q2 have fade)
+	D_SetRenderStates (d3d_BSAlphaPreMult, d3d_DSDepthNoWrite, d3d_RSFullCull);
+	D_BindShaderBundle (d3d_ParticleShader);
+	D_BindVertexBuffer (6, d3d_ParticleVertexes, sizeof (particle_t), 0);
 
-	if (SUCCEEDED (d3d_Context->lpVtbl->Map (d3d_Context, (ID3D11Resource *) d3d_ParticleVertexes, 0, mode, 0, &msr)))
+	// the client's particle limit is a cvar so the scene may hold more than the buffer; draw it in batches
+	while (numparticles > 0)
 	{
-		// copy over the particles and unmap the buffer
-		memcpy ((particle_t *) msr.pData + r_FirstParticle, r_newrefdef.particles, r_newrefdef.num_particles * sizeof (particle_t));
-		d3d_Context->lpVtbl->Unmap (d3d_Context, (ID3D11Resource *) d3d_ParticleVertexes, 0);
+		D3D11_MAP mode = D3D11_MAP_WRITE_NO_OVERWRITE;
+		int batch = (numparticles < MAX_GPU_PARTICLES) ? numparticles : MAX_GPU_PARTICLES;
 
-		// go to points for the geometry shader
-		// (we could alternatively attach an index buffer with indices 0|0|0|1|1|1|2|2|2 etc, and do triangle-to-quad expansion, which would be hellishly cute)
-		d3d_Context->lpVtbl->IASetPrimitiveTopology (d3d_Context, D3D11_PRIMITIVE_TOPOLOGY_POINTLIST);
+		if (r_FirstParticle + batch >= MAX_GPU_PARTICLES)
+		{
+			r_FirstParticle = 0;
+			mode = D3D11_MAP_WRITE_DISCARD;
+		}
 
-		// square particles can potentially expose a faster path by not using alpha blending
-		// but we might wish to add particle fade at some time so we can't do it (note: all particles in Q2 have fade)
-		D_SetRenderStates (d3d_BSAlphaPreMult, d3d_DSDepthNoWrite, d3d_RSFullCull);
-		D_BindShaderBundle (d3d_ParticleShader);
-		D_BindVertexBuffer (6, d3d_ParticleVertexes, sizeof (particle_t), 0);
+		if (FAILED (d3d_Context->lpVtbl->Map (d3d_Context, (ID3D11Resource *) d3d_ParticleVertexes, 0, mode, 0, &msr)))
+			break;
 
-		// and draw it
-		d3d_Context->lpVtbl->Draw (d3d_Context, r_newrefdef.num_particles, r_FirstParticle);
+		// copy over the particles and unmap the buffer
+		memcpy ((particle_t *) msr.pData + r_FirstParticle, particles, batch * sizeof (particle_t));
+		d3d_Context->lpVtbl->Unmap (d3d_Context, (ID3D11Resource *) d3d_ParticleVertexes, 0);
 
-		// back to triangles
-		d3d_Context->lpVtbl->IASetPrimitiveTopology (d3d_Context, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		// and draw it
+		d3d_Context->lpVtbl->Draw (d3d_Context, batch, r_FirstParticle);
 
 		// and go to the next particle batch
-		r_FirstParticle += r_newrefdef.num_particles;
+		r_FirstParticle += batch;
+		particles += batch;
+		numparticles -= batch;
 	}
 
+	// back to triangles
+	d3d_Context->lpVtbl->IASetPrimitiveTopology (d3d_Context, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
 	r_newrefdef.num_particles = 0;
 }
 
@@ -85,6 +85,7 @@ void R_DrawSkyChain (msurface_t *surf)
 void R_SetSky (char *name, float rotate, vec3_t axis)
 {
 	int		i;
+	int		mark = ri.Load_GetMark ();
 
 	byte	*sky_pic[6];
 	int		sky_width[6];
@@ -121,7 +122,11 @@ void R_SetSky (char *name, float rotate, vec3_t axis)
 	}
 
 	// only proceed if we got something
-	if (max_size < 1) return;
+	if (max_size < 1)
+	{
+		ri.Load_FreeToMark (mark);
+		return;
+	}
 
 	// now set up the skybox faces for the cubemap
 	for (i = 0; i < 6; i++)
@@ -136,7 +141,6 @@ void R_SetSky (char *name, float rotate, vec3_t axis)
 			{
 				// case where a sky face may be omitted due to some misguided attempt to "save memory"
 				sky_pic[i] = (byte *) ri.Load_AllocMemory (max_size * max_size * 4);
-				memset (sky_pic[i], 0, max_size * max_size * 4);
 			}
 
 			// and set the new data
@@ -154,6 +158,6 @@ void R_SetSky (char *name, float rotate, vec3_t axis)
 	R_CreateTexture (&r_SkyCubemap, srd, max_size, max_size, 1, TEX_RGBA8 | TEX_CUBEMAP);
 
 	// throw away memory used for loading
-	ri.Load_FreeMemory ();
+	ri.Load_FreeToMark (mark);
 }
 
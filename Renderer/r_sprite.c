@@ -33,6 +33,9 @@ typedef struct spritebuffers_s {
 
 static spritebuffers_t d3d_SpriteBuffers[MAX_MOD_KNOWN];
 
+static int d3d_SpriteIndexData[NAMEINDEX_STORAGE (MAX_MOD_KNOWN)];
+static nameindex_t d3d_SpriteIndex = {MAX_MOD_KNOWN, d3d_SpriteIndexData};
+
 
 void R_FreeUnusedSpriteBuffers (void)
 {
@@ -45,6 +48,7 @@ void R_FreeUnusedSpriteBuffers (void)
 		if (set->registration_sequence != r_registration_sequence)
 		{
 			SAFE_RELEASE (set->PolyVerts);
+			NameIndex_Free (&d3d_SpriteIndex, i);
 			memset (set, 0, sizeof (spritebuffers_t));
 		}
 	}
@@ -55,6 +59,7 @@ static void D_CreateSpriteBufferSet (model_t *mod, dsprite_t *psprite)
 {
 	int i;
 	spritebuffers_t *set = &d3d_SpriteBuffers[mod->bufferset];
+	int mark = ri.Load_GetMark ();
 	spritepolyvert_t *verts = (spritepolyvert_t *) ri.Load_AllocMemory (sizeof (spritepolyvert_t) * 4 * psprite->numframes);
 
 	D3D11_BUFFER_DESC vbDesc = {
@@ -89,7 +94,7 @@ static void D_CreateSpriteBufferSet (model_t *mod, dsprite_t *psprite)
 
 	// create the new vertex buffer
 	d3d_Device->lpVtbl->CreateBuffer (d3d_Device, &vbDesc, &srd, &set->PolyVerts);
-	ri.Load_FreeMemory ();
+	ri.Load_FreeToMark (mark);
 }
 
 
@@ -98,7 +103,7 @@ int D_FindSpriteBuffers (model_t *mod)
 	int i;
 
 	// see do we already have it
-	for (i = 0; i < MAX_MOD_KNOWN; i++)
+	for (i = NameIndex_Find (&d3d_SpriteIndex, mod->name); i != -1; i = NameIndex_FindNext (&d3d_SpriteIndex, i))
 	{
 		spritebuffers_t *set = &d3d_SpriteBuffers[i];
 
@@ -124,13 +129,10 @@ void D_MakeSpriteBuffers (model_t *mod)
 	if ((mod->bufferset = D_FindSpriteBuffers (mod)) != -1) return;
 
 	// find the first free buffer
-	for (i = 0; i < MAX_MOD_KNOWN; i++)
+	if ((i = NameIndex_Alloc (&d3d_SpriteIndex, mod->name)) != -1)
 	{
 		spritebuffers_t *set = &d3d_SpriteBuffers[i];
 
-		// already allocated
-		if (set->PolyVerts) continue;
-
 		// cache the name so that we'll find it next time too
 		strcpy (set->Name, mod->name);
 
@@ -186,6 +188,8 @@ void R_ShutdownSprites (void)
 		SAFE_RELEASE (set->PolyVerts);
 		memset (set, 0, sizeof (spritebuffers_t));
 	}
+
+	NameIndex_Clear (&d3d_SpriteIndex);
 }
 
 
@@ -0,0 +1,512 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#include "r_local.h"
+
+
+/*
+====================================================================
+
+TEXTURE STREAMING
+
+Wall textures, skins and sprites are decoded and created on a small pool of worker threads so that map loads
+don't stall on them.  The main thread still reads the file (the filesystem isn't thread-safe) and parses just
+enough of the header to know the size, which is needed right away for texcoord calculation; the image then uses
+r_notexture until the worker is done and R_PumpTextureStream swaps in the real texture.
+
+The device is created without D3D11_CREATE_DEVICE_SINGLETHREADED so CreateTexture2D may be called from the
+workers; nothing is ever done with the immediate context off the main thread.
+
+Load memory belongs to the calling thread so each worker decodes into its own arena, and nothing called on a
+worker may print or error.
+
+====================================================================
+*/
+
+#define MAX_TEXSTREAM_THREADS	4
+
+typedef enum _texformat_t {
+	texfmt_wal,
+	texfmt_pcx,
+	texfmt_tga
+} texformat_t;
+
+#define TEXJOB_QUEUED	0
+#define TEXJOB_RUNNING	1
+#define TEXJOB_DONE		2
+
+typedef struct texjob_s {
+	image_t		*image;			// image that the texture will be installed into
+	image_t		scratch;		// the worker creates the texture on this
+	imagetype_t	type;
+	texformat_t	format;
+	unsigned	*palette;		// wal only; pcx palettes come from the file
+
+	byte		*raw;			// file data, freed by the main thread when the job is retired
+	int			rawlen;
+
+	volatile LONG	state;
+	struct texjob_s	*next;
+} texjob_t;
+
+cvar_t *r_texturestream;
+
+// pending jobs are indexed by image number so that any image can be finished on demand
+static texjob_t *r_texjobs[MAX_GLTEXTURES];
+static int r_numtexjobs = 0;
+
+static texjob_t *r_texqueuehead = NULL;
+static texjob_t *r_texqueuetail = NULL;
+
+static CRITICAL_SECTION r_texqueuelock;
+static HANDLE r_texqueuesema = NULL;
+static HANDLE r_texthreads[MAX_TEXSTREAM_THREADS];
+static int r_numtexthreads = 0;
+static volatile LONG r_texthreadquit = 0;
+
+
+/*
+================
+R_RunTextureJob
+
+Decodes the file and creates the texture; this may run on a worker or on the main thread if the job was claimed
+by R_FinishStreamedImage before a worker got to it
+================
+*/
+static void R_RunTextureJob (texjob_t *job)
+{
+	image_t *scratch = &job->scratch;
+	int mark = ri.Load_GetMark ();
+	byte *pic = NULL;
+	byte *pcxpal = NULL;
+	unsigned table[256];
+	unsigned *palette = NULL;
+	int bits = 8;
+	int width = 0, height = 0;
+
+	switch (job->format)
+	{
+	case texfmt_wal:
+		pic = job->raw + LittleLong (((miptex_t *) job->raw)->offsets[0]);
+		width = scratch->width;
+		height = scratch->height;
+		palette = job->palette;
+		break;
+
+	case texfmt_pcx:
+		if (Image_DecodePCX (job->raw, job->rawlen, &pic, &pcxpal, &width, &height))
+		{
+			// skins use the solid palette; everything else has alpha
+			if (job->type == it_skin)
+				Image_QuakePalFromPCXPal (table, pcxpal, TEX_RGBA8);
+			else Image_QuakePalFromPCXPal (table, pcxpal, TEX_ALPHA);
+
+			palette = table;
+		}
+		break;
+
+	case texfmt_tga:
+		pic = Image_DecodeTGA (job->raw, &width, &height);
+		bits = 32;
+		break;
+	}
+
+	// the header was already parsed for the size so anything that decodes differently is bad data
+	if (pic && width == scratch->width && height == scratch->height)
+	{
+		// on failure the scratch texture is left NULL and R_RetireTextureJob keeps the placeholder
+		R_TryCreateTexture32 (scratch, R_PrepareImageData (scratch, pic, job->type, bits, palette));
+	}
+
+	ri.Load_FreeToMark (mark);
+
+	InterlockedExchange (&job->state, TEXJOB_DONE);
+}
+
+
+static DWORD WINAPI R_TextureStreamThread (LPVOID param)
+{
+	for (;;)
+	{
+		texjob_t *job;
+
+		WaitForSingleObject (r_texqueuesema, INFINITE);
+
+		if (r_texthreadquit)
+			break;
+
+		EnterCriticalSection (&r_texqueuelock);
+
+		// the queue may be empty if the main thread claimed a job itself
+		if ((job = r_texqueuehead) != NULL)
+		{
+			if ((r_texqueuehead = job->next) == NULL)
+				r_texqueuetail = NULL;
+
+			job->next = NULL;
+			job->state = TEXJOB_RUNNING;
+		}
+
+		LeaveCriticalSection (&r_texqueuelock);
+
+		if (job)
+			R_RunTextureJob (job);
+	}
+
+	ri.Load_ShutdownThread ();
+
+	return 0;
+}
+
+
+/*
+================
+R_RetireTextureJob
+
+Installs the finished texture into its image and releases the placeholder; main thread only
+================
+*/
+static void R_RetireTextureJob (texjob_t *job)
+{
+	image_t *image = job->image;
+
+	if (job->scratch.Texture && job->scratch.SRV)
+	{
+		// drop the references to r_notexture that were taken when the job was queued
+		SAFE_RELEASE (image->Texture);
+		SAFE_RELEASE (image->SRV);
+
+		image->Texture = job->scratch.Texture;
+		image->SRV = job->scratch.SRV;
+	}
+	else ri.Con_Printf (PRINT_DEVELOPER, "R_RetireTextureJob: failed to load %s\n", image->name);
+
+	r_texjobs[image - gltextures] = NULL;
+	r_numtexjobs--;
+
+	ri.FS_FreeFile (job->raw);
+	HeapFree (hRefHeap, 0, job);
+}
+
+
+/*
+================
+R_StreamImageSize
+
+Gets the size from the header and validates just enough of it for the worker to decode safely; returns false
+if the image should go through the normal load path instead, which will report any errors
+================
+*/
+static qboolean R_StreamImageSize (byte *raw, int len, texformat_t format, int *width, int *height)
+{
+	if (format == texfmt_wal)
+	{
+		miptex_t *mt = (miptex_t *) raw;
+
+		if (len < sizeof (miptex_t)) return false;
+
+		*width = LittleLong (mt->width);
+		*height = LittleLong (mt->height);
+
+		if (*width < 1 || *height < 1) return false;
+		if (LittleLong (mt->offsets[0]) < 0 || LittleLong (mt->offsets[0]) + *width * *height > len) return false;
+	}
+	else if (format == texfmt_pcx)
+	{
+		pcx_t *pcx = (pcx_t *) raw;
+
+		if (len < sizeof (pcx_t)) return false;
+		if (pcx->manufacturer != 0x0a || pcx->version != 5 || pcx->encoding != 1 || pcx->bits_per_pixel != 8) return false;
+
+		*width = LittleShort (pcx->xmax) + 1;
+		*height = LittleShort (pcx->ymax) + 1;
+
+		if (*width < 1 || *height < 1) return false;
+	}
+	else
+	{
+		TargaHeader *targa_header = (TargaHeader *) raw;
+
+		if (len < sizeof (TargaHeader)) return false;
+		if (targa_header->image_type != 2 && targa_header->image_type != 10) return false;
+		if (targa_header->colormap_type != 0 || (targa_header->pixel_size != 32 && targa_header->pixel_size != 24)) return false;
+
+		*width = LittleShort (targa_header->width);
+		*height = LittleShort (targa_header->height);
+
+		if (*width < 1 || *height < 1) return false;
+	}
+
+	return true;
+}
+
+
+/*
+================
+R_StreamImage
+
+Queues an image for loading on the workers and returns it with a placeholder texture, or returns NULL if the
+image should be loaded synchronously
+================
+*/
+image_t *R_StreamImage (char *name, imagetype_t type, int texinfoflags)
+{
+	int len = strlen (name);
+	int rawlen, width, height;
+	texformat_t format;
+	texjob_t *job;
+	image_t *image;
+	byte *raw;
+
+	if (!r_numtexthreads) return NULL;
+	if (!r_texturestream || !r_texturestream->value) return NULL;
+	if (!r_notexture || !r_notexture->Texture || !r_notexture->SRV) return NULL;
+	if (len < 5) return NULL;
+
+	if (!strcmp (name + len - 4, ".wal"))
+		format = texfmt_wal;
+	else if (!strcmp (name + len - 4, ".pcx"))
+		format = texfmt_pcx;
+	else if (!strcmp (name + len - 4, ".tga"))
+		format = texfmt_tga;
+	else return NULL;
+
+	// load the file here because the filesystem isn't thread-safe
+	if ((rawlen = ri.FS_LoadFile (name, (void **) &raw)) < 1 || !raw)
+		return NULL;
+
+	if (!R_StreamImageSize (raw, rawlen, format, &width, &height))
+	{
+		ri.FS_FreeFile (raw);
+		return NULL;
+	}
+
+	image = GL_FindFreeImage (name, width, height, type);
+	image->texinfoflags = texinfoflags;
+
+	// calculate the colour that was used to generate radiosity for this texture; R_LightPoint can want it
+	// before the texture is ready, and still wants it if the texture can't be created
+	if (format == texfmt_wal)
+		R_WalColor (image->color, raw + LittleLong (((miptex_t *) raw)->offsets[0]), width, height);
+
+	// draw with r_notexture until the real texture is ready; the references are dropped by R_RetireTextureJob
+	image->Texture = r_notexture->Texture;
+	image->SRV = r_notexture->SRV;
+
+	image->Texture->lpVtbl->AddRef (image->Texture);
+	image->SRV->lpVtbl->AddRef (image->SRV);
+
+	// set up the job; the scratch image gets a copy of everything the texture is created from
+	job = (texjob_t *) HeapAlloc (hRefHeap, HEAP_ZERO_MEMORY, sizeof (texjob_t));
+
+	job->image = image;
+	job->scratch = *image;
+	job->scratch.Texture = NULL;
+	job->scratch.SRV = NULL;
+	job->type = type;
+	job->format = format;
+	job->raw = raw;
+	job->rawlen = rawlen;
+	job->state = TEXJOB_QUEUED;
+
+	// choose the correct palette to use (note: using texinfo flags here)
+	if (texinfoflags & SURF_TRANS33)
+		job->palette = d_8to24table_trans33;
+	else if (texinfoflags & SURF_TRANS66)
+		job->palette = d_8to24table_trans66;
+	else job->palette = d_8to24table_solid;
+
+	r_texjobs[image - gltextures] = job;
+	r_numtexjobs++;
+
+	// and hand it off
+	EnterCriticalSection (&r_texqueuelock);
+
+	if (r_texqueuetail)
+		r_texqueuetail->next = job;
+	else r_texqueuehead = job;
+
+	r_texqueuetail = job;
+
+	LeaveCriticalSection (&r_texqueuelock);
+	ReleaseSemaphore (r_texqueuesema, 1, NULL);
+
+	return image;
+}
+
+
+/*
+================
+R_FinishStreamedImage
+
+Makes sure that an image which is still streaming has its real texture; if no worker has picked it up yet it's
+just run here
+================
+*/
+void R_FinishStreamedImage (image_t *image)
+{
+	texjob_t *job = r_texjobs[image - gltextures];
+	qboolean claimed = false;
+
+	if (!job) return;
+
+	EnterCriticalSection (&r_texqueuelock);
+
+	if (job->state == TEXJOB_QUEUED)
+	{
+		texjob_t **link;
+
+		for (link = &r_texqueuehead; *link; link = &(*link)->next)
+		{
+			if (*link != job) continue;
+
+			*link = job->next;
+			break;
+		}
+
+		// rebuild the tail if it was the one removed
+		for (r_texqueuetail = r_texqueuehead; r_texqueuetail && r_texqueuetail->next; r_texqueuetail = r_texqueuetail->next);
+
+		job->next = NULL;
+		job->state = TEXJOB_RUNNING;
+		claimed = true;
+	}
+
+	LeaveCriticalSection (&r_texqueuelock);
+
+	if (claimed)
+		R_RunTextureJob (job);
+	else
+	{
+		// a worker has it so wait for it
+		while (job->state != TEXJOB_DONE)
+			Sleep (0);
+	}
+
+	R_RetireTextureJob (job);
+}
+
+
+/*
+================
+R_PumpTextureStream
+
+Installs any textures that the workers have finished; called once per frame and at the end of registration
+================
+*/
+void R_PumpTextureStream (void)
+{
+	int i;
+
+	for (i = 0; i < MAX_GLTEXTURES && r_numtexjobs > 0; i++)
+	{
+		if (!r_texjobs[i]) continue;
+		if (r_texjobs[i]->state != TEXJOB_DONE) continue;
+
+		R_RetireTextureJob (r_texjobs[i]);
+	}
+}
+
+
+void R_InitTextureStream (void)
+{
+	SYSTEM_INFO si;
+	int i;
+
+	if (r_numtexthreads) return;
+
+	// leave a core for the main thread; more than a few threads just contend for the device
+	GetSystemInfo (&si);
+
+	if ((r_numtexthreads = (int) si.dwNumberOfProcessors - 1) > MAX_TEXSTREAM_THREADS)
+		r_numtexthreads = MAX_TEXSTREAM_THREADS;
+	else if (r_numtexthreads < 1)
+		r_numtexthreads = 1;
+
+	InitializeCriticalSection (&r_texqueuelock);
+	r_texqueuesema = CreateSemaphore (NULL, 0, 0x7fffffff, NULL);
+	r_texthreadquit = 0;
+
+	for (i = 0; i < r_numtexthreads; i++)
+	{
+		if ((r_texthreads[i] = CreateThread (NULL, 0, R_TextureStreamThread, NULL, 0, NULL)) == NULL)
+			break;
+	}
+
+	// if no threads could be created everything just loads synchronously
+	if ((r_numtexthreads = i) == 0)
+	{
+		CloseHandle (r_texqueuesema);
+		r_texqueuesema = NULL;
+		DeleteCriticalSection (&r_texqueuelock);
+	}
+
+	ri.Con_Printf (PRINT_DEVELOPER, "Texture streaming with %i threads\n", r_numtexthreads);
+}
+
+
+/*
+================
+R_DrainTextureStream
+
+Finishes and retires everything that's still outstanding, so that nothing the workers read is in use; anything
+that changes the image kernels or their tables must call this first
+================
+*/
+void R_DrainTextureStream (void)
+{
+	int i;
+
+	if (!r_numtexthreads) return;
+
+	for (i = 0; i < MAX_GLTEXTURES && r_numtexjobs > 0; i++)
+	{
+		if (r_texjobs[i])
+			R_FinishStreamedImage (&gltextures[i]);
+	}
+}
+
+
+void R_ShutdownTextureStream (void)
+{
+	int i;
+
+	if (!r_numtexthreads) return;
+
+	R_DrainTextureStream ();
+
+	// and bring down the threads
+	InterlockedExchange (&r_texthreadquit, 1);
+	ReleaseSemaphore (r_texqueuesema, r_numtexthreads, NULL);
+	WaitForMultipleObjects (r_numtexthreads, r_texthreads, TRUE, INFINITE);
+
+	for (i = 0; i < r_numtexthreads; i++)
+	{
+		CloseHandle (r_texthreads[i]);
+		r_texthreads[i] = NULL;
+	}
+
+	CloseHandle (r_texqueuesema);
+	r_texqueuesema = NULL;
+	DeleteCriticalSection (&r_texqueuelock);
+
+	r_numtexthreads = 0;
+}
+
@@ -23,6 +23,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 image_t		gltextures[MAX_GLTEXTURES];
 
+// name lookups and free slots for gltextures
+static int r_imageindexdata[NAMEINDEX_STORAGE (MAX_GLTEXTURES)];
+static nameindex_t r_imageindex = {MAX_GLTEXTURES, r_imageindexdata};
+
 unsigned	d_8to24table_solid[256];
 unsigned	d_8to24table_alpha[256];
 unsigned	d_8to24table_trans33[256];
@@ -77,9 +81,48 @@ void R_DescribeTexture (D3D11_TEXTURE2D_DESC *Desc, int width, int height, int a
 }
 
 
-void R_CreateTexture32 (image_t *image, unsigned *data)
+/*
+================
+R_BuildMipChain
+
+Fills in srd[1..n] with successively reduced miplevels of the data already in srd[0]; returns the total number of levels
+================
+*/
+int R_BuildMipChain (D3D11_SUBRESOURCE_DATA *srd, int width, int height)
+{
+	unsigned *data = (unsigned *) srd[0].pSysMem;
+	int mipnum;
+
+	for (mipnum = 1; width > 1 || height > 1; mipnum++)
+	{
+		// choose the appropriate filter
+		if ((width & 1) || (height & 1))
+			data = Image_MipReduceLinearFilter (data, width, height);
+		else data = Image_MipReduceBoxFilter (data, width, height);
+
+		if ((width = width >> 1) < 1) width = 1;
+		if ((height = height >> 1) < 1) height = 1;
+
+		srd[mipnum].pSysMem = data;
+		srd[mipnum].SysMemPitch = width << 2;
+		srd[mipnum].SysMemSlicePitch = 0;
+	}
+
+	return mipnum;
+}
+
+
+/*
+================
+R_TryCreateTexture32
+
+Creates the texture and SRV for an image without erroring, so that it may also be called from a texture streaming worker
+================
+*/
+HRESULT R_TryCreateTexture32 (image_t *image, unsigned *data)
 {
 	D3D11_TEXTURE2D_DESC Desc;
+	HRESULT hr;
 
 	if (image->flags & TEX_CHARSET)
 	{
@@ -99,52 +142,41 @@ void R_CreateTexture32 (image_t *image, unsigned *data)
 		// describe the texture
 		R_DescribeTexture (&Desc, image->width >> 4, image->height >> 4, 256, image->flags);
 
-		// failure is not an option...
-		if (FAILED (d3d_Device->lpVtbl->CreateTexture2D (d3d_Device, &Desc, srd, &image->Texture))) ri.Sys_Error (ERR_FATAL, "CreateTexture2D failed");
+		if (FAILED (hr = d3d_Device->lpVtbl->CreateTexture2D (d3d_Device, &Desc, srd, &image->Texture))) return hr;
 	}
 	else
 	{
 		// this is good for a 4-billion X 4-billion texture; we assume it will never be needed that large
 		D3D11_SUBRESOURCE_DATA srd[32];
 
-		// copy these off so that they can be changed during miplevel reduction
-		int width = image->width;
-		int height = image->height;
-
 		// the first one just has the data
 		srd[0].pSysMem = data;
-		srd[0].SysMemPitch = width << 2;
+		srd[0].SysMemPitch = image->width << 2;
 		srd[0].SysMemSlicePitch = 0;
 
 		// create further miplevels for the texture type
 		if (image->flags & TEX_MIPMAP)
-		{
-			int mipnum;
-
-			for (mipnum = 1; width > 1 || height > 1; mipnum++)
-			{
-				// choose the appropriate filter
-				if ((width & 1) || (height & 1))
-					data = Image_MipReduceLinearFilter (data, width, height);
-				else data = Image_MipReduceBoxFilter (data, width, height);
-
-				if ((width = width >> 1) < 1) width = 1;
-				if ((height = height >> 1) < 1) height = 1;
-
-				srd[mipnum].pSysMem = data;
-				srd[mipnum].SysMemPitch = width << 2;
-				srd[mipnum].SysMemSlicePitch = 0;
-			}
-		}
+			R_BuildMipChain (srd, image->width, image->height);
 
 		R_DescribeTexture (&Desc, image->width, image->height, 1, image->flags);
 
-		// failure is not an option...
-		if (FAILED (d3d_Device->lpVtbl->CreateTexture2D (d3d_Device, &Desc, srd, &image->Texture))) ri.Sys_Error (ERR_FATAL, "CreateTexture2D failed");
+		if (FAILED (hr = d3d_Device->lpVtbl->CreateTexture2D (d3d_Device, &Desc, srd, &image->Texture))) return hr;
+	}
+
+	if (FAILED (hr = d3d_Device->lpVtbl->CreateShaderResourceView (d3d_Device, (ID3D11Resource *) image->Texture, NULL, &image->SRV)))
+	{
+		SAFE_RELEASE (image->Texture);
+		return hr;
 	}
 
+	return S_OK;
+}
+
+
+void R_CreateTexture32 (image_t *image, unsigned *data)
+{
 	// failure is not an option...
-	if (FAILED (d3d_Device->lpVtbl->CreateShaderResourceView (d3d_Device, (ID3D11Resource *) image->Texture, NULL, &image->SRV))) ri.Sys_Error (ERR_FATAL, "CreateShaderResourceView failed");
+	if (FAILED (R_TryCreateTexture32 (image, data))) ri.Sys_Error (ERR_FATAL, "R_CreateTexture32: failed to create texture for %s", image->name);
 }
 
 
@@ -164,9 +196,10 @@ void R_TexSubImage32 (ID3D11Texture2D *tex, int level, int x, int y, int w, int
 
 void R_TexSubImage8 (ID3D11Texture2D *tex, int level, int x, int y, int w, int h, byte *data, unsigned *palette)
 {
+	int mark = ri.Load_GetMark ();
 	unsigned *trans = GL_Image8To32 (data, w, h, palette);
 	R_TexSubImage32 (tex, level, x, y, w, h, trans);
-	ri.Load_FreeMemory ();
+	ri.Load_FreeToMark (mark);
 }
 
 
@@ -205,23 +238,15 @@ image_t *GL_FindFreeImage (char *name, int width, int height, imagetype_t type)
 	image_t		*image;
 	int			i;
 
-	// find a free image_t
-	for (i = 0, image = gltextures; i < MAX_GLTEXTURES; i++, image++)
-	{
-		if (image->Texture) continue;
-		if (image->SRV) continue;
-
-		break;
-	}
+	if (strlen (name) >= sizeof (image->name))
+		ri.Sys_Error (ERR_DROP, "Draw_LoadPic: \"%s\" is too long", name);
 
-	if (i == MAX_GLTEXTURES)
+	// find a free image_t
+	if ((i = NameIndex_Alloc (&r_imageindex, name)) == -1)
 		ri.Sys_Error (ERR_DROP, "MAX_GLTEXTURES");
 
 	image = &gltextures[i];
 
-	if (strlen (name) >= sizeof (image->name))
-		ri.Sys_Error (ERR_DROP, "Draw_LoadPic: \"%s\" is too long", name);
-
 	strcpy (image->name, name);
 	image->registration_sequence = r_registration_sequence;
 
@@ -246,18 +271,17 @@ image_t *GL_FindFreeImage (char *name, int width, int height, imagetype_t type)
 
 /*
 ================
-GL_LoadPic
+R_PrepareImageData
 
-This is also used as an entry point for the generated r_notexture
+Converts a loaded pic to the 32-bit data that its texture is created from; if the pic was upscaled the image size is
+doubled and TEX_UPSCALE is set, and the caller must bring it back down after creating the texture
 ================
 */
-image_t *GL_LoadPic (char *name, byte *pic, int width, int height, imagetype_t type, int bits, unsigned *palette)
+unsigned *R_PrepareImageData (image_t *image, byte *pic, imagetype_t type, int bits, unsigned *palette)
 {
-	image_t *image = GL_FindFreeImage (name, width, height, type);
-
 	// floodfill 8-bit alias skins (32-bit are assumed to be already filled)
 	if (type == it_skin && bits == 8)
-		R_FloodFillSkin (pic, width, height);
+		R_FloodFillSkin (pic, image->width, image->height);
 
 	// problem - if we use linear filtering, we lose all of the fine pixel art detail in the original 8-bit textures.
 	// if we use nearest filtering we can't do anisotropic and we get noise at minification levels.
@@ -273,9 +297,24 @@ image_t *GL_LoadPic (char *name, byte *pic, int width, int height, imagetype_t t
 
 	// it's 2018 and we have non-power-of-two textures nowadays so don't bother with scraps
 	if (bits == 8)
-		R_CreateTexture8 (image, pic, palette);
-	else
-		R_CreateTexture32 (image, (unsigned *) pic);
+		return GL_Image8To32 (pic, image->width, image->height, palette);
+	else return (unsigned *) pic;
+}
+
+
+/*
+================
+GL_LoadPic
+
+This is also used as an entry point for the generated r_notexture
+================
+*/
+image_t *GL_LoadPic (char *name, byte *pic, int width, int height, imagetype_t type, int bits, unsigned *palette)
+{
+	int mark = ri.Load_GetMark ();
+	image_t *image = GL_FindFreeImage (name, width, height, type);
+
+	R_CreateTexture32 (image, R_PrepareImageData (image, pic, type, bits, palette));
 
 	// if the image was upscaled, bring it back down again so that texcoord calculation will work as expected
 	if (image->flags & TEX_UPSCALE)
@@ -285,7 +324,7 @@ image_t *GL_LoadPic (char *name, byte *pic, int width, int height, imagetype_t t
 	}
 
 	// free memory used for loading the image
-	ri.Load_FreeMemory ();
+	ri.Load_FreeToMark (mark);
 
 	return image;
 }
@@ -297,8 +336,10 @@ image_t *GL_HaveImage (char *name, int flags)
 	image_t	*image;
 
 	// look for it
-	for (i = 0, image = gltextures; i < MAX_GLTEXTURES; i++, image++)
+	for (i = NameIndex_Find (&r_imageindex, name); i != -1; i = NameIndex_FindNext (&r_imageindex, i))
 	{
+		image = &gltextures[i];
+
 		// not a valid image
 		if (!image->Texture) continue;
 		if (!image->SRV) continue;
@@ -334,6 +375,44 @@ float ColorNormalize (vec3_t out, vec3_t in)
 }
 
 
+/*
+================
+R_WalColor
+
+Calculates the colour that was used to generate radiosity for a wall texture
+https://github.com/id-Software/Quake-2-Tools/blob/master/bsp/qrad3/patches.c#L88
+this is used for R_LightPoint tracing that hits sky and may also be used for contents colours in the future
+================
+*/
+void R_WalColor (float *color, byte *texels, int width, int height)
+{
+	int i;
+	float scale;
+
+	Vector3Set (color, 0, 0, 0);
+
+	// accumulate the colours
+	for (i = 0; i < width * height; i++)
+	{
+		color[0] += ((byte *) &d_8to24table_solid[texels[i]])[0];
+		color[1] += ((byte *) &d_8to24table_solid[texels[i]])[1];
+		color[2] += ((byte *) &d_8to24table_solid[texels[i]])[2];
+	}
+
+	// average them out and bring to 0..1 scale
+	color[0] = color[0] / (width * height) / 255.0f;
+	color[1] = color[1] / (width * height) / 255.0f;
+	color[2] = color[2] / (width * height) / 255.0f;
+
+	// scale the reflectivity up, because the textures are so dim
+	scale = ColorNormalize (color, color);
+
+	// ??? can this even happen ???
+	if (scale < 0.5)
+		Vector3Scalef (color, color, scale * 2);
+}
+
+
 /*
 ================
 GL_LoadWal
@@ -342,15 +421,18 @@ GL_LoadWal
 image_t *GL_LoadWal (char *name, int flags)
 {
 	miptex_t	*mt;
-	int			i, width, height;
+	int			width, height;
 	image_t		*image;
 	byte		*texels;
-	float		scale;
 
 	// look for it
 	if ((image = GL_HaveImage (name, flags)) != NULL)
 		return image;
 
+	// hand it off to the streaming workers if we can
+	if ((image = R_StreamImage (name, it_wall, flags)) != NULL)
+		return image;
+
 	// load the pic from disk
 	ri.FS_LoadFile (name, (void **) &mt);
 
@@ -372,33 +454,10 @@ image_t *GL_LoadWal (char *name, int flags)
 	else image = GL_LoadPic (name, texels, width, height, it_wall, 8, d_8to24table_solid);
 
 	// calculate the colour that was used to generate radiosity for this texture
-	// https://github.com/id-Software/Quake-2-Tools/blob/master/bsp/qrad3/patches.c#L88
-	// this is used for R_LightPoint tracing that hits sky and may also be used for contents colours in the future
-	Vector3Set (image->color, 0, 0, 0);
-
-	// accumulate the colours
-	for (i = 0; i < width * height; i++)
-	{
-		image->color[0] += ((byte *) &d_8to24table_solid[texels[i]])[0];
-		image->color[1] += ((byte *) &d_8to24table_solid[texels[i]])[1];
-		image->color[2] += ((byte *) &d_8to24table_solid[texels[i]])[2];
-	}
-
-	// average them out and bring to 0..1 scale
-	image->color[0] = image->color[0] / (width * height) / 255.0f;
-	image->color[1] = image->color[1] / (width * height) / 255.0f;
-	image->color[2] = image->color[2] / (width * height) / 255.0f;
-
-	// scale the reflectivity up, because the textures are so dim
-	scale = ColorNormalize (image->color, image->color);
-
-	// ??? can this even happen ???
-	if (scale < 0.5)
-		Vector3Scalef (image->color, image->color, scale * 2);
+	R_WalColor (image->color, texels, width, height);
 
 	// free any memory used for loading
 	ri.FS_FreeFile ((void *) mt);
-	ri.Load_FreeMemory ();
 
 	// store out the flags used for matching
 	image->texinfoflags = flags;
@@ -420,6 +479,7 @@ image_t *GL_FindImage (char *name, imagetype_t type)
 	int		len;
 	byte	*pic, *palette;
 	int		width, height;
+	int		mark;
 
 	// validate the name
 	if (!name) return NULL;
@@ -429,9 +489,14 @@ image_t *GL_FindImage (char *name, imagetype_t type)
 	if ((image = GL_HaveImage (name, 0)) != NULL)
 		return image;
 
+	// skins and sprites may be handed off to the streaming workers; pics are needed immediately so are always loaded here
+	if ((type == it_skin || type == it_sprite) && (image = R_StreamImage (name, type, 0)) != NULL)
+		return image;
+
 	// load the pic from disk
 	pic = NULL;
 	palette = NULL;
+	mark = ri.Load_GetMark ();
 
 	// PCX/TGA types only; WAL is sent directly through GL_LoadWal
 	if (!strcmp (name + len - 4, ".pcx"))
@@ -441,7 +506,10 @@ image_t *GL_FindImage (char *name, imagetype_t type)
 		LoadPCX (name, &pic, &palette, &width, &height);
 
 		if (!pic)
+		{
+			ri.Load_FreeToMark (mark);
 			return NULL;
+		}
 
 		// skins use the solid palette; everything else has alpha
 		if (type == it_skin)
@@ -463,7 +531,7 @@ image_t *GL_FindImage (char *name, imagetype_t type)
 	}
 
 	// free any memory used for loading
-	ri.Load_FreeMemory ();
+	ri.Load_FreeToMark (mark);
 
 	// store out the flags used for matching
 	image->texinfoflags = 0;
@@ -514,9 +582,13 @@ void R_FreeUnusedImages (void)
 		// disposable type
 		if (image->flags & TEX_DISPOSABLE)
 		{
+			// an image that's still streaming must finish before it can be freed
+			R_FinishStreamedImage (image);
+
 			SAFE_RELEASE (image->Texture);
 			SAFE_RELEASE (image->SRV);
 
+			NameIndex_Free (&r_imageindex, i);
 			memset (image, 0, sizeof (*image));
 		}
 	}
@@ -531,7 +603,9 @@ R_InitImages
 void R_InitImages (void)
 {
 	r_registration_sequence = 1;
+	R_InitImageKernels ();
 	Draw_GetPalette ();
+	R_InitTextureStream ();
 }
 
 
@@ -545,6 +619,9 @@ void R_ShutdownImages (void)
 	int		i;
 	image_t	*image;
 
+	// all jobs must be retired before the images they're loading into go away
+	R_ShutdownTextureStream ();
+
 	for (i = 0, image = gltextures; i < MAX_GLTEXTURES; i++, image++)
 	{
 		SAFE_RELEASE (image->Texture);
@@ -553,6 +630,7 @@ void R_ShutdownImages (void)
 		memset (image, 0, sizeof (*image));
 	}
 
+	NameIndex_Clear (&r_imageindex);
 	Draw_ShutdownRawImage ();
 }
 
@@ -560,6 +638,7 @@ void R_ShutdownImages (void)
 image_t *R_LoadTexArray (char *base)
 {
 	int i;
+	int mark = ri.Load_GetMark ();
 	image_t *image = NULL;
 	char *sb_nums[11] = {"_0", "_1", "_2", "_3", "_4", "_5", "_6", "_7", "_8", "_9", "_minus"};
 
@@ -595,7 +674,7 @@ image_t *R_LoadTexArray (char *base)
 	if (FAILED (d3d_Device->lpVtbl->CreateShaderResourceView (d3d_Device, (ID3D11Resource *) image->Texture, NULL, &image->SRV))) ri.Sys_Error (ERR_FATAL, "CreateShaderResourceView failed");
 
 	// free memory used for loading the image
-	ri.Load_FreeMemory ();
+	ri.Load_FreeToMark (mark);
 
 	return image;
 }
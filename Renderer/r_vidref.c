@@ -53,6 +53,11 @@ void R_Register (void)
 	vid_width = ri.Cvar_Get ("vid_width", "640", CVAR_ARCHIVE | CVAR_VIDEO, NULL);
 	vid_height = ri.Cvar_Get ("vid_height", "480", CVAR_ARCHIVE | CVAR_VIDEO, NULL);
 	vid_vsync = ri.Cvar_Get ("vid_vsync", "0", CVAR_ARCHIVE, NULL);
+
+	r_simd = ri.Cvar_Get ("r_simd", "2", 0, R_InitImageKernels);
+	r_texturestream = ri.Cvar_Get ("r_texturestream", "1", 0, NULL);
+
+	ri.Cmd_AddCommand ("imagebench", R_ImageBench_f);
 }
 
 
@@ -169,9 +174,12 @@ R_Shutdown
 */
 void R_Shutdown (void)
 {
+	ri.Cmd_RemoveCommand ("imagebench");
+
 	Mod_FreeAll ();
 
 	R_ShutdownImages ();
+	R_ShutdownLocalMatrix ();
 
 	// shut down OS specific OpenGL stuff like contexts, etc.
 	GLimp_Shutdown ();
@@ -254,6 +262,9 @@ refexport_t GetRefAPI (refimport_t rimp)
 	// first of all, if one existed from a previous refresh, destroy it
 	if (hRefHeap)
 	{
+		// anything still pointing into it has to forget it, as a new heap can come back with the same handle
+		R_ShutdownLocalMatrix ();
+
 		HeapDestroy (hRefHeap);
 		hRefHeap = NULL;
 	}